@@ -0,0 +1,90 @@
+#include <vector>
+#include <string>
+#include "benchmark_utilities.h"
+#include "MatrixOperations.h"
+#include "ActivationKernels.h"
+#include "RandomStream.h"
+
+namespace
+{
+	// square single precision matrix product, items are floating point operations
+	void AddMatrixMultiplyBenchmark(size_t size)
+	{
+		RegisterBenchmark("MatrixMultiply<float>/" + std::to_string(size) + "x" + std::to_string(size), [=](BenchmarkState& state)
+		{
+			std::vector<size_t> dims(2, size);
+			std::shared_ptr< Tensor<float> > a = CreateRandomTensor<float>(dims);
+			std::shared_ptr< Tensor<float> > b = CreateRandomTensor<float>(dims);
+			Tensor<float> c(dims);
+			while (state.KeepRunning())
+				MatrixMultiply<float>(CblasColMajor, CblasNoTrans, CblasNoTrans, size, size, size, 1,
+					a->GetStartPtr(), size, b->GetStartPtr(), size, 0, c.GetStartPtr(), size);
+			state.SetItemsProcessed(2.0*size*size*size*state.GetIterations());
+			state.SetLabel("flops");
+		});
+	}
+
+	template <class Activation>
+	void AddActivationBenchmarks(const std::string& name, size_t num_elements)
+	{
+		std::string suffix = "/" + std::to_string(num_elements);
+		RegisterBenchmark("ElementwiseActivation<" + name + ">/fprop" + suffix, [=](BenchmarkState& state)
+		{
+			std::shared_ptr< Tensor<float> > input = CreateRandomTensor<float>(std::vector<size_t>(1, num_elements));
+			std::vector<float> output(num_elements);
+			while (state.KeepRunning())
+				ElementwiseActivation<Activation, float>::fprop(input->GetStartPtr(), output.data(), num_elements);
+			state.SetItemsProcessed(static_cast<double>(num_elements)*state.GetIterations());
+		});
+		RegisterBenchmark("ElementwiseActivation<" + name + ">/bprop" + suffix, [=](BenchmarkState& state)
+		{
+			std::shared_ptr< Tensor<float> > input = CreateRandomTensor<float>(std::vector<size_t>(1, num_elements));
+			std::shared_ptr< Tensor<float> > output_gradients = CreateRandomTensor<float>(std::vector<size_t>(1, num_elements));
+			std::vector<float> output(num_elements), input_gradients(num_elements);
+			ElementwiseActivation<Activation, float>::fprop(input->GetStartPtr(), output.data(), num_elements);
+			while (state.KeepRunning())
+				ElementwiseActivation<Activation, float>::bprop(input->GetStartPtr(), output.data(), output_gradients->GetStartPtr(),
+					input_gradients.data(), num_elements);
+			state.SetItemsProcessed(static_cast<double>(num_elements)*state.GetIterations());
+		});
+	}
+
+	// bulk fills of RandomStream, e.g. the dropout mask of a minibatch
+	void AddRandomStreamBenchmarks(size_t num_elements)
+	{
+		std::string suffix = "/" + std::to_string(num_elements);
+		RegisterBenchmark("RandomStream/FillBernoulli<float>" + suffix, [=](BenchmarkState& state)
+		{
+			RandomStream stream;
+			std::vector<float> mask(num_elements);
+			while (state.KeepRunning())
+				stream.FillBernoulli(mask.data(), num_elements, 0.5);
+			state.SetItemsProcessed(static_cast<double>(num_elements)*state.GetIterations());
+		});
+		RegisterBenchmark("RandomStream/FillNormal<float>" + suffix, [=](BenchmarkState& state)
+		{
+			RandomStream stream;
+			std::vector<float> values(num_elements);
+			while (state.KeepRunning())
+				stream.FillNormal(values.data(), num_elements, 0.0f, 1.0f);
+			state.SetItemsProcessed(static_cast<double>(num_elements)*state.GetIterations());
+		});
+	}
+}
+
+void RegisterKernelBenchmarks()
+{
+	AddMatrixMultiplyBenchmark(64);
+	AddMatrixMultiplyBenchmark(256);
+	AddMatrixMultiplyBenchmark(1024);
+
+	const size_t num_elements = 1 << 20;
+	AddActivationBenchmarks<TanhActivation>("tanh", num_elements);
+	AddActivationBenchmarks<SigmoidActivation>("sigmoid", num_elements);
+	AddActivationBenchmarks<RluActivation>("rlu", num_elements);
+	AddActivationBenchmarks<SoftSignActivation>("softsign", num_elements);
+	AddActivationBenchmarks<AbsActivation>("abs", num_elements);
+
+	// a minibatch of 1000 samples with 4096 features
+	AddRandomStreamBenchmarks(1000*4096);
+}
@@ -0,0 +1,189 @@
+#include <vector>
+#include <string>
+#include <memory>
+#include "benchmark_utilities.h"
+#include "GaussianInitializer.h"
+#include "LinearMixModule.h"
+#include "KernelModule.h"
+#include "KernelFactory.h"
+#include "SoftmaxModule.h"
+#include "PureSoftmaxModule.h"
+#include "BatchSoftmaxModule.h"
+#include "BatchPureSoftmaxModule.h"
+#include "MeanStdNormalizingModule.h"
+#include "DropoutModule.h"
+#include "TanhModule.h"
+#include "SigmoidModule.h"
+#include "RectifiedLinearUnitModule.h"
+#include "SoftSignModule.h"
+#include "AbsModule.h"
+
+namespace
+{
+	typedef std::function< std::shared_ptr< Module<float> >() > ModuleCreator;
+
+	std::string DimsToString(const std::vector<size_t>& dims)
+	{
+		std::string res;
+		for (size_t i=0; i<dims.size(); i++)
+			res += (i==0 ? "" : "x") + std::to_string(dims[i]);
+		return res;
+	}
+
+	// registers fprop and bprop benchmarks of the module for each minibatch size, the items are samples.
+	// sample_dims are the dimensions of the input of one sample
+	void AddModuleBenchmarks(const std::string& name, const ModuleCreator& create_module, const std::vector<size_t>& sample_dims)
+	{
+		const size_t minibatch_sizes[] = {1, 32, 256};
+		for (size_t i=0; i<sizeof(minibatch_sizes)/sizeof(minibatch_sizes[0]); i++)
+		{
+			size_t minibatch_size = minibatch_sizes[i];
+			std::vector<size_t> input_dims = sample_dims;
+			input_dims.push_back(minibatch_size);
+			std::string suffix = "/" + DimsToString(sample_dims) + "/batch:" + std::to_string(minibatch_size);
+
+			RegisterBenchmark(name + "/fprop" + suffix, [=](BenchmarkState& state)
+			{
+				std::shared_ptr< Module<float> > module = create_module();
+				module->InitializeParameters();
+				std::shared_ptr< Tensor<float> > input = CreateRandomTensor<float>(input_dims);
+				while (state.KeepRunning())
+					module->train_fprop(input);
+				state.SetItemsProcessed(static_cast<double>(minibatch_size)*state.GetIterations());
+			});
+
+			RegisterBenchmark(name + "/bprop" + suffix, [=](BenchmarkState& state)
+			{
+				std::shared_ptr< Module<float> > module = create_module();
+				module->InitializeParameters();
+				std::shared_ptr< Tensor<float> > input = CreateRandomTensor<float>(input_dims);
+				std::shared_ptr< Tensor<float> > output = module->train_fprop(input);
+				std::shared_ptr< Tensor<float> > output_gradients = CreateRandomTensor<float>(output->GetDimensions());
+				std::vector<float> importances(minibatch_size, 1);
+				while (state.KeepRunning())
+					module->bprop(output_gradients, importances);
+				state.SetItemsProcessed(static_cast<double>(minibatch_size)*state.GetIterations());
+			});
+		}
+	}
+
+	void AddLinearMixBenchmarks(size_t num_inputs, size_t num_outputs, ActivationType fused_activation)
+	{
+		std::string name = "LinearMixModule";
+		if (fused_activation != no_activation)
+			name += "+" + GetActivationName(fused_activation);
+		AddModuleBenchmarks(name, [=]() -> std::shared_ptr< Module<float> >
+		{
+			std::shared_ptr<ParametersInitializer<float>> initializer(new GaussianInitializer<float>(0.01));
+			std::shared_ptr< Module<float> > module( new LinearMixModule<float>("module", num_inputs, num_outputs, initializer) );
+			module->FuseActivation(fused_activation);
+			return module;
+		}, std::vector<size_t>(1, num_inputs));
+	}
+
+	// images of size x size pixels with num_input_channels channels
+	void AddConvolutionBenchmarks(size_t size, size_t num_input_channels, size_t kernel_size, size_t num_kernels)
+	{
+		std::vector<size_t> sample_dims; sample_dims.push_back(size); sample_dims.push_back(size); sample_dims.push_back(num_input_channels);
+		std::vector<size_t> kernel_dims; kernel_dims.push_back(kernel_size); kernel_dims.push_back(kernel_size); kernel_dims.push_back(num_input_channels);
+		std::vector<size_t> strides(3, 1);
+		AddModuleBenchmarks("KernelModule<convolutional " + DimsToString(kernel_dims) + "x" + std::to_string(num_kernels) + ">",
+			[=]() -> std::shared_ptr< Module<float> >
+		{
+			std::shared_ptr<ParametersInitializer<float>> initializer(new GaussianInitializer<float>(0.01));
+			return std::shared_ptr< Module<float> >( new KernelModule<float>("module", num_kernels, kernel_dims, strides,
+				ConvolutionalKernelFactory<float>(), initializer) );
+		}, sample_dims);
+	}
+
+	void AddMaxPoolingBenchmarks(size_t size, size_t num_channels, size_t pooling_size)
+	{
+		std::vector<size_t> sample_dims; sample_dims.push_back(size); sample_dims.push_back(size); sample_dims.push_back(num_channels);
+		std::vector<size_t> kernel_dims; kernel_dims.push_back(pooling_size); kernel_dims.push_back(pooling_size); kernel_dims.push_back(1);
+		std::vector<size_t> strides = kernel_dims;
+		AddModuleBenchmarks("KernelModule<max_pooling " + DimsToString(kernel_dims) + ">", [=]() -> std::shared_ptr< Module<float> >
+		{
+			return std::shared_ptr< Module<float> >( new KernelModule<float>("module", 1, kernel_dims, strides, MaxPoolingKernelFactory<float>()) );
+		}, sample_dims);
+	}
+
+	// long 1-D signals (e.g. audio) downsampled by wide overlapping windows, the running sums do not depend on the window size
+	void AddAveragePoolingBenchmarks(size_t length, size_t window, size_t stride)
+	{
+		std::vector<size_t> sample_dims; sample_dims.push_back(length); sample_dims.push_back(1);
+		std::vector<size_t> kernel_dims; kernel_dims.push_back(window); kernel_dims.push_back(1);
+		std::vector<size_t> strides; strides.push_back(stride); strides.push_back(1);
+		AddModuleBenchmarks("KernelModule<average_pooling " + DimsToString(kernel_dims) + "/" + std::to_string(stride) + ">", [=]() -> std::shared_ptr< Module<float> >
+		{
+			return std::shared_ptr< Module<float> >( new KernelModule<float>("module", 1, kernel_dims, strides, AveragePoolingKernelFactory<float>()) );
+		}, sample_dims);
+		AddModuleBenchmarks("KernelModule<l2_pooling " + DimsToString(kernel_dims) + "/" + std::to_string(stride) + ">", [=]() -> std::shared_ptr< Module<float> >
+		{
+			return std::shared_ptr< Module<float> >( new KernelModule<float>("module", 1, kernel_dims, strides, L2PoolingKernelFactory<float>()) );
+		}, sample_dims);
+	}
+
+	template <class ModuleType>
+	void AddParameterlessModuleBenchmarks(const std::string& name, size_t num_features)
+	{
+		AddModuleBenchmarks(name, []() -> std::shared_ptr< Module<float> >
+		{
+			return std::shared_ptr< Module<float> >( new ModuleType("module") );
+		}, std::vector<size_t>(1, num_features));
+	}
+
+	// the softmax modules use vectorized_exp by default
+	template <class ModuleType>
+	void AddSoftmaxBenchmarks(const std::string& name, size_t num_features, ExpPrecision exp_precision)
+	{
+		AddModuleBenchmarks(name + "<" + GetExpPrecisionName(exp_precision) + "_exp>", [=]() -> std::shared_ptr< Module<float> >
+		{
+			std::shared_ptr<ModuleType> module( new ModuleType("module") );
+			module->SetExpPrecision(exp_precision);
+			return module;
+		}, std::vector<size_t>(1, num_features));
+	}
+}
+
+void RegisterModuleBenchmarks()
+{
+	AddLinearMixBenchmarks(256, 256, no_activation);
+	AddLinearMixBenchmarks(1024, 1024, no_activation);
+	AddLinearMixBenchmarks(1024, 1024, rlu_activation);
+
+	AddConvolutionBenchmarks(32, 8, 5, 16);
+	AddMaxPoolingBenchmarks(32, 16, 2);
+	AddAveragePoolingBenchmarks(4000, 40, 20);
+
+	const size_t num_classes[] = {10, 1000};
+	for (size_t i=0; i<sizeof(num_classes)/sizeof(num_classes[0]); i++)
+	{
+		AddParameterlessModuleBenchmarks< SoftmaxModule<float> >("SoftmaxModule", num_classes[i]);
+		AddParameterlessModuleBenchmarks< PureSoftmaxModule<float> >("PureSoftmaxModule", num_classes[i]);
+		AddParameterlessModuleBenchmarks< BatchSoftmaxModule<float> >("BatchSoftmaxModule", num_classes[i]);
+		AddParameterlessModuleBenchmarks< BatchPureSoftmaxModule<float> >("BatchPureSoftmaxModule", num_classes[i]);
+		AddSoftmaxBenchmarks< SoftmaxModule<float> >("SoftmaxModule", num_classes[i], precise_exp);
+		AddSoftmaxBenchmarks< SoftmaxModule<float> >("SoftmaxModule", num_classes[i], fast_exp);
+		AddSoftmaxBenchmarks< BatchSoftmaxModule<float> >("BatchSoftmaxModule", num_classes[i], fast_exp);
+	}
+
+	const size_t num_features = 1024;
+	AddModuleBenchmarks("MeanStdNormalizingModule", [=]() -> std::shared_ptr< Module<float> >
+	{
+		return std::shared_ptr< Module<float> >( new MeanStdNormalizingModule<float>("module", num_features) );
+	}, std::vector<size_t>(1, num_features));
+	AddModuleBenchmarks("DropoutModule", []() -> std::shared_ptr< Module<float> >
+	{
+		return std::shared_ptr< Module<float> >( new DropoutModule<float>("module", 0.5) );
+	}, std::vector<size_t>(1, num_features));
+	AddModuleBenchmarks("DropoutModule<inverted>", []() -> std::shared_ptr< Module<float> >
+	{
+		return std::shared_ptr< Module<float> >( new DropoutModule<float>("module", 0.5, true) );
+	}, std::vector<size_t>(1, num_features));
+
+	AddParameterlessModuleBenchmarks< TanhModule<float> >("TanhModule", num_features);
+	AddParameterlessModuleBenchmarks< SigmoidModule<float> >("SigmoidModule", num_features);
+	AddParameterlessModuleBenchmarks< RectifiedLinearUnitModule<float> >("RectifiedLinearUnitModule", num_features);
+	AddParameterlessModuleBenchmarks< SoftSignModule<float> >("SoftSignModule", num_features);
+	AddParameterlessModuleBenchmarks< AbsModule<float> >("AbsModule", num_features);
+}
@@ -0,0 +1,170 @@
+#include <vector>
+#include <string>
+#include <memory>
+#include "benchmark_utilities.h"
+#include "GaussianInitializer.h"
+#include "LinearMixModule.h"
+#include "BiasModule.h"
+#include "RectifiedLinearUnitModule.h"
+#include "SoftmaxModule.h"
+#include "CompositeModule.h"
+#include "ActivationFusion.h"
+#include "CrossEntropyCostModule.h"
+#include "FullTensorDataLoader.h"
+#include "TrainDataset.h"
+#include "SGD_Trainer.h"
+#include "HogwildTrainer.h"
+#include "NN.h"
+#include "InferenceNN.h"
+
+namespace
+{
+	const size_t num_inputs = 784;
+	const size_t num_hidden = 256;
+	const size_t num_classes = 10;
+	const std::string network_name = "mlp_784_256_256_10";
+
+	// two hidden rectified linear layers and softmax output, the activations are fused
+	std::shared_ptr< CompositeModule<float> > CreateNetwork()
+	{
+		std::shared_ptr<ParametersInitializer<float>> initializer(new GaussianInitializer<float>(0.01));
+		std::vector< std::shared_ptr< Module<float> > > modules;
+		size_t layer_inputs[] = {num_inputs, num_hidden, num_hidden};
+		size_t layer_outputs[] = {num_hidden, num_hidden, num_classes};
+		for (size_t i=0; i<3; i++)
+		{
+			std::string layer = std::to_string(i+1);
+			modules.push_back(std::shared_ptr< Module<float> >( new LinearMixModule<float>("linear_mix" + layer, layer_inputs[i], layer_outputs[i], initializer) ));
+			modules.push_back(std::shared_ptr< Module<float> >( new BiasModule<float>("bias" + layer, std::vector<size_t>(1, layer_outputs[i]), initializer) ));
+			if (i < 2)
+				modules.push_back(std::shared_ptr< Module<float> >( new RectifiedLinearUnitModule<float>("rlu" + layer) ));
+		}
+		modules.push_back(std::shared_ptr< Module<float> >( new SoftmaxModule<float>("softmax") ));
+		modules = FuseActivations(modules);
+		return std::shared_ptr< CompositeModule<float> >( new CompositeModule<float>("network", modules) );
+	}
+
+	// random inputs and one hot outputs
+	std::shared_ptr< ITrainDataset<float> > CreateDataset(size_t num_samples)
+	{
+		std::vector< std::shared_ptr< Tensor<float> > > inputs(num_samples), outputs(num_samples);
+		for (size_t i=0; i<num_samples; i++)
+		{
+			inputs[i] = CreateRandomTensor<float>(std::vector<size_t>(1, num_inputs));
+			outputs[i] = std::shared_ptr< Tensor<float> >( new Tensor<float>(std::vector<size_t>(1, num_classes)) );
+			outputs[i]->SetZeros();
+			(*outputs[i])[i % num_classes] = 1;
+		}
+		std::shared_ptr< ITensorDataLoader<float> > input_loader( new FullTensorDataLoader<float,float>(inputs) );
+		std::shared_ptr< ITensorDataLoader<float> > output_loader( new FullTensorDataLoader<float,float>(outputs) );
+		std::vector<float> importance(num_samples, 1);
+		return std::shared_ptr< ITrainDataset<float> >( new TrainDataset<float>(input_loader, output_loader, importance) );
+	}
+
+	// the samples of the batch are split into minibatches of the network, which are processed by num_threads threads
+	void AddGradientsBenchmark(size_t batch_size, size_t minibatch_size, size_t num_threads)
+	{
+		RegisterBenchmark("NN::GetGradientsAndCost/" + network_name + "/batch:" + std::to_string(batch_size) + "/minibatch:" + std::to_string(minibatch_size)
+			+ "/threads:" + std::to_string(num_threads), [=](BenchmarkState& state)
+		{
+			std::shared_ptr< ITrainDataset<float> > dataset = CreateDataset(batch_size);
+			std::shared_ptr< CompositeModule<float> > network = CreateNetwork();
+			NN<float> net(network, minibatch_size);
+			net.SetNumThreads(num_threads);
+			net.InitializeParameters();
+			CrossEntropyCostModule<float> cost_module;
+			std::vector<size_t> indices = dataset->SelectIndices(batch_size);
+			while (state.KeepRunning())
+				net.GetGradientsAndCost(*dataset, cost_module, indices);
+			state.SetItemsProcessed(static_cast<double>(batch_size)*state.GetIterations());
+		});
+	}
+
+	// the network in predict mode and its frozen inference copy, the items are samples
+	void AddPredictBenchmarks(size_t batch_size)
+	{
+		RegisterBenchmark("CompositeModule::predict_fprop/" + network_name + "/batch:" + std::to_string(batch_size), [=](BenchmarkState& state)
+		{
+			std::shared_ptr< CompositeModule<float> > network = CreateNetwork();
+			network->InitializeParameters();
+			std::vector<size_t> input_dims(1, num_inputs);
+			input_dims.push_back(batch_size);
+			std::shared_ptr< Tensor<float> > input = CreateRandomTensor<float>(input_dims);
+			while (state.KeepRunning())
+				network->predict_fprop(input);
+			state.SetItemsProcessed(static_cast<double>(batch_size)*state.GetIterations());
+		});
+
+		RegisterBenchmark("InferenceNN::Predict/" + network_name + "/batch:" + std::to_string(batch_size), [=](BenchmarkState& state)
+		{
+			std::shared_ptr< CompositeModule<float> > network = CreateNetwork();
+			network->InitializeParameters();
+			InferenceNN<float> inference_nn(*network, std::vector<size_t>(1, num_inputs), batch_size);
+			std::vector<size_t> input_dims(1, num_inputs);
+			input_dims.push_back(batch_size);
+			std::shared_ptr< Tensor<float> > input = CreateRandomTensor<float>(input_dims);
+			std::vector<float> output(batch_size*num_classes);
+			while (state.KeepRunning())
+				inference_nn.Predict(input->GetStartPtr(), batch_size, output.data());
+			state.SetItemsProcessed(static_cast<double>(batch_size)*state.GetIterations());
+		});
+	}
+
+	// items are SGD iterations. Train also computes the costs of the train and validation sets before the first iteration,
+	// the sets are small enough that it takes a few percents of the time
+	void AddTrainerBenchmark(size_t batch_size)
+	{
+		RegisterBenchmark("SGD_Trainer/" + network_name + "/batch:" + std::to_string(batch_size), [=](BenchmarkState& state)
+		{
+			const size_t num_iterations = 200;
+			std::shared_ptr< ITrainDataset<float> > train_set = CreateDataset(1000);
+			std::shared_ptr< ITrainDataset<float> > validation_set = CreateDataset(100);
+			std::shared_ptr< CompositeModule<float> > network = CreateNetwork();
+			NN<float> net(network, batch_size);
+			net.InitializeParameters();
+			SGD_Trainer<float> trainer(num_iterations, 0.001f, 0.9f, batch_size, 100, 0.99, 0, num_iterations+1, num_iterations+1);
+			CrossEntropyCostModule<float> cost_module;
+			while (state.KeepRunning())
+				trainer.Train(net, cost_module, cost_module, *train_set, *validation_set);
+			state.SetItemsProcessed(static_cast<double>(num_iterations)*state.GetIterations());
+			state.SetLabel("iterations");
+		});
+	}
+
+	// the same iterations as AddTrainerBenchmark, done by the asynchronous workers
+	void AddHogwildTrainerBenchmark(size_t batch_size, size_t num_threads)
+	{
+		RegisterBenchmark("HogwildTrainer/" + network_name + "/batch:" + std::to_string(batch_size) + "/threads:" + std::to_string(num_threads),
+			[=](BenchmarkState& state)
+		{
+			const size_t num_iterations = 200;
+			std::shared_ptr< ITrainDataset<float> > train_set = CreateDataset(1000);
+			std::shared_ptr< ITrainDataset<float> > validation_set = CreateDataset(100);
+			std::shared_ptr< CompositeModule<float> > network = CreateNetwork();
+			NN<float> net(network, batch_size);
+			net.InitializeParameters();
+			HogwildTrainer<float> trainer(num_iterations, 0.001f, 0.9f, batch_size, 100, 0.99, 0, num_iterations+1, num_iterations+1, num_threads);
+			CrossEntropyCostModule<float> cost_module;
+			while (state.KeepRunning())
+				trainer.Train(net, cost_module, cost_module, *train_set, *validation_set);
+			state.SetItemsProcessed(static_cast<double>(num_iterations)*state.GetIterations());
+			state.SetLabel("iterations");
+		});
+	}
+}
+
+void RegisterNNBenchmarks()
+{
+	AddGradientsBenchmark(256, 256, 1);
+	AddGradientsBenchmark(1024, 128, 1);
+	AddGradientsBenchmark(1024, 128, 4);
+
+	AddPredictBenchmarks(1);
+	AddPredictBenchmarks(64);
+
+	AddTrainerBenchmark(32);
+	AddTrainerBenchmark(128);
+	AddHogwildTrainerBenchmark(32, 1);
+	AddHogwildTrainerBenchmark(32, 2);
+	AddHogwildTrainerBenchmark(32, 4);
+}
@@ -0,0 +1,192 @@
+#include "benchmark_utilities.h"
+#include <regex>
+#include <thread>
+#include <ctime>
+#include <cstdio>
+#include <sstream>
+#include <iomanip>
+#include <algorithm>
+#include <Windows.h>
+#include "SimdOperations.h"
+
+namespace
+{
+	struct RegisteredBenchmark
+	{
+		std::string name;
+		BenchmarkFunction function;
+	};
+
+	std::vector<RegisteredBenchmark>& GetRegisteredBenchmarks()
+	{
+		static std::vector<RegisteredBenchmark> benchmarks;
+		return benchmarks;
+	}
+
+	BenchmarkResult RunBenchmark(const RegisteredBenchmark& benchmark, double min_time)
+	{
+		const size_t max_iterations = 1000000000;
+		size_t iterations = 1;
+		while (true)
+		{
+			BenchmarkState state(iterations);
+			benchmark.function(state);
+			double elapsed_time = state.GetElapsedTime();
+			if (elapsed_time >= min_time || iterations >= max_iterations)
+			{
+				BenchmarkResult result;
+				result.name = benchmark.name;
+				result.iterations = iterations;
+				result.real_time = elapsed_time / iterations;
+				result.items_per_second = elapsed_time > 0 ? state.GetItemsProcessed() / elapsed_time : 0;
+				result.label = state.GetLabel();
+				return result;
+			}
+			// aim a bit above the minimal time, but do not trust the prediction from very short runs
+			double multiplier = elapsed_time > 0 ? 1.4 * min_time / elapsed_time : 10;
+			if (elapsed_time < 0.1 * min_time)
+				multiplier = std::min(multiplier, 10.0);
+			size_t next_iterations = static_cast<size_t>(iterations * multiplier);
+			iterations = std::min(max_iterations, std::max(next_iterations, iterations+1));
+		}
+	}
+
+	std::string FormatTime(double seconds)
+	{
+		const char* units[] = {"s", "ms", "us", "ns"};
+		size_t unit_ind = 0;
+		while (unit_ind < 3 && seconds < 1)
+		{
+			seconds *= 1000;
+			unit_ind++;
+		}
+		std::ostringstream stream;
+		stream << std::fixed << std::setprecision(2) << seconds << " " << units[unit_ind];
+		return stream.str();
+	}
+
+	std::string JsonString(const std::string& str)
+	{
+		std::string res = "\"";
+		for (size_t i=0; i<str.size(); i++)
+		{
+			if (str[i] == '"' || str[i] == '\\')
+				res += '\\';
+			res += str[i];
+		}
+		return res + "\"";
+	}
+
+	std::string GetCurrentDate()
+	{
+		time_t now = time(nullptr);
+		char buffer[64];
+		strftime(buffer, sizeof(buffer), "%Y-%m-%d %H:%M:%S", localtime(&now));
+		return buffer;
+	}
+}
+
+double seconds_now()
+{
+	static LARGE_INTEGER s_frequency;
+	static BOOL s_use_qpc = QueryPerformanceFrequency(&s_frequency);
+	if (s_use_qpc) {
+		LARGE_INTEGER now;
+		QueryPerformanceCounter(&now);
+		return static_cast<double>(now.QuadPart) / s_frequency.QuadPart;
+	} else {
+		return GetTickCount() / 1000.0;
+	}
+}
+
+BenchmarkState::BenchmarkState(size_t max_iterations) : max_iterations_(max_iterations), iterations_(0), running_(false),
+	start_time_(0), elapsed_time_(0), items_processed_(0)
+{
+}
+
+bool BenchmarkState::KeepRunning()
+{
+	if (!running_ && iterations_ == 0)
+	{
+		running_ = true;
+		start_time_ = seconds_now();
+	}
+	if (iterations_ < max_iterations_)
+	{
+		iterations_++;
+		return true;
+	}
+	if (running_)
+	{
+		elapsed_time_ = seconds_now() - start_time_;
+		running_ = false;
+	}
+	return false;
+}
+
+void RegisterBenchmark(const std::string& name, const BenchmarkFunction& function)
+{
+	RegisteredBenchmark benchmark;
+	benchmark.name = name;
+	benchmark.function = function;
+	GetRegisteredBenchmarks().push_back(benchmark);
+}
+
+std::vector<BenchmarkResult> RunBenchmarks(const std::string& filter, double min_time, std::ostream& log)
+{
+	std::regex filter_regex(filter.empty() ? "." : filter);
+	std::vector<BenchmarkResult> results;
+	const std::vector<RegisteredBenchmark>& benchmarks = GetRegisteredBenchmarks();
+	for (size_t i=0; i<benchmarks.size(); i++)
+	{
+		if (!std::regex_search(benchmarks[i].name, filter_regex))
+			continue;
+		BenchmarkResult result = RunBenchmark(benchmarks[i], min_time);
+		log << std::left << std::setw(70) << result.name << std::right << std::setw(14) << FormatTime(result.real_time)
+			<< std::setw(12) << result.iterations;
+		if (result.items_per_second > 0)
+			log << "  " << std::setprecision(4) << result.items_per_second << " items/s";
+		if (!result.label.empty())
+			log << " " << result.label;
+		log << std::endl;
+		results.push_back(result);
+	}
+	return results;
+}
+
+void WriteBenchmarksJson(std::ostream& out, const std::vector<BenchmarkResult>& results)
+{
+#ifdef NDEBUG
+	std::string build_type = "release";
+#else
+	std::string build_type = "debug";
+#endif
+#ifdef NNLIB_SIMD_FLOAT
+	size_t simd_width = simd_float_width;
+#else
+	size_t simd_width = 1;
+#endif
+	out << "{\n";
+	out << "  \"context\": {\n";
+	out << "    \"date\": " << JsonString(GetCurrentDate()) << ",\n";
+	out << "    \"num_cpus\": " << std::thread::hardware_concurrency() << ",\n";
+	out << "    \"library_build_type\": " << JsonString(build_type) << ",\n";
+	out << "    \"simd_float_width\": " << simd_width << "\n";
+	out << "  },\n";
+	out << "  \"benchmarks\": [";
+	for (size_t i=0; i<results.size(); i++)
+	{
+		const BenchmarkResult& result = results[i];
+		out << (i==0 ? "\n" : ",\n") << "    {\n";
+		out << "      \"name\": " << JsonString(result.name) << ",\n";
+		out << "      \"iterations\": " << result.iterations << ",\n";
+		out << "      \"real_time\": " << std::setprecision(10) << result.real_time*1e9 << ",\n";
+		out << "      \"time_unit\": \"ns\"";
+		if (result.items_per_second > 0)
+			out << ",\n      \"items_per_second\": " << std::setprecision(10) << result.items_per_second;
+		if (!result.label.empty())
+			out << ",\n      \"label\": " << JsonString(result.label);
+		out << "\n    }";
+	}
+	out << "\n  ]\n}\n";
+}
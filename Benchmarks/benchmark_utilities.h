@@ -0,0 +1,103 @@
+#ifndef BENCHMARK_UTILITIES_H
+#define BENCHMARK_UTILITIES_H
+
+#include <vector>
+#include <string>
+#include <memory>
+#include <ostream>
+#include <functional>
+#include "Tensor.h"
+#include "RandomGenerator.h"
+
+// Minimal benchmark framework in the style of Google Benchmark. A benchmark function prepares its data,
+// then runs the measured code in the loop while (state.KeepRunning()). The number of iterations is increased
+// until the measured time exceeds the minimal time, the results are written as JSON in the format of Google Benchmark
+
+class BenchmarkState
+{
+	size_t max_iterations_;
+	size_t iterations_;
+	bool running_;
+	double start_time_;
+	double elapsed_time_;
+	double items_processed_;
+	std::string label_;
+
+public:
+	explicit BenchmarkState(size_t max_iterations);
+
+	// starts the timer at the first call and stops it when max_iterations iterations are done
+	bool KeepRunning();
+
+	size_t GetIterations() const
+	{
+		return iterations_;
+	}
+
+	// seconds between the first and the last call of KeepRunning
+	double GetElapsedTime() const
+	{
+		return elapsed_time_;
+	}
+
+	// reported as items_per_second, e.g. samples or floating point operations processed by all the iterations
+	void SetItemsProcessed(double items_processed)
+	{
+		items_processed_ = items_processed;
+	}
+
+	double GetItemsProcessed() const
+	{
+		return items_processed_;
+	}
+
+	// describes the items
+	void SetLabel(const std::string& label)
+	{
+		label_ = label;
+	}
+
+	const std::string& GetLabel() const
+	{
+		return label_;
+	}
+};
+
+typedef std::function<void(BenchmarkState&)> BenchmarkFunction;
+
+struct BenchmarkResult
+{
+	std::string name;
+	size_t iterations;
+	// seconds per iteration
+	double real_time;
+	// 0 if the benchmark did not set the processed items
+	double items_per_second;
+	std::string label;
+};
+
+void RegisterBenchmark(const std::string& name, const BenchmarkFunction& function);
+
+// runs the registered benchmarks whose names match the filter (ECMAScript regex, all if empty) for at least min_time seconds each,
+// a line per benchmark is printed to the log
+std::vector<BenchmarkResult> RunBenchmarks(const std::string& filter, double min_time, std::ostream& log);
+
+void WriteBenchmarksJson(std::ostream& out, const std::vector<BenchmarkResult>& results);
+
+double seconds_now();
+
+template <class DataType>
+std::shared_ptr< Tensor<DataType> > CreateRandomTensor(const std::vector<size_t>& tensor_dims, double min_val=-1, double max_val=1)
+{
+	std::shared_ptr< Tensor<DataType> > tensor( new Tensor<DataType>(tensor_dims) );
+	for (size_t i=0; i<tensor->Numel(); i++)
+		(*tensor)[i] = static_cast<DataType>(RandomGenerator::GetUniformDouble(min_val, max_val));
+	return tensor;
+}
+
+// benchmarks of each group, defined in benchmark_<group>.cpp
+void RegisterKernelBenchmarks();
+void RegisterModuleBenchmarks();
+void RegisterNNBenchmarks();
+
+#endif
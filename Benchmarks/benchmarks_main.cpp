@@ -0,0 +1,54 @@
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <cstdlib>
+#include "benchmark_utilities.h"
+
+// Runs the benchmarks of kernels, modules and trainers and prints the table of the results. Arguments:
+// --benchmark_filter=<regex>    run only the benchmarks whose names match
+// --benchmark_min_time=<sec>    minimal measured time of each benchmark, 0.5 by default
+// --benchmark_out=<file>        writes the results as JSON to the file, - for the standard output, no JSON by default
+int main( int argc, char* argv[])
+{
+	std::string filter;
+	double min_time = 0.5;
+	std::string output_file;
+	for (int i=1; i<argc; i++)
+	{
+		std::string arg = argv[i];
+		if (arg.find("--benchmark_filter=") == 0)
+			filter = arg.substr(std::string("--benchmark_filter=").size());
+		else if (arg.find("--benchmark_min_time=") == 0)
+			min_time = std::atof(arg.substr(std::string("--benchmark_min_time=").size()).c_str());
+		else if (arg.find("--benchmark_out=") == 0)
+			output_file = arg.substr(std::string("--benchmark_out=").size());
+		else
+		{
+			std::cerr << "Unknown argument " << arg << std::endl;
+			std::cerr << "Usage: " << argv[0] << " [--benchmark_filter=<regex>] [--benchmark_min_time=<seconds>] [--benchmark_out=<file>]" << std::endl;
+			return 1;
+		}
+	}
+
+	RegisterKernelBenchmarks();
+	RegisterModuleBenchmarks();
+	RegisterNNBenchmarks();
+
+	// the table goes to the error stream if the standard output is used for JSON
+	std::ostream& log = output_file == "-" ? std::cerr : std::cout;
+	std::vector<BenchmarkResult> results = RunBenchmarks(filter, min_time, log);
+
+	if (output_file == "-")
+		WriteBenchmarksJson(std::cout, results);
+	else if (!output_file.empty())
+	{
+		std::ofstream out(output_file);
+		if (!out)
+		{
+			std::cerr << "Can not open " << output_file << std::endl;
+			return 1;
+		}
+		WriteBenchmarksJson(out, results);
+	}
+	return 0;
+}
@@ -2,6 +2,7 @@
 #define ABS_MODULE_H
 
 #include "Module.h"
+#include "ActivationKernels.h"
 
 template <class ParamsType>
 class AbsModule : public Module<ParamsType>
@@ -21,6 +22,26 @@ public:
 	{
 		return module.GetType() == GetType() && module.GetName() == GetName();
 	}
+
+	virtual bool OverwritesOutputBuffer() const
+	{
+		return true;
+	}
+
+	virtual bool OverwritesInputGradientsBuffer() const
+	{
+		return true;
+	}
+
+	virtual ActivationType GetActivationType() const
+	{
+		return abs_activation;
+	}
+
+	virtual bool BpropUsesOutput() const
+	{
+		return false;
+	}
 	
 	static std::shared_ptr< Module< ParamsType> > Create(IOTreeNode& data);
 
@@ -49,10 +70,7 @@ std::shared_ptr< Module< ParamsType> > AbsModule<ParamsType>::Create(IOTreeNode&
 template <class ParamsType>
 void AbsModule<ParamsType>::sub_train_fprop(const std::shared_ptr< Tensor<ParamsType> >& input, std::shared_ptr< Tensor<ParamsType> >& output)
 {
-	const Tensor<ParamsType>& input_tensor = *input;
-	Tensor<ParamsType>& output_tensor = *output;
-	for (size_t i = 0; i<input->Numel(); i++)
-		output_tensor[i] = std::abs(input_tensor[i]);
+	ElementwiseActivation<AbsActivation, ParamsType>::fprop(input->GetStartPtr(), output->GetStartPtr(), input->Numel());
 }
 
 template <class ParamsType>
@@ -60,14 +78,8 @@ void AbsModule<ParamsType>::sub_bprop(const std::shared_ptr< Tensor<ParamsType>
 	std::shared_ptr< Tensor<ParamsType> >& input_gradients, const std::shared_ptr< Tensor<ParamsType> >& output_gradients, 
 	const std::vector<ParamsType>& samples_importances)
 {
-	const Tensor<ParamsType>& input_tensor = *input;
-	Tensor<ParamsType>& input_gradients_tensor = *input_gradients;
-	const Tensor<ParamsType>& output_gradients_tensor = *output_gradients;
-	for (size_t i = 0; i<input->Numel(); i++)
-	{
-		ParamsType in = input_tensor[i];
-		input_gradients_tensor[i] = (in>0?1:-1)*output_gradients_tensor[i];
-	}
+	ElementwiseActivation<AbsActivation, ParamsType>::bprop(input->GetStartPtr(), output->GetStartPtr(), output_gradients->GetStartPtr(), 
+		input_gradients->GetStartPtr(), input->Numel());
 }
 
 #endif
\ No newline at end of file
@@ -0,0 +1,84 @@
+#ifndef ACTIVATION_FUSION_H
+#define ACTIVATION_FUSION_H
+
+#include <vector>
+#include <memory>
+#include "Module.h"
+#include "ActivationKernels.h"
+
+// Activation applied in place to the output of a module (LinearMixModule, BiasModule) while it is in cache,
+// instead of a separate activation module with its own output and input gradients buffers
+template <class ParamsType>
+class FusedActivation
+{
+	ActivationType activation_;
+	// gradients with respect to the output of the module before the activation
+	std::shared_ptr< Tensor<ParamsType> > gradients_;
+
+public:
+	FusedActivation() : activation_(no_activation)
+	{
+	}
+
+	ActivationType GetType() const
+	{
+		return activation_;
+	}
+
+	// only one activation can be fused, and only if its gradient is computed from its output
+	bool Set(ActivationType activation)
+	{
+		if (activation_ != no_activation || !IsFusableActivation(activation))
+			return false;
+		activation_ = activation;
+		return true;
+	}
+
+	void fprop(ParamsType* data, size_t num_elements) const
+	{
+		if (activation_ != no_activation)
+			ActivationFprop(activation_, data, data, num_elements);
+	}
+
+	// gradients with respect to the output of the module before the activation, output_gradients if there is no activation
+	std::shared_ptr< Tensor<ParamsType> > bprop(const std::shared_ptr< Tensor<ParamsType> >& output, const std::shared_ptr< Tensor<ParamsType> >& output_gradients)
+	{
+		if (activation_ == no_activation)
+			return output_gradients;
+		if (!gradients_ || !gradients_->DimensionsEqual(*output))
+			gradients_ = std::shared_ptr< Tensor<ParamsType> >( new Tensor<ParamsType>(output->GetShape()) );
+		ActivationBprop(activation_, output->GetStartPtr(), output->GetStartPtr(), output_gradients->GetStartPtr(), 
+			gradients_->GetStartPtr(), output->Numel());
+		return gradients_;
+	}
+
+	// the attribute is written only for fused activations, so states of modules without them do not change
+	void GetState(IOTreeNode& node) const
+	{
+		if (activation_ != no_activation)
+			node.attributes().AppendEntry( "fused_activation", GetActivationName(activation_) );
+	}
+
+	void SetState(IOTreeNode& node)
+	{
+		if (node.attributes().HasEntry( "fused_activation" ))
+			Set( GetActivationByName(node.attributes().GetEntry( "fused_activation" )) );
+	}
+};
+
+// removes the activation modules that can be fused into the preceding modules (see Module::FuseActivation)
+template <class ParamsType>
+std::vector< std::shared_ptr< Module<ParamsType> > > FuseActivations(const std::vector< std::shared_ptr< Module<ParamsType> > >& modules)
+{
+	std::vector< std::shared_ptr< Module<ParamsType> > > fused_modules;
+	for (size_t i=0; i<modules.size(); i++)
+	{
+		ActivationType activation = modules[i]->GetActivationType();
+		if (activation != no_activation && !fused_modules.empty() && fused_modules.back()->FuseActivation(activation))
+			continue;
+		fused_modules.push_back(modules[i]);
+	}
+	return fused_modules;
+}
+
+#endif
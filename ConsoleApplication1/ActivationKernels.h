@@ -0,0 +1,269 @@
+#ifndef ACTIVATION_KERNELS_H
+#define ACTIVATION_KERNELS_H
+
+#include <cmath>
+#include <string>
+#include <stdexcept>
+#include "SimdOperations.h"
+
+// Elementwise activation functions used by the activation modules and fused into LinearMixModule and BiasModule.
+// Each function has scalar fprop and bprop, and vectorized versions for floats if NNLIB_SIMD_FLOAT is defined
+
+struct TanhActivation
+{
+	template <class T>
+	static T fprop(T input)
+	{
+		return static_cast<T>(2.0 / (1.0 + std::exp(-2*input)) - 1);
+	}
+
+	template <class T>
+	static T bprop(T input, T output, T output_gradient)
+	{
+		return (1-output*output)*output_gradient;
+	}
+
+#ifdef NNLIB_SIMD_FLOAT
+	static SimdFloat fprop(SimdFloat input)
+	{
+		SimdFloat one = SimdSet(1.0f);
+		return SimdSub( SimdDiv(SimdSet(2.0f), SimdAdd(one, SimdExp(SimdMul(input, SimdSet(-2.0f))))), one );
+	}
+
+	static SimdFloat bprop(SimdFloat input, SimdFloat output, SimdFloat output_gradient)
+	{
+		return SimdMul( SimdSub(SimdSet(1.0f), SimdMul(output, output)), output_gradient );
+	}
+#endif
+};
+
+struct SigmoidActivation
+{
+	template <class T>
+	static T fprop(T input)
+	{
+		return static_cast<T>(1.0 / (1.0 + std::exp(-input)));
+	}
+
+	template <class T>
+	static T bprop(T input, T output, T output_gradient)
+	{
+		return output*(1-output)*output_gradient;
+	}
+
+#ifdef NNLIB_SIMD_FLOAT
+	static SimdFloat fprop(SimdFloat input)
+	{
+		SimdFloat one = SimdSet(1.0f);
+		return SimdDiv( one, SimdAdd(one, SimdExp(SimdSub(SimdSet(0.0f), input))) );
+	}
+
+	static SimdFloat bprop(SimdFloat input, SimdFloat output, SimdFloat output_gradient)
+	{
+		return SimdMul( SimdMul(output, SimdSub(SimdSet(1.0f), output)), output_gradient );
+	}
+#endif
+};
+
+struct RluActivation
+{
+	template <class T>
+	static T fprop(T input)
+	{
+		return input>0 ? input : 0;
+	}
+
+	// output is positive where input is positive
+	template <class T>
+	static T bprop(T input, T output, T output_gradient)
+	{
+		return output>0 ? output_gradient : 0;
+	}
+
+#ifdef NNLIB_SIMD_FLOAT
+	static SimdFloat fprop(SimdFloat input)
+	{
+		return SimdMax(input, SimdSet(0.0f));
+	}
+
+	static SimdFloat bprop(SimdFloat input, SimdFloat output, SimdFloat output_gradient)
+	{
+		return SimdSelectPositive(output, output_gradient, SimdSet(0.0f));
+	}
+#endif
+};
+
+struct SoftSignActivation
+{
+	template <class T>
+	static T fprop(T input)
+	{
+		return static_cast<T>(input / (1.0 + std::abs(input)));
+	}
+
+	// derivative 1/(1+|input|)^2 equals (1-|output|)^2
+	template <class T>
+	static T bprop(T input, T output, T output_gradient)
+	{
+		T factor = 1-std::abs(output);
+		return factor*factor*output_gradient;
+	}
+
+#ifdef NNLIB_SIMD_FLOAT
+	static SimdFloat fprop(SimdFloat input)
+	{
+		return SimdDiv( input, SimdAdd(SimdSet(1.0f), SimdAbs(input)) );
+	}
+
+	static SimdFloat bprop(SimdFloat input, SimdFloat output, SimdFloat output_gradient)
+	{
+		SimdFloat factor = SimdSub(SimdSet(1.0f), SimdAbs(output));
+		return SimdMul( SimdMul(factor, factor), output_gradient );
+	}
+#endif
+};
+
+struct AbsActivation
+{
+	template <class T>
+	static T fprop(T input)
+	{
+		return std::abs(input);
+	}
+
+	// the sign is lost in the output, so the gradient needs the input
+	template <class T>
+	static T bprop(T input, T output, T output_gradient)
+	{
+		return input>0 ? output_gradient : -output_gradient;
+	}
+
+#ifdef NNLIB_SIMD_FLOAT
+	static SimdFloat fprop(SimdFloat input)
+	{
+		return SimdAbs(input);
+	}
+
+	static SimdFloat bprop(SimdFloat input, SimdFloat output, SimdFloat output_gradient)
+	{
+		return SimdSelectPositive(input, output_gradient, SimdSub(SimdSet(0.0f), output_gradient));
+	}
+#endif
+};
+
+// applies Activation to arrays. The output can be the same array as the input (and input gradients as output gradients)
+template <class Activation, class T>
+struct ElementwiseActivation
+{
+	static void fprop(const T* input, T* output, size_t num_elements)
+	{
+		for (size_t i=0; i<num_elements; i++)
+			output[i] = Activation::fprop(input[i]);
+	}
+
+	static void bprop(const T* input, const T* output, const T* output_gradients, T* input_gradients, size_t num_elements)
+	{
+		for (size_t i=0; i<num_elements; i++)
+			input_gradients[i] = Activation::bprop(input[i], output[i], output_gradients[i]);
+	}
+};
+
+#ifdef NNLIB_SIMD_FLOAT
+template <class Activation>
+struct ElementwiseActivation<Activation, float>
+{
+	static void fprop(const float* input, float* output, size_t num_elements)
+	{
+		size_t i = 0;
+		for (; i+simd_float_width<=num_elements; i+=simd_float_width)
+			SimdStore( output+i, Activation::fprop(SimdLoad(input+i)) );
+		for (; i<num_elements; i++)
+			output[i] = Activation::fprop(input[i]);
+	}
+
+	static void bprop(const float* input, const float* output, const float* output_gradients, float* input_gradients, size_t num_elements)
+	{
+		size_t i = 0;
+		for (; i+simd_float_width<=num_elements; i+=simd_float_width)
+			SimdStore( input_gradients+i, Activation::bprop(SimdLoad(input+i), SimdLoad(output+i), SimdLoad(output_gradients+i)) );
+		for (; i<num_elements; i++)
+			input_gradients[i] = Activation::bprop(input[i], output[i], output_gradients[i]);
+	}
+};
+#endif
+
+enum ActivationType
+{
+	no_activation,
+	tanh_activation,
+	sigmoid_activation,
+	rlu_activation,
+	softsign_activation,
+	abs_activation
+};
+
+inline std::string GetActivationName(ActivationType activation)
+{
+	switch (activation)
+	{
+	case no_activation: return "none";
+	case tanh_activation: return "tanh";
+	case sigmoid_activation: return "sigmoid";
+	case rlu_activation: return "rlu";
+	case softsign_activation: return "softsign";
+	case abs_activation: return "abs";
+	}
+	throw std::runtime_error("Unknown activation");
+}
+
+inline ActivationType GetActivationByName(const std::string& name)
+{
+	const ActivationType activations[] = {no_activation, tanh_activation, sigmoid_activation, rlu_activation, softsign_activation, abs_activation};
+	for (size_t i=0; i<sizeof(activations)/sizeof(activations[0]); i++)
+		if (GetActivationName(activations[i]) == name)
+			return activations[i];
+	throw std::runtime_error("Unknown activation " + name);
+}
+
+// whether the gradient of the activation can be computed from its output,
+// so that it can be applied in place of its input (fused into the module that computes the input)
+inline bool IsFusableActivation(ActivationType activation)
+{
+	return activation != abs_activation;
+}
+
+template <class T>
+void ActivationFprop(ActivationType activation, const T* input, T* output, size_t num_elements)
+{
+	switch (activation)
+	{
+	case no_activation:
+		if (input != output)
+			std::copy(input, input+num_elements, output);
+		break;
+	case tanh_activation: ElementwiseActivation<TanhActivation, T>::fprop(input, output, num_elements); break;
+	case sigmoid_activation: ElementwiseActivation<SigmoidActivation, T>::fprop(input, output, num_elements); break;
+	case rlu_activation: ElementwiseActivation<RluActivation, T>::fprop(input, output, num_elements); break;
+	case softsign_activation: ElementwiseActivation<SoftSignActivation, T>::fprop(input, output, num_elements); break;
+	case abs_activation: ElementwiseActivation<AbsActivation, T>::fprop(input, output, num_elements); break;
+	}
+}
+
+template <class T>
+void ActivationBprop(ActivationType activation, const T* input, const T* output, const T* output_gradients, T* input_gradients, size_t num_elements)
+{
+	switch (activation)
+	{
+	case no_activation:
+		if (output_gradients != input_gradients)
+			std::copy(output_gradients, output_gradients+num_elements, input_gradients);
+		break;
+	case tanh_activation: ElementwiseActivation<TanhActivation, T>::bprop(input, output, output_gradients, input_gradients, num_elements); break;
+	case sigmoid_activation: ElementwiseActivation<SigmoidActivation, T>::bprop(input, output, output_gradients, input_gradients, num_elements); break;
+	case rlu_activation: ElementwiseActivation<RluActivation, T>::bprop(input, output, output_gradients, input_gradients, num_elements); break;
+	case softsign_activation: ElementwiseActivation<SoftSignActivation, T>::bprop(input, output, output_gradients, input_gradients, num_elements); break;
+	case abs_activation: ElementwiseActivation<AbsActivation, T>::bprop(input, output, output_gradients, input_gradients, num_elements); break;
+	}
+}
+
+#endif
@@ -0,0 +1,354 @@
+#ifndef AVERAGE_POOLING_KERNEL_H
+#define AVERAGE_POOLING_KERNEL_H
+
+#include "Kernel.h"
+#include "MaxPoolingKernel.h"
+#include "MemoryPool.h"
+#include <algorithm>
+
+// Mean of the elements of the window. The kernel is separable: the window sums are computed one dimension at a time,
+// and the sum of each window along a dimension is updated from the sum of the previous window (a running sum),
+// so the cost of an output does not depend on the size of the window. bprop spreads the gradients the same way
+template <class DataType>
+class AveragePoolingKernel : public Kernel<DataType>
+{
+	// dimensions where the kernel has a window or a stride, the other dimensions are copied
+	std::vector<size_t> reduced_dims_;
+	std::vector<size_t> windows_;
+	std::vector<size_t> window_strides_;
+	size_t window_numel_;
+	// results of the passes before the last one (the window sums over the first reduced dimensions), and their gradients in bprop
+	std::vector< typename PoolVector<DataType>::type > sums_buffers_;
+	std::vector< typename PoolVector<DataType>::type > gradients_buffers_;
+
+	// shapes of the tensors before and after each pass over a reduced dimension, the results of the passes are dense
+	size_t GetPassesShapes(const TensorShape& input_shape, TensorShape* shapes) const;
+
+	static void SumLineWindows(const DataType* from, size_t from_stride, size_t window, size_t stride,
+		DataType* to, size_t to_stride, size_t num_windows, DataType scale);
+
+	static void SpreadLineWindows(const DataType* from, size_t from_stride, size_t num_windows, size_t window, size_t stride,
+		DataType* to, size_t to_stride, size_t length, DataType scale);
+
+	void subGetResponse(const Tensor<DataType>& data, size_t dim_num, size_t* data_current_pos, bool squares, DataType& res) const;
+
+protected:
+	// calls function(offset1, offset2) for each line along the dimension, with the offsets of the start of the line in the tensors
+	// of the shapes (the dimensions of the shapes are equal except the dimension of the lines)
+	template <class Function>
+	static void ForEachLine(const TensorShape& shape1, const TensorShape& shape2, size_t dim_ind, Function function);
+
+	// sum (of the squares of the elements if squares is true) of the window at the position
+	DataType GetWindowSum(const Tensor<DataType>& data, const size_t* data_pos, bool squares) const;
+
+	// to = scale * the sums of the windows of from
+	void SumWindows(const Tensor<DataType>& from, Tensor<DataType>& to, DataType scale);
+
+	// adds to each element of to scale * the sum of from over the windows that contain the element, the adjoint of SumWindows
+	void SpreadWindows(const Tensor<DataType>& from, Tensor<DataType>& to, DataType scale);
+
+	size_t GetWindowNumel() const
+	{
+		return window_numel_;
+	}
+
+public:
+
+	virtual void fprop(const Tensor<DataType>& input, Tensor<DataType>& output);
+
+	virtual void bprop(const Tensor<DataType>& input, const Tensor<DataType>& output,
+		Tensor<DataType>& input_gradients, const Tensor<DataType>& upper_gradients);
+
+	virtual void GetGradient(const Tensor<DataType>& input, const Tensor<DataType>& output,
+		const Tensor<DataType>& upper_gradients, Tensor<DataType>& gradient);
+
+	virtual size_t GetNumberOfParameters() const;
+
+	virtual DataType GetResponse(const Tensor<DataType>& data, const size_t* data_pos) const;
+
+	AveragePoolingKernel(const Tensor<DataType>& kernel, const std::vector<size_t>& strides);
+
+	// the windows are placed as the windows of max pooling
+	virtual std::vector<size_t> GetOutputTensorDimensions(const std::vector<size_t>& input_dimensions) const;
+
+	virtual std::string GetType() const;
+};
+
+template <class DataType>
+std::string AveragePoolingKernel<DataType>::GetType() const
+{
+	return "AveragePoolingKernel";
+}
+
+template <class DataType>
+AveragePoolingKernel<DataType>::AveragePoolingKernel(const Tensor<DataType>& kernel, const std::vector<size_t>& strides) : Kernel<DataType>(kernel, strides),
+	window_numel_(kernel.Numel())
+{
+	for (size_t dim_ind = 0; dim_ind<kernel.NumDimensions(); dim_ind++)
+	{
+		size_t stride = dim_ind < strides.size() ? strides[dim_ind] : 1;
+		if (kernel.GetDimensionSize(dim_ind) > 1 || stride > 1)
+		{
+			reduced_dims_.push_back(dim_ind);
+			windows_.push_back(kernel.GetDimensionSize(dim_ind));
+			window_strides_.push_back(stride);
+		}
+	}
+	if (!reduced_dims_.empty())
+	{
+		sums_buffers_.resize(reduced_dims_.size()-1);
+		gradients_buffers_.resize(reduced_dims_.size()-1);
+	}
+}
+
+template <class DataType>
+std::vector<size_t> AveragePoolingKernel<DataType>::GetOutputTensorDimensions(const std::vector<size_t>& input_dimensions) const
+{
+	return MaxPoolingKernel<DataType>::GetOutputTensorDimensions(input_dimensions, GetKernelDimensions(), GetStrides());
+}
+
+template <class DataType>
+size_t AveragePoolingKernel<DataType>::GetNumberOfParameters() const
+{
+	return 0;
+}
+
+template <class DataType>
+size_t AveragePoolingKernel<DataType>::GetPassesShapes(const TensorShape& input_shape, TensorShape* shapes) const
+{
+	size_t num_passes = 0;
+	shapes[0] = input_shape;
+	for (size_t pass = 0; pass<reduced_dims_.size(); pass++)
+	{
+		size_t dim_ind = reduced_dims_[pass];
+		// the dimensions of the kernel beyond the input have size 1, there is nothing to reduce
+		if (dim_ind >= input_shape.size())
+			break;
+		assert( input_shape[dim_ind] >= windows_[pass] );
+		size_t full_output_dim_size = input_shape[dim_ind] - windows_[pass] + 1;
+		shapes[num_passes+1] = shapes[num_passes];
+		shapes[num_passes+1].SetDimension(dim_ind, (full_output_dim_size + window_strides_[pass] - 1) / window_strides_[pass]);
+		shapes[num_passes+1] = shapes[num_passes+1].GetContiguous();
+		num_passes++;
+	}
+	return num_passes;
+}
+
+template <class DataType>
+template <class Function>
+void AveragePoolingKernel<DataType>::ForEachLine(const TensorShape& shape1, const TensorShape& shape2, size_t dim_ind, Function function)
+{
+	if (shape1.Numel() == 0)
+		return;
+	size_t num_lines = shape1.Numel() / shape1[dim_ind];
+	size_t line_pos[TensorShape::max_rank] = {0};
+	size_t offset1 = 0, offset2 = 0;
+	for (size_t line_ind = 0; line_ind<num_lines; line_ind++)
+	{
+		function(offset1, offset2);
+		for (size_t other_dim_ind = 0; other_dim_ind<shape1.size(); other_dim_ind++)
+		{
+			if (other_dim_ind == dim_ind)
+				continue;
+			offset1 += shape1.GetStride(other_dim_ind);
+			offset2 += shape2.GetStride(other_dim_ind);
+			if (++line_pos[other_dim_ind] < shape1[other_dim_ind])
+				break;
+			offset1 -= shape1.GetStride(other_dim_ind)*shape1[other_dim_ind];
+			offset2 -= shape2.GetStride(other_dim_ind)*shape2[other_dim_ind];
+			line_pos[other_dim_ind] = 0;
+		}
+	}
+}
+
+// the running sums are accumulated in double and the elements are converted to double before the subtraction,
+// so the sums of floats are exact and the long lines do not accumulate rounding errors
+template <class DataType>
+void AveragePoolingKernel<DataType>::SumLineWindows(const DataType* from, size_t from_stride, size_t window, size_t stride,
+	DataType* to, size_t to_stride, size_t num_windows, DataType scale)
+{
+	double window_sum = 0;
+	for (size_t i=0; i<window; i++)
+		window_sum += from[i*from_stride];
+	to[0] = static_cast<DataType>(scale*window_sum);
+	for (size_t window_ind = 1; window_ind<num_windows; window_ind++)
+	{
+		size_t start = window_ind*stride;
+		if (stride >= window)
+		{
+			// the windows do not overlap, each element is read once
+			window_sum = 0;
+			for (size_t i=start; i<start+window; i++)
+				window_sum += from[i*from_stride];
+		}
+		else
+			for (size_t i=start-stride; i<start; i++)
+				window_sum += static_cast<double>(from[(i+window)*from_stride]) - static_cast<double>(from[i*from_stride]);
+		to[window_ind*to_stride] = static_cast<DataType>(scale*window_sum);
+	}
+}
+
+template <class DataType>
+void AveragePoolingKernel<DataType>::SpreadLineWindows(const DataType* from, size_t from_stride, size_t num_windows, size_t window, size_t stride,
+	DataType* to, size_t to_stride, size_t length, DataType scale)
+{
+	// sum of the gradients of the windows first_window to last_window-1, the windows that contain the element
+	double gradients_sum = 0;
+	size_t first_window = 0, last_window = 0;
+	for (size_t i=0; i<length; i++)
+	{
+		while (last_window < num_windows && last_window*stride <= i)
+			gradients_sum += from[(last_window++)*from_stride];
+		while (first_window < last_window && first_window*stride + window <= i)
+			gradients_sum -= from[(first_window++)*from_stride];
+		// no rounding errors are carried over the gaps between the windows
+		if (first_window == last_window)
+			gradients_sum = 0;
+		to[i*to_stride] += static_cast<DataType>(scale*gradients_sum);
+	}
+}
+
+template <class DataType>
+void AveragePoolingKernel<DataType>::SumWindows(const Tensor<DataType>& from, Tensor<DataType>& to, DataType scale)
+{
+	TensorShape shapes[TensorShape::max_rank+1];
+	size_t num_passes = GetPassesShapes(from.GetShape(), shapes);
+	assert( shapes[num_passes] == to.GetShape() );
+	shapes[num_passes] = to.GetShape();
+	const DataType* from_ptr = from.GetStartPtr();
+	DataType* to_ptr = to.GetStartPtr();
+	if (num_passes == 0)
+	{
+		size_t length = shapes[0][0], from_stride = shapes[0].GetStride(0), to_stride = to.GetShape().GetStride(0);
+		ForEachLine(shapes[0], to.GetShape(), 0, [&](size_t from_offset, size_t to_offset)
+		{
+			for (size_t i=0; i<length; i++)
+				to_ptr[to_offset + i*to_stride] = scale*from_ptr[from_offset + i*from_stride];
+		});
+		return;
+	}
+
+	for (size_t pass = 0; pass<num_passes; pass++)
+	{
+		DataType* pass_to_ptr = to_ptr;
+		DataType pass_scale = pass+1 == num_passes ? scale : 1;
+		if (pass+1 < num_passes)
+		{
+			sums_buffers_[pass].resize(shapes[pass+1].Numel());
+			pass_to_ptr = sums_buffers_[pass].data();
+		}
+		size_t dim_ind = reduced_dims_[pass];
+		size_t window = windows_[pass];
+		size_t stride = window_strides_[pass];
+		size_t from_stride = shapes[pass].GetStride(dim_ind);
+		size_t to_stride = shapes[pass+1].GetStride(dim_ind);
+		size_t num_windows = shapes[pass+1][dim_ind];
+		ForEachLine(shapes[pass], shapes[pass+1], dim_ind, [&](size_t from_offset, size_t to_offset)
+		{
+			SumLineWindows(from_ptr + from_offset, from_stride, window, stride, pass_to_ptr + to_offset, to_stride, num_windows, pass_scale);
+		});
+		from_ptr = pass_to_ptr;
+	}
+}
+
+template <class DataType>
+void AveragePoolingKernel<DataType>::SpreadWindows(const Tensor<DataType>& from, Tensor<DataType>& to, DataType scale)
+{
+	TensorShape shapes[TensorShape::max_rank+1];
+	size_t num_passes = GetPassesShapes(to.GetShape(), shapes);
+	assert( shapes[num_passes] == from.GetShape() );
+	shapes[num_passes] = from.GetShape();
+	const DataType* from_ptr = from.GetStartPtr();
+	DataType* to_ptr = to.GetStartPtr();
+	if (num_passes == 0)
+	{
+		size_t length = shapes[0][0], from_stride = from.GetShape().GetStride(0), to_stride = shapes[0].GetStride(0);
+		ForEachLine(from.GetShape(), shapes[0], 0, [&](size_t from_offset, size_t to_offset)
+		{
+			for (size_t i=0; i<length; i++)
+				to_ptr[to_offset + i*to_stride] += scale*from_ptr[from_offset + i*from_stride];
+		});
+		return;
+	}
+
+	// the passes of SumWindows in the reverse order
+	for (size_t pass = num_passes; pass-- > 0; )
+	{
+		DataType* pass_to_ptr = to_ptr;
+		DataType pass_scale = pass == 0 ? scale : 1;
+		if (pass > 0)
+		{
+			gradients_buffers_[pass-1].assign(shapes[pass].Numel(), 0);
+			pass_to_ptr = gradients_buffers_[pass-1].data();
+		}
+		size_t dim_ind = reduced_dims_[pass];
+		size_t window = windows_[pass];
+		size_t stride = window_strides_[pass];
+		size_t from_stride = shapes[pass+1].GetStride(dim_ind);
+		size_t to_stride = shapes[pass].GetStride(dim_ind);
+		size_t num_windows = shapes[pass+1][dim_ind];
+		size_t length = shapes[pass][dim_ind];
+		ForEachLine(shapes[pass+1], shapes[pass], dim_ind, [&](size_t from_offset, size_t to_offset)
+		{
+			SpreadLineWindows(from_ptr + from_offset, from_stride, num_windows, window, stride, pass_to_ptr + to_offset, to_stride, length, pass_scale);
+		});
+		from_ptr = pass_to_ptr;
+	}
+}
+
+template <class DataType>
+void AveragePoolingKernel<DataType>::fprop(const Tensor<DataType>& input, Tensor<DataType>& output)
+{
+	SumWindows(input, output, static_cast<DataType>(1.0 / window_numel_));
+}
+
+template <class DataType>
+void AveragePoolingKernel<DataType>::bprop(const Tensor<DataType>& input, const Tensor<DataType>& output,
+										  Tensor<DataType>& input_gradients, const Tensor<DataType>& output_gradients)
+{
+	SpreadWindows(output_gradients, input_gradients, static_cast<DataType>(1.0 / window_numel_));
+}
+
+template <class DataType>
+void AveragePoolingKernel<DataType>::GetGradient(const Tensor<DataType>& input, const Tensor<DataType>& output,
+												 const Tensor<DataType>& upper_gradients, Tensor<DataType>& gradient)
+{
+}
+
+template <class DataType>
+void AveragePoolingKernel<DataType>::subGetResponse(const Tensor<DataType>& data, size_t dim_num, size_t* data_current_pos,
+	bool squares, DataType& res) const
+{
+	size_t initial_data_dim_pos = data_current_pos[dim_num];
+	for (size_t i=0; i<GetKernelTensor().GetDimensionSize(dim_num); i++)
+	{
+		data_current_pos[dim_num] = initial_data_dim_pos+i;
+		if (dim_num == 0)
+		{
+			DataType value = *data.GetPtr(data_current_pos);
+			res += squares ? value*value : value;
+		}
+		else
+			subGetResponse(data, dim_num-1, data_current_pos, squares, res);
+	}
+	data_current_pos[dim_num] = initial_data_dim_pos;
+}
+
+template <class DataType>
+DataType AveragePoolingKernel<DataType>::GetWindowSum(const Tensor<DataType>& data, const size_t* data_pos, bool squares) const
+{
+	size_t num_dims = (std::max)(data.NumDimensions(), GetKernelTensor().NumDimensions());
+	std::vector<size_t> current_data_pos(num_dims);
+	std::copy(data_pos, data_pos+data.NumDimensions(), current_data_pos.begin());
+	DataType res = 0;
+	subGetResponse(data, GetKernelTensor().NumDimensions()-1, current_data_pos.data(), squares, res);
+	return res;
+}
+
+template <class DataType>
+DataType AveragePoolingKernel<DataType>::GetResponse(const Tensor<DataType>& data, const size_t* data_pos) const
+{
+	return GetWindowSum(data, data_pos, false) / window_numel_;
+}
+
+#endif
@@ -2,10 +2,28 @@
 #define BASE_TENSOR_DATA_LOADER_H
 
 #include <cassert>
+#include <cstring>
+#include <cmath>
 #include  "ITensorDataLoader.h"
 #include "CashedTensor.h"
 #include "TensorIO.h"
 
+// copies the elements converting them to To
+template <class From, class To>
+inline void CopySampleElements(const From* from, To* to, size_t num_elements)
+{
+	for (size_t i=0; i<num_elements; i++)
+		to[i] = static_cast<To>(from[i]);
+}
+
+// no conversion is needed, the elements are copied as a block
+template <class T>
+inline void CopySampleElements(const T* from, T* to, size_t num_elements)
+{
+	if (num_elements > 0)
+		memcpy(to, from, num_elements*sizeof(T));
+}
+
 template <class OutputType, class InputType>
 class BaseTensorDataLoader : public ITensorDataLoader<OutputType>
 {
@@ -16,14 +34,75 @@ class BaseTensorDataLoader : public ITensorDataLoader<OutputType>
 	virtual void sub_save(std::ostream& output_stream) const = 0;
 	mutable CashedTensor<OutputType> cashed_data_buffer;
 	mutable std::vector< input_type_tensor_ptr > data_;
+
+	// sample arena: samples of the same dimensions stored one after another in a single buffer
+	// with one dimensions descriptor, used instead of data_ if the loader packs the samples
+	// the memory of the pool is aligned to MemoryPool::alignment bytes
+	mutable typename PoolVector<InputType>::type arena_storage_;
+	TensorShape arena_sample_dims_;
+	size_t arena_sample_numel_;
+	size_t arena_num_samples_;
+	bool uses_arena_;
+
+	// views of external memory are not packed, the loader keeps using the memory they point to
+	void PackSamples()
+	{
+		if (data_.empty())
+			return;
+		for (size_t i=0; i<data_.size(); i++)
+			if (!data_[i]->OwnsData() || !data_[i]->DimensionsEqual(*data_[0]))
+				return;
+
+		arena_sample_dims_ = data_[0]->GetShape();
+		arena_sample_numel_ = data_[0]->Numel();
+		arena_num_samples_ = data_.size();
+		arena_storage_.resize(arena_num_samples_*arena_sample_numel_);
+		for (size_t i=0; i<arena_num_samples_; i++)
+			CopySampleElements(data_[i]->GetStartPtr(), &arena_storage_[i*arena_sample_numel_], arena_sample_numel_);
+		data_.clear();
+		uses_arena_ = true;
+	}
+
+	// views of the samples, they do not own the data
+	std::vector< input_type_tensor_ptr > GetSamplesViews() const
+	{
+		std::vector< input_type_tensor_ptr > samples(GetNumSamples());
+		for (size_t i=0; i<samples.size(); i++)
+			samples[i] = input_type_tensor_ptr( new Tensor<InputType>(&arena_storage_[i*arena_sample_numel_], arena_sample_dims_) );
+		return samples;
+	}
+
 protected:
+	// is not available if the samples are packed to the arena, use GetSamplePtr instead
 	Tensor<InputType>& GetSample(size_t ind) const
 	{
+		assert( !uses_arena_ );
 		return  *data_[ind];
 	}
 
+	virtual const InputType* GetSamplePtr(size_t ind) const
+	{
+		if (uses_arena_)
+			return &arena_storage_[ind*arena_sample_numel_];
+		return data_[ind]->GetStartPtr();
+	}
+
+	virtual size_t GetSampleNumel(size_t ind) const
+	{
+		if (uses_arena_)
+			return arena_sample_numel_;
+		return data_[ind]->Numel();
+	}
+
+	bool UsesSampleArena() const
+	{
+		return uses_arena_;
+	}
+
 	virtual std::vector<size_t> GetSampleDims(size_t sample_ind = 0) const
 	{
+		if (uses_arena_)
+			return arena_sample_dims_.GetDimensions();
 		return data_[sample_ind]->GetDimensions();
 	}
 
@@ -42,12 +121,12 @@ public:
 		return name_;
 	}
 
-	void Save(std::ostream& output_stream) const
+	virtual void Save(std::ostream& output_stream) const
 	{
 		output_stream<<"DataLoader"<<"\n";
 		output_stream<<GetType()<<"\n";
 		output_stream<<GetName()<<"\n";
-		SaveDataset(data_, output_stream);
+		SaveDataset(uses_arena_ ? GetSamplesViews() : data_, output_stream);
 		sub_save(output_stream);
 	}
 	
@@ -70,13 +149,20 @@ public:
 		}
 	}
 
-	BaseTensorDataLoader(const std::vector< input_type_tensor_ptr >& data, std::string name) : data_(data)
+	// if pack_samples is set and all the samples own their data and have the same dimensions, the samples are copied
+	// to the sample arena and the loader does not keep references to the given tensors
+	BaseTensorDataLoader(const std::vector< input_type_tensor_ptr >& data, std::string name, bool pack_samples = false) : data_(data),
+		arena_sample_numel_(0), arena_num_samples_(0), uses_arena_(false)
 	{
 		name_ = name;
+		if (pack_samples)
+			PackSamples();
 	}
 
 	virtual size_t GetNumSamples() const
 	{
+		if (uses_arena_)
+			return arena_num_samples_;
 		return data_.size();
 	}
 
@@ -88,9 +174,21 @@ public:
 		if ( data_loader.GetName() != GetName() )
 			return false;
 
-		for (size_t i=0; i<data_.size(); i++)
-			if ( *data_[i] != *data_loader.data_[i])
+		if ( data_loader.GetNumSamples() != GetNumSamples() )
+			return false;
+
+		// samples are compared by values, so that packed and not packed samples can be compared
+		for (size_t i=0; i<GetNumSamples(); i++)
+		{
+			if ( data_loader.GetSampleDims(i) != GetSampleDims(i) )
 				return false;
+			const InputType* sample = GetSamplePtr(i);
+			const InputType* other_sample = data_loader.GetSamplePtr(i);
+			size_t numel = GetSampleNumel(i);
+			for (size_t j=0; j<numel; j++)
+				if ( std::abs(sample[j] - other_sample[j])>0.000001 )
+					return false;
+		}
 
 		return true;
 	}
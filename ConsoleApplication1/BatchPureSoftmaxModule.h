@@ -2,6 +2,7 @@
 #define BATCH_PURE_SOFTSIGN_H
 
 #include <limits>
+#include <algorithm>
 #include "Module.h"
 #include "CashedTensor.h"
 #include "my_math.h"
@@ -12,6 +13,7 @@ template <class ParamsType>
 class BatchPureSoftmaxModule : public Module<ParamsType>
 {
 	ParamsType EPS_;
+	// per feature values, the partition values are kept as their inverses
 	CashedTensor<ParamsType> partition_values_buffer_;
 	CashedTensor<ParamsType> weighted_gradients_buffer_;
 public:
@@ -29,6 +31,22 @@ public:
 	{
 		return module.GetType() == GetType() && module.GetName() == GetName();
 	}
+
+	virtual bool OverwritesOutputBuffer() const
+	{
+		return true;
+	}
+
+	virtual bool OverwritesInputGradientsBuffer() const
+	{
+		return true;
+	}
+
+	// the gradients are computed from the output and the partition values
+	virtual bool BpropUsesInput() const
+	{
+		return false;
+	}
 	
 	static std::shared_ptr< Module< ParamsType> > Create(IOTreeNode& data);
 
@@ -56,28 +74,28 @@ std::shared_ptr< Module< ParamsType> > BatchPureSoftmaxModule<ParamsType>::Creat
 template <class ParamsType>
 void BatchPureSoftmaxModule<ParamsType>::sub_train_fprop(const std::shared_ptr< Tensor<ParamsType> >& input, std::shared_ptr< Tensor<ParamsType> >& output)
 {
-	Tensor<ParamsType>& input_tensor = *input;
-	Tensor<ParamsType>& output_tensor = *output;
-	size_t minibatch_size = input_tensor.GetDimensionSize(input_tensor.NumDimensions()-1);
-	size_t num_features = input_tensor.Numel() / minibatch_size;
+	size_t minibatch_size = input->GetDimensionSize(input->NumDimensions()-1);
+	size_t num_features = input->Numel() / minibatch_size;
+	const ParamsType* input_ptr = input->GetStartPtr();
+	ParamsType* output_ptr = output->GetStartPtr();
 	
-	partition_values_buffer_.Update(input->GetDimensions());
-	Tensor<ParamsType>& partition_values_tensor = *partition_values_buffer_();
-	partition_values_tensor.SetZeros();
-	for (size_t i=0; i<num_features; i++)
-		partition_values_tensor[i] = EPS_;
+	partition_values_buffer_.Update(std::vector<size_t>(1, num_features));
+	ParamsType* partition_values = partition_values_buffer_()->GetStartPtr();
+	std::fill(partition_values, partition_values+num_features, EPS_);
 	for (size_t sample_ind = 0; sample_ind<minibatch_size; sample_ind++)
 	{
-		size_t sample_offset = num_features*sample_ind;
+		const ParamsType* sample_input = input_ptr + num_features*sample_ind;
 		for (size_t i=0; i<num_features; i++)
-			partition_values_tensor[i] += input_tensor[sample_offset+i];
+			partition_values[i] += sample_input[i];
 	}
 
+	for (size_t i=0; i<num_features; i++)
+		partition_values[i] = 1 / partition_values[i];
 	for (size_t sample_ind = 0; sample_ind<minibatch_size; sample_ind++)
 	{
 		size_t sample_offset = num_features*sample_ind;
 		for (size_t i = 0; i<num_features; i++)
-			output_tensor[sample_offset+i] = input_tensor[sample_offset+i]/partition_values_tensor[i];
+			output_ptr[sample_offset+i] = input_ptr[sample_offset+i]*partition_values[i];
 	}
 }
 
@@ -86,31 +104,32 @@ void BatchPureSoftmaxModule<ParamsType>::sub_bprop(const std::shared_ptr< Tensor
 	std::shared_ptr< Tensor<ParamsType> >& input_gradients, const std::shared_ptr< Tensor<ParamsType> >& output_gradients, 
 	const std::vector<ParamsType>& samples_importances)
 {	
-	// partition_values_buffer_ already contains the partition values
-	Tensor<ParamsType>& partition_values_tensor = *partition_values_buffer_();
-
-	Tensor<ParamsType>& input_tensor = *input;
-	Tensor<ParamsType>& output_tensor = *output;
-	Tensor<ParamsType>& input_gradients_tensor = *input_gradients;
-	Tensor<ParamsType>& output_gradients_tensor = *output_gradients;
-	size_t minibatch_size = output_tensor.GetDimensionSize(output_tensor.NumDimensions()-1);
-	size_t num_features = output_tensor.Numel() / minibatch_size;
-
-	weighted_gradients_buffer_.Update(input->GetDimensions());
-	Tensor<ParamsType>& weighted_gradients_tensor = *weighted_gradients_buffer_();
-	weighted_gradients_tensor.SetZeros();
+	// partition_values_buffer_ already contains the inverses of the partition values
+	const ParamsType* partition_values = partition_values_buffer_()->GetStartPtr();
+
+	size_t minibatch_size = output->GetDimensionSize(output->NumDimensions()-1);
+	size_t num_features = output->Numel() / minibatch_size;
+	const ParamsType* output_ptr = output->GetStartPtr();
+	const ParamsType* output_gradients_ptr = output_gradients->GetStartPtr();
+	ParamsType* input_gradients_ptr = input_gradients->GetStartPtr();
+
+	weighted_gradients_buffer_.Update(std::vector<size_t>(1, num_features));
+	ParamsType* weighted_gradients = weighted_gradients_buffer_()->GetStartPtr();
+	std::fill(weighted_gradients, weighted_gradients+num_features, static_cast<ParamsType>(0));
 	for (size_t sample_ind = 0; sample_ind<minibatch_size; sample_ind++)
 	{
 		size_t sample_offset = num_features*sample_ind;
 		for (size_t i=0; i<num_features; i++)
-			weighted_gradients_tensor[i] += output_tensor[sample_offset+i]*output_gradients_tensor[sample_offset+i]/partition_values_tensor[i];
+			weighted_gradients[i] += output_ptr[sample_offset+i]*output_gradients_ptr[sample_offset+i];
 	}
+	for (size_t i=0; i<num_features; i++)
+		weighted_gradients[i] *= partition_values[i];
 
 	for (size_t sample_ind = 0; sample_ind<minibatch_size; sample_ind++)
 	{
 		size_t sample_offset = num_features*sample_ind;
 		for (size_t i = 0; i<num_features; i++)
-			input_gradients_tensor[sample_offset+i] = output_gradients_tensor[sample_offset+i]/partition_values_tensor[i] - weighted_gradients_tensor[i];
+			input_gradients_ptr[sample_offset+i] = output_gradients_ptr[sample_offset+i]*partition_values[i] - weighted_gradients[i];
 	}
 }
 
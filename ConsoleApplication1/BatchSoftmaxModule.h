@@ -5,19 +5,20 @@
 #include <algorithm>
 #include "Module.h"
 #include "CashedTensor.h"
-#include "my_math.h"
+#include "SoftmaxKernels.h"
 
-// Takes softmax over the batch dimensions 
+// Takes softmax over the batch dimensions
 template <class ParamsType>
 class BatchSoftmaxModule : public Module<ParamsType>
 {
-	ParamsType EPS_;
+	ExpPrecision exp_precision_;
+	// per feature values, the partition values are kept as their inverses
 	CashedTensor<ParamsType> partition_values_buffer_;
-	CashedTensor<ParamsType> min_values_buffer_;
+	CashedTensor<ParamsType> max_values_buffer_;
 	CashedTensor<ParamsType> weighted_gradients_buffer_;
 public:
 
-	BatchSoftmaxModule( std::string name) : Module<ParamsType>(name), EPS_(std::numeric_limits<ParamsType>::epsilon())
+	BatchSoftmaxModule( std::string name) : Module<ParamsType>(name), exp_precision_(vectorized_exp)
 	{
 	}
 
@@ -25,19 +26,47 @@ public:
 	{
 		return "BatchSoftmaxModule";
 	}
-	
+
 	virtual bool Equals(const Module<ParamsType>& module) const
 	{
-		return module.GetType() == GetType() && module.GetName() == GetName();
+		return module.GetType() == GetType() && module.GetName() == GetName() &&
+			static_cast<const BatchSoftmaxModule<ParamsType>&>(module).exp_precision_ == exp_precision_;
+	}
+
+	virtual bool OverwritesOutputBuffer() const
+	{
+		return true;
 	}
-	
+
+	virtual bool OverwritesInputGradientsBuffer() const
+	{
+		return true;
+	}
+
+	// the gradients are computed from the output
+	virtual bool BpropUsesInput() const
+	{
+		return false;
+	}
+
+	// exp() of the floats in vectorized builds, vectorized_exp by default
+	void SetExpPrecision(ExpPrecision exp_precision)
+	{
+		exp_precision_ = exp_precision;
+	}
+
+	ExpPrecision GetExpPrecision() const
+	{
+		return exp_precision_;
+	}
+
 	static std::shared_ptr< Module< ParamsType> > Create(IOTreeNode& data);
 
 protected:
 	virtual void sub_train_fprop(const std::shared_ptr< Tensor<ParamsType> >& input, std::shared_ptr< Tensor<ParamsType> >& output);
-	
-	virtual void sub_bprop(const std::shared_ptr< Tensor<ParamsType> >& input, const std::shared_ptr< Tensor<ParamsType> >& output, 
-		std::shared_ptr< Tensor<ParamsType> >& input_gradients, const std::shared_ptr< Tensor<ParamsType> >& output_gradients, 
+
+	virtual void sub_bprop(const std::shared_ptr< Tensor<ParamsType> >& input, const std::shared_ptr< Tensor<ParamsType> >& output,
+		std::shared_ptr< Tensor<ParamsType> >& input_gradients, const std::shared_ptr< Tensor<ParamsType> >& output_gradients,
 		const std::vector<ParamsType>& samples_importances);
 
 	virtual void sub_GetState(IOTreeNode& node) const;
@@ -46,84 +75,86 @@ protected:
 template <class ParamsType>
 void BatchSoftmaxModule<ParamsType>::sub_GetState(IOTreeNode& node) const
 {
+	if (exp_precision_ != vectorized_exp)
+		node.attributes().AppendEntry( "exp_precision", GetExpPrecisionName(exp_precision_) );
 }
 
 template <class ParamsType>
 std::shared_ptr< Module< ParamsType> > BatchSoftmaxModule<ParamsType>::Create(IOTreeNode& data)
 {
-	return std::shared_ptr< Module< ParamsType> >( new BatchSoftmaxModule<ParamsType>(data.attributes().GetEntry( "Name" ) ));
+	std::shared_ptr< BatchSoftmaxModule<ParamsType> > module( new BatchSoftmaxModule<ParamsType>(data.attributes().GetEntry( "Name" )) );
+	if (data.attributes().HasEntry( "exp_precision" ))
+		module->SetExpPrecision( GetExpPrecisionByName(data.attributes().GetEntry( "exp_precision" )) );
+	return module;
 }
 
 template <class ParamsType>
 void BatchSoftmaxModule<ParamsType>::sub_train_fprop(const std::shared_ptr< Tensor<ParamsType> >& input, std::shared_ptr< Tensor<ParamsType> >& output)
 {
-	Tensor<ParamsType>& input_tensor = *input;
-	Tensor<ParamsType>& output_tensor = *output;
-	size_t minibatch_size = input_tensor.GetDimensionSize(input_tensor.NumDimensions()-1);
-	size_t num_features = input_tensor.Numel() / minibatch_size;
-	
-	min_values_buffer_.Update(input->GetDimensions());
-	Tensor<ParamsType>& min_values_tensor = *min_values_buffer_();
-	
-	for (size_t i=0; i<num_features; i++)
-		min_values_tensor[i] = std::numeric_limits<ParamsType>::max();
+	size_t minibatch_size = input->GetDimensionSize(input->NumDimensions()-1);
+	size_t num_features = input->Numel() / minibatch_size;
+	const ParamsType* input_ptr = input->GetStartPtr();
+	ParamsType* output_ptr = output->GetStartPtr();
 
-	for (size_t sample_ind = 0; sample_ind<minibatch_size; sample_ind++)
+	max_values_buffer_.Update(std::vector<size_t>(1, num_features));
+	ParamsType* max_values = max_values_buffer_()->GetStartPtr();
+	std::copy(input_ptr, input_ptr+num_features, max_values);
+	for (size_t sample_ind = 1; sample_ind<minibatch_size; sample_ind++)
+	{
+		const ParamsType* sample_input = input_ptr + num_features*sample_ind;
 		for (size_t i=0; i<num_features; i++)
-		{
-			size_t sample_offset = num_features*sample_ind;
-			min_values_tensor[i] = std::min(min_values_tensor[i], input_tensor[sample_offset+i]);
-		}
-
-	partition_values_buffer_.Update(input->GetDimensions());
-	Tensor<ParamsType>& partition_values_tensor = *partition_values_buffer_();
-	partition_values_tensor.SetZeros();
-	for (size_t i=0; i<num_features; i++)
-		partition_values_tensor[i] = EPS_;
+			max_values[i] = sample_input[i] > max_values[i] ? sample_input[i] : max_values[i];
+	}
+
+	// the partition values are at least 1, the maximal element contributes exp(0)
+	partition_values_buffer_.Update(std::vector<size_t>(1, num_features));
+	ParamsType* partition_values = partition_values_buffer_()->GetStartPtr();
+	std::fill(partition_values, partition_values+num_features, static_cast<ParamsType>(0));
 	for (size_t sample_ind = 0; sample_ind<minibatch_size; sample_ind++)
 	{
 		size_t sample_offset = num_features*sample_ind;
+		ShiftedExp(input_ptr+sample_offset, max_values, output_ptr+sample_offset, num_features, exp_precision_);
 		for (size_t i=0; i<num_features; i++)
-			partition_values_tensor[i] += std::exp(input_tensor[sample_offset+i]-min_values_tensor[i]);
+			partition_values[i] += output_ptr[sample_offset+i];
 	}
 
+	for (size_t i=0; i<num_features; i++)
+		partition_values[i] = 1 / partition_values[i];
 	for (size_t sample_ind = 0; sample_ind<minibatch_size; sample_ind++)
 	{
-		size_t sample_offset = num_features*sample_ind;
+		ParamsType* sample_output = output_ptr + num_features*sample_ind;
 		for (size_t i = 0; i<num_features; i++)
-			output_tensor[sample_offset+i] = std::exp(input_tensor[sample_offset+i]-min_values_tensor[i])/partition_values_tensor[i];
+			sample_output[i] *= partition_values[i];
 	}
 }
 
 template <class ParamsType>
-void BatchSoftmaxModule<ParamsType>::sub_bprop(const std::shared_ptr< Tensor<ParamsType> >& input, const std::shared_ptr< Tensor<ParamsType> >& output, 
-	std::shared_ptr< Tensor<ParamsType> >& input_gradients, const std::shared_ptr< Tensor<ParamsType> >& output_gradients, 
+void BatchSoftmaxModule<ParamsType>::sub_bprop(const std::shared_ptr< Tensor<ParamsType> >& input, const std::shared_ptr< Tensor<ParamsType> >& output,
+	std::shared_ptr< Tensor<ParamsType> >& input_gradients, const std::shared_ptr< Tensor<ParamsType> >& output_gradients,
 	const std::vector<ParamsType>& samples_importances)
-{	
-	Tensor<ParamsType>& input_tensor = *input;
-	Tensor<ParamsType>& output_tensor = *output;
-	Tensor<ParamsType>& input_gradients_tensor = *input_gradients;
-	Tensor<ParamsType>& output_gradients_tensor = *output_gradients;
-	size_t minibatch_size = output_tensor.GetDimensionSize(output_tensor.NumDimensions()-1);
-	size_t num_features = output_tensor.Numel() / minibatch_size;
-
-	weighted_gradients_buffer_.Update(input->GetDimensions());
-	Tensor<ParamsType>& weighted_gradients_tensor = *weighted_gradients_buffer_();
-	weighted_gradients_tensor.SetZeros();
+{
+	size_t minibatch_size = output->GetDimensionSize(output->NumDimensions()-1);
+	size_t num_features = output->Numel() / minibatch_size;
+	const ParamsType* output_ptr = output->GetStartPtr();
+	const ParamsType* output_gradients_ptr = output_gradients->GetStartPtr();
+	ParamsType* input_gradients_ptr = input_gradients->GetStartPtr();
+
+	weighted_gradients_buffer_.Update(std::vector<size_t>(1, num_features));
+	ParamsType* weighted_gradients = weighted_gradients_buffer_()->GetStartPtr();
+	std::fill(weighted_gradients, weighted_gradients+num_features, static_cast<ParamsType>(0));
 	for (size_t sample_ind = 0; sample_ind<minibatch_size; sample_ind++)
 	{
 		size_t sample_offset = num_features*sample_ind;
 		for (size_t i=0; i<num_features; i++)
-			weighted_gradients_tensor[i] += output_tensor[sample_offset+i]*output_gradients_tensor[sample_offset+i];
+			weighted_gradients[i] += output_ptr[sample_offset+i]*output_gradients_ptr[sample_offset+i];
 	}
-	
+
 	for (size_t sample_ind = 0; sample_ind<minibatch_size; sample_ind++)
 	{
 		size_t sample_offset = num_features*sample_ind;
 		for (size_t i = 0; i<num_features; i++)
-			input_gradients_tensor[sample_offset+i] = static_cast<ParamsType>(  output_tensor[sample_offset+i] * 
-				( output_gradients_tensor[sample_offset+i] - weighted_gradients_tensor[i] ) );
+			input_gradients_ptr[sample_offset+i] = output_ptr[sample_offset+i] * (output_gradients_ptr[sample_offset+i] - weighted_gradients[i]);
 	}
 }
 
-#endif
\ No newline at end of file
+#endif
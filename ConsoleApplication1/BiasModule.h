@@ -9,6 +9,7 @@
 #include "InitializerFactory.h"
 #include "IOTreeNode.h"
 #include "TensorIO.h"
+#include "ActivationFusion.h"
 
 template <class ParamsType>
 class BiasModule : public Module<ParamsType>
@@ -18,6 +19,17 @@ private:
 	Tensor<ParamsType> gradients;
 	std::shared_ptr<ParametersInitializer<ParamsType> > params_initializer;
 	std::shared_ptr<Regularizer<ParamsType> > regularizer;
+	FusedActivation<ParamsType> fused_activation_;
+
+	// used by Create, the parameters get memory only if they are not mapped (see Module::LoadParameters)
+	BiasModule(std::string name, IOTreeNode& parameters_node, const std::shared_ptr<ParametersInitializer<ParamsType> >& params_initializer,
+		const std::shared_ptr<Regularizer<ParamsType> >& regularizer) 
+			: Module(name), params_initializer(params_initializer), regularizer(regularizer), 
+			parameters(0, GetTensorStateDimensions(parameters_node)), gradients(0, GetTensorStateDimensions(parameters_node))
+	{
+		if (!HasMappedParameters(parameters_node))
+			parameters.Allocate();
+	}
 public:
 
 	virtual double GetCost(const std::vector<ParamsType>& samples_importances)
@@ -32,6 +44,16 @@ public:
 			receiver.push_back( parameters[i] );
 	}
 
+	virtual void BindParameters(ParamsType* params)
+	{
+		parameters.SetDataPtr(params);
+	}
+
+	virtual void BindGradients(ParamsType* gradients)
+	{
+		this->gradients.SetDataPtr(gradients);
+	}
+
 	virtual void SetParameters(const ParamsType* params)
 	{
 		for (size_t i=0; i < parameters.Numel(); i++)
@@ -53,6 +75,12 @@ public:
 
 	virtual void GetGradients(std::vector<ParamsType>& receiver) const
 	{
+		// the gradients have no memory before the first bprop
+		if (!gradients.GetStartPtr())
+		{
+			receiver.resize(receiver.size() + parameters.Numel(), 0);
+			return;
+		}
 		for (size_t i=0; i < parameters.Numel(); i++)
 			receiver.push_back( gradients[i] );
 	}
@@ -60,7 +88,7 @@ public:
 	BiasModule(std::string name, const std::vector<size_t>& input_case_dims, 
 		const std::shared_ptr<ParametersInitializer<ParamsType> >& params_initializer = std::shared_ptr<ParametersInitializer<ParamsType> >(new ConstantInitializer<ParamsType>(0)),
 		const std::shared_ptr<Regularizer<ParamsType> >& regularizer = std::shared_ptr<Regularizer<ParamsType> >(new EmptyRegularizer<ParamsType>()) ) 
-			: Module(name), params_initializer(params_initializer), regularizer(regularizer), parameters(input_case_dims), gradients(input_case_dims)
+			: Module(name), params_initializer(params_initializer), regularizer(regularizer), parameters(input_case_dims), gradients(0, input_case_dims)
 	{
 		parameters.SetZeros();
 	}
@@ -86,6 +114,31 @@ public:
 		return false;
 	}
 
+	virtual bool OverwritesOutputBuffer() const
+	{
+		return true;
+	}
+
+	virtual bool FuseActivation(ActivationType activation)
+	{
+		return fused_activation_.Set(activation);
+	}
+
+	ActivationType GetFusedActivation() const
+	{
+		return fused_activation_.GetType();
+	}
+
+	virtual bool BpropUsesInput() const
+	{
+		return false;
+	}
+
+	virtual bool BpropUsesOutput() const
+	{
+		return fused_activation_.GetType() != no_activation;
+	}
+
 	virtual std::string GetType() const
 	{
 		return "BiasModule";
@@ -112,12 +165,14 @@ bool BiasModule<ParamsType>::Equals(const Module<ParamsType>& module) const
 		return false;
 
 	const BiasModule<ParamsType>* other_module = static_cast< const BiasModule<ParamsType>* >( &module );
-	if (other_module->parameters != parameters)
+	if (!EqualValues(other_module->parameters, parameters))
 		return false;
 	if (!params_initializer->Equals(*other_module->params_initializer))
 		return false;
 	if (!regularizer->Equals(*other_module->regularizer))
 		return false;
+	if (other_module->GetFusedActivation() != GetFusedActivation())
+		return false;
 	return true;
 }
 
@@ -127,6 +182,7 @@ void BiasModule<ParamsType>::sub_GetState(IOTreeNode& node) const
 	node.nodes().AppendEntry( "regularizer", regularizer->GetState() );
 	node.nodes().AppendEntry( "initializer", params_initializer->GetState() );
 	node.nodes().AppendEntry( "Parameters", GetTensorState(parameters) );
+	fused_activation_.GetState(node);
 }
 
 template <class ParamsType>
@@ -134,12 +190,13 @@ std::shared_ptr< Module< ParamsType> > BiasModule<ParamsType>::Create(IOTreeNode
 {
 	std::shared_ptr< Regularizer<ParamsType> > regularizer = RegularizerFactory::GetRegularizer<ParamsType>(*data.nodes().GetEntry("regularizer"));
 	std::shared_ptr< ParametersInitializer<ParamsType> > initializer = InitializerFactory::GetInitializer<ParamsType>(*data.nodes().GetEntry("initializer"));
-	std::shared_ptr< Tensor<ParamsType> > parameters = CreateTensor<ParamsType>(*data.nodes().GetEntry("Parameters"));
+	IOTreeNode& parameters_node = *data.nodes().GetEntry("Parameters");
 
 	std::shared_ptr< BiasModule<ParamsType> > module = 
 		std::shared_ptr< BiasModule< ParamsType> >( new BiasModule<ParamsType>(data.attributes().GetEntry( "Name" ), 
-		parameters->GetDimensions(), initializer, regularizer) );
-	module->SetParameters(*parameters);
+		parameters_node, initializer, regularizer) );
+	module->LoadParameters(parameters_node);
+	module->fused_activation_.SetState(data);
 
 	return module;
 }
@@ -157,6 +214,7 @@ void BiasModule<ParamsType>::sub_train_fprop(const std::shared_ptr< Tensor<Param
 		size_t input_offset = num_input_features*sample_index;
 		for ( size_t offset = 0; offset < num_input_features; offset++ )
 			output_tensor[input_offset+offset] = input_tensor[input_offset+offset]+parameters[offset];
+		fused_activation_.fprop(output->GetStartPtr()+input_offset, num_input_features);
 	}
 }
 	
@@ -165,11 +223,14 @@ void BiasModule<ParamsType>::sub_bprop(const std::shared_ptr< Tensor<ParamsType>
 	std::shared_ptr< Tensor<ParamsType> >& input_gradients, const std::shared_ptr< Tensor<ParamsType> >& output_gradients, 
 	const std::vector<ParamsType>& samples_importances)
 {
+	if (!gradients.GetStartPtr())
+		gradients.Allocate();
 	gradients.SetZeros();
 	ParamsType importance_sum = static_cast<ParamsType>(std::accumulate(samples_importances.begin(),samples_importances.end(),0.0));
 	regularizer->GetGradients(parameters, gradients, importance_sum);
 	
-	Tensor<ParamsType>& output_gradients_tensor = *output_gradients;
+	std::shared_ptr< Tensor<ParamsType> > activation_input_gradients = fused_activation_.bprop(output, output_gradients);
+	const Tensor<ParamsType>& output_gradients_tensor = *activation_input_gradients;
 
 	const size_t minibatch_size = output->GetDimensionSize(output->NumDimensions()-1);
 	const size_t num_input_features = input->Numel() / minibatch_size;
@@ -182,7 +243,7 @@ void BiasModule<ParamsType>::sub_bprop(const std::shared_ptr< Tensor<ParamsType>
 	}
 
 	// backprop gradients
-	input_gradients = output_gradients;
+	input_gradients = activation_input_gradients;
 }
 
 #endif
\ No newline at end of file
@@ -40,6 +40,27 @@ public:
 		branch_module_->GetGradients(receiver);
 	}
 
+	virtual void BindParameters(ParamsType* params)
+	{
+		branch_module_->BindParameters(params);
+	}
+
+	virtual void BindGradients(ParamsType* gradients)
+	{
+		branch_module_->BindGradients(gradients);
+	}
+
+	virtual void CopyTrainState(const Module<ParamsType>& module)
+	{
+		branch_module_->CopyTrainState(*static_cast< const BranchModule<ParamsType>& >(module).branch_module_);
+	}
+
+	virtual void SetProfiler(const std::shared_ptr<ModuleProfiler>& profiler)
+	{
+		Module<ParamsType>::SetProfiler(profiler);
+		branch_module_->SetProfiler(profiler);
+	}
+
 	virtual void InitializeParameters()
 	{
 		Module<ParamsType>::InitializeParameters();
@@ -85,6 +106,12 @@ public:
 		return true;
 	}
 
+	// the input is passed to the branch module and to the next module, they make dense copies if they need them
+	virtual bool AcceptsStridedInput() const
+	{
+		return true;
+	}
+
 	BranchModule( std::string name, std::shared_ptr< Module<ParamsType> > branch_module) : Module<ParamsType>(name), branch_module_(branch_module)
 	{
 	}
@@ -216,6 +216,8 @@ std::vector< std::shared_ptr< Tensor<ParamsType> > > BranchSemisupervisedNN<Para
 	if ( output_module_name == "" )
 		output_module_name = nn_module_->GetModule( nn_module_->NumModules()-1 )->GetName();
 	std::shared_ptr< Module<ParamsType> > output_module = nn_module_->GetModule(output_module_name);
+	// outputs of inner modules share memory with other buffers
+	nn_module_->RetainOutputBuffer(output_module_name);
 
 	if (indices.size() == 0)
 	{
@@ -0,0 +1,60 @@
+#ifndef BUFFER_ARENA_H
+#define BUFFER_ARENA_H
+
+#include <vector>
+#include <algorithm>
+#include <assert.h>
+#include "MemoryPool.h"
+
+// Memory shared by the buffers of several modules whose lifetimes do not overlap (see CompositeModule).
+// The arena grows to the largest buffer, its memory moves when it grows, so the modules compare the pointers of their buffers
+template <class T>
+class BufferArena
+{
+	typename PoolVector<T>::type data_;
+
+public:
+	T* Reserve(size_t numel)
+	{
+		// the previous contents are not needed, as the buffers that used them are not alive
+		if (data_.size() < numel)
+			typename PoolVector<T>::type(numel).swap(data_);
+		return data_.data();
+	}
+
+	size_t Numel() const
+	{
+		return data_.size();
+	}
+};
+
+// Assigns buffers to arenas, so that the buffers of an arena are not alive at the same time.
+// Buffer i is alive from time starts[i] to time ends[i] inclusive. Returns the index of the arena of each buffer,
+// the arenas are reused greedily in the order of the start times, which gives the minimal number of arenas
+inline std::vector<size_t> AssignBufferArenas(const std::vector<size_t>& starts, const std::vector<size_t>& ends)
+{
+	assert( starts.size() == ends.size() );
+	std::vector< std::pair<size_t, size_t> > start_order;
+	for (size_t i=0; i<starts.size(); i++)
+		start_order.push_back(std::make_pair(starts[i], i));
+	std::sort(start_order.begin(), start_order.end());
+
+	std::vector<size_t> arena_inds(starts.size());
+	// end of the last buffer of each arena
+	std::vector<size_t> arena_ends;
+	for (size_t i=0; i<start_order.size(); i++)
+	{
+		size_t buffer_ind = start_order[i].second;
+		assert( starts[buffer_ind] <= ends[buffer_ind] );
+		size_t arena_ind = 0;
+		while (arena_ind < arena_ends.size() && arena_ends[arena_ind] >= starts[buffer_ind])
+			arena_ind++;
+		if (arena_ind == arena_ends.size())
+			arena_ends.push_back(0);
+		arena_ends[arena_ind] = ends[buffer_ind];
+		arena_inds[buffer_ind] = arena_ind;
+	}
+	return arena_inds;
+}
+
+#endif
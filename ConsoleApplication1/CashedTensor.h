@@ -10,11 +10,11 @@ class CashedTensor
 {
 private:
 	// when shallow copy is made we don't want to create a copy of the vector and tensor
-	std::shared_ptr< std::vector<T> > data_; 
+	std::shared_ptr< typename PoolVector<T>::type > data_; 
 	std::shared_ptr< Tensor<T> > cashed_tensor_;
 public:
 
-	CashedTensor() : data_( new std::vector<T>() ), cashed_tensor_(new Tensor<T>(0, std::vector<size_t>()))
+	CashedTensor() : data_( new typename PoolVector<T>::type() ), cashed_tensor_(new Tensor<T>(0, std::vector<size_t>()))
 	{
 	}
 
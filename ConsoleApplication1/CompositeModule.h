@@ -2,6 +2,7 @@
 #define COMPOSITE_MODULE_H
 
 #include <map>
+#include <algorithm>
 #include "Module.h"
 #include "ModuleFactory.h"
 
@@ -12,13 +13,92 @@ class CompositeModule : public Module<ParamsType>
 
 	std::map< std::string, std::shared_ptr<Module<ParamsType> > > modules_map_;
 
+	// arenas of the output and input gradients buffers of the modules (0 for the buffers that are not allocated)
+	struct BuffersPlan
+	{
+		bool planned;
+		std::vector< std::shared_ptr< BufferArena<ParamsType> > > output_arenas;
+		std::vector< std::shared_ptr< BufferArena<ParamsType> > > input_gradients_arenas;
+		std::vector< std::shared_ptr< BufferArena<ParamsType> > > arenas;
+		// Module::AlocateInputGradientsBuffer of the modules when the plan was made, it changes when a module is fused
+		// with the cost module (see CrossEntropyCostModule::FuseSoftmax)
+		std::vector<bool> allocated_input_gradients;
+
+		BuffersPlan() : planned(false)
+		{
+		}
+	};
+
+	enum UsedPlan
+	{
+		no_plan,
+		predict_plan,
+		train_plan
+	};
+
+	bool share_buffers_;
+	// outputs of the modules that are read after fprop of the composite module (see NN::Predict)
+	std::vector<bool> retained_outputs_;
+	BuffersPlan predict_plan_;
+	BuffersPlan train_plan_;
+	UsedPlan used_plan_;
+
+	BuffersPlan PlanBuffers(bool train_mode) const;
+	void UseBuffersPlan(bool train_mode);
+
+	void ResetBuffersPlans()
+	{
+		predict_plan_ = BuffersPlan();
+		train_plan_ = BuffersPlan();
+		used_plan_ = no_plan;
+		for (size_t i=0; i< modules_.size(); i++)
+			modules_[i]->SetBufferArenas(std::shared_ptr< BufferArena<ParamsType> >(), std::shared_ptr< BufferArena<ParamsType> >());
+	}
+
 public:
 
-	CompositeModule(std::string name, std::vector<std::shared_ptr<Module<ParamsType> > >& modules) : Module<ParamsType>(name), modules_(modules)
+	CompositeModule(std::string name, std::vector<std::shared_ptr<Module<ParamsType> > >& modules) : Module<ParamsType>(name), modules_(modules),
+		share_buffers_(true), retained_outputs_(modules.size(), false), used_plan_(no_plan)
 	{
 		for (size_t i=0; i< modules_.size(); i++)
 			modules_map_[modules_[i]->GetName()] = modules_[i];
 	}
+
+	// Buffers of the modules share the memory if their lifetimes do not overlap: predict_fprop keeps only the input
+	// and the output of the current module (and the outputs read by GetCost), train_fprop and bprop also keep the buffers
+	// that bprop reads (see Module::BpropUsesInput). Outputs of the inner modules are not valid after fprop, except for
+	// the last one and the ones passed to RetainOutputBuffer. Sharing can be disabled, so that every module keeps its own buffers
+	void SetBufferSharing(bool share_buffers)
+	{
+		share_buffers_ = share_buffers;
+		ResetBuffersPlans();
+	}
+
+	bool GetBufferSharing() const
+	{
+		return share_buffers_;
+	}
+
+	// keeps the output of the module valid after fprop of the composite module
+	void RetainOutputBuffer(const std::string& module_name)
+	{
+		for (size_t i=0; i< modules_.size(); i++)
+			if (modules_[i]->GetName() == module_name && !retained_outputs_[i])
+			{
+				retained_outputs_[i] = true;
+				ResetBuffersPlans();
+			}
+	}
+
+	// number of elements in the shared buffers of the modules for train_fprop and bprop or for predict_fprop
+	size_t GetSharedBuffersNumel(bool train_mode) const
+	{
+		const BuffersPlan& plan = train_mode ? train_plan_ : predict_plan_;
+		size_t numel = 0;
+		for (size_t i=0; i<plan.arenas.size(); i++)
+			numel += plan.arenas[i]->Numel();
+		return numel;
+	}
 	
 	virtual size_t GetNumParams() const;
 
@@ -32,6 +112,12 @@ public:
 		return false;
 	}
 
+	// the input is passed to the first module, which makes a dense copy if it needs one
+	virtual bool AcceptsStridedInput() const
+	{
+		return true;
+	}
+
 	std::shared_ptr<Module<ParamsType> > GetModule(std::string name)
 	{
 		if ( modules_map_.find( name ) == modules_map_.end() )
@@ -68,6 +154,26 @@ public:
 		assert( offset == GetNumParams() );
 	}
 
+	virtual void BindParameters(ParamsType* params)
+	{
+		size_t offset = 0;
+		for (size_t i=0; i < modules_.size(); i++)
+		{
+			modules_[i]->BindParameters(params+offset);
+			offset += modules_[i]->GetNumParams();
+		}
+	}
+
+	virtual void BindGradients(ParamsType* gradients)
+	{
+		size_t offset = 0;
+		for (size_t i=0; i < modules_.size(); i++)
+		{
+			modules_[i]->BindGradients(gradients+offset);
+			offset += modules_[i]->GetNumParams();
+		}
+	}
+
 	virtual void SetParameters(const std::vector<ParamsType>& params)
 	{
 		assert(GetNumParams() == params.size());
@@ -86,6 +192,21 @@ public:
 			modules_[i]->GetGradients(receiver);
 	}
 
+	virtual void CopyTrainState(const Module<ParamsType>& module)
+	{
+		const CompositeModule<ParamsType>& other_module = static_cast< const CompositeModule<ParamsType>& >(module);
+		assert( modules_.size() == other_module.modules_.size() );
+		for (size_t i=0; i < modules_.size(); i++)
+			modules_[i]->CopyTrainState(*other_module.modules_[i]);
+	}
+
+	virtual void SetProfiler(const std::shared_ptr<ModuleProfiler>& profiler)
+	{
+		Module<ParamsType>::SetProfiler(profiler);
+		for (size_t i=0; i < modules_.size(); i++)
+			modules_[i]->SetProfiler(profiler);
+	}
+
 	virtual void InitializeParameters();
 	
 	virtual double GetCost(const std::vector<ParamsType>& samples_importances);
@@ -177,9 +298,99 @@ std::vector<size_t> CompositeModule<ParamsType>::GetPerCaseOutputDims(const std:
 	return per_case_output_dims;
 }
 
+// Time steps are fprop of module i at i, bprop of module i at 2n-1-i and 2n after the composite module.
+// A buffer is alive from the step that writes it to the last step that reads it
+template <class ParamsType>
+typename CompositeModule<ParamsType>::BuffersPlan CompositeModule<ParamsType>::PlanBuffers(bool train_mode) const
+{
+	size_t num_modules = modules_.size();
+	size_t end_time = 2*num_modules;
+	std::vector<size_t> starts;
+	std::vector<size_t> ends;
+	std::vector<size_t> output_buffer_inds(num_modules, starts.max_size());
+	std::vector<size_t> input_gradients_buffer_inds(num_modules, starts.max_size());
+	for (size_t module_ind = 0; module_ind<num_modules; module_ind++)
+	{
+		if (!modules_[module_ind]->AlocateOutputBuffer())
+			continue;
+		// the output passes through the modules that do not allocate output buffers (and can modify it in place)
+		// to the next module that allocates it
+		bool used_later = retained_outputs_[module_ind] || (train_mode && modules_[module_ind]->BpropUsesOutput());
+		size_t consumer_ind = module_ind+1;
+		for (; consumer_ind<num_modules; consumer_ind++)
+		{
+			const Module<ParamsType>& consumer = *modules_[consumer_ind];
+			used_later = used_later || consumer.CostUsesInput() || (train_mode && consumer.BpropUsesInput());
+			if (consumer.AlocateOutputBuffer())
+				break;
+			used_later = used_later || retained_outputs_[consumer_ind] || (train_mode && consumer.BpropUsesOutput());
+		}
+		output_buffer_inds[module_ind] = starts.size();
+		starts.push_back(module_ind);
+		ends.push_back( (used_later || consumer_ind == num_modules) ? end_time : consumer_ind );
+	}
+
+	if (train_mode)
+		for (size_t module_ind = 0; module_ind<num_modules; module_ind++)
+		{
+			if (!modules_[module_ind]->AlocateInputGradientsBuffer())
+				continue;
+			// the gradients pass through the modules that do not allocate input gradients buffers to the previous module that allocates it
+			size_t consumer_ind = module_ind;
+			while (consumer_ind > 0 && !modules_[consumer_ind-1]->AlocateInputGradientsBuffer())
+				consumer_ind--;
+			input_gradients_buffer_inds[module_ind] = starts.size();
+			starts.push_back(end_time-1-module_ind);
+			ends.push_back( consumer_ind == 0 ? end_time : end_time-consumer_ind );
+		}
+
+	std::vector<size_t> arena_inds = AssignBufferArenas(starts, ends);
+	BuffersPlan plan;
+	plan.planned = true;
+	for (size_t module_ind = 0; module_ind<num_modules; module_ind++)
+		plan.allocated_input_gradients.push_back(modules_[module_ind]->AlocateInputGradientsBuffer());
+	plan.output_arenas.resize(num_modules);
+	plan.input_gradients_arenas.resize(num_modules);
+	size_t num_arenas = arena_inds.empty() ? 0 : *std::max_element(arena_inds.begin(), arena_inds.end())+1;
+	for (size_t i=0; i<num_arenas; i++)
+		plan.arenas.push_back( std::shared_ptr< BufferArena<ParamsType> >( new BufferArena<ParamsType>() ) );
+	for (size_t module_ind = 0; module_ind<num_modules; module_ind++)
+	{
+		if (output_buffer_inds[module_ind] < starts.size())
+			plan.output_arenas[module_ind] = plan.arenas[arena_inds[output_buffer_inds[module_ind]]];
+		if (input_gradients_buffer_inds[module_ind] < starts.size())
+			plan.input_gradients_arenas[module_ind] = plan.arenas[arena_inds[input_gradients_buffer_inds[module_ind]]];
+	}
+	return plan;
+}
+
+template <class ParamsType>
+void CompositeModule<ParamsType>::UseBuffersPlan(bool train_mode)
+{
+	if (!share_buffers_)
+		return;
+	BuffersPlan& plan = train_mode ? train_plan_ : predict_plan_;
+	if (plan.planned && train_mode)
+		for (size_t module_ind = 0; module_ind<modules_.size(); module_ind++)
+			if (modules_[module_ind]->AlocateInputGradientsBuffer() != plan.allocated_input_gradients[module_ind])
+				plan.planned = false;
+	if (!plan.planned)
+	{
+		plan = PlanBuffers(train_mode);
+		used_plan_ = no_plan;
+	}
+	UsedPlan required_plan = train_mode ? train_plan : predict_plan;
+	if (used_plan_ == required_plan)
+		return;
+	for (size_t module_ind = 0; module_ind<modules_.size(); module_ind++)
+		modules_[module_ind]->SetBufferArenas(plan.output_arenas[module_ind], plan.input_gradients_arenas[module_ind]);
+	used_plan_ = required_plan;
+}
+
 template <class ParamsType>
 void CompositeModule<ParamsType>::sub_train_fprop(const std::shared_ptr< Tensor<ParamsType> >& input, std::shared_ptr< Tensor<ParamsType> >& output)
 {
+	UseBuffersPlan(true);
 	std::shared_ptr< Tensor<ParamsType> > buffer = input;
 	for (size_t module_ind = 0; module_ind<modules_.size(); module_ind++)
 		buffer = modules_[module_ind]->train_fprop(buffer);
@@ -189,6 +400,7 @@ void CompositeModule<ParamsType>::sub_train_fprop(const std::shared_ptr< Tensor<
 template <class ParamsType>
 void CompositeModule<ParamsType>::sub_predict_fprop(const std::shared_ptr< Tensor<ParamsType> >& input, std::shared_ptr< Tensor<ParamsType> >& output)
 {
+	UseBuffersPlan(false);
 	std::shared_ptr< Tensor<ParamsType> > buffer = input;
 	for (size_t module_ind = 0; module_ind<modules_.size(); module_ind++)
 		buffer = modules_[module_ind]->predict_fprop(buffer);
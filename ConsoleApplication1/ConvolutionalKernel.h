@@ -32,6 +32,11 @@ public:
 	virtual std::string GetType() const;
 
 	virtual bool Equals(const Kernel<DataType>& kernel) const;
+
+	virtual bool SupportsMatrixLowering() const
+	{
+		return true;
+	}
 };
 
 
@@ -123,8 +128,8 @@ template <class DataType>
 void ConvolutionalKernel<DataType>::fprop(const Tensor<DataType>& input, Tensor<DataType>& output)
 {
 	output.SetZeros();
-	auto& kernel_offsets = GetKernelOffsets(input.GetDimensions());
-	auto& valid_tensor_positions = GetValidTensorPositions(input.GetDimensions());
+	auto& kernel_offsets = GetKernelOffsets(input.GetShape());
+	auto& valid_tensor_positions = GetValidTensorPositions(input.GetShape());
 	const auto& kernel = GetKernelTensor();
 	const DataType* kernel_start = kernel.GetStartPtr();
 	DataType* output_start_ptr = output.GetStartPtr();
@@ -148,8 +153,9 @@ template <class DataType>
 void ConvolutionalKernel<DataType>::bprop(const Tensor<DataType>& input, const Tensor<DataType>& output, 
 											 Tensor<DataType>& input_gradients, const Tensor<DataType>& output_gradients)
 {
-	auto& kernel_offsets = GetKernelOffsets(input.GetDimensions());
-	auto& valid_tensor_positions = GetValidTensorPositions(input.GetDimensions());
+	// only the gradients are accessed, their layout may differ from the one of the input
+	auto& kernel_offsets = GetKernelOffsets(input_gradients.GetShape());
+	auto& valid_tensor_positions = GetValidTensorPositions(input_gradients.GetShape());
 	auto& kernel = GetKernelTensor();
 	const DataType* kernel_start = kernel.GetStartPtr();
 	const size_t* valid_offsets_start_ptr = valid_tensor_positions.data();
@@ -171,8 +177,8 @@ template <class DataType>
 void ConvolutionalKernel<DataType>::GetGradient(const Tensor<DataType>& input, const Tensor<DataType>& output, 
 													const Tensor<DataType>& output_gradients, Tensor<DataType>& gradient)
 {
-	auto& kernel_offsets = GetKernelOffsets(input.GetDimensions());
-	auto& valid_tensor_positions = GetValidTensorPositions(input.GetDimensions());
+	auto& kernel_offsets = GetKernelOffsets(input.GetShape());
+	auto& valid_tensor_positions = GetValidTensorPositions(input.GetShape());
 	auto& kernel = GetKernelTensor();
 	DataType* gradient_start_ptr = gradient.GetStartPtr();
 	const DataType* kernel_start = kernel.GetStartPtr();
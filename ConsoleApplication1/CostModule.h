@@ -2,6 +2,8 @@
 #define COST_MODULE_H
 
 #include <vector>
+#include <typeinfo>
+#include <utility>
 #include "Tensor.h"
 #include "Module.h"
 
@@ -9,17 +11,37 @@ template <class T>
 class CostModule
 {
 private:
-	std::vector<T> output_gradients_buffer_data;
+	typename PoolVector<T>::type output_gradients_buffer_data;
 	std::shared_ptr< Tensor<T> > output_gradients_buffer_;
+	std::shared_ptr<ModuleProfiler> profiler_;
 
 	virtual void sub_bprop(const Tensor<T>& output, const Tensor<T>& expected_output, 
 		const std::vector<T>& importance_weights, bool normalize_by_importance, Tensor<T>& output_gradients_buffer,double lambda) = 0;
 
 	void UpdateCash(const Tensor<T>& expected_output);
+
+	// 0 if the profiling is off or compiled out
+	ModuleProfiler* GetActiveProfiler() const
+	{
+#ifdef NNLIB_NO_PROFILING
+		return nullptr;
+#else
+		return profiler_.get();
+#endif
+	}
 	
 	virtual double sub_GetCost(const Tensor<T>& net_output, const Tensor<T>& expected_output, 
 		const std::vector<T>& importance_weights, bool normalize_by_importance, double lambda) = 0;
 
+	// cost modules that can compute the cost and the gradients in one pass over the data override it
+	virtual double sub_GetCostAndGradients(const Tensor<T>& net_output, const Tensor<T>& expected_output, 
+		const std::vector<T>& importance_weights, bool normalize_by_importance, Tensor<T>& output_gradients_buffer, double lambda)
+	{
+		double cost = sub_GetCost(net_output, expected_output, importance_weights, normalize_by_importance, lambda);
+		sub_bprop(net_output, expected_output, importance_weights, normalize_by_importance, output_gradients_buffer, lambda);
+		return cost;
+	}
+
 public:
 
 	CostModule() : output_gradients_buffer_( std::shared_ptr< Tensor<T> >(new Tensor<T>(0, std::vector<size_t>())) )
@@ -32,6 +54,49 @@ public:
 	std::shared_ptr< Tensor<T> > bprop(const Tensor<T>& net_output, const Tensor<T>& expected_output, 
 		const std::vector<T>& importance_weights, bool normalize_by_importance, double lambda=1);
 
+	// the results of GetCost and bprop with the same lambda
+	std::pair< double, std::shared_ptr< Tensor<T> > > GetCostAndGradients(const Tensor<T>& net_output, const Tensor<T>& expected_output, 
+		const std::vector<T>& importance_weights, bool normalize_by_importance, double lambda=1);
+
+	// the output module of the network that gets from bprop the gradients with respect to its input instead of its output
+	// (see CrossEntropyCostModule::FuseSoftmax), 0 if bprop returns the gradients with respect to the output of the network
+	virtual const Module<T>* GetFusedModule() const
+	{
+		return 0;
+	}
+
+	// fuses the cost module with the output module of the network if they can be fused (see GetFusedModule), returns whether they were fused
+	virtual bool Fuse(Module<T>& output_module)
+	{
+		return false;
+	}
+
+	// undoes Fuse, bprop returns the gradients with respect to the output of the network again
+	virtual void Unfuse()
+	{
+	}
+
+	// makes GetCost and bprop record their statistics to the profiler under the name "cost_module", 0 to stop the profiling
+	void SetProfiler(const std::shared_ptr<ModuleProfiler>& profiler)
+	{
+		profiler_ = profiler;
+	}
+
+	const std::shared_ptr<ModuleProfiler>& GetProfiler() const
+	{
+		return profiler_;
+	}
+
+	std::string GetName() const
+	{
+		return "cost_module";
+	}
+
+	std::string GetType() const
+	{
+		return typeid(*this).name();
+	}
+
 	virtual ~CostModule()
 	{
 	}
@@ -41,30 +106,55 @@ template <class T>
 std::shared_ptr< Tensor<T> > CostModule<T>::bprop(const Tensor<T>& net_output, const Tensor<T>& expected_output, 
 	const std::vector<T>& importance_weights, bool normalize_by_importance, double lambda=1)
 {
+	ProfiledScope< CostModule<T> > profiled_scope(GetActiveProfiler(), *this, profiled_bprop);
 	UpdateCash(net_output);
 	output_gradients_buffer_->SetZeros();
 	sub_bprop(net_output, expected_output, importance_weights, normalize_by_importance, *output_gradients_buffer_, lambda);
+	if (GetActiveProfiler())
+		profiled_scope.AddBufferBytes( static_cast<double>(sizeof(T)*(net_output.Numel() + expected_output.Numel() + output_gradients_buffer_->Numel())) );
 	return output_gradients_buffer_;
 }
 
+template <class T>
+std::pair< double, std::shared_ptr< Tensor<T> > > CostModule<T>::GetCostAndGradients(const Tensor<T>& net_output, const Tensor<T>& expected_output, 
+	const std::vector<T>& importance_weights, bool normalize_by_importance, double lambda=1)
+{
+	ProfiledScope< CostModule<T> > profiled_scope(GetActiveProfiler(), *this, profiled_cost_and_bprop);
+	size_t minibatch_size = net_output.GetDimensionSize(net_output.NumDimensions()-1);
+	assert(minibatch_size == importance_weights.size());
+	UpdateCash(net_output);
+	output_gradients_buffer_->SetZeros();
+	double cost = sub_GetCostAndGradients(net_output, expected_output, importance_weights, normalize_by_importance, *output_gradients_buffer_, lambda);
+	if (GetActiveProfiler())
+		profiled_scope.AddBufferBytes( static_cast<double>(sizeof(T)*(net_output.Numel() + expected_output.Numel() + output_gradients_buffer_->Numel())) );
+	return std::make_pair(cost, output_gradients_buffer_);
+}
+
 template <class T>
 double CostModule<T>::GetCost(const Tensor<T>& net_output, const Tensor<T>& expected_output, 
 		const std::vector<T>& importance_weights, bool normalize_by_importance, double lambda=1)
 {
+	ProfiledScope< CostModule<T> > profiled_scope(GetActiveProfiler(), *this, profiled_cost);
 	size_t minibatch_size = net_output.GetDimensionSize(net_output.NumDimensions()-1);
 	assert(minibatch_size == importance_weights.size());
 
+	if (GetActiveProfiler())
+		profiled_scope.AddBufferBytes( static_cast<double>(sizeof(T)*(net_output.Numel() + expected_output.Numel())) );
 	return sub_GetCost(net_output, expected_output, importance_weights, normalize_by_importance, lambda);
 }
 
 template <class T>
 void CostModule<T>::UpdateCash(const Tensor<T>& expected_output)
 {
-	if ( expected_output.GetDimensions() != output_gradients_buffer_->GetDimensions() )
+	if ( !expected_output.DimensionsEqual(*output_gradients_buffer_) )
 	{
-		std::vector<size_t> output_dims = expected_output.GetDimensions();
-		if ( Tensor<T>::Numel(output_dims) > output_gradients_buffer_data.size())
-			output_gradients_buffer_data = std::vector<T>(Tensor<T>::Numel(output_dims));
+		TensorShape output_dims = expected_output.GetShape().GetContiguous();
+		if ( output_dims.Numel() > output_gradients_buffer_data.size())
+		{
+			output_gradients_buffer_data = typename PoolVector<T>::type(output_dims.Numel());
+			if (GetActiveProfiler())
+				GetActiveProfiler()->RecordBufferAllocation(GetName(), GetType());
+		}
 		output_gradients_buffer_ = std::shared_ptr< Tensor<T> >(new Tensor<T>(output_gradients_buffer_data.data(), output_dims));
 	}
 }
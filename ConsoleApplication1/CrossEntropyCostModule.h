@@ -2,6 +2,7 @@
 #define ENTROPY_LOSS_COST_MODULE_H
 
 #include "CostModule.h"
+#include "SoftmaxModule.h"
 #include <algorithm>
 
 template <class T>
@@ -9,16 +10,59 @@ class CrossEntropyCostModule : public CostModule<T>
 {
 	const T eps;
 	double log2_;
+	// the module whose output is the net output and which passes the gradients through (see FuseSoftmax), 0 if not fused
+	SoftmaxModule<T>* fused_softmax_;
 
-	double log2(double x)
+	double GetImportanceSum(const std::vector<T>& importance_weights, bool normalize_by_importance) const;
+
+	void GetSampleGradients(const T* probabilities, const T* expected_probabilities, T* gradients, size_t num_features, double gradient_scale) const;
+
+	double ComputeCostAndGradients(const Tensor<T>& net_output, const Tensor<T>& expected_output, 
+		const std::vector<T>& importance_weights, bool normalize_by_importance, Tensor<T>* output_gradients_buffer, double lambda);
+
+public:
+
+	CrossEntropyCostModule() : CostModule(), eps(std::numeric_limits<T>::epsilon()), log2_(std::log(2)), fused_softmax_(0)
 	{
-		return (double)(std::log(x) / log2_);
 	}
 
-public:
+	// makes bprop return the gradients with respect to the input of softmax_module, the output module of the network,
+	// p*sum(y)-y instead of -y/p, which the module passes through without multiplying them by its jacobian.
+	// The fusion is not saved with the network, so a loaded network is trained correctly with any cost module
+	// and has to be fused again to pass the gradients through. The replicas of the threads copy it with the train state.
+	// NN throws if it is trained with a cost module and an output module that are not fused with each other, 
+	// the trainers fuse them for the training call (see FusedCostScope)
+	void FuseSoftmax(SoftmaxModule<T>& softmax_module)
+	{
+		Unfuse();
+		softmax_module.SetFusedCrossEntropy(true);
+		fused_softmax_ = &softmax_module;
+	}
+
+	bool IsSoftmaxFused() const
+	{
+		return fused_softmax_ != 0;
+	}
+
+	virtual const Module<T>* GetFusedModule() const
+	{
+		return fused_softmax_;
+	}
 
-	CrossEntropyCostModule() : CostModule(), eps(std::numeric_limits<T>::epsilon()), log2_(std::log(2))
+	virtual bool Fuse(Module<T>& output_module)
 	{
+		if (output_module.GetType() != "SoftmaxModule")
+			return false;
+		FuseSoftmax(static_cast< SoftmaxModule<T>& >(output_module));
+		return true;
+	}
+
+	// the softmax module multiplies the gradients by its jacobian again
+	virtual void Unfuse()
+	{
+		if (fused_softmax_)
+			fused_softmax_->SetFusedCrossEntropy(false);
+		fused_softmax_ = 0;
 	}
 
 	virtual double sub_GetCost(const Tensor<T>& net_output, const Tensor<T>& expected_output, 
@@ -26,64 +70,96 @@ public:
 	
 	virtual void sub_bprop(const Tensor<T>& net_output, const Tensor<T>& expected_output, 
 		const std::vector<T>& importance_weights, bool normalize_by_importance, Tensor<T>& output_gradients_buffer, double lambda);
+
+	virtual double sub_GetCostAndGradients(const Tensor<T>& net_output, const Tensor<T>& expected_output, 
+		const std::vector<T>& importance_weights, bool normalize_by_importance, Tensor<T>& output_gradients_buffer, double lambda);
 };
 
 template <class T>
-double CrossEntropyCostModule<T>::sub_GetCost(const Tensor<T>& net_output, const Tensor<T>& expected_output, 
-		const std::vector<T>& importance_weights, bool normalize_by_importance, double lambda)
+double CrossEntropyCostModule<T>::GetImportanceSum(const std::vector<T>& importance_weights, bool normalize_by_importance) const
 {
+	if (!normalize_by_importance)
+		return 1;
 	double importance_sum = 0;
-	size_t minibatch_size = net_output.GetDimensionSize(net_output.NumDimensions()-1);
-	if (normalize_by_importance)
-		for (size_t sample_ind = 0; sample_ind<minibatch_size; sample_ind++)
-			importance_sum += importance_weights[sample_ind];
+	for (size_t sample_ind = 0; sample_ind<importance_weights.size(); sample_ind++)
+		importance_sum += importance_weights[sample_ind];
+	return importance_sum;
+}
+
+template <class T>
+void CrossEntropyCostModule<T>::GetSampleGradients(const T* probabilities, const T* expected_probabilities, T* gradients, size_t num_features, 
+	double gradient_scale) const
+{
+	if (fused_softmax_)
+	{
+		double expected_sum = 0;
+		for (size_t i = 0; i<num_features; i++)
+			expected_sum += expected_probabilities[i];
+		for (size_t i = 0; i<num_features; i++)
+			gradients[i] = static_cast<T>(gradient_scale*(probabilities[i]*expected_sum - expected_probabilities[i]));
+	}
 	else
-		importance_sum = 1;
-	
-	double cost = 0;
+		for (size_t i = 0; i<num_features; i++)
+			gradients[i] = static_cast<T>(-gradient_scale*expected_probabilities[i] / (probabilities[i]+eps));
+}
+
+// the cost and the gradients of a sample are computed while it is in cache, output_gradients_buffer is 0 if only the cost is needed
+template <class T>
+double CrossEntropyCostModule<T>::ComputeCostAndGradients(const Tensor<T>& net_output, const Tensor<T>& expected_output, 
+		const std::vector<T>& importance_weights, bool normalize_by_importance, Tensor<T>* output_gradients_buffer, double lambda)
+{
+	size_t minibatch_size = net_output.GetDimensionSize(net_output.NumDimensions()-1);
+	assert(minibatch_size == importance_weights.size());
 	size_t num_features = net_output.Numel() / minibatch_size;
+	double importance_sum = GetImportanceSum(importance_weights, normalize_by_importance);
+	const T* output_ptr = net_output.GetStartPtr();
+	const T* expected_output_ptr = expected_output.GetStartPtr();
+
+	double cost = 0;
 	for (size_t sample_ind = 0; sample_ind<minibatch_size; sample_ind++)
 	{
 		size_t offset = num_features*sample_ind;
-		double feature_cost = 0;
-		for (size_t feature_ind = 0; feature_ind<num_features; feature_ind++)
-		{
-			size_t feature_offset = offset+feature_ind;
-			double feature_probability = net_output[feature_offset];
-			feature_cost -= expected_output[feature_offset]*log2(feature_probability+eps);
-		}
-		cost += feature_cost*importance_weights[sample_ind];
+		double sample_cost = 0;
+		for (size_t i = 0; i<num_features; i++)
+			sample_cost -= expected_output_ptr[offset+i]*std::log(output_ptr[offset+i]+eps);
+		cost += sample_cost*importance_weights[sample_ind];
+
+		if (output_gradients_buffer)
+			GetSampleGradients(output_ptr+offset, expected_output_ptr+offset, output_gradients_buffer->GetStartPtr()+offset, num_features, 
+				lambda*importance_weights[sample_ind]/importance_sum/log2_);
 	}
 
-	return lambda*cost/importance_sum;
+	return lambda*cost/log2_/importance_sum;
+}
+
+template <class T>
+double CrossEntropyCostModule<T>::sub_GetCost(const Tensor<T>& net_output, const Tensor<T>& expected_output, 
+		const std::vector<T>& importance_weights, bool normalize_by_importance, double lambda)
+{
+	return ComputeCostAndGradients(net_output, expected_output, importance_weights, normalize_by_importance, 0, lambda);
 }
 
 template <class T>
 void CrossEntropyCostModule<T>::sub_bprop(const Tensor<T>& net_output, const Tensor<T>& expected_output, 
 		const std::vector<T>& importance_weights, bool normalize_by_importance, Tensor<T>& output_gradients_buffer, double lambda)
 {
-	double importance_sum = 0;
 	size_t minibatch_size = net_output.GetDimensionSize(net_output.NumDimensions()-1);
 	assert(minibatch_size == importance_weights.size());
 	size_t num_features = net_output.Numel() / minibatch_size;
-	if (normalize_by_importance)
-		for (size_t sample_ind = 0; sample_ind<minibatch_size; sample_ind++)
-			importance_sum += importance_weights[sample_ind];
-	else
-		importance_sum = 1;
-	
+	double importance_sum = GetImportanceSum(importance_weights, normalize_by_importance);
 	for (size_t sample_ind = 0; sample_ind<minibatch_size; sample_ind++)
 	{
 		size_t offset = num_features*sample_ind;
-
-		double sample_importance = importance_weights[sample_ind]/importance_sum;
-		for (size_t feature_ind = 0; feature_ind<num_features; feature_ind++)
-		{
-			size_t feature_offset = offset+feature_ind;
-			double feature_probability = net_output[feature_offset];
-			output_gradients_buffer[feature_offset] = static_cast<T>(-lambda*sample_importance* expected_output[feature_offset] / (feature_probability+eps) / log2_);
-		}
+		GetSampleGradients(net_output.GetStartPtr()+offset, expected_output.GetStartPtr()+offset, output_gradients_buffer.GetStartPtr()+offset, 
+			num_features, lambda*importance_weights[sample_ind]/importance_sum/log2_);
 	}
 }
 
+template <class T>
+double CrossEntropyCostModule<T>::sub_GetCostAndGradients(const Tensor<T>& net_output, const Tensor<T>& expected_output, 
+		const std::vector<T>& importance_weights, bool normalize_by_importance, Tensor<T>& output_gradients_buffer, double lambda)
+{
+	return ComputeCostAndGradients(net_output, expected_output, importance_weights, normalize_by_importance, &output_gradients_buffer, lambda);
+}
+
 #endif
\ No newline at end of file
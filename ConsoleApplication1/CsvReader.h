@@ -0,0 +1,319 @@
+#ifndef CSV_READER_H
+#define CSV_READER_H
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <thread>
+#include <stdexcept>
+#include <cstdlib>
+#include <cstdint>
+#include "MappedFile.h"
+#include "ThreadPool.h"
+
+// Parses the number of a csv field that starts at ptr, the field ends at the delimiter, the end of the line or end.
+// On success moves ptr to the end of the field. Decimal numbers with at most 19 significant digits and small exponents are
+// converted exactly without strtod, other fields (long mantissas, nan, inf) are passed to strtod
+template <class T>
+bool ParseCsvNumber(const char*& ptr, const char* end, char delimiter, T& value)
+{
+	static const double powers_of_10[] = {1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+		1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+	const char* p = ptr;
+	while (p != end && (*p == ' ' || *p == '\t'))
+		p++;
+	const char* field_start = p;
+	bool negative = p != end && *p == '-';
+	if (p != end && (*p == '-' || *p == '+'))
+		p++;
+	uint64_t mantissa = 0;
+	int num_significant_digits = 0;
+	int exponent = 0;
+	bool has_digits = false;
+	for (; p != end && *p >= '0' && *p <= '9'; p++)
+	{
+		has_digits = true;
+		if (num_significant_digits < 19)
+		{
+			mantissa = mantissa*10 + (*p - '0');
+			num_significant_digits += mantissa != 0;
+		}
+		else
+			exponent++;
+	}
+	if (p != end && *p == '.')
+		for (p++; p != end && *p >= '0' && *p <= '9'; p++)
+		{
+			has_digits = true;
+			if (num_significant_digits < 19)
+			{
+				mantissa = mantissa*10 + (*p - '0');
+				num_significant_digits += mantissa != 0;
+				exponent--;
+			}
+		}
+	if (has_digits && p != end && (*p == 'e' || *p == 'E'))
+	{
+		p++;
+		bool negative_exponent = p != end && *p == '-';
+		if (p != end && (*p == '-' || *p == '+'))
+			p++;
+		if (p == end || *p < '0' || *p > '9')
+			has_digits = false;
+		int written_exponent = 0;
+		for (; p != end && *p >= '0' && *p <= '9'; p++)
+			written_exponent = written_exponent < 100000 ? written_exponent*10 + (*p - '0') : written_exponent;
+		exponent += negative_exponent ? -written_exponent : written_exponent;
+	}
+	const char* number_end = p;
+	while (p != end && (*p == ' ' || *p == '\t'))
+		p++;
+	bool at_field_end = p == end || *p == delimiter || *p == '\n' || *p == '\r';
+
+	// the mantissa and the power of 10 are exact doubles, so the result is correctly rounded
+	if (has_digits && at_field_end && mantissa <= (static_cast<uint64_t>(1) << 53) && exponent >= -22 && exponent <= 22)
+	{
+		double result = static_cast<double>(mantissa);
+		result = exponent < 0 ? result / powers_of_10[-exponent] : result * powers_of_10[exponent];
+		value = static_cast<T>(negative ? -result : result);
+		ptr = p;
+		return true;
+	}
+
+	// strtod needs a null-terminated string, the mapped file is not
+	const char* field_end = number_end;
+	while (field_end != end && *field_end != delimiter && *field_end != '\n' && *field_end != '\r')
+		field_end++;
+	while (field_end != field_start && (field_end[-1] == ' ' || field_end[-1] == '\t'))
+		field_end--;
+	char field[128];
+	size_t field_size = static_cast<size_t>(field_end - field_start);
+	if (field_size == 0 || field_size >= sizeof(field))
+		return false;
+	std::copy(field_start, field_end, field);
+	field[field_size] = 0;
+	char* parsed_end;
+	double result = std::strtod(field, &parsed_end);
+	if (parsed_end != field + field_size)
+		return false;
+	value = static_cast<T>(result);
+	ptr = field_end;
+	while (ptr != end && (*ptr == ' ' || *ptr == '\t'))
+		ptr++;
+	return true;
+}
+
+// Reads the numeric rows of a csv file into a row-major matrix. The file is mapped to memory and read in chunks of bytes,
+// the lines of a chunk are split between the threads, each thread counts its rows and then parses them straight into
+// their place in the matrix. Empty lines are skipped, all the other lines must have the same number of values.
+// ReadChunk lets the caller process a large file chunk by chunk
+template <class T>
+class CsvReader
+{
+	std::string path_;
+	MappedFile file_;
+	char delimiter_;
+	size_t chunk_bytes_;
+	std::shared_ptr<ThreadPool> thread_pool_;
+	std::vector<std::string> header_;
+	size_t num_columns_;
+	// the start of the next unread line and its number (from 1, for the error messages)
+	size_t position_;
+	size_t line_number_;
+
+	CsvReader(const CsvReader&);
+	CsvReader& operator=(const CsvReader&);
+
+	static bool IsEmptyLine(const char* line_start, const char* line_end)
+	{
+		for (const char* p = line_start; p != line_end; p++)
+			if (*p != ' ' && *p != '\t' && *p != '\r' && *p != '\n')
+				return false;
+		return true;
+	}
+
+	// the start of the line after the one that contains position, or end
+	static const char* GetNextLineStart(const char* position, const char* end)
+	{
+		while (position != end && *position != '\n')
+			position++;
+		return position == end ? end : position+1;
+	}
+
+	void ReadHeader()
+	{
+		const char* data = file_.GetData();
+		const char* end = data + file_.GetSize();
+		const char* line_end = GetNextLineStart(data, end);
+		position_ = line_end - data;
+		line_number_ = 2;
+		std::string field;
+		for (const char* p = data; p != line_end; p++)
+		{
+			if (*p == delimiter_ || *p == '\n')
+			{
+				header_.push_back(field);
+				field.clear();
+			}
+			else if (*p != '\r' && *p != '"')
+				field += *p;
+		}
+		if (!field.empty() || line_end == end)
+			header_.push_back(field);
+		num_columns_ = header_.size();
+	}
+
+	// the number of the values of the first non-empty line, 0 if there are no values
+	size_t CountColumns()
+	{
+		const char* data = file_.GetData();
+		const char* end = data + file_.GetSize();
+		for (const char* line_start = data + position_; line_start != end; )
+		{
+			const char* line_end = GetNextLineStart(line_start, end);
+			if (!IsEmptyLine(line_start, line_end))
+			{
+				size_t num_columns = 1;
+				for (const char* p = line_start; p != line_end; p++)
+					num_columns += *p == delimiter_;
+				return num_columns;
+			}
+			line_start = line_end;
+		}
+		return 0;
+	}
+
+	static void CountRows(const char* begin, const char* end, size_t& num_rows, size_t& num_lines)
+	{
+		num_rows = 0;
+		num_lines = 0;
+		for (const char* line_start = begin; line_start != end; num_lines++)
+		{
+			const char* line_end = GetNextLineStart(line_start, end);
+			num_rows += !IsEmptyLine(line_start, line_end);
+			line_start = line_end;
+		}
+	}
+
+	void ParseRows(const char* begin, const char* end, size_t first_line_number, T* output) const
+	{
+		size_t line_number = first_line_number;
+		for (const char* line_start = begin; line_start != end; line_number++)
+		{
+			const char* line_end = GetNextLineStart(line_start, end);
+			if (!IsEmptyLine(line_start, line_end))
+			{
+				const char* p = line_start;
+				for (size_t column = 0; column<num_columns_; column++)
+				{
+					if (column > 0)
+					{
+						if (p == line_end || *p != delimiter_)
+							throw std::runtime_error("CsvReader: less than " + std::to_string(num_columns_) + " values in line " +
+								std::to_string(line_number) + " of " + path_);
+						p++;
+					}
+					if (!ParseCsvNumber(p, line_end, delimiter_, output[column]))
+						throw std::runtime_error("CsvReader: can not parse value " + std::to_string(column+1) + " in line " +
+							std::to_string(line_number) + " of " + path_);
+				}
+				if (!IsEmptyLine(p, line_end))
+					throw std::runtime_error("CsvReader: more than " + std::to_string(num_columns_) + " values in line " +
+						std::to_string(line_number) + " of " + path_);
+				output += num_columns_;
+			}
+			line_start = line_end;
+		}
+	}
+
+public:
+
+	// num_threads 0 uses all the hardware threads
+	CsvReader(const std::string& path, bool has_header = true, char delimiter = ',', size_t num_threads = 0, size_t chunk_bytes = 1 << 24)
+		: path_(path), file_(path), delimiter_(delimiter), chunk_bytes_(chunk_bytes), num_columns_(0), position_(0), line_number_(1)
+	{
+		if (num_threads == 0)
+			num_threads = std::max<size_t>(1, std::thread::hardware_concurrency());
+		thread_pool_ = std::shared_ptr<ThreadPool>( new ThreadPool(num_threads) );
+		if (has_header)
+			ReadHeader();
+		else
+			num_columns_ = CountColumns();
+	}
+
+	// the fields of the first line, with the quotes removed. Empty if the file has no header
+	const std::vector<std::string>& GetHeader() const
+	{
+		return header_;
+	}
+
+	size_t GetNumColumns() const
+	{
+		return num_columns_;
+	}
+
+	bool AtEnd() const
+	{
+		return position_ == file_.GetSize();
+	}
+
+	// appends the rows of the next chunk of the file (about chunk_bytes) to the row-major matrix, returns the number of the rows
+	size_t ReadChunk(std::vector<T>& matrix)
+	{
+		const char* data = file_.GetData();
+		const char* end = data + file_.GetSize();
+		const char* chunk_start = data + position_;
+		const char* chunk_end = static_cast<size_t>(end - chunk_start) <= chunk_bytes_ ? end : GetNextLineStart(chunk_start + chunk_bytes_, end);
+
+		size_t num_workers = thread_pool_->GetNumWorkers();
+		std::vector<const char*> range_starts(num_workers+1, chunk_end);
+		range_starts[0] = chunk_start;
+		size_t range_bytes = (chunk_end - chunk_start) / num_workers;
+		for (size_t worker_ind = 1; worker_ind < num_workers; worker_ind++)
+		{
+			const char* range_start = range_starts[worker_ind-1] + range_bytes;
+			// the ranges start at the starts of the lines
+			range_starts[worker_ind] = range_start >= chunk_end ? chunk_end :
+				(range_start == chunk_start ? chunk_start : GetNextLineStart(range_start-1, chunk_end));
+		}
+
+		std::vector<size_t> num_rows(num_workers), num_lines(num_workers);
+		thread_pool_->Run( [&](size_t worker_ind)
+		{
+			CountRows(range_starts[worker_ind], range_starts[worker_ind+1], num_rows[worker_ind], num_lines[worker_ind]);
+		});
+
+		size_t first_row = matrix.size() / std::max<size_t>(num_columns_, 1);
+		std::vector<size_t> row_offsets(num_workers+1, first_row), line_numbers(num_workers+1, line_number_);
+		for (size_t worker_ind = 0; worker_ind < num_workers; worker_ind++)
+		{
+			row_offsets[worker_ind+1] = row_offsets[worker_ind] + num_rows[worker_ind];
+			line_numbers[worker_ind+1] = line_numbers[worker_ind] + num_lines[worker_ind];
+		}
+		size_t num_chunk_rows = row_offsets[num_workers] - first_row;
+		if (num_chunk_rows > 0 && num_columns_ == 0)
+			throw std::runtime_error("CsvReader: no columns in " + path_);
+		matrix.resize(matrix.size() + num_chunk_rows*num_columns_);
+		T* matrix_data = matrix.data();
+		thread_pool_->Run( [&](size_t worker_ind)
+		{
+			ParseRows(range_starts[worker_ind], range_starts[worker_ind+1], line_numbers[worker_ind],
+				matrix_data + row_offsets[worker_ind]*num_columns_);
+		});
+
+		position_ = chunk_end - data;
+		line_number_ = line_numbers[num_workers];
+		return num_chunk_rows;
+	}
+
+	// appends all the remaining rows to the matrix, returns their number
+	size_t ReadAll(std::vector<T>& matrix)
+	{
+		size_t num_rows = 0;
+		while (!AtEnd())
+			num_rows += ReadChunk(matrix);
+		return num_rows;
+	}
+};
+
+#endif
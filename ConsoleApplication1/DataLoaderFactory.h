@@ -5,6 +5,7 @@
 #include "FullTensorDataLoader.h"
 #include "RandomShiftPartialTensorDataLoader.h"
 #include "FixedShiftPartialTensorDataLoader.h"
+#include "MappedTensorDataLoader.h"
 
 class UnknownDataLoaderType : public std::runtime_error 
 {
@@ -34,6 +35,10 @@ public:
 		input_stream>>name;
 		std::getline(input_stream, end_of_line_char_str); // remove end of line character
 
+		// the samples are not saved in the stream
+		if (type == "MappedTensorDataLoader")
+			return MappedTensorDataLoader<OutputType, InputType>::Create(name, input_stream);
+
 		std::vector< std::shared_ptr< Tensor<InputType> > > data;
 		LoadDataset<InputType>(input_stream, data);
 
@@ -2,38 +2,83 @@
 #define DROPOUT_MODULE_H
 
 #include <string>
+#include <cstdint>
 #include "Module.h"
 #include "RandomGenerator.h"
+#include "SimdOperations.h"
 #include "Converter.h"
 
+// output[i] = input[i]*scale if bit i of the mask is set, 0 otherwise (bit i%32 of mask_bits[i/32])
+template <class T>
+void ApplyDropoutMask(const T* input, const uint32_t* mask_bits, T scale, T* output, size_t num_elements)
+{
+	for (size_t i = 0; i<num_elements; i++)
+		output[i] = ((mask_bits[i/32] >> (i%32)) & 1) ? input[i]*scale : static_cast<T>(0);
+}
+
+#ifdef NNLIB_SIMD_FLOAT
+inline void ApplyDropoutMask(const float* input, const uint32_t* mask_bits, float scale, float* output, size_t num_elements)
+{
+	SimdFloat simd_scale = SimdSet(scale);
+	size_t i = 0;
+	for (; i+32<=num_elements; i+=32)
+	{
+		uint32_t word = mask_bits[i/32];
+		for (size_t lane = 0; lane<32; lane+=simd_float_width)
+			SimdStore( output+i+lane, SimdMaskLanes(SimdMul(SimdLoad(input+i+lane), simd_scale), word >> lane) );
+	}
+	for (; i<num_elements; i++)
+		output[i] = ((mask_bits[i/32] >> (i%32)) & 1) ? input[i]*scale : 0.0f;
+}
+#endif
+
+// Sets the elements to 0 with the dropout probability. The mask of the minibatch is kept as a bitset.
+// The inverted dropout scales the kept elements by 1/(1-dropout probability) in training, so predict passes the input through
+// without copying it; otherwise predict scales the input by the dropout probability
 template <class ParamsType>
 class DropoutModule : public Module<ParamsType>
 {
-	std::vector<ParamsType> dropout_tensor_data_;
-	std::shared_ptr< Tensor<ParamsType> > dropout_tensor_;
-	std::vector<size_t> cashed_input_dims;
+	std::vector<uint32_t> mask_bits_;
+	TensorShape cashed_input_dims;
 	double dropout_probability_;
+	bool inverted_;
+	// the inverted dropout does not allocate the output buffer (predict returns the input), the output of training is kept here
+	typename PoolVector<ParamsType>::type train_output_data_;
+	std::shared_ptr< Tensor<ParamsType> > train_output_;
+	// each module (and each replica of a network) has its own stream, see RandomGenerator::CreateStream
+	RandomStream random_stream_;
 
-	void UpdateCash(const std::vector<size_t>& input_dims)
+	void UpdateCash(const TensorShape& input_dims)
 	{
 		if (cashed_input_dims != input_dims)
 		{
 			cashed_input_dims = input_dims;
-			dropout_tensor_data_.reserve( Tensor<ParamsType>::Numel(input_dims) );
-			dropout_tensor_ = std::shared_ptr< Tensor<ParamsType> >(new Tensor<ParamsType>( dropout_tensor_data_.data(), input_dims));
+			size_t numel = input_dims.Numel();
+			mask_bits_.resize( (numel+31) / 32 );
+			if (inverted_)
+			{
+				train_output_data_.resize(numel);
+				train_output_ = std::shared_ptr< Tensor<ParamsType> >(new Tensor<ParamsType>( train_output_data_.data(), input_dims));
+			}
 		}
 	}
 
+	ParamsType GetTrainScale() const
+	{
+		return static_cast<ParamsType>( inverted_ ? 1/(1-dropout_probability_) : 1 );
+	}
+
 	virtual void sub_train_fprop(const std::shared_ptr< Tensor<ParamsType> >& input, std::shared_ptr< Tensor<ParamsType> >& output);
 	virtual void sub_predict_fprop(const std::shared_ptr< Tensor<ParamsType> >& input, std::shared_ptr< Tensor<ParamsType> >& output);
-	
-	virtual void sub_bprop(const std::shared_ptr< Tensor<ParamsType> >& input, const std::shared_ptr< Tensor<ParamsType> >& output, 
-		std::shared_ptr< Tensor<ParamsType> >& input_gradients, const std::shared_ptr< Tensor<ParamsType> >& output_gradients, 
+
+	virtual void sub_bprop(const std::shared_ptr< Tensor<ParamsType> >& input, const std::shared_ptr< Tensor<ParamsType> >& output,
+		std::shared_ptr< Tensor<ParamsType> >& input_gradients, const std::shared_ptr< Tensor<ParamsType> >& output_gradients,
 		const std::vector<ParamsType>& samples_importances);
 	virtual void sub_GetState(IOTreeNode& node) const;
 public:
 
-	DropoutModule(std::string name, double dropout_probability) : Module<ParamsType>(name), dropout_probability_(dropout_probability)
+	DropoutModule(std::string name, double dropout_probability, bool inverted = false) : Module<ParamsType>(name),
+		dropout_probability_(dropout_probability), inverted_(inverted), random_stream_(RandomGenerator::CreateStream())
 	{
 
 	}
@@ -42,13 +87,49 @@ public:
 	{
 		if ( !(module.GetType() == GetType() && module.GetName() == GetName()) )
 			return false;
-		
+
 		const DropoutModule<ParamsType>* other_module = static_cast< const DropoutModule<ParamsType>* >( &module );
-		return other_module->dropout_probability_ == dropout_probability_;
+		return other_module->dropout_probability_ == dropout_probability_ && other_module->inverted_ == inverted_;
+	}
+
+	virtual bool AlocateOutputBuffer() const
+	{
+		return !inverted_;
+	}
+
+	virtual bool OverwritesOutputBuffer() const
+	{
+		return true;
+	}
+
+	virtual bool OverwritesInputGradientsBuffer() const
+	{
+		return true;
+	}
+
+	// bprop uses only the mask
+	virtual bool BpropUsesInput() const
+	{
+		return false;
+	}
+
+	virtual bool BpropUsesOutput() const
+	{
+		return false;
+	}
+
+	double GetDropoutProbability() const
+	{
+		return dropout_probability_;
+	}
+
+	bool IsInverted() const
+	{
+		return inverted_;
 	}
 
 	static std::shared_ptr< Module< ParamsType> > Create(IOTreeNode& data);
-	
+
 	virtual std::string GetType() const
 	{
 		return "DropoutModule";
@@ -59,35 +140,38 @@ template <class ParamsType>
 void DropoutModule<ParamsType>::sub_GetState(IOTreeNode& node) const
 {
 	node.attributes().AppendEntry( "DropoutProbability", std::to_string(dropout_probability_) );
+	if (inverted_)
+		node.attributes().AppendEntry( "Inverted", "1" );
 }
 
 template <class ParamsType>
 std::shared_ptr< Module< ParamsType> > DropoutModule<ParamsType>::Create(IOTreeNode& data)
 {
 	double dropout_probability = Converter::ConvertTo<double>(data.attributes().GetEntry( "DropoutProbability"));
-	return std::shared_ptr< Module< ParamsType> >( new DropoutModule<ParamsType>(data.attributes().GetEntry( "Name" ), dropout_probability ) );
+	bool inverted = data.attributes().HasEntry( "Inverted" ) && data.attributes().GetEntry( "Inverted" ) == "1";
+	return std::shared_ptr< Module< ParamsType> >( new DropoutModule<ParamsType>(data.attributes().GetEntry( "Name" ), dropout_probability, inverted ) );
 }
 
 template <class ParamsType>
 void DropoutModule<ParamsType>::sub_train_fprop(const std::shared_ptr< Tensor<ParamsType> >& input, std::shared_ptr< Tensor<ParamsType> >& output)
 {
-	Tensor<ParamsType>& input_tensor = *input;
-	UpdateCash(input_tensor.GetDimensions());
-	Tensor<ParamsType>& output_tensor = *output;
-	Tensor<ParamsType>& dropout_tensor = *dropout_tensor_;
-	dropout_tensor.SetZeros();
-	size_t numel = input_tensor.Numel();
-	for (size_t i = 0; i<numel; i++)
-	{
-		ParamsType dropout_coeff = static_cast<ParamsType>(RandomGenerator::GetUniformDouble(0,1)>dropout_probability_);
-		dropout_tensor[i] = dropout_coeff;
-		output_tensor[i] = input_tensor[i]*dropout_coeff;
-	}
+	UpdateCash(input->GetShape());
+	if (inverted_)
+		output = train_output_;
+	size_t numel = input->Numel();
+	// the mask of the whole minibatch is generated by one call, an element is kept with probability 1-dropout_probability_
+	random_stream_.FillBernoulliBits(mask_bits_.data(), numel, 1-dropout_probability_);
+	ApplyDropoutMask(input->GetStartPtr(), mask_bits_.data(), GetTrainScale(), output->GetStartPtr(), numel);
 }
 
 template <class ParamsType>
 void DropoutModule<ParamsType>::sub_predict_fprop(const std::shared_ptr< Tensor<ParamsType> >& input, std::shared_ptr< Tensor<ParamsType> >& output)
 {
+	if (inverted_)
+	{
+		output = input;
+		return;
+	}
 	Tensor<ParamsType>& input_tensor = *input;
 	Tensor<ParamsType>& output_tensor = *output;
 	size_t numel = input_tensor.Numel();
@@ -96,16 +180,11 @@ void DropoutModule<ParamsType>::sub_predict_fprop(const std::shared_ptr< Tensor<
 }
 
 template <class ParamsType>
-void DropoutModule<ParamsType>::sub_bprop(const std::shared_ptr< Tensor<ParamsType> >& input, const std::shared_ptr< Tensor<ParamsType> >& output, 
-	std::shared_ptr< Tensor<ParamsType> >& input_gradients, const std::shared_ptr< Tensor<ParamsType> >& output_gradients, 
+void DropoutModule<ParamsType>::sub_bprop(const std::shared_ptr< Tensor<ParamsType> >& input, const std::shared_ptr< Tensor<ParamsType> >& output,
+	std::shared_ptr< Tensor<ParamsType> >& input_gradients, const std::shared_ptr< Tensor<ParamsType> >& output_gradients,
 	const std::vector<ParamsType>& samples_importances)
 {
-	Tensor<ParamsType>& dropout_tensor = *dropout_tensor_;
-	Tensor<ParamsType>& input_gradients_tensor = *input_gradients;
-	Tensor<ParamsType>& output_gradients_tensor = *output_gradients;
-	size_t numel = output_gradients_tensor.Numel();
-	for (size_t i = 0; i<numel; i++)
-		input_gradients_tensor[i] = output_gradients_tensor[i]*dropout_tensor[i];
+	ApplyDropoutMask(output_gradients->GetStartPtr(), mask_bits_.data(), GetTrainScale(), input_gradients->GetStartPtr(), output_gradients->Numel());
 }
 
-#endif
\ No newline at end of file
+#endif
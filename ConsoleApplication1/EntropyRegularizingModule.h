@@ -57,6 +57,11 @@ public:
 		return true;
 	}
 
+	virtual bool CostUsesInput() const
+	{
+		return true;
+	}
+
 	virtual double GetCost(const std::vector<ParamsType>& samples_importances)
 	{
 		std::shared_ptr< Tensor<ParamsType> > softmax_output = batch_softmax_module.predict_fprop(GetInputBuffer());
@@ -11,13 +11,9 @@ class FullTensorDataLoader : public BaseTensorDataLoader<OutputType, InputType>
 
 	size_t GetSampleData( size_t sample_ind, Tensor<OutputType>& output_buffer, size_t output_buffer_offset ) const
 	{
-		Tensor<InputType>& sample = GetSample(sample_ind);
-
-		size_t numel = sample.Numel();
-		for (size_t i=0; i<numel; i++)
-			output_buffer[output_buffer_offset+i] = static_cast<OutputType>(sample[i]);
-		
-		return sample.Numel();
+		size_t numel = GetSampleNumel(sample_ind);
+		CopySampleElements(GetSamplePtr(sample_ind), output_buffer.GetStartPtr()+output_buffer_offset, numel);
+		return numel;
 	}
 	
 	virtual void sub_save(std::ostream& output_stream) const
@@ -42,8 +38,9 @@ public:
 		return BaseTensorDataLoader<OutputType, InputType>::Equals(data_loader);
 	}
 	
+	// samples of the same dimensions are packed to the sample arena
 	FullTensorDataLoader(const std::vector< input_type_tensor_ptr >& data, std::string name = "Default") : 
-		BaseTensorDataLoader<OutputType, InputType>(data, name)
+		BaseTensorDataLoader<OutputType, InputType>(data, name, true)
 	{
 
 	}
@@ -24,8 +24,8 @@ public:
 
 	virtual void InitializeParameters(Tensor<T>& params_tensor) 
 	{
-		for (size_t i = 0; i<params_tensor.Numel(); i++)
-			params_tensor[i] = static_cast<T>(RandomGenerator::GetNormalDouble(mean_, std_));
+		RandomStream random_stream = RandomGenerator::CreateStream();
+		random_stream.FillNormal(params_tensor.GetStartPtr(), params_tensor.Numel(), static_cast<T>(mean_), static_cast<T>(std_));
 	}
 
 
@@ -10,6 +10,8 @@ template <class ParamsType>
 class GaussianNoiseModule : public Module<ParamsType>
 {
 	ParamsType noise_std_;
+	// each module (and each replica of a network) has its own stream, see RandomGenerator::CreateStream
+	RandomStream random_stream_;
 	virtual void sub_train_fprop(const std::shared_ptr< Tensor<ParamsType> >& input, std::shared_ptr< Tensor<ParamsType> >& output);
 	virtual void sub_predict_fprop(const std::shared_ptr< Tensor<ParamsType> >& input, std::shared_ptr< Tensor<ParamsType> >& output);
 	
@@ -29,7 +31,8 @@ public:
 		return false;
 	}
 
-	GaussianNoiseModule(std::string name, ParamsType noise_std) : Module<ParamsType>(name), noise_std_(noise_std)
+	GaussianNoiseModule(std::string name, ParamsType noise_std) : Module<ParamsType>(name), noise_std_(noise_std),
+		random_stream_(RandomGenerator::CreateStream())
 	{
 
 	}
@@ -75,8 +78,10 @@ void GaussianNoiseModule<ParamsType>::sub_train_fprop(const std::shared_ptr< Ten
 			output_tensor[i] = static_cast<ParamsType>(input_tensor[i]);
 	else
 	{
+		// the noise of the whole minibatch is generated by one call
+		random_stream_.FillNormal(output_tensor.GetStartPtr(), numel, static_cast<ParamsType>(0), noise_std_);
 		for (size_t i = 0; i<numel; i++)
-			output_tensor[i] = static_cast<ParamsType>(input_tensor[i]+RandomGenerator::GetNormalDouble(0,noise_std_));
+			output_tensor[i] += input_tensor[i];
 	}
 }
 
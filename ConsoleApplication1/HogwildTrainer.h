@@ -0,0 +1,386 @@
+#ifndef HOGWILD_TRAINER_H
+#define HOGWILD_TRAINER_H
+
+#include <vector>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <exception>
+#include <limits>
+#include <numeric>
+#include <algorithm>
+#include "Trainer.h"
+#include "ThreadPool.h"
+#include "ModuleFactory.h"
+#include "MatrixOperations.h"
+
+// Asynchronous SGD with momentum (Hogwild). Each worker thread trains its own replica of the network, the parameters
+// of all the replicas are bound to one shared parameter vector. A worker takes the next minibatch, computes the gradients
+// and moves the shared parameters by its own momentum speed without locking, so the other workers see the update
+// at once. With max_staleness > 0 a worker sleeps while it has done more than max_staleness batches more than the
+// slowest worker, so it leaves its core to the slower ones. The train and validation results are processed by a separate
+// thread: the net gets a snapshot of the shared parameters for the callbacks and computes the validation cost while the workers go on.
+// The datasets and the cost modules are used by one thread at a time. The train time state of the modules
+// (e.g. the statistics of MeanStdNormalizingModule) is copied to the net from the replica of the first worker
+// at the end of the training, the validation uses the state the net had at the start
+template <class ParamsType>
+class HogwildTrainer : public Trainer<ParamsType>
+{
+	size_t num_iterations_;
+	ParamsType learning_rate_;
+	ParamsType momentum_;
+	size_t train_batch_size_;
+	size_t validation_batch_size_;
+	double train_decay_;
+	double validation_decay_;
+	size_t num_batches_before_train_evaluation_;
+	size_t num_batches_before_validation_evaluation_;
+	size_t num_threads_;
+	size_t max_staleness_;
+
+	static void CopyToBuffer(const Tensor<ParamsType>& from, std::shared_ptr< Tensor<ParamsType> >& to)
+	{
+		if (!to || !to->DimensionsEqual(from))
+			to = std::shared_ptr< Tensor<ParamsType> >( new Tensor<ParamsType>(from.GetShape()) );
+		CopyTensorElements(from, to->GetStartPtr());
+	}
+
+	// the data loaders return their internal buffers, so the samples are copied to the buffers of the thread under the mutex
+	class SynchronizedDataset : public ITrainDataset<ParamsType>
+	{
+		ITrainDataset<ParamsType>& dataset_;
+		std::mutex& mutex_;
+		std::shared_ptr< Tensor<ParamsType> > input_;
+		std::shared_ptr< Tensor<ParamsType> > output_;
+
+	public:
+
+		SynchronizedDataset(ITrainDataset<ParamsType>& dataset, std::mutex& mutex) : dataset_(dataset), mutex_(mutex)
+		{
+		}
+
+		virtual std::shared_ptr< Tensor<ParamsType> > GetInput(std::vector<size_t>& samples_inds)
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			CopyToBuffer(*dataset_.GetInput(samples_inds), input_);
+			return input_;
+		}
+
+		virtual std::shared_ptr< Tensor<ParamsType> > GetOutput(std::vector<size_t>& samples_inds)
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			CopyToBuffer(*dataset_.GetOutput(samples_inds), output_);
+			return output_;
+		}
+
+		virtual std::vector<ParamsType> GetImportance(std::vector<size_t>& samples_inds)
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			return dataset_.GetImportance(samples_inds);
+		}
+
+		virtual std::vector<size_t> SelectIndices(size_t num_samples)
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			return dataset_.SelectIndices(num_samples);
+		}
+
+		virtual size_t GetNumSamples()
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			return dataset_.GetNumSamples();
+		}
+	};
+
+	// the validation cost module may be the train cost module, so the validation takes the mutex of the workers
+	class SynchronizedCostModule : public CostModule<ParamsType>
+	{
+		CostModule<ParamsType>& cost_module_;
+		std::mutex& mutex_;
+
+		virtual void sub_bprop(const Tensor<ParamsType>& output, const Tensor<ParamsType>& expected_output,
+			const std::vector<ParamsType>& importance_weights, bool normalize_by_importance, Tensor<ParamsType>& output_gradients_buffer, double lambda)
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			std::shared_ptr< Tensor<ParamsType> > output_gradients = cost_module_.bprop(output, expected_output, importance_weights, normalize_by_importance, lambda);
+			copy<ParamsType>(output_gradients->GetStartPtr(), output_gradients_buffer.GetStartPtr(), output_gradients->Numel());
+		}
+
+		virtual double sub_GetCost(const Tensor<ParamsType>& net_output, const Tensor<ParamsType>& expected_output,
+			const std::vector<ParamsType>& importance_weights, bool normalize_by_importance, double lambda)
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			return cost_module_.GetCost(net_output, expected_output, importance_weights, normalize_by_importance, lambda);
+		}
+
+	public:
+
+		SynchronizedCostModule(CostModule<ParamsType>& cost_module, std::mutex& mutex) : cost_module_(cost_module), mutex_(mutex)
+		{
+		}
+	};
+
+	struct Worker
+	{
+		std::shared_ptr< CompositeModule<ParamsType> > module;
+		std::shared_ptr<SynchronizedDataset> dataset;
+		std::shared_ptr< Tensor<ParamsType> > output_gradients;
+		std::vector<ParamsType> gradients;
+		std::vector<ParamsType> speed;
+	};
+
+	// the next multiple of the period after num_batches
+	static size_t GetNextResultBatch(size_t num_batches, size_t period)
+	{
+		return (num_batches/period + 1)*period;
+	}
+
+public:
+
+	size_t GetNumIterations(){return num_iterations_;}
+	void SetNumIterations(size_t num_iterations){num_iterations_ = num_iterations;}
+
+	ParamsType GetLearningRate(){return learning_rate_;}
+	void SetLearningRate(ParamsType learning_rate){learning_rate_ = learning_rate;}
+
+	ParamsType GetMomentum(){return momentum_;}
+	void SetMomentum(ParamsType momentum){momentum_ = momentum;}
+
+	// 0 uses all the hardware threads
+	size_t GetNumThreads(){return num_threads_;}
+	void SetNumThreads(size_t num_threads){num_threads_ = num_threads;}
+
+	// 0 lets the workers run without synchronization
+	size_t GetMaxStaleness(){return max_staleness_;}
+	void SetMaxStaleness(size_t max_staleness){max_staleness_ = max_staleness;}
+
+	HogwildTrainer(size_t num_iterations=100000, ParamsType learning_rate=0.00001, ParamsType momentum=0, size_t train_batch_size=30,
+		size_t validation_batch_size=10000000, double train_decay=0.999, double validation_decay=0, size_t num_batches_before_train_evaluation = 100,
+		size_t num_batches_before_validation_evaluation = 100, size_t num_threads = 0, size_t max_staleness = 0);
+
+	// return validation cost
+	virtual double Train(NN<ParamsType>& net,
+		CostModule<ParamsType>& train_cost_module, CostModule<ParamsType>& validation_cost_module,
+		ITrainDataset<ParamsType>& train_set, ITrainDataset<ParamsType>& validation_set,
+		typename Trainer<ParamsType>::ProcessTrainResultFunc train_result_processor = DefaultProcessTrainFunc<ParamsType>,
+			typename Trainer<ParamsType>::ProcessValidationResultFunc validation_result_processor = DefaultProcessValidationFunc<ParamsType>);
+};
+
+template <class ParamsType>
+HogwildTrainer<ParamsType>::HogwildTrainer(size_t num_iterations, ParamsType learning_rate, ParamsType momentum, size_t train_batch_size,
+	size_t validation_batch_size, double train_decay, double validation_decay, size_t num_batches_before_train_evaluation,
+	size_t num_batches_before_validation_evaluation, size_t num_threads, size_t max_staleness) :
+		num_iterations_(num_iterations), learning_rate_(learning_rate), momentum_(momentum), train_batch_size_(train_batch_size),
+		validation_batch_size_(validation_batch_size), train_decay_(train_decay), validation_decay_(validation_decay),
+		num_batches_before_train_evaluation_(num_batches_before_train_evaluation),
+		num_batches_before_validation_evaluation_(num_batches_before_validation_evaluation), num_threads_(num_threads), max_staleness_(max_staleness)
+{
+
+}
+
+template <class ParamsType>
+double HogwildTrainer<ParamsType>::Train(NN<ParamsType>& net,
+		CostModule<ParamsType>& train_cost_module, CostModule<ParamsType>& validation_cost_module,
+		ITrainDataset<ParamsType>& train_set, ITrainDataset<ParamsType>& validation_set,
+		typename Trainer<ParamsType>::ProcessTrainResultFunc train_result_processor,
+		typename Trainer<ParamsType>::ProcessValidationResultFunc validation_result_processor)
+{
+	// the replicas copy the fusion with the train state
+	FusedCostScope<ParamsType> fused_cost_scope(net, train_cost_module);
+	net.CheckCostModuleFusion(train_cost_module);
+	size_t num_threads = num_threads_ > 0 ? num_threads_ : std::max<size_t>(1, std::thread::hardware_concurrency());
+
+	std::vector<size_t> train_indices = train_set.SelectIndices(5000);
+	std::vector<size_t> validation_indices = validation_set.SelectIndices(5000);
+	double train_cost = net.GetCost(train_set, train_cost_module, train_indices, true, false);
+	double best_validation_cost = net.GetCost(validation_set, validation_cost_module, validation_indices, false, false);
+	double validation_cost = best_validation_cost;
+	std::vector<ParamsType> shared_parameters = net.GetParameters();
+	std::vector<ParamsType> best_parameters = shared_parameters;
+	size_t num_params = shared_parameters.size();
+
+	// the datasets may be the same object, so they share the mutex
+	std::mutex dataset_mutex;
+	std::mutex cost_mutex;
+	std::shared_ptr<IOTreeNode> net_state = net.GetCompositeModule()->GetState();
+	std::vector<Worker> workers(num_threads);
+	for (size_t worker_ind = 0; worker_ind<num_threads; worker_ind++)
+	{
+		Worker& worker = workers[worker_ind];
+		worker.module = std::static_pointer_cast< CompositeModule<ParamsType> >(ModuleFactory::GetModule<ParamsType>( *net_state ));
+		worker.module->CopyTrainState(*net.GetCompositeModule());
+		worker.module->BindParameters(shared_parameters.data());
+		worker.gradients.resize(num_params);
+		worker.module->BindGradients(worker.gradients.data());
+		worker.dataset = std::shared_ptr<SynchronizedDataset>( new SynchronizedDataset(train_set, dataset_mutex) );
+		worker.speed.resize(num_params);
+	}
+
+	std::atomic<size_t> next_batch(1);
+	std::atomic<size_t> num_finished_batches(0);
+	std::atomic<bool> stopped(false);
+	// the number of the batches done by each worker, a worker that has no more batches does not hold the others.
+	// The workers that are ahead wait for progress_changed, which is notified when a worker finishes a batch or stops
+	std::vector<size_t> worker_progress(num_threads, 0);
+	std::mutex progress_mutex;
+	std::condition_variable progress_changed;
+	auto set_progress = [&](size_t worker_ind, size_t progress)
+	{
+		std::lock_guard<std::mutex> lock(progress_mutex);
+		worker_progress[worker_ind] = progress;
+		progress_changed.notify_all();
+	};
+	auto stop = [&]()
+	{
+		std::lock_guard<std::mutex> lock(progress_mutex);
+		stopped = true;
+		progress_changed.notify_all();
+	};
+
+	std::mutex results_mutex;
+	std::condition_variable results_ready;
+	bool workers_finished = false;
+	std::exception_ptr results_exception;
+
+	std::thread results_thread([&]()
+	{
+		try
+		{
+			SynchronizedDataset validation_dataset(validation_set, dataset_mutex);
+			SynchronizedCostModule synchronized_validation_cost_module(validation_cost_module, cost_mutex);
+			size_t next_train_result = num_batches_before_train_evaluation_;
+			size_t next_validation_result = num_batches_before_validation_evaluation_;
+			std::vector<ParamsType> snapshot(num_params);
+			while (!stopped)
+			{
+				size_t batch_num;
+				{
+					std::unique_lock<std::mutex> lock(results_mutex);
+					while (!workers_finished && !stopped && num_finished_batches < std::min(next_train_result, next_validation_result))
+						results_ready.wait(lock);
+					batch_num = num_finished_batches;
+					if (batch_num < std::min(next_train_result, next_validation_result))
+						return;
+				}
+
+				double current_train_cost;
+				{
+					std::lock_guard<std::mutex> lock(cost_mutex);
+					current_train_cost = train_cost;
+				}
+				// the workers keep writing to the shared parameters, the snapshot is taken without locking like their reads
+				std::copy(shared_parameters.begin(), shared_parameters.end(), snapshot.begin());
+				net.SetParameters(snapshot);
+				if (batch_num >= next_validation_result)
+				{
+					std::vector<size_t> batch_validation_indices = validation_dataset.SelectIndices(validation_batch_size_);
+					validation_cost = validation_decay_*validation_cost+(1-validation_decay_)*
+						net.GetCost(validation_dataset, synchronized_validation_cost_module, batch_validation_indices, false, false);
+
+					bool is_best = false;
+					if ( validation_cost<best_validation_cost )
+					{
+						is_best = true;
+						best_parameters = snapshot;
+						best_validation_cost = validation_cost;
+					}
+					validation_result_processor( ValidationCallbackParams<ParamsType>(net, is_best, current_train_cost, validation_cost, batch_num) );
+					next_validation_result = GetNextResultBatch(batch_num, num_batches_before_validation_evaluation_);
+				}
+				else
+					train_result_processor( TrainCallbackParams<ParamsType>(net, current_train_cost, batch_num) );
+				if (batch_num >= next_train_result)
+					next_train_result = GetNextResultBatch(batch_num, num_batches_before_train_evaluation_);
+			}
+		}
+		catch (...)
+		{
+			results_exception = std::current_exception();
+			stop();
+		}
+	});
+
+	std::exception_ptr workers_exception;
+	try
+	{
+		ThreadPool thread_pool(num_threads);
+		thread_pool.Run( [&](size_t worker_ind)
+		{
+			Worker& worker = workers[worker_ind];
+			try
+			{
+				for (size_t batch_ind = next_batch++; batch_ind<=num_iterations_ && !stopped; batch_ind = next_batch++)
+				{
+					// bounded staleness, the worker with the least progress never waits
+					if (max_staleness_ > 0)
+					{
+						std::unique_lock<std::mutex> lock(progress_mutex);
+						while (!stopped && worker_progress[worker_ind] > *std::min_element(worker_progress.begin(), worker_progress.end()) + max_staleness_)
+							progress_changed.wait(lock);
+					}
+
+					std::vector<size_t> batch_indices = worker.dataset->SelectIndices(train_batch_size_);
+					std::shared_ptr< Tensor<ParamsType> > input = worker.dataset->GetInput(batch_indices);
+					std::shared_ptr< Tensor<ParamsType> > expected_output = worker.dataset->GetOutput(batch_indices);
+					std::vector<ParamsType> importance = worker.dataset->GetImportance(batch_indices);
+					double weighted_num_samples = std::accumulate(importance.begin(), importance.end(), 0.0);
+
+					std::shared_ptr< Tensor<ParamsType> > output = worker.module->train_fprop(input);
+					{
+						std::lock_guard<std::mutex> lock(cost_mutex);
+						std::pair< double, std::shared_ptr< Tensor<ParamsType> > > cost_and_gradients =
+							train_cost_module.GetCostAndGradients(*output, *expected_output, importance, false);
+						CopyToBuffer(*cost_and_gradients.second, worker.output_gradients);
+						train_cost = train_decay_*train_cost+(1-train_decay_)*cost_and_gradients.first/weighted_num_samples;
+					}
+					worker.module->bprop(worker.output_gradients, importance);
+
+					scale(worker.speed.data(), num_params, momentum_);
+					axpy<ParamsType>(worker.gradients.data(), worker.speed.data(), num_params, static_cast<ParamsType>(1/weighted_num_samples));
+					axpy<ParamsType>(worker.speed.data(), shared_parameters.data(), num_params, -learning_rate_);
+
+					if (max_staleness_ > 0)
+						set_progress(worker_ind, worker_progress[worker_ind] + 1);
+					size_t num_finished = ++num_finished_batches;
+					if (num_finished%num_batches_before_train_evaluation_ == 0 || num_finished%num_batches_before_validation_evaluation_ == 0)
+					{
+						std::lock_guard<std::mutex> lock(results_mutex);
+						results_ready.notify_one();
+					}
+				}
+			}
+			catch (...)
+			{
+				stop();
+				set_progress(worker_ind, std::numeric_limits<size_t>::max());
+				throw;
+			}
+			set_progress(worker_ind, std::numeric_limits<size_t>::max());
+		});
+	}
+	catch (...)
+	{
+		workers_exception = std::current_exception();
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(results_mutex);
+		workers_finished = true;
+		results_ready.notify_one();
+	}
+	results_thread.join();
+	if (workers_exception)
+		std::rethrow_exception(workers_exception);
+	if (results_exception)
+		std::rethrow_exception(results_exception);
+
+	net.GetCompositeModule()->CopyTrainState(*workers[0].module);
+	net.SetParameters(best_parameters);
+
+	std::vector<size_t> all_indices;
+	return net.GetCost(validation_set, validation_cost_module, all_indices, false, false);
+}
+
+#endif
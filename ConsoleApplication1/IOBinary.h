@@ -0,0 +1,294 @@
+#ifndef IO_BINARY_H
+#define IO_BINARY_H
+
+#include <string>
+#include <memory>
+#include <vector>
+#include <iostream>
+#include <stdexcept>
+#include <cstdint>
+#include <assert.h>
+#include "IOTreeNode.h"
+#include "MappedFile.h"
+
+// Versioned binary container for IOTreeNode trees (e.g. NN::GetState), an alternative to IOXML
+// that keeps blobs (parameters) in the raw form, so loading does not parse numbers.
+// File layout:
+//   header   - signature, format version, alignment, metadata size, data offset
+//   metadata - tree structure: attributes, blob descriptions (element type, size, offset) and inner nodes
+//   data     - raw blobs, each one starts at a multiple of the alignment from the start of the file
+// Integers are written in little-endian byte order, blobs are copied from memory, so only little-endian machines are supported
+class IOBinary
+{
+public:
+	static const uint32_t format_version = 1;
+	static const uint32_t alignment = 64;
+	static const size_t header_size = 32;
+
+	// helpers for little-endian binary files (also used by the binary dataset format)
+	static void CheckByteOrder()
+	{
+		const uint32_t value = 1;
+		if (*reinterpret_cast<const char*>(&value) != 1)
+			throw std::runtime_error("IOBinary: only little-endian machines are supported");
+	}
+
+	static uint64_t Align(uint64_t size)
+	{
+		return (size + alignment - 1) / alignment * alignment;
+	}
+
+	static void WriteUInt(std::string& buffer, uint64_t value, size_t num_bytes)
+	{
+		for (size_t i=0; i<num_bytes; i++)
+			buffer.push_back( static_cast<char>( (value >> (8*i)) & 0xFF ) );
+	}
+
+	static uint64_t ReadUInt(const std::string& buffer, size_t& position, size_t num_bytes)
+	{
+		if (position + num_bytes > buffer.size())
+			throw std::runtime_error("IOBinary: corrupted metadata");
+		uint64_t value = 0;
+		for (size_t i=0; i<num_bytes; i++)
+			value |= static_cast<uint64_t>( static_cast<unsigned char>(buffer[position+i]) ) << (8*i);
+		position += num_bytes;
+		return value;
+	}
+
+private:
+	struct PendingBlob
+	{
+		uint64_t offset;
+		uint64_t num_bytes;
+		char* data;
+	};
+
+	static const char* GetSignature()
+	{
+		return "NNLIBBIN";
+	}
+
+	static void WriteString(std::string& buffer, const std::string& str)
+	{
+		WriteUInt(buffer, str.size(), 8);
+		buffer.append(str);
+	}
+
+	static std::string ReadString(const std::string& buffer, size_t& position)
+	{
+		size_t length = static_cast<size_t>( ReadUInt(buffer, position, 8) );
+		if (position + length > buffer.size())
+			throw std::runtime_error("IOBinary: corrupted metadata");
+		std::string str = buffer.substr(position, length);
+		position += length;
+		return str;
+	}
+
+	static std::string ReadBytes(std::istream& input_stream, size_t num_bytes)
+	{
+		std::string buffer(num_bytes, '\0');
+		if (num_bytes > 0)
+			input_stream.read(&buffer[0], num_bytes);
+		if (static_cast<size_t>(input_stream.gcount()) != num_bytes)
+			throw std::runtime_error("IOBinary: unexpected end of file");
+		return buffer;
+	}
+
+	static void SkipBytes(std::istream& input_stream, uint64_t num_bytes)
+	{
+		input_stream.ignore(static_cast<std::streamsize>(num_bytes));
+		if (static_cast<uint64_t>(input_stream.gcount()) != num_bytes)
+			throw std::runtime_error("IOBinary: unexpected end of file");
+	}
+
+	// data_size is the size of the data section needed for the blobs collected so far
+	static void WriteNode(IOTreeNode& node, std::string& metadata, std::vector< std::shared_ptr<IOBlob> >& blobs, uint64_t& data_size)
+	{
+		IOTreeNodeData<std::string>& node_attributes = node.attributes();
+		WriteUInt(metadata, node_attributes.end()-node_attributes.begin(), 8);
+		for (auto iter = node_attributes.begin(); iter != node_attributes.end(); iter++)
+		{
+			WriteString(metadata, *iter);
+			WriteString(metadata, node_attributes.GetEntry(*iter));
+		}
+
+		IOTreeNodeData< std::shared_ptr<IOBlob> >& node_blobs = node.blobs();
+		WriteUInt(metadata, node_blobs.end()-node_blobs.begin(), 8);
+		for (auto iter = node_blobs.begin(); iter != node_blobs.end(); iter++)
+		{
+			std::shared_ptr<IOBlob> blob = node_blobs.GetEntry(*iter);
+			WriteString(metadata, *iter);
+			WriteString(metadata, blob->GetElementType());
+			WriteUInt(metadata, blob->GetNumElements(), 8);
+			WriteUInt(metadata, data_size, 8);
+			blobs.push_back(blob);
+			data_size = Align(data_size + blob->GetNumBytes());
+		}
+
+		IOTreeNodeData< std::shared_ptr<IOTreeNode> >& node_nodes = node.nodes();
+		WriteUInt(metadata, node_nodes.end()-node_nodes.begin(), 8);
+		for (auto iter = node_nodes.begin(); iter != node_nodes.end(); iter++)
+		{
+			WriteString(metadata, *iter);
+			WriteNode(*node_nodes.GetEntry(*iter), metadata, blobs, data_size);
+		}
+	}
+
+	// blobs of a mapped file point to the file data, otherwise they are allocated and added to pending_blobs to be read later
+	static std::shared_ptr<IOTreeNode> ReadNode(const std::string& metadata, size_t& position, std::vector<PendingBlob>& pending_blobs,
+		const std::shared_ptr<MappedFile>& mapped_file, uint64_t data_offset)
+	{
+		std::shared_ptr<IOTreeNode> node( new IOTreeNode() );
+		uint64_t num_attributes = ReadUInt(metadata, position, 8);
+		for (uint64_t i=0; i<num_attributes; i++)
+		{
+			std::string name = ReadString(metadata, position);
+			node->attributes().AppendEntry(name, ReadString(metadata, position));
+		}
+
+		uint64_t num_blobs = ReadUInt(metadata, position, 8);
+		for (uint64_t i=0; i<num_blobs; i++)
+		{
+			std::string name = ReadString(metadata, position);
+			std::string element_type = ReadString(metadata, position);
+			size_t num_elements = static_cast<size_t>( ReadUInt(metadata, position, 8) );
+			PendingBlob pending_blob;
+			pending_blob.offset = ReadUInt(metadata, position, 8);
+			pending_blob.num_bytes = num_elements*IOBlob::GetElementSize(element_type);
+			if (mapped_file)
+			{
+				if (data_offset + pending_blob.offset + pending_blob.num_bytes > mapped_file->GetSize())
+					throw std::runtime_error("IOBinary: unexpected end of file");
+				char* data = mapped_file->GetData() + data_offset + pending_blob.offset;
+				node->blobs().AppendEntry(name, std::shared_ptr<IOBlob>( new IOBlob(element_type, num_elements, data, mapped_file, true) ));
+			}
+			else
+			{
+				node->blobs().AppendEntry(name, IOBlob::Allocate(element_type, num_elements, pending_blob.data));
+				pending_blobs.push_back(pending_blob);
+			}
+		}
+
+		uint64_t num_nodes = ReadUInt(metadata, position, 8);
+		for (uint64_t i=0; i<num_nodes; i++)
+		{
+			std::string name = ReadString(metadata, position);
+			node->nodes().AppendEntry(name, ReadNode(metadata, position, pending_blobs, mapped_file, data_offset));
+		}
+		return node;
+	}
+
+	static void ReadHeader(const std::string& header, uint64_t& metadata_size, uint64_t& data_offset)
+	{
+		std::string signature(GetSignature());
+		if (header.substr(0, signature.size()) != signature)
+			throw std::runtime_error("IOBinary: not a binary file");
+		size_t position = signature.size();
+		uint32_t version = static_cast<uint32_t>( ReadUInt(header, position, 4) );
+		if (version != format_version)
+			throw std::runtime_error("IOBinary: unsupported format version " + std::to_string(version));
+		ReadUInt(header, position, 4); // alignment
+		metadata_size = ReadUInt(header, position, 8);
+		data_offset = ReadUInt(header, position, 8);
+		if (data_offset < header_size + metadata_size)
+			throw std::runtime_error("IOBinary: corrupted header");
+	}
+
+public:
+	static void save(IOTreeNode& node, std::ostream& output_stream)
+	{
+		CheckByteOrder();
+		std::string metadata;
+		std::vector< std::shared_ptr<IOBlob> > blobs;
+		uint64_t data_size = 0;
+		WriteNode(node, metadata, blobs, data_size);
+		uint64_t data_offset = Align(header_size + metadata.size());
+
+		std::string header(GetSignature());
+		WriteUInt(header, format_version, 4);
+		WriteUInt(header, alignment, 4);
+		WriteUInt(header, metadata.size(), 8);
+		WriteUInt(header, data_offset, 8);
+		assert( header.size() == header_size );
+
+		output_stream.write(header.data(), header.size());
+		output_stream.write(metadata.data(), metadata.size());
+		std::string metadata_padding(static_cast<size_t>(data_offset-header_size-metadata.size()), '\0');
+		output_stream.write(metadata_padding.data(), metadata_padding.size());
+		uint64_t position = 0;
+		for (size_t i=0; i<blobs.size(); i++)
+		{
+			output_stream.write(blobs[i]->GetRawData(), blobs[i]->GetNumBytes());
+			position += blobs[i]->GetNumBytes();
+			std::string padding(static_cast<size_t>(Align(position)-position), '\0');
+			output_stream.write(padding.data(), padding.size());
+			position += padding.size();
+		}
+	}
+
+	// checks the signature without consuming the stream
+	static bool IsBinary(std::istream& input_stream)
+	{
+		std::string signature(GetSignature());
+		std::streampos start = input_stream.tellg();
+		std::string buffer(signature.size(), '\0');
+		input_stream.read(&buffer[0], buffer.size());
+		bool is_binary = (static_cast<size_t>(input_stream.gcount()) == buffer.size()) && (buffer == signature);
+		input_stream.clear();
+		input_stream.seekg(start);
+		return is_binary;
+	}
+
+	static std::shared_ptr<IOTreeNode> load(std::istream& input_stream)
+	{
+		CheckByteOrder();
+		std::string header = ReadBytes(input_stream, header_size);
+		uint64_t metadata_size;
+		uint64_t data_offset;
+		ReadHeader(header, metadata_size, data_offset);
+
+		std::string metadata = ReadBytes(input_stream, static_cast<size_t>(metadata_size));
+		std::vector<PendingBlob> pending_blobs;
+		size_t position = 0;
+		std::shared_ptr<IOTreeNode> node = ReadNode(metadata, position, pending_blobs, std::shared_ptr<MappedFile>(), data_offset);
+		SkipBytes(input_stream, data_offset - header_size - metadata_size);
+
+		// blobs are written in the order of the metadata
+		uint64_t data_position = 0;
+		for (size_t i=0; i<pending_blobs.size(); i++)
+		{
+			if (pending_blobs[i].offset < data_position)
+				throw std::runtime_error("IOBinary: corrupted metadata");
+			SkipBytes(input_stream, pending_blobs[i].offset - data_position);
+			input_stream.read(pending_blobs[i].data, static_cast<std::streamsize>(pending_blobs[i].num_bytes));
+			if (static_cast<uint64_t>(input_stream.gcount()) != pending_blobs[i].num_bytes)
+				throw std::runtime_error("IOBinary: unexpected end of file");
+			data_position = pending_blobs[i].offset + pending_blobs[i].num_bytes;
+		}
+		return node;
+	}
+
+	// maps the file to memory, blobs of the returned tree point to the mapped data, so only the metadata is read.
+	// Modules created from the tree use the mapped parameters without copying them (see Module::LoadParameters),
+	// so processes loading the same file share its memory until they change the parameters
+	static std::shared_ptr<IOTreeNode> load_mapped(const std::string& path)
+	{
+		CheckByteOrder();
+		std::shared_ptr<MappedFile> mapped_file( new MappedFile(path) );
+		if (mapped_file->GetSize() < header_size)
+			throw std::runtime_error("IOBinary: unexpected end of file");
+		std::string header(mapped_file->GetData(), header_size);
+		uint64_t metadata_size;
+		uint64_t data_offset;
+		ReadHeader(header, metadata_size, data_offset);
+		if (data_offset > mapped_file->GetSize())
+			throw std::runtime_error("IOBinary: unexpected end of file");
+
+		std::string metadata(mapped_file->GetData() + header_size, static_cast<size_t>(metadata_size));
+		std::vector<PendingBlob> pending_blobs;
+		size_t position = 0;
+		return ReadNode(metadata, position, pending_blobs, mapped_file, data_offset);
+	}
+};
+
+#endif
@@ -0,0 +1,141 @@
+#ifndef IO_BLOB_H
+#define IO_BLOB_H
+
+#include <memory>
+#include <string>
+#include <vector>
+#include <cstring>
+#include <stdexcept>
+
+template <class T>
+std::string GetIOElementTypeName()
+{
+	throw std::runtime_error("IOBlob: unsupported element type");
+}
+
+template <>
+inline std::string GetIOElementTypeName<float>()
+{
+	return "float";
+}
+
+template <>
+inline std::string GetIOElementTypeName<double>()
+{
+	return "double";
+}
+
+// array of numbers that is stored in IOTreeNode in the raw (machine) representation, without converting it to text
+class IOBlob
+{
+	std::string element_type_;
+	size_t num_elements_;
+	char* data_;
+	// keeps alive the memory pointed by data_
+	std::shared_ptr<void> storage_;
+	// whether the users of the blob should use the data in place instead of copying it (e.g. data of a mapped file)
+	bool in_place_;
+
+	template <class From, class To>
+	static void ConvertElements(const char* from, To* to, size_t num_elements)
+	{
+		const From* from_ptr = reinterpret_cast<const From*>(from);
+		for (size_t i=0; i<num_elements; i++)
+			to[i] = static_cast<To>(from_ptr[i]);
+	}
+
+public:
+	IOBlob(const std::string& element_type, size_t num_elements, char* data, std::shared_ptr<void> storage, bool in_place = false) :
+		element_type_(element_type), num_elements_(num_elements), data_(data), storage_(storage), in_place_(in_place)
+	{
+		GetElementSize(element_type_);
+	}
+
+	static size_t GetElementSize(const std::string& element_type)
+	{
+		if (element_type == "float")
+			return sizeof(float);
+		if (element_type == "double")
+			return sizeof(double);
+		throw std::runtime_error("IOBlob: unknown element type " + element_type);
+	}
+
+	// allocates a blob, data has to be written by the caller
+	static std::shared_ptr<IOBlob> Allocate(const std::string& element_type, size_t num_elements, char*& data)
+	{
+		std::shared_ptr< std::vector<char> > storage( new std::vector<char>(num_elements*GetElementSize(element_type)) );
+		data = storage->data();
+		return std::shared_ptr<IOBlob>( new IOBlob(element_type, num_elements, data, storage) );
+	}
+
+	template <class T>
+	static std::shared_ptr<IOBlob> Create(const T* data, size_t num_elements)
+	{
+		char* blob_data;
+		std::shared_ptr<IOBlob> blob = Allocate(GetIOElementTypeName<T>(), num_elements, blob_data);
+		if (num_elements > 0)
+			memcpy(blob_data, data, num_elements*sizeof(T));
+		return blob;
+	}
+
+	const std::string& GetElementType() const
+	{
+		return element_type_;
+	}
+
+	size_t GetNumElements() const
+	{
+		return num_elements_;
+	}
+
+	size_t GetNumBytes() const
+	{
+		return num_elements_*GetElementSize(element_type_);
+	}
+
+	const char* GetRawData() const
+	{
+		return data_;
+	}
+
+	// the blob should store elements of type T
+	template <class T>
+	const T* GetData() const
+	{
+		if (element_type_ != GetIOElementTypeName<T>())
+			throw std::runtime_error("IOBlob: blob stores " + element_type_ + " elements, not " + GetIOElementTypeName<T>());
+		return reinterpret_cast<const T*>(data_);
+	}
+
+	bool IsInPlace() const
+	{
+		return in_place_;
+	}
+
+	// whether the data can be used in place as an array of T
+	template <class T>
+	bool CanViewAs() const
+	{
+		return element_type_ == GetIOElementTypeName<T>() && reinterpret_cast<size_t>(data_) % sizeof(T) == 0;
+	}
+
+	// the data is owned by the blob, it stays valid while the blob exists
+	template <class T>
+	T* GetMutableData()
+	{
+		GetData<T>();
+		return reinterpret_cast<T*>(data_);
+	}
+
+	// copies the elements converting them to T if needed
+	template <class T>
+	void CopyTo(T* receiver) const
+	{
+		if (element_type_ == "float")
+			ConvertElements<float, T>(data_, receiver, num_elements_);
+		else
+			ConvertElements<double, T>(data_, receiver, num_elements_);
+	}
+};
+
+#endif
@@ -4,6 +4,7 @@
 #include <unordered_map>
 #include <memory>
 #include <string>
+#include "IOBlob.h"
 
 template <class T>
 class IOTreeNodeData
@@ -51,6 +52,7 @@ class IOTreeNode
 {
 	IOTreeNodeData<std::string> node_attributes_;
 	IOTreeNodeData< std::shared_ptr<IOTreeNode> > inner_nodes_;
+	IOTreeNodeData< std::shared_ptr<IOBlob> > node_blobs_;
 public:
 
 	IOTreeNodeData<std::string>& attributes()
@@ -61,6 +63,11 @@ public:
 	{
 		return inner_nodes_;
 	}
+	// large numeric arrays (e.g. parameters) that are not converted to text
+	IOTreeNodeData< std::shared_ptr<IOBlob> >& blobs()
+	{
+		return node_blobs_;
+	}
 
 };
 
@@ -12,6 +12,13 @@
 
 class IOXML
 {
+	static std::string BlobToString(const IOBlob& blob)
+	{
+		if (blob.GetElementType() == "float")
+			return Converter::ConvertArrayToString(blob.GetData<float>(), blob.GetNumElements());
+		return Converter::ConvertArrayToString(blob.GetData<double>(), blob.GetNumElements());
+	}
+
 	static void save_node(IOTreeNode& node, rapidxml::xml_node<>& xml_node, rapidxml::xml_document<>& doc)
 	{
 		IOTreeNodeData<std::string>& node_attributes = node.attributes();
@@ -23,6 +30,16 @@ class IOXML
 			xml_node.append_attribute(attr);
 		}
 		
+		// blobs are exported as text attributes, which are read back as attributes
+		IOTreeNodeData< std::shared_ptr<IOBlob> >& node_blobs = node.blobs();
+		for (auto iter = node_blobs.begin(); iter != node_blobs.end(); iter++)
+		{
+			char *attr_name = doc.allocate_string((*iter).c_str());
+			char *attr_value = doc.allocate_string(BlobToString(*node_blobs.GetEntry(*iter)).c_str());
+			rapidxml::xml_attribute<> *attr = doc.allocate_attribute( attr_name, attr_value );
+			xml_node.append_attribute(attr);
+		}
+
 		IOTreeNodeData< std::shared_ptr<IOTreeNode> >& node_nodes = node.nodes();
 		for (auto& iter = node.nodes().begin(); iter != node.nodes().end(); iter++)
 		{
@@ -0,0 +1,343 @@
+#ifndef INFERENCE_NN_H
+#define INFERENCE_NN_H
+
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <stdexcept>
+#include "NN.h"
+#include "CompositeModule.h"
+#include "LinearMixModule.h"
+#include "LinearModule.h"
+#include "BiasModule.h"
+#include "MeanStdNormalizingModule.h"
+#include "DropoutModule.h"
+#include "SoftmaxModule.h"
+#include "ActivationKernels.h"
+#include "SoftmaxKernels.h"
+#include "MatrixOperations.h"
+
+// Frozen copy of a trained network for predictions. The modules are flattened into a list of steps with copies of the parameters:
+// the elementwise affine modules (MeanStdNormalizingModule, LinearModule, BiasModule, dropout in predict mode) are folded
+// into the neighbouring LinearMixModule, and the activations are applied by the step that computes their input.
+// The buffers are allocated for max_batch_size samples once, Predict does not allocate memory and calls no virtual functions.
+// The steps do not depend on the network after the construction. Predict uses the buffers of the object,
+// so the threads that predict concurrently need their own copies
+template <class ParamsType>
+class InferenceNN
+{
+	enum StepType
+	{
+		// output = weights*input + shifts, the weights are column-major num_outputs x num_inputs like in LinearMixModule
+		affine_step,
+		// output = input*scales + shifts for each feature
+		elementwise_step,
+		softmax_step
+	};
+
+	// the activation is applied to the output of the step
+	struct Step
+	{
+		StepType type;
+		size_t num_inputs;
+		size_t num_outputs;
+		std::vector<ParamsType> weights;
+		std::vector<ParamsType> scales;
+		std::vector<ParamsType> shifts;
+		// elementwise step with the scales 1 and the shifts 0, it only applies the activation
+		bool identity;
+		ActivationType activation;
+		ExpPrecision exp_precision;
+	};
+
+	std::vector<Step> steps_;
+	size_t num_inputs_;
+	size_t num_outputs_;
+	size_t max_batch_size_;
+	// the outputs of the steps alternate between the buffers, the last step writes to the output of Predict
+	std::vector<ParamsType> buffers_[2];
+
+	// the elementwise step can be merged into the previous step if the previous step does not apply an activation
+	bool CanFoldIntoLastStep() const
+	{
+		return !steps_.empty() && steps_.back().type != softmax_step && steps_.back().activation == no_activation;
+	}
+
+	void AddLinearMix(const std::vector<ParamsType>& weights, size_t num_inputs, size_t num_outputs, ActivationType activation)
+	{
+		Step step;
+		step.type = affine_step;
+		step.num_inputs = num_inputs;
+		step.num_outputs = num_outputs;
+		step.weights = weights;
+		step.shifts.assign(num_outputs, 0);
+		step.identity = false;
+		step.activation = activation;
+		step.exp_precision = vectorized_exp;
+		// W*(x*scales + shifts) = (W*diag(scales))*x + W*shifts
+		if (!steps_.empty() && steps_.back().type == elementwise_step && steps_.back().activation == no_activation)
+		{
+			const Step& previous_step = steps_.back();
+			for (size_t input_ind = 0; input_ind < num_inputs; input_ind++)
+			{
+				ParamsType* column = step.weights.data() + input_ind*num_outputs;
+				for (size_t output_ind = 0; output_ind < num_outputs; output_ind++)
+				{
+					step.shifts[output_ind] += column[output_ind] * previous_step.shifts[input_ind];
+					column[output_ind] *= previous_step.scales[input_ind];
+				}
+			}
+			steps_.pop_back();
+		}
+		steps_.push_back(step);
+	}
+
+	void AddElementwise(const std::vector<ParamsType>& scales, const std::vector<ParamsType>& shifts, ActivationType activation)
+	{
+		if (CanFoldIntoLastStep())
+		{
+			// (x*s1 + h1)*s2 + h2 and (W*x + h1)*s2 + h2
+			Step& last_step = steps_.back();
+			size_t num_features = scales.size();
+			for (size_t i = 0; i < num_features; i++)
+				last_step.shifts[i] = last_step.shifts[i]*scales[i] + shifts[i];
+			if (last_step.type == elementwise_step)
+			{
+				for (size_t i = 0; i < num_features; i++)
+					last_step.scales[i] *= scales[i];
+				last_step.identity = last_step.identity && std::count(scales.begin(), scales.end(), ParamsType(1)) == num_features &&
+					std::count(shifts.begin(), shifts.end(), ParamsType(0)) == num_features;
+			}
+			else
+				for (size_t input_ind = 0; input_ind < last_step.num_inputs; input_ind++)
+					for (size_t output_ind = 0; output_ind < num_features; output_ind++)
+						last_step.weights[input_ind*num_features + output_ind] *= scales[output_ind];
+			last_step.activation = activation;
+			return;
+		}
+
+		Step step;
+		step.type = elementwise_step;
+		step.num_inputs = scales.size();
+		step.num_outputs = scales.size();
+		step.scales = scales;
+		step.shifts = shifts;
+		step.identity = std::count(scales.begin(), scales.end(), ParamsType(1)) == scales.size() &&
+			std::count(shifts.begin(), shifts.end(), ParamsType(0)) == shifts.size();
+		step.activation = activation;
+		step.exp_precision = vectorized_exp;
+		steps_.push_back(step);
+	}
+
+	void AddActivation(ActivationType activation, size_t num_features)
+	{
+		AddElementwise(std::vector<ParamsType>(num_features, 1), std::vector<ParamsType>(num_features, 0), activation);
+	}
+
+	void AddSoftmax(size_t num_features, ExpPrecision exp_precision)
+	{
+		Step step;
+		step.type = softmax_step;
+		step.num_inputs = num_features;
+		step.num_outputs = num_features;
+		step.identity = false;
+		step.activation = no_activation;
+		step.exp_precision = exp_precision;
+		steps_.push_back(step);
+	}
+
+	static void CheckNumFeatures(const Module<ParamsType>& module, size_t num_features, size_t expected_num_features)
+	{
+		if (num_features != expected_num_features)
+			throw std::runtime_error("InferenceNN: module " + module.GetName() + " expects " + std::to_string(expected_num_features) +
+				" input features, but gets " + std::to_string(num_features));
+	}
+
+	// adds the steps of the module, returns the per case output dims of the module
+	std::vector<size_t> AddModule(Module<ParamsType>& module, const std::vector<size_t>& per_case_input_dims)
+	{
+		std::string type = module.GetType();
+		size_t num_features = Tensor<ParamsType>::Numel(per_case_input_dims);
+		if (type == "CompositeModule")
+		{
+			CompositeModule<ParamsType>& composite_module = static_cast< CompositeModule<ParamsType>& >(module);
+			std::vector<size_t> dims = per_case_input_dims;
+			for (size_t i=0; i<composite_module.NumModules(); i++)
+				dims = AddModule(*composite_module.GetModule(i), dims);
+			return dims;
+		}
+		else if (type == "LinearMixModule")
+		{
+			LinearMixModule<ParamsType>& linear_mix_module = static_cast< LinearMixModule<ParamsType>& >(module);
+			CheckNumFeatures(module, num_features, linear_mix_module.GetNumInputs());
+			std::vector<ParamsType> weights;
+			linear_mix_module.GetParameters(weights);
+			AddLinearMix(weights, linear_mix_module.GetNumInputs(), linear_mix_module.GetNumOutputs(), linear_mix_module.GetFusedActivation());
+		}
+		else if (type == "BiasModule" || type == "LinearModule")
+		{
+			std::vector<ParamsType> parameters;
+			module.GetParameters(parameters);
+			CheckNumFeatures(module, num_features, parameters.size());
+			if (type == "BiasModule")
+				AddElementwise(std::vector<ParamsType>(num_features, 1), parameters, static_cast< BiasModule<ParamsType>& >(module).GetFusedActivation());
+			else
+				AddElementwise(parameters, std::vector<ParamsType>(num_features, 0), no_activation);
+		}
+		else if (type == "MeanStdNormalizingModule")
+		{
+			MeanStdNormalizingModule<ParamsType>& normalizing_module = static_cast< MeanStdNormalizingModule<ParamsType>& >(module);
+			const std::vector<ParamsType>& means = normalizing_module.GetMeans();
+			const std::vector<ParamsType>& stds = normalizing_module.GetStds();
+			CheckNumFeatures(module, num_features, means.size());
+			// (x-means)/stds = x*(1/stds) - means/stds
+			std::vector<ParamsType> scales(num_features), shifts(num_features);
+			for (size_t i=0; i<num_features; i++)
+			{
+				scales[i] = 1 / stds[i];
+				shifts[i] = -means[i] / stds[i];
+			}
+			AddElementwise(scales, shifts, no_activation);
+		}
+		else if (type == "DropoutModule")
+		{
+			DropoutModule<ParamsType>& dropout_module = static_cast< DropoutModule<ParamsType>& >(module);
+			if (!dropout_module.IsInverted())
+				AddElementwise(std::vector<ParamsType>(num_features, static_cast<ParamsType>(dropout_module.GetDropoutProbability())),
+					std::vector<ParamsType>(num_features, 0), no_activation);
+		}
+		else if (type == "SoftmaxModule")
+			AddSoftmax(num_features, static_cast< SoftmaxModule<ParamsType>& >(module).GetExpPrecision());
+		else if (module.GetActivationType() != no_activation)
+			AddActivation(module.GetActivationType(), num_features);
+		// the modules that pass the input through in predict mode
+		else if (type != "GaussianNoiseModule" && type != "EntropyRegularizingModule")
+			throw std::runtime_error("InferenceNN: module " + module.GetName() + " of type " + type + " is not supported");
+		return module.GetPerCaseOutputDims(per_case_input_dims);
+	}
+
+	void RunStep(const Step& step, const ParamsType* input, size_t num_samples, ParamsType* output) const
+	{
+		size_t num_outputs = step.num_outputs;
+		switch (step.type)
+		{
+		case affine_step:
+			// a single sample is the latency case, gemv avoids the overhead of gemm
+			if (num_samples == 1)
+				MatrixVectorMultiply<ParamsType>(CblasColMajor, CblasNoTrans, num_outputs, step.num_inputs, 1, step.weights.data(),
+					num_outputs, input, 0, output);
+			else
+				MatrixMultiply<ParamsType>(CblasColMajor, CblasNoTrans, CblasNoTrans, num_outputs, num_samples, step.num_inputs, 1,
+					step.weights.data(), num_outputs, input, step.num_inputs, 0, output, num_outputs);
+			for (size_t sample_ind = 0; sample_ind < num_samples; sample_ind++)
+			{
+				ParamsType* sample_output = output + sample_ind*num_outputs;
+				const ParamsType* shifts = step.shifts.data();
+				for (size_t i=0; i<num_outputs; i++)
+					sample_output[i] += shifts[i];
+				ActivationFprop(step.activation, sample_output, sample_output, num_outputs);
+			}
+			break;
+		case elementwise_step:
+			if (step.identity)
+			{
+				ActivationFprop(step.activation, input, output, num_samples*num_outputs);
+				break;
+			}
+			for (size_t sample_ind = 0; sample_ind < num_samples; sample_ind++)
+			{
+				const ParamsType* sample_input = input + sample_ind*num_outputs;
+				ParamsType* sample_output = output + sample_ind*num_outputs;
+				const ParamsType* scales = step.scales.data();
+				const ParamsType* shifts = step.shifts.data();
+				for (size_t i=0; i<num_outputs; i++)
+					sample_output[i] = sample_input[i]*scales[i] + shifts[i];
+				ActivationFprop(step.activation, sample_output, sample_output, num_outputs);
+			}
+			break;
+		case softmax_step:
+			for (size_t sample_ind = 0; sample_ind < num_samples; sample_ind++)
+				SoftmaxFprop(input + sample_ind*num_outputs, output + sample_ind*num_outputs, num_outputs, step.exp_precision);
+			break;
+		}
+	}
+
+	void Compile(Module<ParamsType>& module, const std::vector<size_t>& per_case_input_dims)
+	{
+		if (max_batch_size_ == 0)
+			throw std::runtime_error("InferenceNN: the maximal batch size is 0");
+		num_inputs_ = Tensor<ParamsType>::Numel(per_case_input_dims);
+		num_outputs_ = Tensor<ParamsType>::Numel( AddModule(module, per_case_input_dims) );
+		size_t buffer_numel = 0;
+		for (size_t i=0; i<steps_.size(); i++)
+			buffer_numel = std::max(buffer_numel, max_batch_size_*steps_[i].num_outputs);
+		buffers_[0].resize(buffer_numel);
+		buffers_[1].resize(buffer_numel);
+	}
+
+public:
+
+	InferenceNN(NN<ParamsType>& nn, const std::vector<size_t>& per_case_input_dims, size_t max_batch_size = 1) : max_batch_size_(max_batch_size)
+	{
+		Compile(*nn.GetCompositeModule(), per_case_input_dims);
+	}
+
+	InferenceNN(Module<ParamsType>& module, const std::vector<size_t>& per_case_input_dims, size_t max_batch_size = 1) : max_batch_size_(max_batch_size)
+	{
+		Compile(module, per_case_input_dims);
+	}
+
+	size_t GetNumInputs() const
+	{
+		return num_inputs_;
+	}
+
+	size_t GetNumOutputs() const
+	{
+		return num_outputs_;
+	}
+
+	size_t GetMaxBatchSize() const
+	{
+		return max_batch_size_;
+	}
+
+	// number of the steps left after folding the modules
+	size_t GetNumSteps() const
+	{
+		return steps_.size();
+	}
+
+	// the inputs and the outputs of the samples follow each other (the last dimension is the sample index, like in the modules).
+	// Larger numbers of the samples are processed in batches of GetMaxBatchSize()
+	void Predict(const ParamsType* input, size_t num_samples, ParamsType* output)
+	{
+		if (steps_.empty())
+		{
+			std::copy(input, input + num_samples*num_inputs_, output);
+			return;
+		}
+		for (size_t first_sample = 0; first_sample < num_samples; first_sample += max_batch_size_)
+		{
+			size_t batch_size = std::min(max_batch_size_, num_samples - first_sample);
+			const ParamsType* step_input = input + first_sample*num_inputs_;
+			for (size_t step_ind = 0; step_ind < steps_.size(); step_ind++)
+			{
+				ParamsType* step_output = step_ind+1 == steps_.size() ? output + first_sample*num_outputs_ : buffers_[step_ind % 2].data();
+				RunStep(steps_[step_ind], step_input, batch_size, step_output);
+				step_input = step_output;
+			}
+		}
+	}
+
+	// the output has the per case output dims of the network and the samples dimension of the input
+	void Predict(const Tensor<ParamsType>& input, Tensor<ParamsType>& output)
+	{
+		size_t num_samples = input.GetDimensionSize(input.NumDimensions()-1);
+		if (input.Numel() != num_samples*num_inputs_ || output.Numel() != num_samples*num_outputs_)
+			throw std::runtime_error("InferenceNN: the sizes of the input and the output do not match the network");
+		Predict(input.GetStartPtr(), num_samples, output.GetStartPtr());
+	}
+};
+
+#endif
@@ -8,36 +8,70 @@
 template <class DataType>
 class Kernel
 {
-	// for reusing buffers without allocating memory
-	std::vector<size_t> cashed_valid_tensor_positions_;
-	std::vector<size_t> cashed_dimensions_;
-	void UpdateCash(const Tensor<DataType>& input);
+	// positions and offsets of the kernel in the input, for reusing buffers without allocating memory
 	// when a kernel is applied at a point,  we need to iterate over its 
 	// dimensions and look at the corresponding positions of the tensor being processed.
 	// We could use many for loops for this, but since number of tensor's dimensions is not known in advance, it is too difficult.
 	// We use the fact that each tensor occupies contiguous parts of memory. As a result for each kernel point we can get the corresponding 
 	// tensor point at a given position by always substracting the same 1d offset. This approach is not applicable near the borders of tensors, where 
-	// linear offset may "overflow" the dimension of the tensor and point to the wrong data
-	std::vector<int> cashed_kernel_offsets_;
+	// linear offset may "overflow" the dimension of the tensor and point to the wrong data.
+	// The offsets are computed from the strides of the input, so the kernels are applied to strided views (slices, crops) without copying them.
+	// The outputs are written in the dense order
+	struct OffsetsCash
+	{
+		TensorShape dimensions;
+		std::vector<size_t> valid_tensor_positions;
+		std::vector<int> kernel_offsets;
+	};
+	// the offsets of the dense layout (e.g. the gradients in bprop) and of a strided one (the input views in fprop and GetGradient)
+	// are kept separately, so a step with a strided input does not recompute them
+	OffsetsCash dense_cash_;
+	OffsetsCash strided_cash_;
 	
 	std::vector<size_t> strides_;
 	// kernel parameters
 	Tensor<DataType> kernel_;
 
-	std::vector<int> ComputeKernelOffsetsInds(const std::vector<size_t>& input_dims);
+	std::vector<int> ComputeKernelOffsetsInds(const TensorShape& input_shape);
+
+	OffsetsCash& UpdateCash(const TensorShape& input_shape);
 
-	void UpdateCash(std::vector<size_t>& input_dims);
+public:
+	// offsets (in the input tensor) of the positions where the kernel is applied, in the order of the output elements
+	std::vector<size_t>& GetValidTensorPositions(const TensorShape& input_dims)
+	{
+		return UpdateCash(input_dims).valid_tensor_positions;
+	}
 
-protected:
-	std::vector<size_t>& GetValidTensorPositions(std::vector<size_t>& input_dims);
+	std::vector<size_t>& GetValidTensorPositions(const std::vector<size_t>& input_dims)
+	{
+		return GetValidTensorPositions(TensorShape(input_dims));
+	}
 	
-	std::vector<int>& GetKernelOffsets(std::vector<size_t>& input_dims)
+	// offsets of the kernel elements relative to the position where the kernel is applied
+	std::vector<int>& GetKernelOffsets(const TensorShape& input_dims)
 	{
-		UpdateCash(input_dims);
-		return cashed_kernel_offsets_;
+		return UpdateCash(input_dims).kernel_offsets;
+	}
+
+	std::vector<int>& GetKernelOffsets(const std::vector<size_t>& input_dims)
+	{
+		return GetKernelOffsets(TensorShape(input_dims));
+	}
+
+	// whether the response is a dot product of the kernel parameters with the input patch. 
+	// Such kernels can be applied to a whole minibatch by a single matrix multiplication
+	virtual bool SupportsMatrixLowering() const
+	{
+		return false;
+	}
+
+	// whether the input of bprop may have other strides than the input gradients (which are dense)
+	virtual bool SupportsStridedInput() const
+	{
+		return true;
 	}
 
-public:
 	void SetNewParameters(DataType* params_ptr);
 
 	Kernel(const Tensor<DataType>& kernel, const std::vector<size_t>& strides);
@@ -90,13 +124,6 @@ bool Kernel<DataType>::Equals(const Kernel<DataType>& kernel) const
 	return true;
 }
 
-template <class DataType>
-std::vector<size_t>& Kernel<DataType>::GetValidTensorPositions(std::vector<size_t>& input_dims)
-{
-	UpdateCash(input_dims);
-	return cashed_valid_tensor_positions_;
-}
-
 template <class DataType>
 void Kernel<DataType>::SetNewParameters(DataType* params_ptr)
 {
@@ -109,13 +136,13 @@ Kernel<DataType>::Kernel(const Tensor<DataType>& kernel_params, const std::vecto
 }
 
 template <class DataType>
-std::vector<int> Kernel<DataType>::ComputeKernelOffsetsInds(const std::vector<size_t>& input_dimensions)
+std::vector<int> Kernel<DataType>::ComputeKernelOffsetsInds(const TensorShape& input_shape)
 {
-	auto input_dims = input_dimensions;
 	std::vector<size_t> kernel_dimensions = kernel_.GetDimensions();
-	while (input_dims.size()<kernel_dimensions.size())
-		input_dims.push_back(1);
-	std::vector<size_t> img_strides = Tensor<DataType>::GetStrides(input_dims);
+	// the kernel does not move along the missing dimensions of the input
+	std::vector<size_t> img_strides = input_shape.GetStrides();
+	while (img_strides.size()<kernel_dimensions.size())
+		img_strides.push_back(0);
 
 	size_t kernel_numel = kernel_.Numel();
 	std::vector<int> res(kernel_numel);
@@ -132,20 +159,27 @@ std::vector<int> Kernel<DataType>::ComputeKernelOffsetsInds(const std::vector<si
 }
 
 template <class DataType>
-void Kernel<DataType>::UpdateCash(std::vector<size_t>& input_dims)
+typename Kernel<DataType>::OffsetsCash& Kernel<DataType>::UpdateCash(const TensorShape& input_shape)
 {
-	if (cashed_dimensions_ != input_dims)
+	OffsetsCash& cash = input_shape.IsContiguous() ? dense_cash_ : strided_cash_;
+	if (!cash.dimensions.SameLayout(input_shape))
 	{
 		std::vector<size_t> left_margins(kernel_.NumDimensions());
 		std::vector<size_t> right_margins=kernel_.GetDimensions();
 		for (size_t i=0; i<right_margins.size(); i++)
 			right_margins[i]--;
 		
-		cashed_dimensions_ = input_dims;
-		cashed_valid_tensor_positions_ = Tensor<DataType>::GetValidOffsetsInds( input_dims, 
-			Tensor<DataType>::GetStrides(input_dims), left_margins, right_margins, strides_);
-		cashed_kernel_offsets_ = ComputeKernelOffsetsInds(input_dims);
+		// the kernel is applied at each position of the dimensions it does not cover (e.g. to each case of a minibatch)
+		std::vector<size_t> strides = strides_;
+		while (strides.size()<input_shape.size())
+			strides.push_back(1);
+
+		cash.dimensions = input_shape;
+		cash.valid_tensor_positions = Tensor<DataType>::GetValidOffsetsInds( input_shape.GetDimensions(), 
+			input_shape.GetStrides(), left_margins, right_margins, strides);
+		cash.kernel_offsets = ComputeKernelOffsetsInds(input_shape);
 	}
+	return cash;
 }
 
 #endif
\ No newline at end of file
@@ -6,6 +6,8 @@
 #include "Kernel.h"
 #include "ConvolutionalKernel.h"
 #include "MaxPoolingKernel.h"
+#include "AveragePoolingKernel.h"
+#include "L2PoolingKernel.h"
 
 template <class T>
 class KernelFactory
@@ -69,4 +71,46 @@ public:
 	}
 };
 
+template <class T>
+class AveragePoolingKernelFactory: public KernelFactory<T>
+{
+public:
+
+	virtual std::shared_ptr< KernelFactory<T> > Clone() const
+	{
+		return std::shared_ptr< KernelFactory<T> >( new AveragePoolingKernelFactory() );
+	}
+
+	virtual std::string GetKernelType()
+	{
+		return "AveragePoolingKernel";
+	}
+
+	virtual std::shared_ptr< Kernel<T> > GetKernel(const std::vector<size_t>& dims, const std::vector<size_t>& strides, T* params_ptr) const
+	{
+		return std::shared_ptr< Kernel<T> >(new AveragePoolingKernel<T>(Tensor<T>(0, dims), strides));
+	}
+};
+
+template <class T>
+class L2PoolingKernelFactory: public KernelFactory<T>
+{
+public:
+
+	virtual std::shared_ptr< KernelFactory<T> > Clone() const
+	{
+		return std::shared_ptr< KernelFactory<T> >( new L2PoolingKernelFactory() );
+	}
+
+	virtual std::string GetKernelType()
+	{
+		return "L2PoolingKernel";
+	}
+
+	virtual std::shared_ptr< Kernel<T> > GetKernel(const std::vector<size_t>& dims, const std::vector<size_t>& strides, T* params_ptr) const
+	{
+		return std::shared_ptr< Kernel<T> >(new L2PoolingKernel<T>(Tensor<T>(0, dims), strides));
+	}
+};
+
 #endif
\ No newline at end of file
@@ -22,6 +22,10 @@ std::shared_ptr< KernelFactory<T> > GetKernelFactory(std::string kernel_type)
 		return std::shared_ptr< KernelFactory<T> >( new ConvolutionalKernelFactory<T>());
 	else if (kernel_type == "MaxPoolingKernel")
 		return std::shared_ptr< KernelFactory<T> >( new MaxPoolingKernelFactory<T>());
+	else if (kernel_type == "AveragePoolingKernel")
+		return std::shared_ptr< KernelFactory<T> >( new AveragePoolingKernelFactory<T>());
+	else if (kernel_type == "L2PoolingKernel")
+		return std::shared_ptr< KernelFactory<T> >( new L2PoolingKernelFactory<T>());
 	else
 		throw UnknownKernelType(kernel_type);
 }
@@ -10,12 +10,14 @@
 #include "TensorIO.h"
 #include "Converter.h"
 #include "KernelFactoryIO.h"
+#include "MatrixOperations.h"
 
 template <class ParamsType>
 class KernelModule : public Module<ParamsType>
 {
 private:
 	Tensor<ParamsType> parameters_;
+	Tensor<ParamsType> gradients_;
 	std::vector< std::shared_ptr< Kernel<ParamsType> > > kernels;
 	std::vector<Tensor<ParamsType> > kernels_gradients;
 	std::vector<size_t> kernels_dims;
@@ -23,6 +25,42 @@ private:
 	std::shared_ptr<ParametersInitializer<ParamsType> > params_initializer;
 	std::shared_ptr<Regularizer<ParamsType> > regularizer;
 	std::shared_ptr<KernelFactory<ParamsType> > kernel_factory_;
+
+	// Kernels that support matrix lowering are applied to the whole minibatch at once: every input patch is copied 
+	// into a column of patch_matrix_ (num_params_per_kernel x num_positions*minibatch_size) and all kernels
+	// are computed with a single GEMM. Other kernels are applied case by case, a single kernel is applied to the whole minibatch.
+	typename PoolVector<ParamsType>::type patch_matrix_;
+	// GEMM result / output gradients in (position, kernel) layout
+	typename PoolVector<ParamsType>::type patch_output_buffer_;
+	// input the patch matrix was built from, so that bprop can reuse it
+	const ParamsType* lowered_input_ptr_;
+
+	bool AppliesKernelToMinibatch(const Tensor<ParamsType>& input) const
+	{
+		return kernels.size() == 1 && kernels[0]->GetKernelTensor().NumDimensions() < input.NumDimensions();
+	}
+
+	bool UseMatrixLowering() const
+	{
+		return kernels[0]->SupportsMatrixLowering();
+	}
+
+	// used by Create, the parameters get memory only if they are not mapped (see Module::LoadParameters)
+	KernelModule(std::string name, size_t num_kernels, const std::vector<size_t>& kernels_dims, const std::vector<size_t>& kernels_strides, 
+		const KernelFactory<ParamsType>& kernel_factory, IOTreeNode& parameters_node, 
+		const std::shared_ptr<ParametersInitializer<ParamsType> >& params_initializer, const std::shared_ptr<Regularizer<ParamsType> >& regularizer);
+
+	void CreateKernels(size_t num_kernels, const KernelFactory<ParamsType>& kernel_factory, bool allocate_parameters);
+	void AllocateGradients();
+
+	void FillPatchMatrix(const Tensor<ParamsType>& input, const TensorShape& per_case_input_dims);
+	void AccumulatePatchGradients(Tensor<ParamsType>& input_gradients, const TensorShape& per_case_input_dims);
+	
+	void LoweredFprop(const Tensor<ParamsType>& input, Tensor<ParamsType>& output);
+	void LoweredBprop(const Tensor<ParamsType>& input, Tensor<ParamsType>& input_gradients, const Tensor<ParamsType>& output_gradients);
+	void PerCaseFprop(const std::shared_ptr< Tensor<ParamsType> >& input, std::shared_ptr< Tensor<ParamsType> >& output);
+	void PerCaseBprop(const std::shared_ptr< Tensor<ParamsType> >& input, const std::shared_ptr< Tensor<ParamsType> >& output, 
+		std::shared_ptr< Tensor<ParamsType> >& input_gradients, const std::shared_ptr< Tensor<ParamsType> >& output_gradients);
 public:
 
 	size_t GetNumKernels() const
@@ -50,6 +88,10 @@ public:
 
 	virtual void SetParameters(const ParamsType* parameters);
 
+	virtual void BindParameters(ParamsType* params);
+
+	virtual void BindGradients(ParamsType* gradients);
+
 	virtual void SetParameters(const std::vector<ParamsType>& params);
 
 	virtual void SetParameters(Tensor<ParamsType>& parameters);
@@ -61,6 +103,12 @@ public:
 		return kernels[0]->GetNumberOfParameters()*kernels.size();
 	}
 
+	// the kernels are applied to the views of the cases, so a crop or a slice of a minibatch is not copied
+	virtual bool AcceptsStridedInput() const
+	{
+		return kernels[0]->SupportsStridedInput();
+	}
+
 	static std::shared_ptr< Module< ParamsType> > Create(IOTreeNode& data);
 	
 	virtual std::string GetType() const
@@ -87,7 +135,7 @@ bool KernelModule<ParamsType>::Equals(const Module<ParamsType>& module) const
 		return false;
 
 	const KernelModule<ParamsType>* other_module = static_cast< const KernelModule<ParamsType>* >( &module );
-	if (other_module->parameters_ != parameters_)
+	if (!EqualValues(other_module->parameters_, parameters_))
 		return false;
 	if (other_module->kernels.size() != kernels.size())
 		return false;
@@ -126,16 +174,17 @@ std::shared_ptr< Module< ParamsType> > KernelModule<ParamsType>::Create(IOTreeNo
 	std::shared_ptr< Regularizer<ParamsType> > regularizer = RegularizerFactory::GetRegularizer<ParamsType>(*data.nodes().GetEntry("regularizer"));
 	std::shared_ptr< ParametersInitializer<ParamsType> > initializer = InitializerFactory::GetInitializer<ParamsType>(*data.nodes().GetEntry("initializer"));
 	std::shared_ptr<KernelFactory<ParamsType> > kernel_factory = GetKernelFactory<ParamsType>( data.attributes().GetEntry("kernel_type") );
-	std::shared_ptr< Tensor<ParamsType> > parameters_tensor = CreateTensor<ParamsType>(*data.nodes().GetEntry("Parameters"));
 	std::vector<size_t> kernels_dims = Converter::StringToVector<size_t>( data.attributes().GetEntry("kernels_dims") );
 	std::vector<size_t> kernels_strides = Converter::StringToVector<size_t>( data.attributes().GetEntry("kernels_strides") );
 
+	IOTreeNode& parameters_node = *data.nodes().GetEntry("Parameters");
+
 	std::shared_ptr< KernelModule<ParamsType> > module = 
 		std::shared_ptr< KernelModule< ParamsType> >( new KernelModule<ParamsType>(data.attributes().GetEntry( "Name" ), 
-		num_kernels, kernels_dims, kernels_strides, *kernel_factory, 
+		num_kernels, kernels_dims, kernels_strides, *kernel_factory, parameters_node,
 		initializer, regularizer));
 
-	module->SetParameters(*parameters_tensor);
+	module->LoadParameters(parameters_node);
 
 	return module;
 }
@@ -150,12 +199,13 @@ void KernelModule<ParamsType>::GetParameters(std::vector<ParamsType>& receiver)
 template <class ParamsType>
 void KernelModule<ParamsType>::GetGradients(std::vector<ParamsType>& receiver) const
 {
-	for (size_t kernel_ind=0; kernel_ind<kernels_gradients.size(); kernel_ind++)
+	// the gradients have no memory before the first bprop
+	if (!gradients_.GetStartPtr())
 	{
-		const Tensor<ParamsType>& kernel_gradients = kernels_gradients[kernel_ind];
-		for (size_t i=0; i < kernel_gradients.Numel(); i++)
-			receiver.push_back( kernel_gradients[i] );
+		receiver.resize(receiver.size() + gradients_.Numel(), 0);
+		return;
 	}
+	receiver.insert(receiver.end(), gradients_.GetStartPtr(), gradients_.GetStartPtr() + gradients_.Numel());
 }
 
 template <class ParamsType>
@@ -166,6 +216,24 @@ void KernelModule<ParamsType>::SetParameters(const ParamsType* parameters)
 		parameters_[i] = parameters[i];
 }
 
+template <class ParamsType>
+void KernelModule<ParamsType>::BindParameters(ParamsType* params)
+{
+	parameters_.SetDataPtr(params);
+	size_t num_params_per_kernel = GetNumParams() / GetNumKernels();
+	for (size_t kernel_ind = 0; kernel_ind<GetNumKernels(); kernel_ind++)
+		kernels[kernel_ind]->SetNewParameters(params + num_params_per_kernel*kernel_ind);
+}
+
+template <class ParamsType>
+void KernelModule<ParamsType>::BindGradients(ParamsType* gradients)
+{
+	gradients_.SetDataPtr(gradients);
+	size_t num_params_per_kernel = GetNumParams() / GetNumKernels();
+	for (size_t kernel_ind = 0; kernel_ind<GetNumKernels(); kernel_ind++)
+		kernels_gradients[kernel_ind].SetDataPtr(gradients + num_params_per_kernel*kernel_ind);
+}
+
 template <class ParamsType>
 void KernelModule<ParamsType>::SetParameters(const std::vector<ParamsType>& params)
 {
@@ -201,24 +269,56 @@ template <class ParamsType>
 KernelModule<ParamsType>::KernelModule(std::string name, size_t num_kernels, const std::vector<size_t>& kernels_dims, const std::vector<size_t>& kernels_strides, 
 		const KernelFactory<ParamsType>& kernel_factory, const std::shared_ptr<ParametersInitializer<ParamsType> >& params_initializer,
 		const std::shared_ptr<Regularizer<ParamsType> >& regularizer ) 
-		: Module(name), kernels_dims(kernels_dims), kernels_strides(kernels_strides),  	params_initializer(params_initializer), regularizer(regularizer)
+		: Module(name), kernels_dims(kernels_dims), kernels_strides(kernels_strides),  	params_initializer(params_initializer), regularizer(regularizer),
+		lowered_input_ptr_(0)
+{
+	CreateKernels(num_kernels, kernel_factory, true);
+}
+
+template <class ParamsType>
+KernelModule<ParamsType>::KernelModule(std::string name, size_t num_kernels, const std::vector<size_t>& kernels_dims, const std::vector<size_t>& kernels_strides, 
+		const KernelFactory<ParamsType>& kernel_factory, IOTreeNode& parameters_node, 
+		const std::shared_ptr<ParametersInitializer<ParamsType> >& params_initializer, const std::shared_ptr<Regularizer<ParamsType> >& regularizer ) 
+		: Module(name), kernels_dims(kernels_dims), kernels_strides(kernels_strides), params_initializer(params_initializer), regularizer(regularizer),
+		lowered_input_ptr_(0)
+{
+	CreateKernels(num_kernels, kernel_factory, !HasMappedParameters(parameters_node));
+}
+
+// the kernels of the parameters without memory are bound to the parameters later (see BindParameters), 
+// the gradients get memory from BindGradients or from the first bprop (see AllocateGradients)
+template <class ParamsType>
+void KernelModule<ParamsType>::CreateKernels(size_t num_kernels, const KernelFactory<ParamsType>& kernel_factory, bool allocate_parameters)
 {
 	kernel_factory_ = kernel_factory.Clone();
 	std::shared_ptr< Kernel<ParamsType> > kernel = kernel_factory.GetKernel(kernels_dims, kernels_strides, 0);
 	size_t num_params_per_kernel = kernel->GetNumberOfParameters();
 	size_t num_params = num_params_per_kernel*num_kernels;
 	std::vector<size_t> params_dims(1, num_params);
-	parameters_ = Tensor<ParamsType>(params_dims);
+	parameters_ = Tensor<ParamsType>(0, params_dims);
+	gradients_ = Tensor<ParamsType>(0, params_dims);
+	if (allocate_parameters)
+		parameters_.Allocate();
 	ParamsType* parameters_start = parameters_.GetStartPtr();
 	
+	// kernels gradients are stored contiguously so that all of them can be computed by one matrix multiplication
 	std::vector<size_t> kernel_params_dims(1, num_params_per_kernel);
 	for (size_t kernel_ind = 0; kernel_ind<num_kernels; kernel_ind++)
 	{
-		kernels.push_back( kernel_factory.GetKernel(kernels_dims, kernels_strides, parameters_start+num_params_per_kernel*kernel_ind) );
-		kernels_gradients.push_back( Tensor<ParamsType>( kernel_params_dims ) );
+		kernels.push_back( kernel_factory.GetKernel(kernels_dims, kernels_strides, parameters_start ? parameters_start+num_params_per_kernel*kernel_ind : 0) );
+		kernels_gradients.push_back( Tensor<ParamsType>( 0, kernel_params_dims ) );
 	}
 }
 
+template <class ParamsType>
+void KernelModule<ParamsType>::AllocateGradients()
+{
+	gradients_.Allocate();
+	size_t num_params_per_kernel = GetNumParams() / GetNumKernels();
+	for (size_t kernel_ind = 0; kernel_ind<GetNumKernels(); kernel_ind++)
+		kernels_gradients[kernel_ind].SetDataPtr(gradients_.GetStartPtr() + num_params_per_kernel*kernel_ind);
+}
+
 template <class ParamsType>
 void KernelModule<ParamsType>::InitializeParameters()
 {
@@ -244,28 +344,10 @@ std::vector<size_t> KernelModule<ParamsType>::GetPerCaseOutputDims(const std::ve
 template <class ParamsType>
 void KernelModule<ParamsType>::sub_train_fprop(const std::shared_ptr< Tensor<ParamsType> >& input, std::shared_ptr< Tensor<ParamsType> >& output)
 {
-	std::vector<size_t> per_case_input_dims = input->GetDimensions();
-	per_case_input_dims.pop_back(); // remove minibatch dimension
-	std::vector<size_t> per_case_kernel_output_dims = kernels[0]->GetOutputTensorDimensions(per_case_input_dims);
-	size_t num_kernel_dims_per_kernel = per_case_kernel_output_dims[per_case_kernel_output_dims.size()-1];
-	size_t minibatch_size = input->GetDimensionSize(input->NumDimensions()-1);
-	std::vector<size_t> input_pos(input->NumDimensions());
-	std::vector<size_t> output_pos(per_case_kernel_output_dims.size()+1);
-
-	Tensor<ParamsType> input_tensor(0, per_case_input_dims);
-	Tensor<ParamsType> output_tensor(0, per_case_kernel_output_dims);
-	for (size_t case_ind = 0; case_ind<minibatch_size; case_ind++ )
-	{
-		input_pos[input_pos.size()-1] = case_ind;
-		output_pos[output_pos.size()-1] = case_ind;
-		for (size_t kernel_ind = 0; kernel_ind<kernels.size(); kernel_ind++)
-		{
-			output_pos[output_pos.size()-2] = kernel_ind*num_kernel_dims_per_kernel;
-			input_tensor.SetDataPtr(input->GetPtr(input_pos.data()));
-			output_tensor.SetDataPtr(output->GetPtr(output_pos.data()));
-			kernels[kernel_ind]->fprop(input_tensor, output_tensor);
-		}
-	}
+	if (UseMatrixLowering())
+		LoweredFprop(*input, *output);
+	else
+		PerCaseFprop(input, output);
 }
 
 template <class ParamsType>
@@ -273,18 +355,9 @@ void KernelModule<ParamsType>::sub_bprop(const std::shared_ptr< Tensor<ParamsTyp
 		std::shared_ptr< Tensor<ParamsType> >& input_gradients, const std::shared_ptr< Tensor<ParamsType> >& output_gradients, 
 		const std::vector<ParamsType>& samples_importances)
 {
-	for (size_t i=0; i< kernels_gradients.size(); i++)
-		kernels_gradients[i].SetZeros();
-	std::vector<size_t> per_case_input_dims = input->GetDimensions();
-	per_case_input_dims.pop_back(); // remove minibatch dimension
-
-	std::vector<size_t> per_case_kernel_output_dims = kernels[0]->GetOutputTensorDimensions(per_case_input_dims);
-	size_t num_kernel_dims_per_kernel = per_case_kernel_output_dims[per_case_kernel_output_dims.size()-1];
-
-	size_t minibatch_size = input->GetDimensionSize(input->NumDimensions()-1);
-	std::vector<size_t> input_pos(per_case_input_dims.size()+1);
-	std::vector<size_t> output_pos(per_case_kernel_output_dims.size()+1);
-	
+	if (!gradients_.GetStartPtr())
+		AllocateGradients();
+	gradients_.SetZeros();
 	size_t num_params_per_kernel = GetNumParams() / GetNumKernels();
 	Tensor<ParamsType> kernel_params_tensor(0, std::vector<size_t>(1, num_params_per_kernel) );
 	ParamsType importance_sum = static_cast<ParamsType>(std::accumulate(samples_importances.begin(),samples_importances.end(),0.0));
@@ -294,41 +367,212 @@ void KernelModule<ParamsType>::sub_bprop(const std::shared_ptr< Tensor<ParamsTyp
 		regularizer->GetGradients(kernel_params_tensor, kernels_gradients[kernel_ind], importance_sum);
 	}
 
-	Tensor<ParamsType> input_tensor(0, per_case_input_dims);
-	Tensor<ParamsType> input_gradients_tensor(0, per_case_input_dims);
-	Tensor<ParamsType> output_tensor(0, per_case_kernel_output_dims);
-	Tensor<ParamsType> output_gradients_tensor(0, per_case_kernel_output_dims);
+	input_gradients->SetZeros();
+	if (UseMatrixLowering())
+		LoweredBprop(*input, *input_gradients, *output_gradients);
+	else
+		PerCaseBprop(input, output, input_gradients, output_gradients);
+}
+
+template <class ParamsType>
+void KernelModule<ParamsType>::FillPatchMatrix(const Tensor<ParamsType>& input, const TensorShape& per_case_input_dims)
+{
+	const std::vector<int>& kernel_offsets = kernels[0]->GetKernelOffsets(per_case_input_dims);
+	const std::vector<size_t>& valid_tensor_positions = kernels[0]->GetValidTensorPositions(per_case_input_dims);
+	size_t num_params_per_kernel = kernel_offsets.size();
+	size_t num_positions = valid_tensor_positions.size();
+	size_t case_stride = input.GetDimStride(input.NumDimensions()-1);
+	size_t minibatch_size = input.GetDimensionSize(input.NumDimensions()-1);
+
+	patch_matrix_.resize(num_params_per_kernel*num_positions*minibatch_size);
+	ParamsType* patch_ptr = patch_matrix_.data();
+	const int* offsets_start_ptr = kernel_offsets.data();
+	const int* offsets_stop_ptr = offsets_start_ptr + num_params_per_kernel;
+	for (size_t case_ind = 0; case_ind<minibatch_size; case_ind++)
+	{
+		const ParamsType* case_input_ptr = input.GetStartPtr() + case_ind*case_stride;
+		for (size_t pos_ind = 0; pos_ind<num_positions; pos_ind++)
+		{
+			const ParamsType* position_ptr = case_input_ptr + valid_tensor_positions[pos_ind];
+			for (const int* offset_ptr = offsets_start_ptr; offset_ptr<offsets_stop_ptr; offset_ptr++, patch_ptr++)
+				*patch_ptr = *(position_ptr + *offset_ptr);
+		}
+	}
+	lowered_input_ptr_ = input.GetStartPtr();
+}
+
+template <class ParamsType>
+void KernelModule<ParamsType>::AccumulatePatchGradients(Tensor<ParamsType>& input_gradients, const TensorShape& per_case_input_dims)
+{
+	const std::vector<int>& kernel_offsets = kernels[0]->GetKernelOffsets(per_case_input_dims);
+	const std::vector<size_t>& valid_tensor_positions = kernels[0]->GetValidTensorPositions(per_case_input_dims);
+	size_t num_params_per_kernel = kernel_offsets.size();
+	size_t num_positions = valid_tensor_positions.size();
+	size_t case_stride = input_gradients.GetDimStride(input_gradients.NumDimensions()-1);
+	size_t minibatch_size = input_gradients.GetDimensionSize(input_gradients.NumDimensions()-1);
+
+	const ParamsType* patch_ptr = patch_matrix_.data();
+	const int* offsets_start_ptr = kernel_offsets.data();
+	const int* offsets_stop_ptr = offsets_start_ptr + num_params_per_kernel;
+	for (size_t case_ind = 0; case_ind<minibatch_size; case_ind++)
+	{
+		ParamsType* case_gradients_ptr = input_gradients.GetStartPtr() + case_ind*case_stride;
+		for (size_t pos_ind = 0; pos_ind<num_positions; pos_ind++)
+		{
+			ParamsType* position_ptr = case_gradients_ptr + valid_tensor_positions[pos_ind];
+			for (const int* offset_ptr = offsets_start_ptr; offset_ptr<offsets_stop_ptr; offset_ptr++, patch_ptr++)
+				*(position_ptr + *offset_ptr) += *patch_ptr;
+		}
+	}
+}
+
+template <class ParamsType>
+void KernelModule<ParamsType>::LoweredFprop(const Tensor<ParamsType>& input, Tensor<ParamsType>& output)
+{
+	TensorShape per_case_input_dims = input.GetShape();
+	per_case_input_dims.pop_back(); // remove minibatch dimension
+	FillPatchMatrix(input, per_case_input_dims);
+
+	size_t num_kernels = GetNumKernels();
+	size_t num_params_per_kernel = GetNumParams() / num_kernels;
+	size_t num_positions = kernels[0]->GetValidTensorPositions(per_case_input_dims).size();
+	size_t minibatch_size = input.GetDimensionSize(input.NumDimensions()-1);
+	size_t num_columns = num_positions*minibatch_size;
+	assert( output.Numel() == num_columns*num_kernels );
+
+	// responses[column, kernel] = patch_matrix[:, column]' * kernel
+	// with one kernel this is exactly the output layout
+	ParamsType* responses = output.GetStartPtr();
+	if (num_kernels > 1)
+	{
+		patch_output_buffer_.resize(num_columns*num_kernels);
+		responses = patch_output_buffer_.data();
+	}
+	MatrixMultiply<ParamsType>(CblasColMajor, CblasTrans, CblasNoTrans, num_columns, num_kernels, num_params_per_kernel, 
+		1, patch_matrix_.data(), num_params_per_kernel, parameters_.GetStartPtr(), num_params_per_kernel, 0, responses, num_columns);
+	
+	// output of each case stores responses of the kernels one after another
+	if (num_kernels > 1)
+		for (size_t case_ind = 0; case_ind<minibatch_size; case_ind++)
+			for (size_t kernel_ind = 0; kernel_ind<num_kernels; kernel_ind++)
+				copy<ParamsType>(responses + kernel_ind*num_columns + case_ind*num_positions, 
+					output.GetStartPtr() + (case_ind*num_kernels + kernel_ind)*num_positions, num_positions);
+}
+
+template <class ParamsType>
+void KernelModule<ParamsType>::LoweredBprop(const Tensor<ParamsType>& input, Tensor<ParamsType>& input_gradients, const Tensor<ParamsType>& output_gradients)
+{
+	TensorShape per_case_input_dims = input.GetShape();
+	per_case_input_dims.pop_back(); // remove minibatch dimension
+	if (lowered_input_ptr_ != input.GetStartPtr())
+		FillPatchMatrix(input, per_case_input_dims);
+
+	size_t num_kernels = GetNumKernels();
+	size_t num_params_per_kernel = GetNumParams() / num_kernels;
+	size_t num_positions = kernels[0]->GetValidTensorPositions(per_case_input_dims).size();
+	size_t minibatch_size = input.GetDimensionSize(input.NumDimensions()-1);
+	size_t num_columns = num_positions*minibatch_size;
+
+	// bring output gradients to (column, kernel) layout
+	const ParamsType* responses_gradients = output_gradients.GetStartPtr();
+	if (num_kernels > 1)
+	{
+		patch_output_buffer_.resize(num_columns*num_kernels);
+		for (size_t case_ind = 0; case_ind<minibatch_size; case_ind++)
+			for (size_t kernel_ind = 0; kernel_ind<num_kernels; kernel_ind++)
+				copy<ParamsType>(output_gradients.GetStartPtr() + (case_ind*num_kernels + kernel_ind)*num_positions, 
+					patch_output_buffer_.data() + kernel_ind*num_columns + case_ind*num_positions, num_positions);
+		responses_gradients = patch_output_buffer_.data();
+	}
+
+	// kernels gradients (added to the regularizer gradients)
+	MatrixMultiply<ParamsType>(CblasColMajor, CblasNoTrans, CblasNoTrans, num_params_per_kernel, num_kernels, num_columns, 
+		1, patch_matrix_.data(), num_params_per_kernel, responses_gradients, num_columns, 1, gradients_.GetStartPtr(), num_params_per_kernel);
+
+	// patches gradients overwrite the patch matrix
+	MatrixMultiply<ParamsType>(CblasColMajor, CblasNoTrans, CblasTrans, num_params_per_kernel, num_columns, num_kernels, 
+		1, parameters_.GetStartPtr(), num_params_per_kernel, responses_gradients, num_columns, 0, patch_matrix_.data(), num_params_per_kernel);
+	lowered_input_ptr_ = 0;
+
+	// the input may be a strided view, the gradients are dense
+	TensorShape per_case_gradients_dims = input_gradients.GetShape();
+	per_case_gradients_dims.pop_back();
+	AccumulatePatchGradients(input_gradients, per_case_gradients_dims);
+}
+
+template <class ParamsType>
+void KernelModule<ParamsType>::PerCaseFprop(const std::shared_ptr< Tensor<ParamsType> >& input, std::shared_ptr< Tensor<ParamsType> >& output)
+{
+	// the output of a single kernel applied to the whole minibatch has the layout of the module output,
+	// and the kernel keeps the state of the minibatch for bprop (e.g. the maximums of MaxPoolingKernel)
+	if (AppliesKernelToMinibatch(*input))
+	{
+		kernels[0]->fprop(*input, *output);
+		return;
+	}
+
+	// outputs of the kernels are stored one after another along the last per case dimension
+	size_t case_dim_ind = input->NumDimensions()-1;
+	size_t kernel_dim_ind = output->NumDimensions()-2;
+	size_t num_kernel_dims_per_kernel = output->GetDimensionSize(kernel_dim_ind) / kernels.size();
+
+	size_t minibatch_size = input->GetDimensionSize(case_dim_ind);
+	for (size_t case_ind = 0; case_ind<minibatch_size; case_ind++ )
+	{
+		Tensor<ParamsType> input_tensor = input->Select(case_dim_ind, case_ind);
+		Tensor<ParamsType> case_output = output->Select(kernel_dim_ind+1, case_ind);
+		for (size_t kernel_ind = 0; kernel_ind<kernels.size(); kernel_ind++)
+		{
+			Tensor<ParamsType> output_tensor = case_output.Slice(kernel_dim_ind, kernel_ind*num_kernel_dims_per_kernel, num_kernel_dims_per_kernel);
+			kernels[kernel_ind]->fprop(input_tensor, output_tensor);
+		}
+	}
+}
+
+template <class ParamsType>
+void KernelModule<ParamsType>::PerCaseBprop(const std::shared_ptr< Tensor<ParamsType> >& input, const std::shared_ptr< Tensor<ParamsType> >& output, 
+		std::shared_ptr< Tensor<ParamsType> >& input_gradients, const std::shared_ptr< Tensor<ParamsType> >& output_gradients)
+{
+	if (AppliesKernelToMinibatch(*input))
+	{
+		kernels[0]->GetGradient(*input, *output, *output_gradients, kernels_gradients[0]);
+		kernels[0]->bprop(*input, *output, *input_gradients, *output_gradients);
+		return;
+	}
+
+	size_t case_dim_ind = input->NumDimensions()-1;
+	size_t kernel_dim_ind = output->NumDimensions()-2;
+	size_t num_kernel_dims_per_kernel = output->GetDimensionSize(kernel_dim_ind) / kernels.size();
+	size_t minibatch_size = input->GetDimensionSize(case_dim_ind);
 
 	// update gradient
 	for (size_t case_ind = 0; case_ind<minibatch_size; case_ind++ )
 	{
-		input_pos[input_pos.size()-1] = case_ind;
-		output_pos[output_pos.size()-1] = case_ind;
+		Tensor<ParamsType> input_tensor = input->Select(case_dim_ind, case_ind);
+		Tensor<ParamsType> case_output = output->Select(kernel_dim_ind+1, case_ind);
+		Tensor<ParamsType> case_output_gradients = output_gradients->Select(kernel_dim_ind+1, case_ind);
 		for (size_t kernel_ind = 0; kernel_ind<kernels.size(); kernel_ind++)
 		{
-			output_pos[output_pos.size()-2] = kernel_ind*num_kernel_dims_per_kernel;
-			input_tensor.SetDataPtr(input->GetPtr(input_pos.data()));
-			output_tensor.SetDataPtr(output->GetPtr(output_pos.data()));
-			output_gradients_tensor.SetDataPtr(output_gradients->GetPtr(output_pos.data()));
+			size_t kernel_start = kernel_ind*num_kernel_dims_per_kernel;
+			Tensor<ParamsType> output_tensor = case_output.Slice(kernel_dim_ind, kernel_start, num_kernel_dims_per_kernel);
+			Tensor<ParamsType> output_gradients_tensor = case_output_gradients.Slice(kernel_dim_ind, kernel_start, num_kernel_dims_per_kernel);
 			kernels[kernel_ind]->GetGradient(input_tensor, output_tensor, output_gradients_tensor, kernels_gradients[kernel_ind]);
 		}
 	}
 
 	// bprop
-	input_gradients->SetZeros();
 	for (size_t case_ind = 0; case_ind<minibatch_size; case_ind++ )
 	{
-		input_pos[input_pos.size()-1] = case_ind;
-		output_pos[output_pos.size()-1] = case_ind;
+		Tensor<ParamsType> input_tensor = input->Select(case_dim_ind, case_ind);
+		Tensor<ParamsType> input_gradients_tensor = input_gradients->Select(case_dim_ind, case_ind);
+		Tensor<ParamsType> case_output = output->Select(kernel_dim_ind+1, case_ind);
+		Tensor<ParamsType> case_output_gradients = output_gradients->Select(kernel_dim_ind+1, case_ind);
 		for (size_t kernel_ind = 0; kernel_ind<kernels.size(); kernel_ind++)
 		{
-			output_pos[output_pos.size()-2] = kernel_ind*num_kernel_dims_per_kernel;
-			input_tensor.SetDataPtr(input->GetPtr(input_pos.data()));
-			output_tensor.SetDataPtr(output->GetPtr(output_pos.data()));
-			output_gradients_tensor.SetDataPtr(output_gradients->GetPtr(output_pos.data()));
-			input_gradients_tensor.SetDataPtr(input_gradients->GetPtr(input_pos.data()));
+			size_t kernel_start = kernel_ind*num_kernel_dims_per_kernel;
+			Tensor<ParamsType> output_tensor = case_output.Slice(kernel_dim_ind, kernel_start, num_kernel_dims_per_kernel);
+			Tensor<ParamsType> output_gradients_tensor = case_output_gradients.Slice(kernel_dim_ind, kernel_start, num_kernel_dims_per_kernel);
 			kernels[kernel_ind]->bprop(input_tensor, output_tensor, input_gradients_tensor, output_gradients_tensor);
-
 		}
 	}
 }
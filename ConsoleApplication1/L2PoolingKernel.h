@@ -0,0 +1,104 @@
+#ifndef L2_POOLING_KERNEL_H
+#define L2_POOLING_KERNEL_H
+
+#include "AveragePoolingKernel.h"
+#include <cmath>
+
+// Root mean square of the elements of the window, sqrt(mean(x^2)). The means of the squares are computed
+// with the running sums of AveragePoolingKernel
+template <class DataType>
+class L2PoolingKernel : public AveragePoolingKernel<DataType>
+{
+	// squares of the input, then the input in bprop
+	typename PoolVector<DataType>::type input_buffer_;
+	// gradients with respect to the means of squares, then the sums of them over the windows of each input element
+	typename PoolVector<DataType>::type output_buffer_;
+	typename PoolVector<DataType>::type spread_buffer_;
+
+public:
+
+	virtual void fprop(const Tensor<DataType>& input, Tensor<DataType>& output);
+
+	virtual void bprop(const Tensor<DataType>& input, const Tensor<DataType>& output,
+		Tensor<DataType>& input_gradients, const Tensor<DataType>& upper_gradients);
+
+	virtual DataType GetResponse(const Tensor<DataType>& data, const size_t* data_pos) const;
+
+	L2PoolingKernel(const Tensor<DataType>& kernel, const std::vector<size_t>& strides);
+
+	virtual std::string GetType() const;
+};
+
+template <class DataType>
+std::string L2PoolingKernel<DataType>::GetType() const
+{
+	return "L2PoolingKernel";
+}
+
+template <class DataType>
+L2PoolingKernel<DataType>::L2PoolingKernel(const Tensor<DataType>& kernel, const std::vector<size_t>& strides) :
+	AveragePoolingKernel<DataType>(kernel, strides)
+{
+}
+
+template <class DataType>
+void L2PoolingKernel<DataType>::fprop(const Tensor<DataType>& input, Tensor<DataType>& output)
+{
+	TensorShape input_shape = input.GetShape().GetContiguous();
+	input_buffer_.resize(input_shape.Numel());
+	CopyTensorElements(input, input_buffer_.data());
+	for (size_t i=0; i<input_buffer_.size(); i++)
+		input_buffer_[i] *= input_buffer_[i];
+
+	SumWindows(Tensor<DataType>(input_buffer_.data(), input_shape), output, static_cast<DataType>(1.0 / GetWindowNumel()));
+
+	// the running sums of doubles can leave a small negative value in a window of zeros that follows large elements,
+	// the means of squares are clamped to 0 so that such windows give 0 and not NaN
+	DataType* output_ptr = output.GetStartPtr();
+	size_t length = output.GetDimensionSize(0), stride = output.GetShape().GetStride(0);
+	ForEachLine(output.GetShape(), output.GetShape(), 0, [&](size_t offset, size_t)
+	{
+		for (size_t i=0; i<length; i++)
+			output_ptr[offset + i*stride] = std::sqrt((std::max)(output_ptr[offset + i*stride], DataType(0)));
+	});
+}
+
+// d y / d x = x / (N y) for the elements x of a window of N elements whose output is y
+template <class DataType>
+void L2PoolingKernel<DataType>::bprop(const Tensor<DataType>& input, const Tensor<DataType>& output,
+									 Tensor<DataType>& input_gradients, const Tensor<DataType>& output_gradients)
+{
+	TensorShape output_shape = output.GetShape().GetContiguous();
+	output_buffer_.resize(output_shape.Numel());
+	spread_buffer_.resize(output_shape.Numel());
+	CopyTensorElements(output, output_buffer_.data());
+	CopyTensorElements(output_gradients, spread_buffer_.data());
+	DataType scale = static_cast<DataType>(1.0 / GetWindowNumel());
+	for (size_t i=0; i<output_buffer_.size(); i++)
+		output_buffer_[i] = output_buffer_[i] > 0 ? scale*spread_buffer_[i]/output_buffer_[i] : 0;
+
+	TensorShape input_shape = input.GetShape().GetContiguous();
+	spread_buffer_.assign(input_shape.Numel(), 0);
+	Tensor<DataType> spread(spread_buffer_.data(), input_shape);
+	SpreadWindows(Tensor<DataType>(output_buffer_.data(), output_shape), spread, 1);
+
+	input_buffer_.resize(input_shape.Numel());
+	CopyTensorElements(input, input_buffer_.data());
+	DataType* input_gradients_ptr = input_gradients.GetStartPtr();
+	const DataType* input_ptr = input_buffer_.data();
+	const DataType* spread_ptr = spread_buffer_.data();
+	size_t length = input_shape[0], stride = input_gradients.GetShape().GetStride(0);
+	ForEachLine(input_shape, input_gradients.GetShape(), 0, [&](size_t offset, size_t gradients_offset)
+	{
+		for (size_t i=0; i<length; i++)
+			input_gradients_ptr[gradients_offset + i*stride] += input_ptr[offset + i]*spread_ptr[offset + i];
+	});
+}
+
+template <class DataType>
+DataType L2PoolingKernel<DataType>::GetResponse(const Tensor<DataType>& data, const size_t* data_pos) const
+{
+	return std::sqrt(GetWindowSum(data, data_pos, true) / GetWindowNumel());
+}
+
+#endif
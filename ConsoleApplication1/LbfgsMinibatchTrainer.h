@@ -191,6 +191,7 @@ double LbfgsMinibatchTrainer<ParamsType>::Train(NN<ParamsType>& net,
 		ProcessTrainResultFunc train_result_processor = DefaultProcessTrainFunc<ParamsType>, 
 		ProcessValidationResultFunc validation_result_processor = DefaultProcessValidationFunc<ParamsType>)
 {
+	FusedCostScope<ParamsType> fused_cost_scope(net, train_cost_module);
 	size_t num_params = net.GetNumParams();
 
 	size_t num_train_cases = train_set.GetNumSamples();
@@ -33,6 +33,16 @@ public:
 			receiver.push_back( parameters[i] );
 	}
 
+	virtual void BindParameters(ParamsType* params)
+	{
+		parameters.SetDataPtr(params);
+	}
+
+	virtual void BindGradients(ParamsType* gradients)
+	{
+		this->gradients.SetDataPtr(gradients);
+	}
+
 	virtual void SetParameters(const ParamsType* params)
 	{
 		for (size_t i=0; i < parameters.Numel(); i++)
@@ -127,7 +137,7 @@ bool LinearMaxModule<ParamsType>::Equals(const Module<ParamsType>& module) const
 		return false;
 
 	const LinearMaxModule<ParamsType>* other_module = static_cast< const LinearMaxModule<ParamsType>* >( &module );
-	if (other_module->parameters != parameters)
+	if (!EqualValues(other_module->parameters, parameters))
 		return false;
 	return true;
 }
@@ -141,16 +151,16 @@ void LinearMaxModule<ParamsType>::sub_GetState(IOTreeNode& node) const
 template <class ParamsType>
 std::shared_ptr< Module< ParamsType> > LinearMaxModule<ParamsType>::Create(IOTreeNode& data)
 {
-	std::shared_ptr< Tensor<ParamsType> > parameters = CreateTensor<ParamsType>(*data.nodes().GetEntry("Parameters"));
+	IOTreeNode& parameters_node = *data.nodes().GetEntry("Parameters");
 
-	std::vector< size_t > sample_dims = parameters->GetDimensions();
+	std::vector< size_t > sample_dims = GetTensorStateDimensions(parameters_node);
 	size_t num_lines = sample_dims[sample_dims.size()-1];
 	sample_dims.pop_back();
 	sample_dims.pop_back();
 
 	std::shared_ptr< LinearMaxModule<ParamsType> > module = 
 		std::shared_ptr< LinearMaxModule< ParamsType> >( new LinearMaxModule<ParamsType>(data.attributes().GetEntry( "Name" ), sample_dims, num_lines) );
-	module->SetParameters(*parameters);
+	module->LoadParameters(parameters_node);
 
 	return module;
 }
@@ -24,8 +24,9 @@ public:
 	{
 		assert(params_tensor.NumDimensions() == 2);
 		double coeff = 1.0/std::sqrt(params_tensor.GetDimensionSize(0)+params_tensor.GetDimensionSize(1));
-		for (size_t i = 0; i<params_tensor.Numel(); i++)
-			params_tensor[i] = static_cast<T>(multiplier_*coeff*RandomGenerator::GetUniformDouble(-1, 1));
+		T max_value = static_cast<T>(multiplier_*coeff);
+		RandomStream random_stream = RandomGenerator::CreateStream();
+		random_stream.FillUniform(params_tensor.GetStartPtr(), params_tensor.Numel(), -max_value, max_value);
 	}
 
 	static std::shared_ptr< ParametersInitializer< T> > Create(IOTreeNode& data)
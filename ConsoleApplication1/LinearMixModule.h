@@ -9,6 +9,7 @@
 #include "IOTreeNode.h"
 #include "TensorIO.h"
 #include "MatrixOperations.h"
+#include "ActivationFusion.h"
 
 template <class ParamsType>
 class LinearMixModule : public Module<ParamsType>
@@ -18,6 +19,25 @@ private:
 	Tensor<ParamsType> gradients;
 	std::shared_ptr<ParametersInitializer<ParamsType> > params_initializer;
 	std::shared_ptr<Regularizer<ParamsType> > regularizer;
+	FusedActivation<ParamsType> fused_activation_;
+
+	static std::vector<size_t> GetParametersDims(size_t num_input_features, size_t num_output_features)
+	{
+		std::vector<size_t> parameters_dims;
+		parameters_dims.push_back(num_output_features);
+		parameters_dims.push_back(num_input_features);
+		return parameters_dims;
+	}
+
+	// used by Create, the parameters get memory only if they are not mapped (see Module::LoadParameters)
+	LinearMixModule(std::string name, size_t num_input_features, size_t num_output_features, IOTreeNode& parameters_node,
+		const std::shared_ptr<ParametersInitializer<ParamsType> >& params_initializer, const std::shared_ptr<Regularizer<ParamsType> >& regularizer) 
+			: Module(name), params_initializer(params_initializer), regularizer(regularizer), 
+			parameters(0, GetParametersDims(num_input_features, num_output_features)), gradients(0, GetParametersDims(num_input_features, num_output_features))
+	{
+		if (!HasMappedParameters(parameters_node))
+			parameters.Allocate();
+	}
 public:
 
 	LinearMixModule(std::string name, size_t num_input_features, size_t num_output_features, 
@@ -45,6 +65,16 @@ public:
 		receiver.insert(receiver.end(), parameters.GetStartPtr(), parameters.GetStartPtr() + parameters.Numel());
 	}
 
+	virtual void BindParameters(ParamsType* params)
+	{
+		parameters.SetDataPtr(params);
+	}
+
+	virtual void BindGradients(ParamsType* gradients)
+	{
+		this->gradients.SetDataPtr(gradients);
+	}
+
 	virtual void SetParameters(const ParamsType* params)
 	{
 		size_t numel = parameters.Numel();
@@ -67,6 +97,12 @@ public:
 
 	virtual void GetGradients(std::vector<ParamsType>& receiver) const
 	{
+		// the gradients have no memory before the first bprop
+		if (!gradients.GetStartPtr())
+		{
+			receiver.resize(receiver.size() + gradients.Numel(), 0);
+			return;
+		}
 		receiver.insert(receiver.end(), gradients.GetStartPtr(), gradients.GetStartPtr() + gradients.Numel());
 	}
 
@@ -85,6 +121,31 @@ public:
 		return GetNumInputs()*GetNumOutputs();
 	}
 
+	virtual bool OverwritesOutputBuffer() const
+	{
+		return true;
+	}
+
+	virtual bool OverwritesInputGradientsBuffer() const
+	{
+		return true;
+	}
+
+	virtual bool FuseActivation(ActivationType activation)
+	{
+		return fused_activation_.Set(activation);
+	}
+
+	ActivationType GetFusedActivation() const
+	{
+		return fused_activation_.GetType();
+	}
+
+	virtual bool BpropUsesOutput() const
+	{
+		return fused_activation_.GetType() != no_activation;
+	}
+
 	virtual std::string GetType() const
 	{
 		return "LinearMixModule";
@@ -111,12 +172,14 @@ bool LinearMixModule<ParamsType>::Equals(const Module<ParamsType>& module) const
 		return false;
 
 	const LinearMixModule<ParamsType>* other_module = static_cast< const LinearMixModule<ParamsType>* >( &module );
-	if (other_module->parameters != parameters)
+	if (!EqualValues(other_module->parameters, parameters))
 		return false;
 	if (!params_initializer->Equals(*other_module->params_initializer))
 		return false;
 	if (!regularizer->Equals(*other_module->regularizer))
 		return false;
+	if (other_module->GetFusedActivation() != GetFusedActivation())
+		return false;
 	return true;
 }
 
@@ -128,6 +191,7 @@ void LinearMixModule<ParamsType>::sub_GetState(IOTreeNode& node) const
 	node.nodes().AppendEntry( "regularizer", regularizer->GetState() );
 	node.nodes().AppendEntry( "initializer", params_initializer->GetState() );
 	node.nodes().AppendEntry( "Parameters", GetTensorState(parameters) );
+	fused_activation_.GetState(node);
 }
 
 template <class ParamsType>
@@ -135,14 +199,14 @@ std::shared_ptr< Module< ParamsType> > LinearMixModule<ParamsType>::Create(IOTre
 {
 	std::shared_ptr< Regularizer<ParamsType> > regularizer = RegularizerFactory::GetRegularizer<ParamsType>(*data.nodes().GetEntry("regularizer"));
 	std::shared_ptr< ParametersInitializer<ParamsType> > initializer = InitializerFactory::GetInitializer<ParamsType>(*data.nodes().GetEntry("initializer"));
-	std::shared_ptr< Tensor<ParamsType> > parameters = CreateTensor<ParamsType>(*data.nodes().GetEntry("Parameters"));
-	
 	size_t num_inputs = Converter::ConvertTo<size_t>(data.attributes().GetEntry( "num_inputs" ));
 	size_t num_outputs = Converter::ConvertTo<size_t>(data.attributes().GetEntry( "num_outputs" ));
+	IOTreeNode& parameters_node = *data.nodes().GetEntry("Parameters");
 	std::shared_ptr< LinearMixModule<ParamsType> > module = 
 		std::shared_ptr< LinearMixModule< ParamsType> >( new LinearMixModule<ParamsType>(data.attributes().GetEntry( "Name" ), 
-		num_inputs, num_outputs, initializer, regularizer) );
-	module->SetParameters(*parameters);
+		num_inputs, num_outputs, parameters_node, initializer, regularizer) );
+	module->LoadParameters(parameters_node);
+	module->fused_activation_.SetState(data);
 
 	return module;
 }
@@ -151,13 +215,9 @@ template <class ParamsType>
 LinearMixModule<ParamsType>::LinearMixModule(std::string name, size_t num_input_features, size_t num_output_features, 
 		const std::shared_ptr<ParametersInitializer<ParamsType> >& params_initializer = std::shared_ptr<ParametersInitializer<ParamsType> >(new ConstantInitializer<ParamsType>(0)),
 		const std::shared_ptr<Regularizer<ParamsType> >& regularizer = std::shared_ptr<Regularizer<ParamsType> >(new EmptyRegularizer<ParamsType>()) ) 
-			: Module(name), params_initializer(params_initializer), regularizer(regularizer)
+			: Module(name), params_initializer(params_initializer), regularizer(regularizer), 
+			parameters(GetParametersDims(num_input_features, num_output_features)), gradients(0, GetParametersDims(num_input_features, num_output_features))
 {
-	std::vector<size_t> parameters_dims;
-	parameters_dims.push_back(num_output_features);
-	parameters_dims.push_back(num_input_features);
-	this->parameters = Tensor<ParamsType>(parameters_dims);
-	this->gradients = Tensor<ParamsType>(parameters_dims);
 }
 
 template <class ParamsType>
@@ -168,9 +228,26 @@ void LinearMixModule<ParamsType>::sub_train_fprop(const std::shared_ptr< Tensor<
 	size_t num_samples = input->GetDimensionSize(input->NumDimensions()-1);
 	assert( input->Numel() / num_samples == num_input_features);
 
-	MatrixMultiply<ParamsType>(CblasColMajor, CblasNoTrans, CblasNoTrans, num_output_features, num_samples, 
-		num_input_features, 1, parameters.GetStartPtr(), num_output_features, input->GetStartPtr(), 
-		num_input_features, 0,output->GetStartPtr(), num_output_features);
+	if (fused_activation_.GetType() == no_activation)
+	{
+		MatrixMultiply<ParamsType>(CblasColMajor, CblasNoTrans, CblasNoTrans, num_output_features, num_samples, 
+			num_input_features, 1, parameters.GetStartPtr(), num_output_features, input->GetStartPtr(), 
+			num_input_features, 0,output->GetStartPtr(), num_output_features);
+		return;
+	}
+
+	// the samples are multiplied in chunks, so the activation is applied to the results while they are in cache
+	const size_t chunk_numel = 16384;
+	size_t chunk_size = std::max<size_t>(1, chunk_numel / num_output_features);
+	for (size_t first_sample = 0; first_sample < num_samples; first_sample += chunk_size)
+	{
+		size_t num_chunk_samples = std::min(chunk_size, num_samples - first_sample);
+		ParamsType* output_ptr = output->GetStartPtr() + first_sample*num_output_features;
+		MatrixMultiply<ParamsType>(CblasColMajor, CblasNoTrans, CblasNoTrans, num_output_features, num_chunk_samples, 
+			num_input_features, 1, parameters.GetStartPtr(), num_output_features, input->GetStartPtr() + first_sample*num_input_features, 
+			num_input_features, 0, output_ptr, num_output_features);
+		fused_activation_.fprop(output_ptr, num_chunk_samples*num_output_features);
+	}
 }
 
 template <class ParamsType>
@@ -181,10 +258,13 @@ void LinearMixModule<ParamsType>::sub_bprop(const std::shared_ptr< Tensor<Params
 	size_t num_input_features = GetNumInputs();
 	size_t num_output_features = GetNumOutputs();
 	size_t num_samples = input->GetDimensionSize(input->NumDimensions()-1);
+	std::shared_ptr< Tensor<ParamsType> > activation_input_gradients = fused_activation_.bprop(output, output_gradients);
+	if (!gradients.GetStartPtr())
+		gradients.Allocate();
 
 	// set parameters gradients
 	MatrixMultiply<ParamsType>(CblasColMajor, CblasNoTrans, CblasTrans, num_output_features, num_input_features, 
-		num_samples, 1, output_gradients->GetStartPtr(), num_output_features, input->GetStartPtr(), 
+		num_samples, 1, activation_input_gradients->GetStartPtr(), num_output_features, input->GetStartPtr(), 
 		num_input_features, 0, gradients.GetStartPtr(), num_output_features);
 
 	ParamsType importance_sum = static_cast<ParamsType>(std::accumulate(samples_importances.begin(),samples_importances.end(),0.0));
@@ -192,7 +272,7 @@ void LinearMixModule<ParamsType>::sub_bprop(const std::shared_ptr< Tensor<Params
 
 	// backpropagate data
 	MatrixMultiply<ParamsType>(CblasColMajor, CblasTrans, CblasNoTrans, num_input_features, num_samples, 
-		num_output_features, 1, parameters.GetStartPtr(), num_output_features, output_gradients->GetStartPtr(), 
+		num_output_features, 1, parameters.GetStartPtr(), num_output_features, activation_input_gradients->GetStartPtr(), 
 		num_output_features, 0, input_gradients->GetStartPtr(), num_input_features);
 }
 
@@ -15,6 +15,16 @@ private:
 	Tensor<ParamsType> gradients;
 	std::shared_ptr<ParametersInitializer<ParamsType> > params_initializer;
 	std::shared_ptr<Regularizer<ParamsType> > regularizer;
+
+	// used by Create, the parameters get memory only if they are not mapped (see Module::LoadParameters)
+	LinearModule(std::string name, IOTreeNode& parameters_node, const std::shared_ptr<ParametersInitializer<ParamsType> >& params_initializer,
+		const std::shared_ptr<Regularizer<ParamsType> >& regularizer) 
+			: Module(name), params_initializer(params_initializer), regularizer(regularizer), 
+			parameters(0, GetTensorStateDimensions(parameters_node)), gradients(0, GetTensorStateDimensions(parameters_node))
+	{
+		if (!HasMappedParameters(parameters_node))
+			parameters.Allocate();
+	}
 public:
 
 	virtual double GetCost(const std::vector<ParamsType>& samples_importances)
@@ -26,11 +36,21 @@ public:
 	LinearModule(std::string name, const std::vector<size_t>& input_case_dims, 
 		const std::shared_ptr<ParametersInitializer<ParamsType> >& params_initializer = std::shared_ptr<ParametersInitializer<ParamsType> >(new ConstantInitializer<ParamsType>(0)),
 		const std::shared_ptr<Regularizer<ParamsType> >& regularizer = std::shared_ptr<Regularizer<ParamsType> >(new EmptyRegularizer<ParamsType>()) ) 
-			: Module(name), params_initializer(params_initializer), regularizer(regularizer), parameters(input_case_dims), gradients(input_case_dims)
+			: Module(name), params_initializer(params_initializer), regularizer(regularizer), parameters(input_case_dims), gradients(0, input_case_dims)
 	{
 		parameters.SetZeros();
 	}
 	
+	virtual void BindParameters(ParamsType* params)
+	{
+		parameters.SetDataPtr(params);
+	}
+
+	virtual void BindGradients(ParamsType* gradients)
+	{
+		this->gradients.SetDataPtr(gradients);
+	}
+
 	virtual void SetParameters(const ParamsType* params)
 	{
 		for (size_t i=0; i < parameters.Numel(); i++)
@@ -58,6 +78,12 @@ public:
 
 	virtual void GetGradients(std::vector<ParamsType>& receiver) const
 	{
+		// the gradients have no memory before the first bprop
+		if (!gradients.GetStartPtr())
+		{
+			receiver.resize(receiver.size() + parameters.Numel(), 0);
+			return;
+		}
 		for (size_t i=0; i < parameters.Numel(); i++)
 			receiver.push_back( gradients[i] );
 	}
@@ -99,7 +125,7 @@ bool LinearModule<ParamsType>::Equals(const Module<ParamsType>& module) const
 		return false;
 
 	const LinearModule<ParamsType>* other_module = static_cast< const LinearModule<ParamsType>* >( &module );
-	if (other_module->parameters != parameters)
+	if (!EqualValues(other_module->parameters, parameters))
 		return false;
 	if (!params_initializer->Equals(*other_module->params_initializer))
 		return false;
@@ -121,12 +147,12 @@ std::shared_ptr< Module< ParamsType> > LinearModule<ParamsType>::Create(IOTreeNo
 {
 	std::shared_ptr< Regularizer<ParamsType> > regularizer = RegularizerFactory::GetRegularizer<ParamsType>(*data.nodes().GetEntry("regularizer"));
 	std::shared_ptr< ParametersInitializer<ParamsType> > initializer = InitializerFactory::GetInitializer<ParamsType>(*data.nodes().GetEntry("initializer"));
-	std::shared_ptr< Tensor<ParamsType> > parameters = CreateTensor<ParamsType>(*data.nodes().GetEntry("Parameters"));
+	IOTreeNode& parameters_node = *data.nodes().GetEntry("Parameters");
 
 	std::shared_ptr< LinearModule<ParamsType> > module = 
 		std::shared_ptr< LinearModule< ParamsType> >( new LinearModule<ParamsType>(data.attributes().GetEntry( "Name" ), 
-		parameters->GetDimensions(), initializer, regularizer) );
-	module->SetParameters(*parameters);
+		parameters_node, initializer, regularizer) );
+	module->LoadParameters(parameters_node);
 
 	return module;
 }
@@ -152,6 +178,8 @@ void LinearModule<ParamsType>::sub_bprop(const std::shared_ptr< Tensor<ParamsTyp
 	std::shared_ptr< Tensor<ParamsType> >& input_gradients, const std::shared_ptr< Tensor<ParamsType> >& output_gradients, 
 	const std::vector<ParamsType>& samples_importances)
 {
+	if (!gradients.GetStartPtr())
+		gradients.Allocate();
 	gradients.SetZeros();
 	ParamsType importance_sum = static_cast<ParamsType>(std::accumulate(samples_importances.begin(),samples_importances.end(),0.0));
 	regularizer->GetGradients(parameters, gradients, importance_sum);
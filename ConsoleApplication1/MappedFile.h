@@ -0,0 +1,98 @@
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include <string>
+#include <stdexcept>
+
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+// Read-only file mapped to memory in the copy-on-write mode: all the processes that map the same file
+// share its pages in the page cache, a page is copied only when the process writes to it. The changes are never written to the file
+class MappedFile
+{
+	char* data_;
+	size_t size_;
+#ifdef _WIN32
+	HANDLE file_;
+	HANDLE mapping_;
+#endif
+
+	MappedFile(const MappedFile&);
+	MappedFile& operator=(const MappedFile&);
+public:
+	MappedFile(const std::string& path) : data_(0), size_(0)
+	{
+#ifdef _WIN32
+		file_ = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+		if (file_ == INVALID_HANDLE_VALUE)
+			throw std::runtime_error("MappedFile: can not open " + path);
+		LARGE_INTEGER file_size;
+		if (!GetFileSizeEx(file_, &file_size) || file_size.QuadPart == 0)
+		{
+			CloseHandle(file_);
+			throw std::runtime_error("MappedFile: can not map empty file " + path);
+		}
+		size_ = static_cast<size_t>(file_size.QuadPart);
+		mapping_ = CreateFileMappingA(file_, NULL, PAGE_WRITECOPY, 0, 0, NULL);
+		if (mapping_ == NULL)
+		{
+			CloseHandle(file_);
+			throw std::runtime_error("MappedFile: can not map " + path);
+		}
+		data_ = static_cast<char*>( MapViewOfFile(mapping_, FILE_MAP_COPY, 0, 0, 0) );
+		if (data_ == NULL)
+		{
+			CloseHandle(mapping_);
+			CloseHandle(file_);
+			throw std::runtime_error("MappedFile: can not map " + path);
+		}
+#else
+		int file_descriptor = open(path.c_str(), O_RDONLY);
+		if (file_descriptor < 0)
+			throw std::runtime_error("MappedFile: can not open " + path);
+		struct stat file_stat;
+		if (fstat(file_descriptor, &file_stat) != 0 || file_stat.st_size == 0)
+		{
+			close(file_descriptor);
+			throw std::runtime_error("MappedFile: can not map empty file " + path);
+		}
+		size_ = static_cast<size_t>(file_stat.st_size);
+		void* data = mmap(0, size_, PROT_READ | PROT_WRITE, MAP_PRIVATE, file_descriptor, 0);
+		// the mapping stays valid after the descriptor is closed
+		close(file_descriptor);
+		if (data == MAP_FAILED)
+			throw std::runtime_error("MappedFile: can not map " + path);
+		data_ = static_cast<char*>(data);
+#endif
+	}
+
+	~MappedFile()
+	{
+#ifdef _WIN32
+		UnmapViewOfFile(data_);
+		CloseHandle(mapping_);
+		CloseHandle(file_);
+#else
+		munmap(data_, size_);
+#endif
+	}
+
+	char* GetData()
+	{
+		return data_;
+	}
+
+	size_t GetSize() const
+	{
+		return size_;
+	}
+};
+
+#endif
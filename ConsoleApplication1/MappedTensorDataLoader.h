@@ -0,0 +1,254 @@
+#ifndef MAPPED_TENSOR_DATA_LOADER_H
+#define MAPPED_TENSOR_DATA_LOADER_H
+
+#include <fstream>
+#include "BaseTensorDataLoader.h"
+#include "IOBinary.h"
+#include "MappedFile.h"
+
+// Binary dataset file. Layout:
+//   header (64 bytes) - signature, version, number of sample dimensions, element type, number of samples,
+//                       flags, offsets of the dimensions, index and data sections
+//   dimensions        - dimensions of all the samples, or of each sample if the samples have different dimensions
+//   index             - only for samples with different dimensions: offset (in elements) of each sample and the total number of elements
+//   data              - samples stored one after another, starts at a multiple of 64 bytes
+// Integers are little-endian, samples are stored in the machine representation (little-endian machines only)
+class BinaryDataset
+{
+public:
+	static const uint32_t format_version = 1;
+	static const size_t header_size = 64;
+	static const uint64_t variable_sample_dims_flag = 1;
+
+	static const char* GetSignature()
+	{
+		return "NNLIBDS";
+	}
+
+	struct Header
+	{
+		uint32_t num_dims;
+		std::string element_type;
+		uint64_t num_samples;
+		uint64_t flags;
+		uint64_t dims_offset;
+		uint64_t index_offset;
+		uint64_t data_offset;
+	};
+
+	static std::string WriteHeader(const Header& header)
+	{
+		std::string buffer(GetSignature(), 8);
+		IOBinary::WriteUInt(buffer, format_version, 4);
+		IOBinary::WriteUInt(buffer, header.num_dims, 4);
+		std::string element_type = header.element_type;
+		element_type.resize(8, '\0');
+		buffer.append(element_type);
+		IOBinary::WriteUInt(buffer, header.num_samples, 8);
+		IOBinary::WriteUInt(buffer, header.flags, 8);
+		IOBinary::WriteUInt(buffer, header.dims_offset, 8);
+		IOBinary::WriteUInt(buffer, header.index_offset, 8);
+		IOBinary::WriteUInt(buffer, header.data_offset, 8);
+		assert( buffer.size() == header_size );
+		return buffer;
+	}
+
+	static Header ReadHeader(const std::string& buffer)
+	{
+		if (buffer.size() < header_size || buffer.compare(0, 8, std::string(GetSignature(), 8)) != 0)
+			throw std::runtime_error("BinaryDataset: not a binary dataset file");
+		size_t position = 8;
+		uint32_t version = static_cast<uint32_t>( IOBinary::ReadUInt(buffer, position, 4) );
+		if (version != format_version)
+			throw std::runtime_error("BinaryDataset: unsupported format version " + std::to_string(version));
+		Header header;
+		header.num_dims = static_cast<uint32_t>( IOBinary::ReadUInt(buffer, position, 4) );
+		header.element_type = std::string(buffer.c_str() + position);
+		position += 8;
+		header.num_samples = IOBinary::ReadUInt(buffer, position, 8);
+		header.flags = IOBinary::ReadUInt(buffer, position, 8);
+		header.dims_offset = IOBinary::ReadUInt(buffer, position, 8);
+		header.index_offset = IOBinary::ReadUInt(buffer, position, 8);
+		header.data_offset = IOBinary::ReadUInt(buffer, position, 8);
+		return header;
+	}
+};
+
+// writes the dataset in the binary format that is read by MappedTensorDataLoader. All the samples should have the same number of dimensions
+template< class T>
+void SaveBinaryDataset(const std::vector< std::shared_ptr< Tensor<T> > >& dataset, std::ostream& output_stream)
+{
+	IOBinary::CheckByteOrder();
+	BinaryDataset::Header header;
+	header.num_dims = dataset.empty() ? 0 : static_cast<uint32_t>( dataset[0]->NumDimensions() );
+	header.element_type = GetIOElementTypeName<T>();
+	header.num_samples = dataset.size();
+	header.flags = 0;
+	for (size_t i=0; i<dataset.size(); i++)
+	{
+		if (dataset[i]->NumDimensions() != header.num_dims)
+			throw std::runtime_error("SaveBinaryDataset: all the samples should have the same number of dimensions");
+		if (!dataset[i]->DimensionsEqual(dataset[0]->GetDimensions()))
+			header.flags |= BinaryDataset::variable_sample_dims_flag;
+	}
+	bool variable_sample_dims = (header.flags & BinaryDataset::variable_sample_dims_flag) != 0;
+
+	std::string dims_section;
+	std::string index_section;
+	uint64_t num_elements = 0;
+	for (size_t i=0; i<dataset.size(); i++)
+	{
+		if (variable_sample_dims || i == 0)
+			for (size_t dim=0; dim<header.num_dims; dim++)
+				IOBinary::WriteUInt(dims_section, dataset[i]->GetDimensionSize(dim), 8);
+		if (variable_sample_dims)
+			IOBinary::WriteUInt(index_section, num_elements, 8);
+		num_elements += dataset[i]->Numel();
+	}
+	if (variable_sample_dims)
+		IOBinary::WriteUInt(index_section, num_elements, 8);
+
+	header.dims_offset = BinaryDataset::header_size;
+	header.index_offset = variable_sample_dims ? header.dims_offset + dims_section.size() : 0;
+	header.data_offset = IOBinary::Align(header.dims_offset + dims_section.size() + index_section.size());
+
+	std::string buffer = BinaryDataset::WriteHeader(header);
+	buffer.append(dims_section);
+	buffer.append(index_section);
+	buffer.resize(static_cast<size_t>(header.data_offset), '\0');
+	output_stream.write(buffer.data(), buffer.size());
+	for (size_t i=0; i<dataset.size(); i++)
+		output_stream.write(reinterpret_cast<const char*>(dataset[i]->GetStartPtr()), dataset[i]->Numel()*sizeof(T));
+}
+
+// Serves minibatches directly from a memory mapped binary dataset file (see SaveBinaryDataset),
+// samples are not loaded to memory as separate tensors. InputType should be the type of the elements in the file
+template <class OutputType, class InputType>
+class MappedTensorDataLoader : public BaseTensorDataLoader<OutputType, InputType>
+{
+	typedef std::shared_ptr< Tensor<OutputType> > output_type_tensor_ptr;
+	typedef std::shared_ptr< Tensor<InputType> > input_type_tensor_ptr;
+
+	std::string path_;
+	std::shared_ptr<MappedFile> mapped_file_;
+	BinaryDataset::Header header_;
+	const InputType* data_;
+	// dimensions of all the samples, or of each sample if they have different dimensions
+	std::vector<size_t> dims_;
+	// offsets of the samples (in elements), only if they have different dimensions
+	std::vector<size_t> sample_offsets_;
+
+	bool HasVariableSampleDims() const
+	{
+		return (header_.flags & BinaryDataset::variable_sample_dims_flag) != 0;
+	}
+
+	virtual void sub_save(std::ostream& output_stream) const
+	{
+	}
+
+protected:
+	virtual const InputType* GetSamplePtr(size_t sample_ind) const
+	{
+		if (HasVariableSampleDims())
+			return data_ + sample_offsets_[sample_ind];
+		return data_ + sample_ind*Tensor<InputType>::Numel(dims_);
+	}
+
+	virtual size_t GetSampleNumel(size_t sample_ind) const
+	{
+		if (HasVariableSampleDims())
+			return sample_offsets_[sample_ind+1] - sample_offsets_[sample_ind];
+		return Tensor<InputType>::Numel(dims_);
+	}
+
+public:
+
+	MappedTensorDataLoader(const std::string& path, std::string name = "Default") :
+		BaseTensorDataLoader<OutputType, InputType>(std::vector< input_type_tensor_ptr >(), name), path_(path)
+	{
+		IOBinary::CheckByteOrder();
+		mapped_file_ = std::shared_ptr<MappedFile>( new MappedFile(path) );
+		const char* file_data = mapped_file_->GetData();
+		size_t file_size = mapped_file_->GetSize();
+		header_ = BinaryDataset::ReadHeader( std::string(file_data, file_size < BinaryDataset::header_size ? file_size : BinaryDataset::header_size) );
+		if (header_.data_offset > file_size)
+			throw std::runtime_error("MappedTensorDataLoader: corrupted file " + path);
+		if (header_.element_type != GetIOElementTypeName<InputType>())
+			throw std::runtime_error("MappedTensorDataLoader: file " + path + " stores " + header_.element_type + " elements");
+
+		size_t num_dims_entries = HasVariableSampleDims() ? header_.num_dims*static_cast<size_t>(header_.num_samples) : header_.num_dims;
+		size_t num_index_entries = HasVariableSampleDims() ? static_cast<size_t>(header_.num_samples)+1 : 0;
+		if (header_.dims_offset + 8*num_dims_entries > file_size || header_.index_offset + 8*num_index_entries > file_size)
+			throw std::runtime_error("MappedTensorDataLoader: corrupted file " + path);
+		std::string metadata(file_data, static_cast<size_t>(header_.data_offset));
+		size_t position = static_cast<size_t>(header_.dims_offset);
+		for (size_t i=0; i<num_dims_entries; i++)
+			dims_.push_back( static_cast<size_t>( IOBinary::ReadUInt(metadata, position, 8) ) );
+		position = static_cast<size_t>(header_.index_offset);
+		for (size_t i=0; i<num_index_entries; i++)
+			sample_offsets_.push_back( static_cast<size_t>( IOBinary::ReadUInt(metadata, position, 8) ) );
+
+		size_t total_numel = HasVariableSampleDims() ? sample_offsets_.back() : static_cast<size_t>(header_.num_samples)*Tensor<InputType>::Numel(dims_);
+		if (header_.data_offset + total_numel*sizeof(InputType) > file_size)
+			throw std::runtime_error("MappedTensorDataLoader: corrupted file " + path);
+		data_ = reinterpret_cast<const InputType*>(file_data + header_.data_offset);
+	}
+
+	static std::shared_ptr< MappedTensorDataLoader<OutputType, InputType> > Create(std::string name, std::istream& input_stream)
+	{
+		std::string path;
+		std::getline(input_stream, path);
+		return std::shared_ptr< MappedTensorDataLoader<OutputType, InputType> >( new MappedTensorDataLoader<OutputType, InputType>( path, name) );
+	}
+
+	// the samples stay in the file, only the path is saved
+	virtual void Save(std::ostream& output_stream) const
+	{
+		output_stream<<"DataLoader"<<"\n";
+		output_stream<<GetType()<<"\n";
+		output_stream<<GetName()<<"\n";
+		output_stream<<path_<<"\n";
+	}
+
+	virtual std::string GetType() const
+	{
+		return "MappedTensorDataLoader";
+	}
+
+	virtual size_t GetNumSamples() const
+	{
+		return static_cast<size_t>(header_.num_samples);
+	}
+
+	virtual std::vector<size_t> GetSampleDims(size_t sample_ind = 0) const
+	{
+		if (HasVariableSampleDims())
+			return std::vector<size_t>(dims_.begin()+sample_ind*header_.num_dims, dims_.begin()+(sample_ind+1)*header_.num_dims);
+		return dims_;
+	}
+
+	virtual bool Equals(BaseTensorDataLoader<OutputType, InputType>& data_loader)
+	{
+		return BaseTensorDataLoader<OutputType, InputType>::Equals(data_loader);
+	}
+
+	// all the requested samples should have the same dimensions
+	virtual output_type_tensor_ptr GetData(const std::vector<size_t>& samples_inds) const
+	{
+		std::vector<size_t> sample_dims = GetSampleDims(samples_inds.empty() ? 0 : samples_inds[0]);
+		output_type_tensor_ptr output_buffer = GetOutputBuffer(samples_inds.size(), sample_dims);
+		OutputType* output_ptr = output_buffer->GetStartPtr();
+		size_t sample_numel = Tensor<InputType>::Numel(sample_dims);
+		for (size_t i = 0; i<samples_inds.size(); i++)
+		{
+			if (HasVariableSampleDims() && GetSampleDims(samples_inds[i]) != sample_dims)
+				throw std::runtime_error("MappedTensorDataLoader: samples of a minibatch should have the same dimensions");
+			CopySampleElements(GetSamplePtr(samples_inds[i]), output_ptr, sample_numel);
+			output_ptr += sample_numel;
+		}
+		return output_buffer;
+	}
+};
+
+#endif
@@ -26,6 +26,28 @@ inline void MatrixMultiply<double>(CBLAS_ORDER order, CBLAS_TRANSPOSE transpose_
 	cblas_dgemm(order, transpose_A, transpose_B, M, N, K, alpha, A, lda, B, ldb, beta, C, ldc);
 }
 
+// y <- alpha*op(A)*x + beta*y, A is M x N
+template <class T>
+void MatrixVectorMultiply(CBLAS_ORDER order, CBLAS_TRANSPOSE transpose_A, size_t M, size_t N, 
+	T alpha, const T *A, size_t lda, const T *x, T beta, T* y)
+{
+	throw "Not implemented";
+}
+
+template <>
+inline void MatrixVectorMultiply<float>(CBLAS_ORDER order, CBLAS_TRANSPOSE transpose_A, size_t M, size_t N, 
+	float alpha, const float *A, size_t lda, const float *x, float beta, float* y)
+{
+	cblas_sgemv(order, transpose_A, M, N, alpha, A, lda, x, 1, beta, y, 1);
+}
+
+template <>
+inline void MatrixVectorMultiply<double>(CBLAS_ORDER order, CBLAS_TRANSPOSE transpose_A, size_t M, size_t N, 
+	double alpha, const double *A, size_t lda, const double *x, double beta, double* y)
+{
+	cblas_dgemv(order, transpose_A, M, N, alpha, A, lda, x, 1, beta, y, 1);
+}
+
 template <class T>
 T dot_product(const T* x1, const T* x2, size_t num_elements)
 {
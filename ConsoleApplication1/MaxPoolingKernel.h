@@ -7,6 +7,24 @@
 template <class DataType>
 class MaxPoolingKernel : public Kernel<DataType>
 {
+	// indices (in the kernel) of the maximums found by the last fprop, so bprop does not search for them again
+	std::vector<unsigned int> argmax_indices_;
+	const DataType* argmax_input_ptr_;
+	TensorShape argmax_input_shape_;
+
+	bool HasArgmax(const Tensor<DataType>& input, size_t num_positions) const
+	{
+		return argmax_input_ptr_ == input.GetStartPtr() && argmax_input_shape_.SameLayout(input.GetShape()) && 
+			argmax_indices_.size() == num_positions;
+	}
+
+	bool GetSpecializedWindow(const TensorShape& input_shape, size_t& window0, size_t& window1) const;
+
+	// window0 x window1 windows whose rows are contiguous, the loops over the window are unrolled by the compiler
+	template <size_t window0, size_t window1>
+	static void WindowsFprop(const DataType* input_ptr, size_t row_stride, const std::vector<size_t>& valid_tensor_positions, 
+		DataType* output_ptr, unsigned int* argmax_ptr);
+
 protected:
 	void subGetResponse(const Tensor<DataType>& data, size_t dim_num,  size_t* data_current_pos,  size_t* kernel_current_pos, DataType& res)  const;
 	DataType GetMaxElement(const DataType* input_ptr, const std::vector<int>& kernel_offsets) const;
@@ -33,6 +51,12 @@ public:
 														 const std::vector<size_t>& kernel_strides);
 
 	virtual std::string GetType() const;
+
+	// bprop finds the maximum in the input and updates the gradient at the same offset
+	virtual bool SupportsStridedInput() const
+	{
+		return false;
+	}
 };
 
 template <class DataType>
@@ -105,7 +129,8 @@ DataType MaxPoolingKernel<DataType>::GetResponse(const Tensor<DataType>& data,
 }
 
 template <class DataType>
-MaxPoolingKernel<DataType>::MaxPoolingKernel(const Tensor<DataType>& kernel, const std::vector<size_t>& strides) : Kernel<DataType>(kernel, strides)
+MaxPoolingKernel<DataType>::MaxPoolingKernel(const Tensor<DataType>& kernel, const std::vector<size_t>& strides) : Kernel<DataType>(kernel, strides), 
+	argmax_input_ptr_(0)
 {
 	std::vector<size_t> params_dims; params_dims.push_back(0);
 }
@@ -125,36 +150,92 @@ DataType MaxPoolingKernel<DataType>::GetMaxElement(const DataType* input_ptr, co
 template <class DataType>
 size_t MaxPoolingKernel<DataType>::GetMaxElementIndex(const DataType* input_ptr, const std::vector<int>& kernel_offsets) const
 {
-	size_t max_ind = 0;
-	DataType max_element = *(input_ptr+kernel_offsets[0]);
-	for (size_t offset_ind = 1; offset_ind < kernel_offsets.size(); offset_ind++)
+	// the first element equal to the maximum, the branches on the comparisons of the inputs would be mispredicted
+	DataType max_element = GetMaxElement(input_ptr, kernel_offsets);
+	for (size_t offset_ind = 0; offset_ind < kernel_offsets.size(); offset_ind++)
+		if ( *(input_ptr+kernel_offsets[offset_ind]) == max_element )
+			return offset_ind;
+	return 0;
+}
+
+// 1-D windows of 2 or 3 elements, 2-D windows of 2x2 or 3x3 elements (with any strides) on the inputs with contiguous rows
+template <class DataType>
+bool MaxPoolingKernel<DataType>::GetSpecializedWindow(const TensorShape& input_shape, size_t& window0, size_t& window1) const
+{
+	const TensorShape& kernel_shape = GetKernelTensor().GetShape();
+	if (kernel_shape.empty() || input_shape.empty() || input_shape.GetStride(0) != 1)
+		return false;
+	for (size_t dim_ind = 2; dim_ind<kernel_shape.size(); dim_ind++)
+		if (kernel_shape[dim_ind] != 1)
+			return false;
+	window0 = kernel_shape[0];
+	window1 = kernel_shape.size() > 1 ? kernel_shape[1] : 1;
+	if (window1 > 1 && input_shape.size() < 2)
+		return false;
+	return (window0 == 2 || window0 == 3) && (window1 == 1 || window1 == window0);
+}
+
+template <class DataType>
+template <size_t window0, size_t window1>
+void MaxPoolingKernel<DataType>::WindowsFprop(const DataType* input_ptr, size_t row_stride, const std::vector<size_t>& valid_tensor_positions, 
+	DataType* output_ptr, unsigned int* argmax_ptr)
+{
+	size_t num_positions = valid_tensor_positions.size();
+	for (size_t pos_ind = 0; pos_ind<num_positions; pos_ind++)
 	{
-		int kernel_offset = kernel_offsets[offset_ind];
-		if ( *(input_ptr+kernel_offset) > max_element )
-		{
-			max_element = *(input_ptr+kernel_offset);
-			max_ind = offset_ind;
-		}
+		const DataType* window_ptr = input_ptr + valid_tensor_positions[pos_ind];
+		// the maximum, then the first element equal to it (as in GetMaxElementIndex), without branches:
+		// the comparisons of the inputs are unpredictable, and the comparisons with the maximum do not depend on each other
+		DataType max_element = window_ptr[0];
+		for (size_t row = 0; row<window1; row++)
+			for (size_t col = 0; col<window0; col++)
+				max_element = (std::max)(max_element, window_ptr[row*row_stride + col]);
+		unsigned int max_index = 0;
+		for (size_t row = window1; row-- > 0; )
+			for (size_t col = window0; col-- > 0; )
+			{
+				unsigned int equal_mask = 0u - static_cast<unsigned int>(window_ptr[row*row_stride + col] == max_element);
+				max_index = (max_index & ~equal_mask) | (static_cast<unsigned int>(row*window0 + col) & equal_mask);
+			}
+		output_ptr[pos_ind] = max_element;
+		argmax_ptr[pos_ind] = max_index;
 	}
-	return max_ind;
 }
 
 template <class DataType>
 void MaxPoolingKernel<DataType>::fprop(const Tensor<DataType>& input, Tensor<DataType>& output)
 {
-	output.SetZeros();
-	auto input_dims = input.GetDimensions();
-	auto& kernel_offsets = GetKernelOffsets(input.GetDimensions());
-	auto& valid_tensor_positions = GetValidTensorPositions(input.GetDimensions());
-	const size_t* valid_offsets_start_ptr = valid_tensor_positions.data();
-	const size_t* valid_offsets_stop_ptr = valid_offsets_start_ptr+valid_tensor_positions.size();
+	auto& kernel_offsets = GetKernelOffsets(input.GetShape());
+	auto& valid_tensor_positions = GetValidTensorPositions(input.GetShape());
 	const DataType* input_start_ptr = input.GetStartPtr();
-	DataType* output_pos = output.GetStartPtr();
-	for (const size_t* input_offset_ptr = valid_offsets_start_ptr; input_offset_ptr<valid_offsets_stop_ptr; input_offset_ptr++,output_pos++)
+	DataType* output_start_ptr = output.GetStartPtr();
+	assert( output.Numel() == valid_tensor_positions.size() );
+	argmax_indices_.resize(valid_tensor_positions.size());
+	argmax_input_ptr_ = input_start_ptr;
+	argmax_input_shape_ = input.GetShape();
+
+	size_t window0, window1;
+	if (GetSpecializedWindow(input.GetShape(), window0, window1))
+	{
+		size_t row_stride = input.GetDimStride(1);
+		unsigned int* argmax_ptr = argmax_indices_.data();
+		if (window0 == 2 && window1 == 1)
+			WindowsFprop<2,1>(input_start_ptr, row_stride, valid_tensor_positions, output_start_ptr, argmax_ptr);
+		else if (window0 == 3 && window1 == 1)
+			WindowsFprop<3,1>(input_start_ptr, row_stride, valid_tensor_positions, output_start_ptr, argmax_ptr);
+		else if (window0 == 2)
+			WindowsFprop<2,2>(input_start_ptr, row_stride, valid_tensor_positions, output_start_ptr, argmax_ptr);
+		else
+			WindowsFprop<3,3>(input_start_ptr, row_stride, valid_tensor_positions, output_start_ptr, argmax_ptr);
+		return;
+	}
+
+	for (size_t pos_ind = 0; pos_ind<valid_tensor_positions.size(); pos_ind++)
 	{
-		const DataType* current_input_ptr = input_start_ptr+*input_offset_ptr;
+		const DataType* current_input_ptr = input_start_ptr+valid_tensor_positions[pos_ind];
 		size_t max_index = GetMaxElementIndex(current_input_ptr, kernel_offsets);
-		*output_pos = *(current_input_ptr+kernel_offsets[max_index]);
+		output_start_ptr[pos_ind] = *(current_input_ptr+kernel_offsets[max_index]);
+		argmax_indices_[pos_ind] = static_cast<unsigned int>(max_index);
 	}
 }
 
@@ -162,21 +243,26 @@ template <class DataType>
 void MaxPoolingKernel<DataType>::bprop(const Tensor<DataType>& input, const Tensor<DataType>& output, 
 										  Tensor<DataType>& input_gradients, const Tensor<DataType>& output_gradients)
 {
-	auto& kernel_offsets = GetKernelOffsets(input.GetDimensions());
-	auto& valid_tensor_positions = GetValidTensorPositions(input.GetDimensions());
-	const size_t* valid_offsets_start_ptr = valid_tensor_positions.data();
-	const size_t* valid_offsets_stop_ptr = valid_offsets_start_ptr+valid_tensor_positions.size();
-	DataType* input_gradients_start_ptr = input_gradients.GetStartPtr();
-	const DataType* input_start_ptr = input.GetStartPtr();
-	const DataType* output_gradients_pos = output_gradients.GetStartPtr();
-	for (const size_t* input_offset_ptr = valid_offsets_start_ptr; input_offset_ptr<valid_offsets_stop_ptr; input_offset_ptr++,output_gradients_pos++)
+	// see SupportsStridedInput
+	assert( input.GetShape().SameLayout(input_gradients.GetShape()) );
+	auto& kernel_offsets = GetKernelOffsets(input.GetShape());
+	auto& valid_tensor_positions = GetValidTensorPositions(input.GetShape());
+	size_t num_positions = valid_tensor_positions.size();
+	// the maximums are searched again only if the last fprop was applied to another input
+	if (!HasArgmax(input, num_positions))
 	{
-		DataType* current_input_gradients_ptr = input_gradients_start_ptr+*input_offset_ptr;
-
-		const DataType* current_input_ptr = input_start_ptr+*input_offset_ptr;
-		size_t max_index = GetMaxElementIndex(current_input_ptr, kernel_offsets);
-		*(current_input_gradients_ptr+kernel_offsets[max_index]) += *output_gradients_pos;
+		const DataType* input_start_ptr = input.GetStartPtr();
+		argmax_indices_.resize(num_positions);
+		for (size_t pos_ind = 0; pos_ind<num_positions; pos_ind++)
+			argmax_indices_[pos_ind] = static_cast<unsigned int>(GetMaxElementIndex(input_start_ptr+valid_tensor_positions[pos_ind], kernel_offsets));
+		argmax_input_ptr_ = input_start_ptr;
+		argmax_input_shape_ = input.GetShape();
 	}
+
+	DataType* input_gradients_start_ptr = input_gradients.GetStartPtr();
+	const DataType* output_gradients_start_ptr = output_gradients.GetStartPtr();
+	for (size_t pos_ind = 0; pos_ind<num_positions; pos_ind++)
+		*(input_gradients_start_ptr + valid_tensor_positions[pos_ind] + kernel_offsets[argmax_indices_[pos_ind]]) += output_gradients_start_ptr[pos_ind];
 }
 
 template <class DataType>
@@ -42,6 +42,14 @@ public:
 		return stds_;
 	}
 
+	virtual void CopyTrainState(const Module<ParamsType>& module)
+	{
+		const MeanStdNormalizingModule<ParamsType>& other_module = static_cast< const MeanStdNormalizingModule<ParamsType>& >(module);
+		means_ = other_module.means_;
+		stds_ = other_module.stds_;
+		frozen_ = other_module.frozen_;
+	}
+
 	MeanStdNormalizingModule(std::string name, size_t num_inputs, ParamsType start_std = 100, ParamsType decay=0.999 ) : 
 		Module(name), means_( num_inputs, 0), stds_(num_inputs, start_std), decay_(decay), frozen_(false),
 		eps_(std::numeric_limits<ParamsType>::epsilon())
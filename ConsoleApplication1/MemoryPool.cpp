@@ -0,0 +1,56 @@
+#include "MemoryPool.h"
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <Windows.h>
+#include <malloc.h>
+#else
+#include <sys/mman.h>
+#endif
+
+void* MemoryPool::SystemAllocate(size_t num_bytes, bool& large_pages)
+{
+	void* ptr = 0;
+#ifdef _WIN32
+	if (large_pages)
+	{
+		// requires the "Lock pages in memory" privilege, falls back to the regular pages without it
+		size_t page_size = GetLargePageMinimum();
+		if (page_size > 0)
+			ptr = VirtualAlloc(NULL, (num_bytes + page_size - 1) / page_size * page_size, MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE);
+		large_pages = ptr != 0;
+	}
+	if (!ptr)
+		ptr = _aligned_malloc(num_bytes, alignment);
+#else
+	size_t block_alignment = alignment;
+	if (large_pages)
+		block_alignment = large_page_size;
+	if (posix_memalign(&ptr, block_alignment, num_bytes) != 0)
+		ptr = 0;
+#ifdef MADV_HUGEPAGE
+	// transparent huge pages are a hint, the block is usable either way
+	if (ptr && large_pages)
+		madvise(ptr, num_bytes, MADV_HUGEPAGE);
+#else
+	large_pages = false;
+#endif
+#endif
+	if (!ptr)
+		throw std::bad_alloc();
+	return ptr;
+}
+
+void MemoryPool::SystemDeallocate(void* ptr, bool large_pages)
+{
+#ifdef _WIN32
+	if (large_pages)
+		VirtualFree(ptr, 0, MEM_RELEASE);
+	else
+		_aligned_free(ptr);
+#else
+	free(ptr);
+#endif
+}
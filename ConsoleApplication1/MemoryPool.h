@@ -0,0 +1,289 @@
+#ifndef MEMORY_POOL_H
+#define MEMORY_POOL_H
+
+#include <vector>
+#include <mutex>
+#include <new>
+#include <cstdlib>
+#include <cstddef>
+#include <assert.h>
+
+struct MemoryPoolStatistics
+{
+	size_t num_allocations; // calls of Allocate
+	size_t num_pool_hits; // allocations served by a previously released block
+	size_t num_system_allocations; // blocks requested from the system
+	size_t num_large_page_allocations; // blocks backed by large pages
+	size_t bytes_in_use; // sizes of the blocks that are not released
+	size_t peak_bytes_in_use;
+	size_t bytes_cached; // released blocks kept for reuse
+
+	MemoryPoolStatistics() : num_allocations(0), num_pool_hits(0), num_system_allocations(0), num_large_page_allocations(0),
+		bytes_in_use(0), peak_bytes_in_use(0), bytes_cached(0)
+	{
+	}
+};
+
+// Allocator of the memory of tensors and buffers. The blocks are aligned to 64 bytes (a cache line, the widest SIMD registers)
+// and rounded up to size classes, powers of 2 up to 64 KB and eighths of a power of 2 above, so a large block wastes at most
+// 1/8 of its size. A released block is kept in the free list of its class and is reused by the next allocation of the class,
+// so a workload whose buffer sizes vary (e.g. the last minibatch of an epoch) does not call the system allocator after the first
+// iterations. The blocks above the pooled size (e.g. a whole dataset) are allocated with their exact sizes and are returned
+// to the system right away.
+// Each block starts with a header of one alignment unit that stores its size, so the blocks are released without their sizes.
+// The calls of the system allocator are in MemoryPool.cpp, so that the system headers are not included with the tensors
+class MemoryPool
+{
+public:
+	static const size_t alignment = 64;
+	static const size_t large_page_size = 2*1024*1024;
+
+private:
+	static const size_t min_block_size = 64;
+	// from this size on each power of 2 is split into num_fine_steps classes
+	static const size_t min_fine_block_size = 64*1024;
+	static const size_t num_fine_steps = 8;
+	// 11 powers of 2 from min_block_size to min_fine_block_size, then the fine classes of blocks of up to 256 TB
+	static const size_t num_size_classes = 11 + 32*num_fine_steps;
+
+	struct BlockHeader
+	{
+		size_t block_size;
+		size_t size_class; // num_size_classes for the blocks that are not pooled
+		bool large_pages;
+	};
+
+	std::mutex mutex_;
+	std::vector< std::vector<void*> > free_blocks_;
+	MemoryPoolStatistics statistics_;
+	size_t max_pooled_block_size_;
+	bool use_large_pages_;
+
+	MemoryPool(const MemoryPool&);
+	MemoryPool& operator=(const MemoryPool&);
+
+	static size_t GetSizeClass(size_t num_bytes)
+	{
+		size_t size_class = 0;
+		size_t block_size = min_block_size;
+		while (block_size < num_bytes && block_size < min_fine_block_size)
+		{
+			block_size *= 2;
+			size_class++;
+		}
+		if (block_size < num_bytes)
+		{
+			while (2*block_size < num_bytes)
+			{
+				block_size *= 2;
+				size_class += num_fine_steps;
+			}
+			size_t step = block_size / num_fine_steps;
+			size_class += (num_bytes - block_size + step - 1) / step;
+		}
+		assert(size_class < num_size_classes);
+		return size_class;
+	}
+
+	static size_t GetBlockSize(size_t size_class)
+	{
+		size_t block_size = min_block_size;
+		while (block_size < min_fine_block_size && size_class > 0)
+		{
+			block_size *= 2;
+			size_class--;
+		}
+		while (size_class > num_fine_steps)
+		{
+			block_size *= 2;
+			size_class -= num_fine_steps;
+		}
+		return block_size + size_class * (block_size / num_fine_steps);
+	}
+
+	static BlockHeader* GetHeader(void* ptr)
+	{
+		return reinterpret_cast<BlockHeader*>( static_cast<char*>(ptr) - alignment );
+	}
+
+	// the memory starts at a multiple of the alignment, large page blocks start at a multiple of the page,
+	// large_pages is reset if the system does not provide them
+	static void* SystemAllocate(size_t num_bytes, bool& large_pages);
+
+	static void SystemDeallocate(void* ptr, bool large_pages);
+
+	static void SystemDeallocateBlock(void* ptr)
+	{
+		SystemDeallocate(GetHeader(ptr), GetHeader(ptr)->large_pages);
+	}
+
+public:
+
+	MemoryPool(size_t max_pooled_block_size = 32*1024*1024) : free_blocks_(num_size_classes),
+		max_pooled_block_size_(max_pooled_block_size), use_large_pages_(false)
+	{
+	}
+
+	~MemoryPool()
+	{
+		ReleaseCachedBlocks();
+	}
+
+	// the memory of the pool is used by Tensor and by the buffers of modules, cost modules and data loaders
+	static MemoryPool& GetInstance()
+	{
+		// never destroyed, as the tensors of static objects may be released after the end of main
+		static MemoryPool* instance = new MemoryPool();
+		return *instance;
+	}
+
+	// the blocks of at least large_page_size bytes are backed by large pages, when the system provides them
+	void SetUseLargePages(bool use_large_pages)
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		use_large_pages_ = use_large_pages;
+	}
+
+	void* Allocate(size_t num_bytes)
+	{
+		// the blocks above the pooled size are not rounded up to the size classes, only to the alignment
+		size_t size_class = num_bytes <= max_pooled_block_size_ ? GetSizeClass(num_bytes) : num_size_classes;
+		if (size_class < num_size_classes && GetBlockSize(size_class) > max_pooled_block_size_)
+			size_class = num_size_classes;
+		size_t block_size = size_class < num_size_classes ? GetBlockSize(size_class) : (num_bytes + alignment - 1) / alignment * alignment;
+		bool large_pages = false;
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			statistics_.num_allocations++;
+			statistics_.bytes_in_use += block_size;
+			if (statistics_.bytes_in_use > statistics_.peak_bytes_in_use)
+				statistics_.peak_bytes_in_use = statistics_.bytes_in_use;
+			if (size_class < num_size_classes && !free_blocks_[size_class].empty())
+			{
+				void* ptr = free_blocks_[size_class].back();
+				free_blocks_[size_class].pop_back();
+				statistics_.num_pool_hits++;
+				statistics_.bytes_cached -= block_size;
+				return ptr;
+			}
+			statistics_.num_system_allocations++;
+			large_pages = use_large_pages_ && block_size >= large_page_size;
+		}
+
+		char* memory = static_cast<char*>( SystemAllocate(block_size + alignment, large_pages) );
+		BlockHeader* header = reinterpret_cast<BlockHeader*>(memory);
+		header->block_size = block_size;
+		header->size_class = size_class;
+		header->large_pages = large_pages;
+		if (large_pages)
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			statistics_.num_large_page_allocations++;
+		}
+		return memory + alignment;
+	}
+
+	void Deallocate(void* ptr)
+	{
+		if (!ptr)
+			return;
+		size_t block_size = GetHeader(ptr)->block_size;
+		size_t size_class = GetHeader(ptr)->size_class;
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			statistics_.bytes_in_use -= block_size;
+			if (size_class < num_size_classes)
+			{
+				free_blocks_[size_class].push_back(ptr);
+				statistics_.bytes_cached += block_size;
+				return;
+			}
+		}
+		SystemDeallocateBlock(ptr);
+	}
+
+	// returns the cached blocks to the system, e.g. after a phase that used more memory than the next ones
+	void ReleaseCachedBlocks()
+	{
+		std::vector< std::vector<void*> > free_blocks(num_size_classes);
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			free_blocks.swap(free_blocks_);
+			statistics_.bytes_cached = 0;
+		}
+		for (size_t size_class = 0; size_class<free_blocks.size(); size_class++)
+			for (size_t i=0; i<free_blocks[size_class].size(); i++)
+				SystemDeallocateBlock(free_blocks[size_class][i]);
+	}
+
+	MemoryPoolStatistics GetStatistics()
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		return statistics_;
+	}
+};
+
+// STL allocator of the memory of the pool, e.g. for the buffers that are resized like vectors
+template <class T>
+class PoolAllocator
+{
+public:
+	typedef T value_type;
+	typedef T* pointer;
+	typedef const T* const_pointer;
+	typedef T& reference;
+	typedef const T& const_reference;
+	typedef size_t size_type;
+	typedef ptrdiff_t difference_type;
+
+	template <class U>
+	struct rebind
+	{
+		typedef PoolAllocator<U> other;
+	};
+
+	PoolAllocator()
+	{
+	}
+
+	template <class U>
+	PoolAllocator(const PoolAllocator<U>&)
+	{
+	}
+
+	T* allocate(size_t n, const void* = 0)
+	{
+		return static_cast<T*>( MemoryPool::GetInstance().Allocate(n*sizeof(T)) );
+	}
+
+	void deallocate(T* ptr, size_t)
+	{
+		MemoryPool::GetInstance().Deallocate(ptr);
+	}
+
+	size_t max_size() const
+	{
+		return static_cast<size_t>(-1) / sizeof(T);
+	}
+};
+
+template <class T, class U>
+bool operator==(const PoolAllocator<T>&, const PoolAllocator<U>&)
+{
+	return true;
+}
+
+template <class T, class U>
+bool operator!=(const PoolAllocator<T>&, const PoolAllocator<U>&)
+{
+	return false;
+}
+
+// vector whose memory is aligned and comes from the pool (MSVC 2012 has no alias templates)
+template <class T>
+struct PoolVector
+{
+	typedef std::vector< T, PoolAllocator<T> > type;
+};
+
+#endif
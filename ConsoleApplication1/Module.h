@@ -7,17 +7,29 @@
 #include "CashedTensor.h"
 #include "Tensor.h"
 #include "IOTreeNode.h"
+#include "TensorIO.h"
+#include "ActivationKernels.h"
+#include "BufferArena.h"
+#include "ModuleProfiler.h"
 
 template <class ParamsType>
 class Module
 {
 	std::string name_;
-	std::vector<ParamsType> output_buffer_data_;
-	std::vector<ParamsType> input_gradients_buffer_data_;
+	typename PoolVector<ParamsType>::type output_buffer_data_;
+	typename PoolVector<ParamsType>::type input_gradients_buffer_data_;
 
 	std::shared_ptr< Tensor<ParamsType> > input_buffer_;
 	std::shared_ptr< Tensor<ParamsType> > output_buffer_;
 	std::shared_ptr< Tensor<ParamsType> > input_gradients_buffer_;
+	// dense copy of a strided input, for the modules that do not accept strided views (see AcceptsStridedInput)
+	std::shared_ptr< Tensor<ParamsType> > contiguous_input_;
+	// memory of the buffers shared with other modules (see CompositeModule), 0 if the module uses its own memory
+	std::shared_ptr< BufferArena<ParamsType> > output_arena_;
+	std::shared_ptr< BufferArena<ParamsType> > input_gradients_arena_;
+	// keeps alive the memory of the parameters set by LoadParameters without copying
+	std::shared_ptr<IOBlob> parameters_blob_;
+	std::shared_ptr<ModuleProfiler> profiler_;
 	// buffers are passed by reference so that the modules could set them to point to other buffers without performing copying
 	// Modules in train mode and predict mode can behave differently (like dropout)
 	virtual void sub_train_fprop(const std::shared_ptr< Tensor<ParamsType> >& input, std::shared_ptr< Tensor<ParamsType> >& output) = 0;
@@ -30,6 +42,26 @@ class Module
 	virtual void sub_GetState(IOTreeNode& node) const = 0;
 
 	void UpdateCash(const std::shared_ptr< Tensor<ParamsType> >& input);
+	void UpdateInputGradientsCash();
+	const std::shared_ptr< Tensor<ParamsType> >& GetContiguousInput(const std::shared_ptr< Tensor<ParamsType> >& input);
+
+	// 0 if the profiling is off or compiled out
+	ModuleProfiler* GetActiveProfiler() const
+	{
+#ifdef NNLIB_NO_PROFILING
+		return nullptr;
+#else
+		return profiler_.get();
+#endif
+	}
+
+	static ParamsType* GetBufferData(typename PoolVector<ParamsType>::type& own_data, const std::shared_ptr< BufferArena<ParamsType> >& arena, size_t numel)
+	{
+		if (arena)
+			return arena->Reserve(numel);
+		own_data.reserve(numel);
+		return own_data.data();
+	}
 
 public:
 
@@ -60,6 +92,77 @@ public:
 		return true;
 	}
 
+	// modules that write every element of their allocated buffers return true, so the buffers are not zeroed before sub_train_fprop and sub_bprop
+	virtual bool OverwritesOutputBuffer() const
+	{
+		return false;
+	}
+
+	virtual bool OverwritesInputGradientsBuffer() const
+	{
+		return false;
+	}
+
+	// elementwise activation computed by the module (see ActivationKernels.h), no_activation for other modules
+	virtual ActivationType GetActivationType() const
+	{
+		return no_activation;
+	}
+
+	// makes the module apply the activation to its output (see FuseActivations), returns false if the module does not support it
+	virtual bool FuseActivation(ActivationType activation)
+	{
+		return false;
+	}
+
+	// whether bprop reads the data of the input and output buffers, otherwise CompositeModule can reuse their memory after fprop
+	virtual bool BpropUsesInput() const
+	{
+		return true;
+	}
+
+	virtual bool BpropUsesOutput() const
+	{
+		return true;
+	}
+
+	// whether sub_train_fprop and sub_bprop handle inputs that are strided views of other tensors (see Tensor::Slice), 
+	// other modules get a dense copy of such inputs
+	virtual bool AcceptsStridedInput() const
+	{
+		return false;
+	}
+
+	// whether GetCost reads the data of the input buffer
+	virtual bool CostUsesInput() const
+	{
+		return false;
+	}
+
+	// makes the output and input gradients buffers use the arenas instead of the memory of the module, 0 to use the own memory
+	void SetBufferArenas(const std::shared_ptr< BufferArena<ParamsType> >& output_arena, const std::shared_ptr< BufferArena<ParamsType> >& input_gradients_arena)
+	{
+		output_arena_ = output_arena;
+		input_gradients_arena_ = input_gradients_arena;
+		// the buffers are moved to the new memory by the next train_fprop and bprop
+		if (output_arena_)
+			typename PoolVector<ParamsType>::type().swap(output_buffer_data_);
+		if (input_gradients_arena_)
+			typename PoolVector<ParamsType>::type().swap(input_gradients_buffer_data_);
+	}
+
+	// makes train_fprop, predict_fprop and bprop record their statistics to the profiler, 0 to stop the profiling.
+	// Modules that contain other modules pass the profiler to them
+	virtual void SetProfiler(const std::shared_ptr<ModuleProfiler>& profiler)
+	{
+		profiler_ = profiler;
+	}
+
+	const std::shared_ptr<ModuleProfiler>& GetProfiler() const
+	{
+		return profiler_;
+	}
+
 	std::shared_ptr< Tensor<ParamsType> >& GetOutputBuffer()
 	{
 		return output_buffer_;
@@ -110,6 +213,55 @@ public:
 	{
 	}
 
+	// makes the module use params (GetNumParams() elements) as its parameters without copying them.
+	// The memory has to outlive the module
+	virtual void BindParameters(ParamsType* params)
+	{
+	}
+
+	// makes bprop write the gradients to gradients (GetNumParams() elements) instead of the memory of the module,
+	// which the modules allocate on the first bprop if their gradients are not bound. The memory has to outlive the module
+	virtual void BindGradients(ParamsType* gradients)
+	{
+	}
+
+	// whether LoadParameters uses the saved parameters without copying them (they were loaded by IOBinary::load_mapped).
+	// Create of the modules does not allocate memory for such parameters
+	static bool HasMappedParameters(IOTreeNode& parameters_node)
+	{
+		if (!parameters_node.blobs().HasEntry("parameters"))
+			return false;
+		std::shared_ptr<IOBlob> blob = parameters_node.blobs().GetEntry("parameters");
+		return blob->IsInPlace() && blob->CanViewAs<ParamsType>();
+	}
+
+	// sets the parameters saved by GetTensorState. Parameters loaded by IOBinary::load_mapped 
+	// are used without copying them, so they stay in the mapped file
+	void LoadParameters(IOTreeNode& parameters_node)
+	{
+		if (HasMappedParameters(parameters_node))
+		{
+			std::shared_ptr<IOBlob> blob = parameters_node.blobs().GetEntry("parameters");
+			assert( blob->GetNumElements() == GetNumParams() );
+			BindParameters( blob->GetMutableData<ParamsType>() );
+			parameters_blob_ = blob;
+			return;
+		}
+		SetParameters( CreateTensor<ParamsType>(parameters_node)->GetStartPtr() );
+	}
+
+	// whether the output gradients of bprop are the gradients with respect to the input of the module, which the cost module 
+	// fused with it computes (see CostModule::GetFusedModule)
+	virtual bool IsFusedWithCost() const
+	{
+		return false;
+	}
+
+	// copies the state that is changed by train_fprop (not the parameters) from a module of the same type and structure
+	virtual void CopyTrainState(const Module<ParamsType>& module)
+	{
+	}
+
 	virtual std::string GetType() const = 0;
 
 	virtual void InitializeParameters()
@@ -142,41 +294,54 @@ template <class ParamsType>
 std::shared_ptr< Tensor<ParamsType> > Module<ParamsType>::bprop(const std::shared_ptr< Tensor<ParamsType> >& ouput_gradients, 
 																const std::vector<ParamsType>& samples_importances)
 {
+	ProfiledScope< Module<ParamsType> > profiled_scope(GetActiveProfiler(), *this, profiled_bprop);
+	if (AlocateInputGradientsBuffer())
+		UpdateInputGradientsCash();
 	std::shared_ptr< Tensor<ParamsType> > input_gradients = GetInputGradientsBuffer(ouput_gradients);
 	
 	// if we don't allocate the buffer, we should not change it here, because we don't know how it will affect the ouput_gradients buffer
-	if (AlocateInputGradientsBuffer())
+	if (AlocateInputGradientsBuffer() && !OverwritesInputGradientsBuffer())
 		input_gradients->SetZeros();
 
 	sub_bprop(GetInputBuffer(), GetOutputBuffer(), input_gradients, ouput_gradients, samples_importances);
+	if (GetActiveProfiler())
+		profiled_scope.AddBufferBytes( static_cast<double>(sizeof(ParamsType)*(ouput_gradients->Numel() + input_gradients->Numel())) );
 	return input_gradients;
 }
 
 template <class ParamsType>
 std::shared_ptr< Tensor<ParamsType> > Module<ParamsType>::train_fprop(const std::shared_ptr< Tensor<ParamsType> >& input)
 {
-	UpdateCash(input);
+	ProfiledScope< Module<ParamsType> > profiled_scope(GetActiveProfiler(), *this, profiled_train_fprop);
+	const std::shared_ptr< Tensor<ParamsType> >& module_input = GetContiguousInput(input);
+	UpdateCash(module_input);
 	std::shared_ptr< Tensor<ParamsType> >& output_buffer = GetOutputBuffer();
 	
 	// if we don't allocate the buffer, we should not change it here, because we don't know how it will affect the input buffer
-	if (AlocateOutputBuffer())
+	if (AlocateOutputBuffer() && !OverwritesOutputBuffer())
 		output_buffer->SetZeros();
 
-	sub_train_fprop(input, output_buffer);
+	sub_train_fprop(module_input, output_buffer);
+	if (GetActiveProfiler())
+		profiled_scope.AddBufferBytes( static_cast<double>(sizeof(ParamsType)*(input->Numel() + output_buffer->Numel())) );
 	return output_buffer;
 }
 
 template <class ParamsType>
 std::shared_ptr< Tensor<ParamsType> > Module<ParamsType>::predict_fprop(const std::shared_ptr< Tensor<ParamsType> >& input)
 {
-	UpdateCash(input);
+	ProfiledScope< Module<ParamsType> > profiled_scope(GetActiveProfiler(), *this, profiled_predict_fprop);
+	const std::shared_ptr< Tensor<ParamsType> >& module_input = GetContiguousInput(input);
+	UpdateCash(module_input);
 	std::shared_ptr< Tensor<ParamsType> >& output_buffer = GetOutputBuffer();
 	
 	// if we don't allocate the buffer, we should not change it here, because we don't know how it will affect the input buffer
-	if (AlocateOutputBuffer())
+	if (AlocateOutputBuffer() && !OverwritesOutputBuffer())
 		output_buffer->SetZeros();
 
-	sub_predict_fprop(input, output_buffer);
+	sub_predict_fprop(module_input, output_buffer);
+	if (GetActiveProfiler())
+		profiled_scope.AddBufferBytes( static_cast<double>(sizeof(ParamsType)*(input->Numel() + output_buffer->Numel())) );
 	return output_buffer;
 }
 
@@ -189,28 +354,50 @@ void Module<ParamsType>::sub_predict_fprop(const std::shared_ptr< Tensor<ParamsT
 template <class ParamsType>
 void Module<ParamsType>::UpdateCash(const std::shared_ptr< Tensor<ParamsType> >& input)
 {
-	if ( !input_buffer_->DimensionsEqual( *input ) )
+	bool dimensions_changed = !input_buffer_->DimensionsEqual( *input );
+	if (AlocateOutputBuffer())
 	{
-		std::vector<size_t> input_dims = input->GetDimensions();
-		if (AlocateInputGradientsBuffer())
+		TensorShape output_dims = output_buffer_->GetShape();
+		if (dimensions_changed)
 		{
-			input_gradients_buffer_data_.reserve(Tensor<ParamsType>::Numel(input_dims));
-			input_gradients_buffer_ = std::shared_ptr< Tensor<ParamsType> >( new Tensor<ParamsType>(input_gradients_buffer_data_.data(), input_dims));
-		}
-
-		// Get output dimensions
-		if (AlocateOutputBuffer())
-		{
-			size_t num_samples = input_dims[input_dims.size()-1];
+			// Get output dimensions
+			TensorShape input_dims = input->GetShape();
+			size_t num_samples = input_dims.back();
 			input_dims.pop_back();
-			std::vector<size_t> output_dims = GetPerCaseOutputDims(input_dims);
+			output_dims = TensorShape(GetPerCaseOutputDims(input_dims.GetDimensions()));
 			output_dims.push_back(num_samples);
-			output_buffer_data_.reserve(Tensor<ParamsType>::Numel(output_dims));
-			output_buffer_ = std::shared_ptr< Tensor<ParamsType> >( new Tensor<ParamsType>(output_buffer_data_.data(), output_dims));
 		}
+		// the memory changes when the arena is set, and the buffers of other modules can move the memory of a shared arena
+		ParamsType* output_data = GetBufferData(output_buffer_data_, output_arena_, output_dims.Numel());
+		if (output_data != output_buffer_->GetStartPtr() && GetActiveProfiler())
+			GetActiveProfiler()->RecordBufferAllocation(GetName(), GetType());
+		if (dimensions_changed || output_data != output_buffer_->GetStartPtr())
+			output_buffer_ = std::shared_ptr< Tensor<ParamsType> >( new Tensor<ParamsType>(output_data, output_dims));
 	}
 	
 	input_buffer_ = input;
 }
 
+// input gradients buffer is allocated by bprop, so predict_fprop does not need memory for it
+template <class ParamsType>
+void Module<ParamsType>::UpdateInputGradientsCash()
+{
+	ParamsType* input_gradients_data = GetBufferData(input_gradients_buffer_data_, input_gradients_arena_, input_buffer_->Numel());
+	if ((!input_gradients_buffer_ || input_gradients_data != input_gradients_buffer_->GetStartPtr()) && GetActiveProfiler())
+		GetActiveProfiler()->RecordBufferAllocation(GetName(), GetType());
+	if (!input_gradients_buffer_ || !input_gradients_buffer_->DimensionsEqual( *input_buffer_ ) || input_gradients_data != input_gradients_buffer_->GetStartPtr())
+		input_gradients_buffer_ = std::shared_ptr< Tensor<ParamsType> >( new Tensor<ParamsType>(input_gradients_data, input_buffer_->GetShape().GetContiguous()));
+}
+
+template <class ParamsType>
+const std::shared_ptr< Tensor<ParamsType> >& Module<ParamsType>::GetContiguousInput(const std::shared_ptr< Tensor<ParamsType> >& input)
+{
+	if (input->IsContiguous() || AcceptsStridedInput())
+		return input;
+	if (!contiguous_input_ || !contiguous_input_->DimensionsEqual(*input))
+		contiguous_input_ = std::shared_ptr< Tensor<ParamsType> >( new Tensor<ParamsType>(input->GetShape()) );
+	CopyTensorElements(*input, contiguous_input_->GetStartPtr());
+	return contiguous_input_;
+}
+
 #endif
\ No newline at end of file
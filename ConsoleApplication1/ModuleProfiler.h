@@ -0,0 +1,167 @@
+#ifndef MODULE_PROFILER_H
+#define MODULE_PROFILER_H
+
+#include <map>
+#include <string>
+#include <vector>
+#include <mutex>
+#include <ostream>
+#include <iomanip>
+#include <algorithm>
+#include <chrono>
+
+// Statistics of a module collected by ModuleProfiler (see NN::SetProfiling).
+// The times of a module include the times of its inner modules (e.g. of the modules of CompositeModule)
+struct ModuleProfile
+{
+	std::string type;
+	size_t train_fprop_calls;
+	size_t predict_fprop_calls;
+	size_t bprop_calls;
+	size_t cost_calls;
+	// seconds
+	double train_fprop_time;
+	double predict_fprop_time;
+	double bprop_time;
+	double cost_time;
+	// bytes of the buffers passed to and returned by the module
+	double buffer_bytes;
+	// allocations and moves of the memory of the output and input gradients buffers
+	size_t buffer_allocations;
+
+	ModuleProfile() : train_fprop_calls(0), predict_fprop_calls(0), bprop_calls(0), cost_calls(0), train_fprop_time(0), predict_fprop_time(0),
+		bprop_time(0), cost_time(0), buffer_bytes(0), buffer_allocations(0)
+	{
+	}
+
+	double GetTotalTime() const
+	{
+		return train_fprop_time + predict_fprop_time + bprop_time + cost_time;
+	}
+};
+
+enum ProfiledOperation
+{
+	profiled_train_fprop,
+	profiled_predict_fprop,
+	profiled_bprop,
+	profiled_cost,
+	// cost and bprop of a cost module computed together (see CostModule::GetCostAndGradients), the time is added to the cost time
+	profiled_cost_and_bprop
+};
+
+// Collects the statistics of modules by their names. The modules of the replicas of a network (see NN::SetNumThreads)
+// have the same names and record to the same profiler concurrently
+class ModuleProfiler
+{
+	mutable std::mutex mutex_;
+	std::map<std::string, ModuleProfile> profiles_;
+
+	ModuleProfile& GetProfile(const std::string& name, const std::string& type)
+	{
+		ModuleProfile& profile = profiles_[name];
+		if (profile.type.empty())
+			profile.type = type;
+		return profile;
+	}
+
+public:
+
+	void RecordOperation(const std::string& name, const std::string& type, ProfiledOperation operation, double time, double buffer_bytes)
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		ModuleProfile& profile = GetProfile(name, type);
+		switch (operation)
+		{
+		case profiled_train_fprop: profile.train_fprop_calls++; profile.train_fprop_time += time; break;
+		case profiled_predict_fprop: profile.predict_fprop_calls++; profile.predict_fprop_time += time; break;
+		case profiled_bprop: profile.bprop_calls++; profile.bprop_time += time; break;
+		case profiled_cost: profile.cost_calls++; profile.cost_time += time; break;
+		case profiled_cost_and_bprop: profile.cost_calls++; profile.bprop_calls++; profile.cost_time += time; break;
+		}
+		profile.buffer_bytes += buffer_bytes;
+	}
+
+	void RecordBufferAllocation(const std::string& name, const std::string& type)
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		GetProfile(name, type).buffer_allocations++;
+	}
+
+	std::map<std::string, ModuleProfile> GetProfiles() const
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		return profiles_;
+	}
+
+	void Reset()
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		profiles_.clear();
+	}
+
+	// a line per module, sorted by the total time
+	void WriteReport(std::ostream& out) const
+	{
+		std::map<std::string, ModuleProfile> profiles = GetProfiles();
+		std::vector< std::pair<double, std::string> > order;
+		for (auto iter = profiles.begin(); iter != profiles.end(); iter++)
+			order.push_back(std::make_pair(-iter->second.GetTotalTime(), iter->first));
+		std::sort(order.begin(), order.end());
+
+		out << std::left << std::setw(30) << "module" << std::setw(30) << "type" << std::right << std::setw(12) << "total ms"
+			<< std::setw(12) << "fprop ms" << std::setw(12) << "bprop ms" << std::setw(12) << "cost ms" << std::setw(10) << "calls"
+			<< std::setw(12) << "MB" << std::setw(8) << "allocs" << std::endl;
+		for (size_t i=0; i<order.size(); i++)
+		{
+			const ModuleProfile& profile = profiles[order[i].second];
+			out << std::left << std::setw(30) << order[i].second << std::setw(30) << profile.type << std::right << std::fixed << std::setprecision(3)
+				<< std::setw(12) << 1000*profile.GetTotalTime() << std::setw(12) << 1000*(profile.train_fprop_time+profile.predict_fprop_time)
+				<< std::setw(12) << 1000*profile.bprop_time << std::setw(12) << 1000*profile.cost_time
+				<< std::setw(10) << profile.train_fprop_calls+profile.predict_fprop_calls+profile.bprop_calls+profile.cost_calls
+				<< std::setw(12) << profile.buffer_bytes/(1 << 20) << std::setw(8) << profile.buffer_allocations << std::endl;
+		}
+	}
+
+	// seconds from an unspecified moment
+	static double Now()
+	{
+		return std::chrono::duration<double>(std::chrono::high_resolution_clock::now().time_since_epoch()).count();
+	}
+};
+
+// Records the time of an operation of a module from the construction to the destruction, does nothing if the profiler is 0.
+// The name and the type of the module are requested only if the profiler is set. The modules pass 0 if NNLIB_NO_PROFILING
+// is defined, so that the profiling is compiled out
+template <class ProfiledModule>
+class ProfiledScope
+{
+	ModuleProfiler* profiler_;
+	const ProfiledModule& module_;
+	ProfiledOperation operation_;
+	double buffer_bytes_;
+	double start_time_;
+
+	ProfiledScope(const ProfiledScope&);
+	ProfiledScope& operator=(const ProfiledScope&);
+
+public:
+
+	ProfiledScope(ModuleProfiler* profiler, const ProfiledModule& module, ProfiledOperation operation) :
+		profiler_(profiler), module_(module), operation_(operation), buffer_bytes_(0), start_time_(profiler ? ModuleProfiler::Now() : 0)
+	{
+	}
+
+	void AddBufferBytes(double buffer_bytes)
+	{
+		buffer_bytes_ += buffer_bytes;
+	}
+
+	~ProfiledScope()
+	{
+		if (profiler_)
+			profiler_->RecordOperation(module_.GetName(), module_.GetType(), operation_, ModuleProfiler::Now()-start_time_, buffer_bytes_);
+	}
+};
+
+#endif
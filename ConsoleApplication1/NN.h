@@ -5,6 +5,10 @@
 #include <vector>
 #include <memory>
 #include <algorithm>
+#include <map>
+#include <ostream>
+#include <functional>
+#include <stdexcept>
 #include "my_math.h"
 #include "CompositeModule.h"
 #include "CostModule.h"
@@ -14,6 +18,8 @@
 #include "ModuleFactory.h"
 #include "CostAndGradients.h"
 #include "MatrixOperations.h"
+#include "ThreadPool.h"
+#include "ModuleProfiler.h"
 
 template <class ParamsType>
 class NN
@@ -22,17 +28,90 @@ private:
 	size_t num_samples_in_buffer_;
 	std::shared_ptr< CompositeModule<ParamsType> > nn_module_;
 	std::vector<ParamsType> batch_gradients_;
+	// the parameters and the gradients of all the modules, the modules use them as views (see BindArena)
 	std::vector<ParamsType> gradients_;
 	std::vector<ParamsType> parameters_;
+	bool arena_bound_;
+
+	// state of a worker of the multi-threaded GetCost_. Each worker runs its own replica of nn_module_ 
+	// (worker 0 runs nn_module_ itself), so module buffers are never shared between threads
+	struct Worker
+	{
+		std::shared_ptr< CompositeModule<ParamsType> > module;
+		std::shared_ptr< Tensor<ParamsType> > input;
+		std::shared_ptr< Tensor<ParamsType> > expected_output;
+		std::shared_ptr< Tensor<ParamsType> > output_gradients;
+		// bprop of the replicas writes to gradients, the replica of worker 0 is the network itself and writes to gradients_
+		std::vector<ParamsType> gradients;
+		std::vector<ParamsType> batch_gradients;
+		double cost;
+		double weighted_num_samples;
+		size_t num_processed_batches;
+	};
+
+	size_t num_threads_;
+	std::shared_ptr<ThreadPool> thread_pool_;
+	std::vector< std::shared_ptr<Worker> > workers_;
+
+	std::shared_ptr<ModuleProfiler> profiler_;
+
+	// records the cost module of a call to the profiler of the network if it is profiled, and gives back
+	// the previous profiler of the cost module at the end of the call, so the cost module of the caller is not changed
+	class CostModuleProfilerScope
+	{
+		CostModule<ParamsType>& cost_module_;
+		std::shared_ptr<ModuleProfiler> previous_profiler_;
+
+		CostModuleProfilerScope(const CostModuleProfilerScope&);
+		CostModuleProfilerScope& operator=(const CostModuleProfilerScope&);
+
+	public:
+
+		CostModuleProfilerScope(CostModule<ParamsType>& cost_module, const std::shared_ptr<ModuleProfiler>& profiler) :
+			cost_module_(cost_module), previous_profiler_(cost_module.GetProfiler())
+		{
+			if (profiler)
+				cost_module_.SetProfiler(profiler);
+		}
+
+		~CostModuleProfilerScope()
+		{
+			cost_module_.SetProfiler(previous_profiler_);
+		}
+	};
+
+	void UpdateWorkers();
+
+	// moves the parameters of the modules to parameters_ and makes bprop write the gradients to gradients_. Done by the first call
+	// that reads or changes the parameters or computes the gradients, so a network that is loaded by IOBinary::load_mapped
+	// and only predicts keeps its parameters in the mapped file
+	void BindArena();
+
+	static void CopyToWorkerBuffer(const Tensor<ParamsType>& from, std::shared_ptr< Tensor<ParamsType> >& to);
 	
 	std::pair<double,double> GetCost_(ITrainDataset<ParamsType>& dataset, CostModule<ParamsType>& cost_module, std::vector<size_t>& indices, 
 												  bool train_mode, bool with_bprop, bool with_regularization, double cost_module_lambda);
 
+	std::pair<double,double> GetCostParallel_(ITrainDataset<ParamsType>& dataset, CostModule<ParamsType>& cost_module, std::vector<size_t>& indices, 
+												  bool train_mode, bool with_bprop, bool with_regularization, double cost_module_lambda);
+
 public:
 
+	// receives the index (in the indices) of the first sample of the batch and the output buffers of the modules for the batch
+	typedef std::function<void (size_t first_sample, const std::vector< std::shared_ptr< Tensor<ParamsType> > >& batch_outputs)> PredictCallback;
+
 	virtual std::vector< std::shared_ptr< Tensor<ParamsType> > > Predict(
 		ITensorDataLoader<ParamsType>& loader, std::vector<size_t>& indices = std::vector<size_t>(), std::string output_module_name = "");
 
+	// Predicts the samples in minibatches and passes the outputs of the modules ("" is the last module) to the callback without copying them.
+	// The outputs of all the modules are computed by one pass, the buffers are owned by the modules and are valid only during the call.
+	// Empty indices select all the samples of the loader
+	void Predict(ITensorDataLoader<ParamsType>& loader, const std::vector<size_t>& indices, const std::vector<std::string>& output_module_names, 
+		const PredictCallback& callback);
+
+	// writes the outputs of the samples one after another to the output, which is resized to the number of the samples times the size of a sample output
+	void Predict(ITensorDataLoader<ParamsType>& loader, const std::vector<size_t>& indices, std::vector<ParamsType>& output, std::string output_module_name = "");
+
 	double GetCost(ITrainDataset<ParamsType>& dataset, CostModule<ParamsType>& cost_module, 
 		std::vector<size_t>& indices, bool train_mode, bool with_regularization = false, double cost_module_lambda=1);
 
@@ -46,9 +125,70 @@ public:
 		return num_samples_in_buffer_;
 	}
 
+	// number of threads used by GetCost and GetGradientsAndCost. With several threads the samples are split 
+	// into batches of at most GetMinibatchSize() samples that are processed concurrently by replicas of the network.
+	// The replicas get the current parameters and train time state of the modules at each call, but the train time state 
+	// (e.g. statistics of MeanStdNormalizingModule) is updated only in the network itself, by the batches of the first thread
+	void SetNumThreads(size_t num_threads)
+	{
+		assert(num_threads > 0);
+		if (num_threads != num_threads_)
+		{
+			num_threads_ = num_threads;
+			workers_.clear();
+			thread_pool_.reset();
+		}
+	}
+
+	size_t GetNumThreads() const
+	{
+		return num_threads_;
+	}
+
+	// records the time, the number of calls, the bytes of the buffers and the buffer allocations of fprop and bprop 
+	// of each module (by the module name), and of GetCost and bprop of the cost modules passed to GetCost 
+	// and GetGradientsAndCost (as "cost_module"). Has no effect if NNLIB_NO_PROFILING is defined
+	void SetProfiling(bool enabled)
+	{
+		if (enabled == GetProfiling())
+			return;
+		profiler_ = enabled ? std::shared_ptr<ModuleProfiler>( new ModuleProfiler() ) : std::shared_ptr<ModuleProfiler>();
+		for (size_t worker_ind = 1; worker_ind<workers_.size(); worker_ind++)
+			workers_[worker_ind]->module->SetProfiler(profiler_);
+		nn_module_->SetProfiler(profiler_);
+	}
+
+	bool GetProfiling() const
+	{
+		return profiler_ != nullptr;
+	}
+
+	// statistics by the module names, empty if the profiling is off
+	std::map<std::string, ModuleProfile> GetProfile() const
+	{
+		return profiler_ ? profiler_->GetProfiles() : std::map<std::string, ModuleProfile>();
+	}
+
+	void ResetProfile()
+	{
+		if (profiler_)
+			profiler_->Reset();
+	}
+
+	void WriteProfileReport(std::ostream& out) const
+	{
+		if (profiler_)
+			profiler_->WriteReport(out);
+	}
+
 	CostAndGradients<ParamsType> GetGradientsAndCost(ITrainDataset<ParamsType>& dataset, CostModule<ParamsType>& cost_module, 
 		std::vector<size_t>& indices = std::vector<size_t>(), bool with_regularization = false, double cost_module_lambda=1);
 
+	// throws if the gradients of the cost module do not match the output module of the network: the cost module is fused with
+	// another module, or the output module is fused and the cost module is not (see CostModule::GetFusedModule).
+	// Called by the training calls, the trainers that compute the gradients themselves call it before the training
+	void CheckCostModuleFusion(const CostModule<ParamsType>& cost_module) const;
+
 	size_t GetNumParams()
 	{
 		return nn_module_->GetNumParams();
@@ -63,12 +203,19 @@ public:
 		nn_module_->InitializeParameters();
 	}
 
+	// the modules use the parameters and the gradients of the NN after the first training step or access to the parameters,
+	// so they can not be used after the NN is destroyed
 	NN(std::shared_ptr< CompositeModule<ParamsType> >& nn_module, size_t num_samples_in_buffer = 1000);
 	
+	std::shared_ptr< CompositeModule<ParamsType> > GetCompositeModule() const
+	{
+		return nn_module_;
+	}
+
+	// the parameters used by the modules, changing them changes the network
 	std::vector<ParamsType>& GetParameters()
 	{
-		parameters_.clear();
-		nn_module_->GetParameters(parameters_);
+		BindArena();
 		return parameters_;
 	}
 
@@ -111,6 +258,15 @@ std::pair<double,double> NN<ParamsType>::GetCost_(ITrainDataset<ParamsType>& dat
 {
 	assert( train_mode || !with_bprop ); // cannot bprop in predict mode
 
+	CostModuleProfilerScope cost_module_profiler_scope(cost_module, profiler_);
+	if (with_bprop)
+	{
+		CheckCostModuleFusion(cost_module);
+		BindArena();
+	}
+	if (num_threads_ > 1)
+		return GetCostParallel_(dataset, cost_module, indices, train_mode, with_bprop, with_regularization, cost_module_lambda);
+
 	std::vector<size_t> batch_sizes = GetBatchSizes(indices.size(), num_samples_in_buffer_);
 	size_t num_batches = batch_sizes.size();
 	double weighted_num_samples = 0;
@@ -129,24 +285,29 @@ std::pair<double,double> NN<ParamsType>::GetCost_(ITrainDataset<ParamsType>& dat
 		weighted_num_samples += std::accumulate(importance.begin(),importance.end(),0);
 		std::shared_ptr< Tensor<ParamsType> > output = ( train_mode ? nn_module_->train_fprop(input) : nn_module_->predict_fprop(input));
 
-		cost += cost_module_lambda*cost_module.GetCost(*output, *expected_output, importance, false,1);
+		std::shared_ptr< Tensor<ParamsType> > gradient_buffer;
+		if (with_bprop)
+		{
+			std::pair< double, std::shared_ptr< Tensor<ParamsType> > > cost_and_gradients = 
+				cost_module.GetCostAndGradients(*output, *expected_output, importance, false, cost_module_lambda);
+			cost += cost_and_gradients.first;
+			gradient_buffer = cost_and_gradients.second;
+		}
+		else
+			cost += cost_module_lambda*cost_module.GetCost(*output, *expected_output, importance, false,1);
 		if (with_regularization)
 			cost+=nn_module_->GetCost(importance);
 		if (with_bprop)
 		{
-			std::shared_ptr< Tensor<ParamsType> > gradient_buffer = cost_module.bprop(*output, *expected_output, importance, false,cost_module_lambda);
-			nn_module_->bprop(gradient_buffer, importance);
+			// the first batch writes its gradients to gradients_, the others to batch_gradients_ that are added to them
 			if ( batch_ind == 0 )
-			{
-				gradients_.clear();
-				gradients_.reserve(nn_module_->GetNumParams());
-				nn_module_->GetGradients(gradients_);
-			}
+				nn_module_->bprop(gradient_buffer, importance);
 			else
 			{
-				batch_gradients_.clear();
-				nn_module_->GetGradients(batch_gradients_);
-				gradients_.resize(batch_gradients_.size());
+				batch_gradients_.resize(gradients_.size());
+				nn_module_->BindGradients(batch_gradients_.data());
+				nn_module_->bprop(gradient_buffer, importance);
+				nn_module_->BindGradients(gradients_.data());
 				axpy<ParamsType>(batch_gradients_.data(), gradients_.data(), batch_gradients_.size(), 1);
 			}
 		}
@@ -163,51 +324,247 @@ std::pair<double,double> NN<ParamsType>::GetCost_(ITrainDataset<ParamsType>& dat
 }
 
 template <class ParamsType>
-std::vector< std::shared_ptr< Tensor<ParamsType> > > NN<ParamsType>::Predict(
-	ITensorDataLoader<ParamsType>& loader, std::vector<size_t>& indices, std::string output_module_name)
+void NN<ParamsType>::CopyToWorkerBuffer(const Tensor<ParamsType>& from, std::shared_ptr< Tensor<ParamsType> >& to)
 {
-	
-	if ( output_module_name == "" )
-		output_module_name = nn_module_->GetModule( nn_module_->NumModules()-1 )->GetName();
-	std::shared_ptr< Module<ParamsType> > output_module = nn_module_->GetModule(output_module_name);
+	if (!to || !to->DimensionsEqual(from))
+		to = std::shared_ptr< Tensor<ParamsType> >( new Tensor<ParamsType>(from.GetShape()) );
+	CopyTensorElements(from, to->GetStartPtr());
+}
 
-	if (indices.size() == 0)
+template <class ParamsType>
+void NN<ParamsType>::UpdateWorkers()
+{
+	if (!thread_pool_)
+		thread_pool_ = std::shared_ptr<ThreadPool>( new ThreadPool(num_threads_) );
+
+	// the replicas use the parameters of the network, so they get the changes without copying
+	BindArena();
+	if (workers_.empty())
 	{
-		size_t test_numel = loader.GetNumSamples();
-		for (size_t i=0; i<test_numel; i++)
-			indices.push_back(i);
+		std::shared_ptr<IOTreeNode> nn_module_state = nn_module_->GetState();
+		for (size_t worker_ind = 0; worker_ind<num_threads_; worker_ind++)
+		{
+			std::shared_ptr<Worker> worker( new Worker() );
+			if (worker_ind == 0)
+				worker->module = nn_module_;
+			else
+			{
+				worker->module = std::static_pointer_cast< CompositeModule<ParamsType> >(ModuleFactory::GetModule<ParamsType>( *nn_module_state ));
+				worker->module->SetProfiler(profiler_);
+				worker->module->BindParameters(parameters_.data());
+				worker->gradients.resize(parameters_.size());
+				worker->module->BindGradients(worker->gradients.data());
+			}
+			workers_.push_back(worker);
+		}
 	}
-	std::vector< std::shared_ptr< Tensor<ParamsType> > > output(indices.size());
 
-	std::vector<size_t> batch_sizes = GetBatchSizes(indices.size(), num_samples_in_buffer_);
+	for (size_t worker_ind = 1; worker_ind<workers_.size(); worker_ind++)
+		workers_[worker_ind]->module->CopyTrainState(*nn_module_);
+}
+
+template <class ParamsType>
+void NN<ParamsType>::CheckCostModuleFusion(const CostModule<ParamsType>& cost_module) const
+{
+	const Module<ParamsType>* fused_module = cost_module.GetFusedModule();
+	const Module<ParamsType>* output_module = nn_module_->NumModules() > 0 ? nn_module_->GetModule(nn_module_->NumModules()-1).get() : 0;
+	bool output_fused = output_module && output_module->IsFusedWithCost();
+	if (output_fused ? fused_module != output_module : fused_module != 0)
+		throw std::runtime_error("NN: the cost module and the output module of the network are not fused with each other");
+}
+
+template <class ParamsType>
+void NN<ParamsType>::BindArena()
+{
+	if (arena_bound_)
+		return;
+	parameters_.clear();
+	parameters_.reserve(nn_module_->GetNumParams());
+	nn_module_->GetParameters(parameters_);
+	gradients_.assign(parameters_.size(), 0);
+	nn_module_->BindParameters(parameters_.data());
+	nn_module_->BindGradients(gradients_.data());
+	arena_bound_ = true;
+}
+
+template <class ParamsType>
+std::pair<double,double> NN<ParamsType>::GetCostParallel_(ITrainDataset<ParamsType>& dataset, CostModule<ParamsType>& cost_module, std::vector<size_t>& indices, 
+												  bool train_mode, bool with_bprop, bool with_regularization, double cost_module_lambda)
+{
+	UpdateWorkers();
+	size_t num_workers = workers_.size();
+
+	// batches are made smaller than num_samples_in_buffer_ if it is needed to give samples to every worker
+	size_t batch_size = std::min(num_samples_in_buffer_, (indices.size()+num_workers-1)/num_workers);
+	std::vector<size_t> batch_sizes = GetBatchSizes(indices.size(), batch_size);
 	size_t num_batches = batch_sizes.size();
+	std::vector<size_t> batch_offsets(num_batches, 0);
+	for (size_t batch_ind = 1; batch_ind<num_batches; batch_ind++)
+		batch_offsets[batch_ind] = batch_offsets[batch_ind-1] + batch_sizes[batch_ind-1];
+
+	// data loaders return their internal buffers and cost modules store gradients in their own buffer,
+	// so they are used by one worker at a time and the results are copied to the worker's buffers
+	std::mutex shared_objects_mutex;
+	
+	thread_pool_->Run( [&](size_t worker_ind)
+	{
+		Worker& worker = *workers_[worker_ind];
+		worker.cost = 0;
+		worker.weighted_num_samples = 0;
+		worker.num_processed_batches = 0;
+		for (size_t batch_ind = worker_ind; batch_ind<num_batches; batch_ind += num_workers)
+		{
+			std::vector<size_t> batch_indices(batch_sizes[batch_ind]);
+			for (size_t i=0; i<batch_sizes[batch_ind]; i++)
+				batch_indices[i]=indices[batch_offsets[batch_ind]+i];
+
+			std::vector<ParamsType> importance;
+			{
+				std::lock_guard<std::mutex> lock(shared_objects_mutex);
+				CopyToWorkerBuffer(*dataset.GetInput(batch_indices), worker.input);
+				CopyToWorkerBuffer(*dataset.GetOutput(batch_indices), worker.expected_output);
+				importance = dataset.GetImportance(batch_indices);
+			}
+
+			worker.weighted_num_samples += std::accumulate(importance.begin(),importance.end(),0);
+			std::shared_ptr< Tensor<ParamsType> > output = ( train_mode ? worker.module->train_fprop(worker.input) : worker.module->predict_fprop(worker.input));
+
+			{
+				std::lock_guard<std::mutex> lock(shared_objects_mutex);
+				if (with_bprop)
+				{
+					std::pair< double, std::shared_ptr< Tensor<ParamsType> > > cost_and_gradients = 
+						cost_module.GetCostAndGradients(*output, *worker.expected_output, importance, false, cost_module_lambda);
+					worker.cost += cost_and_gradients.first;
+					CopyToWorkerBuffer(*cost_and_gradients.second, worker.output_gradients);
+				}
+				else
+					worker.cost += cost_module_lambda*cost_module.GetCost(*output, *worker.expected_output, importance, false,1);
+			}
+			if (with_regularization)
+				worker.cost += worker.module->GetCost(importance);
+			if (with_bprop)
+			{
+				if ( worker.num_processed_batches == 0 )
+					worker.module->bprop(worker.output_gradients, importance);
+				else
+				{
+					std::vector<ParamsType>& gradients = (worker_ind == 0) ? gradients_ : worker.gradients;
+					worker.batch_gradients.resize(gradients.size());
+					worker.module->BindGradients(worker.batch_gradients.data());
+					worker.module->bprop(worker.output_gradients, importance);
+					worker.module->BindGradients(gradients.data());
+					axpy<ParamsType>(worker.batch_gradients.data(), gradients.data(), gradients.size(), 1);
+				}
+			}
+			worker.num_processed_batches++;
+		}
+	});
+
 	double weighted_num_samples = 0;
 	double cost = 0;
-	size_t offset = 0;
-	for (size_t batch_ind = 0; batch_ind<num_batches; batch_ind++)
+	for (size_t worker_ind = 0; worker_ind<num_workers; worker_ind++)
 	{
-		std::vector<size_t> batch_indices(batch_sizes[batch_ind]);
-		for (size_t i=0; i<batch_sizes[batch_ind]; i++)
-			batch_indices[i]=indices[offset+i];
+		Worker& worker = *workers_[worker_ind];
+		if (worker.num_processed_batches == 0)
+			continue;
+		weighted_num_samples += worker.weighted_num_samples;
+		cost += worker.cost;
+		if (with_bprop && worker_ind > 0)
+			axpy<ParamsType>(worker.gradients.data(), gradients_.data(), worker.gradients.size(), 1);
+	}
 
-		std::shared_ptr< Tensor<ParamsType> > input = loader.GetData(batch_indices);
-		nn_module_->predict_fprop(input);
-			
-		std::shared_ptr< Tensor<ParamsType> > batch_output = output_module->GetOutputBuffer();
+	if (with_bprop)
+	{
+		ParamsType normalizer = static_cast<ParamsType>(1/weighted_num_samples);
+		scale<ParamsType>(gradients_.data(), gradients_.size(), normalizer);
+	}
 
-		std::vector<size_t> per_case_output_dims = batch_output->GetDimensions();
-		per_case_output_dims.pop_back();
-		size_t per_case_num_elements = batch_output->Numel() / batch_sizes[batch_ind];
-		for (size_t i=0; i<batch_sizes[batch_ind]; i++)
-		{
-			std::shared_ptr< Tensor<ParamsType> > sample_output( new Tensor<ParamsType>(per_case_output_dims));
-			for (size_t feature_ind = 0; feature_ind<per_case_num_elements; feature_ind++)
-				(*sample_output)[feature_ind] = (*batch_output)[i*per_case_num_elements+feature_ind];
-			output[offset+i] = sample_output;
-		}
+	return std::make_pair(cost / weighted_num_samples, weighted_num_samples);
+}
+
+template <class ParamsType>
+void NN<ParamsType>::Predict(ITensorDataLoader<ParamsType>& loader, const std::vector<size_t>& indices, 
+	const std::vector<std::string>& output_module_names, const PredictCallback& callback)
+{
+	std::vector< std::shared_ptr< Module<ParamsType> > > output_modules;
+	for (size_t i=0; i<output_module_names.size(); i++)
+	{
+		std::string output_module_name = output_module_names[i];
+		if ( output_module_name == "" )
+			output_module_name = nn_module_->GetModule( nn_module_->NumModules()-1 )->GetName();
+		output_modules.push_back( nn_module_->GetModule(output_module_name) );
+		// outputs of inner modules share memory with other buffers
+		nn_module_->RetainOutputBuffer(output_module_name);
+	}
 
+	std::vector<size_t> all_indices;
+	if (indices.empty())
+	{
+		all_indices.resize(loader.GetNumSamples());
+		for (size_t i=0; i<all_indices.size(); i++)
+			all_indices[i] = i;
+	}
+	const std::vector<size_t>& sample_indices = indices.empty() ? all_indices : indices;
+
+	std::vector<size_t> batch_sizes = GetBatchSizes(sample_indices.size(), num_samples_in_buffer_);
+	std::vector<size_t> batch_indices;
+	std::vector< std::shared_ptr< Tensor<ParamsType> > > batch_outputs(output_modules.size());
+	size_t offset = 0;
+	for (size_t batch_ind = 0; batch_ind<batch_sizes.size(); batch_ind++)
+	{
+		batch_indices.assign(sample_indices.begin() + offset, sample_indices.begin() + offset + batch_sizes[batch_ind]);
+		nn_module_->predict_fprop( loader.GetData(batch_indices) );
+		for (size_t i=0; i<output_modules.size(); i++)
+			batch_outputs[i] = output_modules[i]->GetOutputBuffer();
+		callback(offset, batch_outputs);
 		offset += batch_sizes[batch_ind];
 	}
+}
+
+template <class ParamsType>
+void NN<ParamsType>::Predict(ITensorDataLoader<ParamsType>& loader, const std::vector<size_t>& indices, std::vector<ParamsType>& output, 
+	std::string output_module_name)
+{
+	size_t num_samples = indices.empty() ? loader.GetNumSamples() : indices.size();
+	// the output is resized by the first batch, there is none without samples
+	output.clear();
+	Predict(loader, indices, std::vector<std::string>(1, output_module_name), [&](size_t first_sample, const std::vector< std::shared_ptr< Tensor<ParamsType> > >& batch_outputs)
+	{
+		const Tensor<ParamsType>& batch_output = *batch_outputs[0];
+		size_t batch_size = batch_output.GetDimensionSize(batch_output.NumDimensions()-1);
+		size_t per_case_numel = batch_output.Numel() / batch_size;
+		if (first_sample == 0)
+			output.resize(num_samples*per_case_numel);
+		CopyTensorElements(batch_output, output.data() + first_sample*per_case_numel);
+	});
+}
+
+template <class ParamsType>
+std::vector< std::shared_ptr< Tensor<ParamsType> > > NN<ParamsType>::Predict(
+	ITensorDataLoader<ParamsType>& loader, std::vector<size_t>& indices, std::string output_module_name)
+{
+	if (indices.size() == 0)
+	{
+		size_t test_numel = loader.GetNumSamples();
+		for (size_t i=0; i<test_numel; i++)
+			indices.push_back(i);
+	}
+	std::vector< std::shared_ptr< Tensor<ParamsType> > > output(indices.size());
+
+	Predict(loader, indices, std::vector<std::string>(1, output_module_name), [&](size_t first_sample, const std::vector< std::shared_ptr< Tensor<ParamsType> > >& batch_outputs)
+	{
+		Tensor<ParamsType>& batch_output = *batch_outputs[0];
+		size_t case_dim_ind = batch_output.NumDimensions()-1;
+		size_t batch_size = batch_output.GetDimensionSize(case_dim_ind);
+		for (size_t i=0; i<batch_size; i++)
+		{
+			Tensor<ParamsType> sample_view = batch_output.Select(case_dim_ind, i);
+			std::shared_ptr< Tensor<ParamsType> > sample_output( new Tensor<ParamsType>(sample_view.GetShape()));
+			CopyTensorElements(sample_view, sample_output->GetStartPtr());
+			output[first_sample+i] = sample_output;
+		}
+	});
 
 	return output;
 }
@@ -248,18 +605,20 @@ template <class ParamsType>
 void NN<ParamsType>::SetParameters(const std::vector<ParamsType>& parameters)
 {
 	assert(parameters.size() == nn_module_->GetNumParams());
-	nn_module_->SetParameters(parameters);
+	SetParameters(parameters.data());
 }
 
 template <class ParamsType>
 void NN<ParamsType>::SetParameters(const ParamsType* parameters)
 {
-	nn_module_->SetParameters(parameters);
+	BindArena();
+	if (parameters != parameters_.data())
+		std::copy(parameters, parameters + parameters_.size(), parameters_.begin());
 }
 
 template <class ParamsType>
 NN<ParamsType>::NN(std::shared_ptr< CompositeModule<ParamsType> >& nn_module, size_t num_samples_in_buffer) : 
-	nn_module_(nn_module), num_samples_in_buffer_(num_samples_in_buffer)
+	nn_module_(nn_module), num_samples_in_buffer_(num_samples_in_buffer), arena_bound_(false), num_threads_(1)
 {
 }
 
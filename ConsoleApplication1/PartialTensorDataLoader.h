@@ -8,8 +8,6 @@ class PartialTensorDataLoader : public BaseTensorDataLoader<OutputType, InputTyp
 {
 private:
 
-	mutable std::vector<size_t> sample_offsets_;
-
 	size_t GetSampleData( size_t sample_ind, const std::vector<size_t>& sample_left_offsets, 
 		const std::vector<size_t>& sample_right_offsets, Tensor<OutputType>& output_buffer, size_t output_buffer_offset) const;
 
@@ -26,8 +24,9 @@ public:
 		return BaseTensorDataLoader<OutputType, InputType>::Equals(data_loader);
 	}
 
+	// samples of the same dimensions are packed to the sample arena
 	PartialTensorDataLoader(const std::vector< std::shared_ptr< Tensor<InputType> > >& data, std::string name) : 
-		BaseTensorDataLoader<OutputType, InputType>(data, name)
+		BaseTensorDataLoader<OutputType, InputType>(data, name, true)
 	{
 
 	}
@@ -42,20 +41,16 @@ template <class OutputType, class InputType>
 size_t PartialTensorDataLoader<OutputType,InputType>::GetSampleData( size_t sample_ind, const std::vector<size_t>& sample_left_offsets, 
 	const std::vector<size_t>& sample_right_offsets, Tensor<OutputType>& output_buffer, size_t output_buffer_offset) const
 {
-	Tensor<InputType>& sample = GetSample(sample_ind);
-
-	// use tensor's method for valid positions selection
-	std::vector<size_t> strides(sample.Numel());
-	for (size_t i=0; i<strides.size(); i++)
-		strides[i] = 1;
-	sample_offsets_.clear();
-	Tensor<InputType>::GetValidOffsetsInds(sample_offsets_, sample.GetDimensions(), sample.GetStrides(), 
-											sample_left_offsets, sample_right_offsets, strides);
-		
-	for (size_t i=0; i<sample_offsets_.size(); i++)
-		output_buffer[output_buffer_offset+i] = static_cast<OutputType>(sample[sample_offsets_[i]]);
-		
-	return sample_offsets_.size();
+	std::vector<size_t> sample_dims = GetSampleDims(sample_ind);
+	std::vector<size_t> crop_dims(sample_dims.size());
+	for (size_t dim_ind = 0; dim_ind<sample_dims.size(); dim_ind++)
+		crop_dims[dim_ind] = sample_dims[dim_ind] - sample_left_offsets[dim_ind] - sample_right_offsets[dim_ind];
+
+	// the copied part is a view of the sample, the sample is only read
+	Tensor<InputType> sample(const_cast<InputType*>(GetSamplePtr(sample_ind)), sample_dims);
+	Tensor<InputType> crop = sample.Crop(sample_left_offsets, crop_dims);
+	CopyTensorElements(crop, output_buffer.GetStartPtr() + output_buffer_offset);
+	return crop.Numel();
 }
 
 template <class OutputType, class InputType>
@@ -0,0 +1,231 @@
+#ifndef PREFETCHING_TRAIN_DATASET_H
+#define PREFETCHING_TRAIN_DATASET_H
+
+#include <vector>
+#include <memory>
+#include <algorithm>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <exception>
+#include "TrainDataset.h"
+
+// Prepares minibatches of a dataset in a background thread, so that the trainer does not wait for the data loaders.
+// SelectIndices(batch_size) returns the indices of the next prepared minibatch, GetInput, GetOutput and GetImportance
+// for these indices (or for a part of them, as NN::GetCost_ splits minibatches that do not fit its buffers)
+// return the prepared data. The returned tensors stay valid until the next call of SelectIndices(batch_size).
+// Other requests are passed to the wrapped dataset.
+// Data loaders return their internal buffer, so the wrapped dataset is used by one thread at a time
+// and its results are copied to the ring of minibatches (num_prefetched_batches prepared minibatches and the one in use)
+template <class T>
+class PrefetchingTrainDataset : public ITrainDataset<T>
+{
+	struct Batch
+	{
+		std::vector<size_t> indices;
+		std::shared_ptr< Tensor<T> > input;
+		std::shared_ptr< Tensor<T> > output;
+		std::vector<T> importance;
+		std::exception_ptr exception;
+	};
+
+	std::shared_ptr< ITrainDataset<T> > dataset_;
+	size_t batch_size_;
+	std::vector<Batch> ring_;
+	// minibatches ring_[next_], ..., ring_[next_+num_ready_-1] are prepared, ring_[current_] is used by the trainer
+	size_t next_;
+	size_t num_ready_;
+	size_t current_;
+	bool has_current_;
+	bool stopped_;
+	std::mutex ring_mutex_;
+	std::condition_variable batch_ready_;
+	std::condition_variable slot_released_;
+	// guards dataset_ and the buffers of not prepared requests
+	std::mutex dataset_mutex_;
+	std::shared_ptr< Tensor<T> > input_buffer_;
+	std::shared_ptr< Tensor<T> > output_buffer_;
+	std::thread thread_;
+
+	static void CopyToBuffer(const Tensor<T>& from, std::shared_ptr< Tensor<T> >& to)
+	{
+		if (!to || !to->DimensionsEqual(from))
+			to = std::shared_ptr< Tensor<T> >( new Tensor<T>(from.GetShape()) );
+		CopyTensorElements(from, to->GetStartPtr());
+	}
+
+	void PrepareBatch(Batch& batch)
+	{
+		try
+		{
+			std::lock_guard<std::mutex> lock(dataset_mutex_);
+			batch.indices = dataset_->SelectIndices(batch_size_);
+			CopyToBuffer(*dataset_->GetInput(batch.indices), batch.input);
+			CopyToBuffer(*dataset_->GetOutput(batch.indices), batch.output);
+			batch.importance = dataset_->GetImportance(batch.indices);
+			batch.exception = std::exception_ptr();
+		}
+		catch (...)
+		{
+			batch.exception = std::current_exception();
+		}
+	}
+
+	void PrefetchLoop()
+	{
+		while (true)
+		{
+			size_t slot;
+			{
+				std::unique_lock<std::mutex> lock(ring_mutex_);
+				while (!stopped_ && num_ready_ + (has_current_ ? 1 : 0) == ring_.size())
+					slot_released_.wait(lock);
+				if (stopped_)
+					return;
+				slot = (next_ + num_ready_) % ring_.size();
+			}
+			// the slot is not visible to the trainer until it is marked as ready
+			PrepareBatch(ring_[slot]);
+			{
+				std::lock_guard<std::mutex> lock(ring_mutex_);
+				num_ready_++;
+			}
+			batch_ready_.notify_all();
+		}
+	}
+
+	// position of samples_inds in the current minibatch, ring_mutex_ should be locked
+	bool FindInCurrentBatch(const std::vector<size_t>& samples_inds, size_t& offset) const
+	{
+		if (!has_current_ || samples_inds.empty())
+			return false;
+		const std::vector<size_t>& batch_indices = ring_[current_].indices;
+		std::vector<size_t>::const_iterator part = std::search(batch_indices.begin(), batch_indices.end(), samples_inds.begin(), samples_inds.end());
+		if (part == batch_indices.end())
+			return false;
+		offset = part - batch_indices.begin();
+		return true;
+	}
+
+	// prepared data for samples_inds if they are a part of the current minibatch, 0 otherwise
+	std::shared_ptr< Tensor<T> > GetPreparedData(const std::vector<size_t>& samples_inds, std::shared_ptr< Tensor<T> > Batch::* data)
+	{
+		std::lock_guard<std::mutex> lock(ring_mutex_);
+		size_t offset;
+		if (!FindInCurrentBatch(samples_inds, offset))
+			return std::shared_ptr< Tensor<T> >();
+		const Batch& batch = ring_[current_];
+		const std::shared_ptr< Tensor<T> >& batch_data = batch.*data;
+		if (samples_inds.size() == batch.indices.size())
+			return batch_data;
+		// a part of the minibatch is a view of its samples, if the last dimension corresponds to the samples
+		const TensorShape& dims = batch_data->GetShape();
+		if (dims.empty() || dims.back() != batch.indices.size())
+			return std::shared_ptr< Tensor<T> >();
+		return std::shared_ptr< Tensor<T> >( new Tensor<T>(batch_data->Slice(dims.size()-1, offset, samples_inds.size())) );
+	}
+
+	PrefetchingTrainDataset(const PrefetchingTrainDataset&);
+	PrefetchingTrainDataset& operator=(const PrefetchingTrainDataset&);
+public:
+
+	// minibatches of batch_size samples are prepared, num_prefetched_batches of them ahead of the trainer
+	PrefetchingTrainDataset(std::shared_ptr< ITrainDataset<T> > dataset, size_t batch_size, size_t num_prefetched_batches = 2) :
+		dataset_(dataset), batch_size_(batch_size), ring_(num_prefetched_batches+1), next_(0), num_ready_(0), current_(0),
+		has_current_(false), stopped_(false)
+	{
+		assert( num_prefetched_batches > 0 );
+		thread_ = std::thread(&PrefetchingTrainDataset<T>::PrefetchLoop, this);
+	}
+
+	~PrefetchingTrainDataset()
+	{
+		{
+			std::lock_guard<std::mutex> lock(ring_mutex_);
+			stopped_ = true;
+		}
+		slot_released_.notify_all();
+		thread_.join();
+	}
+
+	size_t GetBatchSize() const
+	{
+		return batch_size_;
+	}
+
+	// releases the current minibatch and returns the indices of the next one
+	virtual std::vector<size_t> SelectIndices(size_t num_samples)
+	{
+		if (num_samples != batch_size_)
+		{
+			std::lock_guard<std::mutex> lock(dataset_mutex_);
+			return dataset_->SelectIndices(num_samples);
+		}
+
+		std::exception_ptr exception;
+		{
+			std::unique_lock<std::mutex> lock(ring_mutex_);
+			has_current_ = false;
+			slot_released_.notify_all();
+			while (num_ready_ == 0)
+				batch_ready_.wait(lock);
+			current_ = next_;
+			next_ = (next_+1) % ring_.size();
+			num_ready_--;
+			exception = ring_[current_].exception;
+			has_current_ = !exception;
+		}
+		if (exception)
+		{
+			slot_released_.notify_all();
+			std::rethrow_exception(exception);
+		}
+		return ring_[current_].indices;
+	}
+
+	virtual std::shared_ptr< Tensor<T> > GetInput(std::vector<size_t>& samples_inds)
+	{
+		std::shared_ptr< Tensor<T> > prepared = GetPreparedData(samples_inds, &Batch::input);
+		if (prepared)
+			return prepared;
+		std::lock_guard<std::mutex> lock(dataset_mutex_);
+		CopyToBuffer(*dataset_->GetInput(samples_inds), input_buffer_);
+		return input_buffer_;
+	}
+
+	virtual std::shared_ptr< Tensor<T> > GetOutput(std::vector<size_t>& samples_inds)
+	{
+		std::shared_ptr< Tensor<T> > prepared = GetPreparedData(samples_inds, &Batch::output);
+		if (prepared)
+			return prepared;
+		std::lock_guard<std::mutex> lock(dataset_mutex_);
+		CopyToBuffer(*dataset_->GetOutput(samples_inds), output_buffer_);
+		return output_buffer_;
+	}
+
+	virtual std::vector<T> GetImportance(std::vector<size_t>& samples_inds)
+	{
+		{
+			std::lock_guard<std::mutex> lock(ring_mutex_);
+			size_t offset;
+			if (FindInCurrentBatch(samples_inds, offset))
+			{
+				const Batch& batch = ring_[current_];
+				if (samples_inds.size() == batch.indices.size())
+					return batch.importance;
+				if (batch.importance.size() == batch.indices.size())
+					return std::vector<T>(batch.importance.begin()+offset, batch.importance.begin()+offset+samples_inds.size());
+			}
+		}
+		std::lock_guard<std::mutex> lock(dataset_mutex_);
+		return dataset_->GetImportance(samples_inds);
+	}
+
+	virtual size_t GetNumSamples()
+	{
+		std::lock_guard<std::mutex> lock(dataset_mutex_);
+		return dataset_->GetNumSamples();
+	}
+};
+
+#endif
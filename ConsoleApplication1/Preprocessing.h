@@ -4,8 +4,10 @@
 #include <algorithm>
 #include <numeric>
 #include <math.h>
+#include <stdexcept>
 #include "Utilities.h"
 #include "Tensor.h"
+#include "ThreadPool.h"
 #include "exports.h"
 
 template <class T>
@@ -35,15 +37,203 @@ void RandomShuffleVector(std::vector<T>& v1)
 	std::random_shuffle ( v1.begin(), v1.end() );
 }
 
-//returns the mean
+// Mean and variance of each feature, accumulated sample by sample in one pass with Welford's algorithm, so the variance
+// does not lose precision when the means are large. The statistics of disjoint sets of samples (the chunks of a stream,
+// the parts of the threads) are combined by Merge, the result does not depend on the size of the chunks up to rounding
+class FeatureStatistics
+{
+	size_t num_samples_;
+	std::vector<double> means_;
+	// the sums of the squared deviations from the means
+	std::vector<double> squared_deviations_;
+
+public:
+
+	explicit FeatureStatistics(size_t num_features = 0) : num_samples_(0), means_(num_features, 0), squared_deviations_(num_features, 0)
+	{
+
+	}
+
+	size_t GetNumFeatures() const
+	{
+		return means_.size();
+	}
+
+	size_t GetNumSamples() const
+	{
+		return num_samples_;
+	}
+
+	template <class T>
+	void AddSample(const T* sample)
+	{
+		num_samples_++;
+		double inverse_num_samples = 1.0 / num_samples_;
+		double* means = means_.data();
+		double* squared_deviations = squared_deviations_.data();
+		for (size_t i=0; i<means_.size(); i++)
+		{
+			double delta = sample[i] - means[i];
+			means[i] += delta * inverse_num_samples;
+			squared_deviations[i] += delta * (sample[i] - means[i]);
+		}
+	}
+
+	// the samples are the rows of a row-major matrix, the features of a row start at the row and the rows are sample_stride apart
+	// (e.g. a chunk of CsvReader with the label column skipped)
+	template <class T>
+	void AddSamples(const T* samples, size_t num_samples, size_t sample_stride)
+	{
+		for (size_t sample_ind=0; sample_ind<num_samples; sample_ind++)
+			AddSample(samples + sample_ind*sample_stride);
+	}
+
+	void Merge(const FeatureStatistics& statistics)
+	{
+		if (statistics.GetNumFeatures() != GetNumFeatures())
+			throw std::runtime_error("FeatureStatistics: can not merge the statistics of different numbers of the features");
+		if (statistics.num_samples_ == 0)
+			return;
+		double num_samples = static_cast<double>(num_samples_ + statistics.num_samples_);
+		double weight = statistics.num_samples_ / num_samples;
+		double deviations_weight = static_cast<double>(num_samples_) * statistics.num_samples_ / num_samples;
+		for (size_t i=0; i<means_.size(); i++)
+		{
+			double delta = statistics.means_[i] - means_[i];
+			means_[i] += delta * weight;
+			squared_deviations_[i] += statistics.squared_deviations_[i] + delta * delta * deviations_weight;
+		}
+		num_samples_ += statistics.num_samples_;
+	}
+
+	double GetMean(size_t feature_ind) const
+	{
+		return means_[feature_ind];
+	}
+
+	// the variance of the population (divided by the number of the samples)
+	double GetVariance(size_t feature_ind) const
+	{
+		return num_samples_ > 0 ? squared_deviations_[feature_ind] / num_samples_ : 0;
+	}
+
+	template <class T>
+	Tensor<T> GetMeans(const std::vector<size_t>& dims) const
+	{
+		Tensor<T> means(dims);
+		for (size_t i=0; i<means.Numel(); i++)
+			means[i] = static_cast<T>(means_[i]);
+		return means;
+	}
+
+	// sqrt(variance)+epsilon, so that the constant features can be divided by the std
+	template <class T>
+	Tensor<T> GetStds(const std::vector<size_t>& dims, double epsilon = 0.0000000001) const
+	{
+		Tensor<T> stds(dims);
+		for (size_t i=0; i<stds.Numel(); i++)
+			stds[i] = static_cast<T>( std::sqrt(GetVariance(i)) + epsilon );
+		return stds;
+	}
+};
+
+// Calls function(part_ind, first_sample, end_sample) for the parts of [0, num_samples) split between num_threads threads.
+// The parts are contiguous and in the order of the threads, so the results merged in that order are deterministic
+template <class Function>
+void ParallelForSamples(size_t num_samples, size_t num_threads, Function function)
+{
+	num_threads = std::max<size_t>( std::min(num_threads, num_samples), 1 );
+	if (num_threads == 1)
+	{
+		function(0, 0, num_samples);
+		return;
+	}
+	ThreadPool thread_pool(num_threads);
+	thread_pool.Run( [&](size_t worker_ind)
+	{
+		function(worker_ind, num_samples*worker_ind/num_threads, num_samples*(worker_ind+1)/num_threads);
+	});
+}
+
+// the statistics of the features of the samples, each thread accumulates its part of the samples and the parts are merged
+template <class T>
+FeatureStatistics ComputeFeatureStatistics(const T* const* samples, size_t num_samples, size_t num_features, size_t num_threads = 1)
+{
+	size_t num_parts = std::max<size_t>( std::min(num_threads, num_samples), 1 );
+	std::vector<FeatureStatistics> parts_statistics(num_parts, FeatureStatistics(num_features));
+	ParallelForSamples(num_samples, num_parts, [&](size_t part_ind, size_t first_sample, size_t end_sample)
+	{
+		FeatureStatistics& statistics = parts_statistics[part_ind];
+		for (size_t sample_ind=first_sample; sample_ind<end_sample; sample_ind++)
+			statistics.AddSample(samples[sample_ind]);
+	});
+	for (size_t part_ind=1; part_ind<num_parts; part_ind++)
+		parts_statistics[0].Merge(parts_statistics[part_ind]);
+	return parts_statistics[0];
+}
+
+template <class T>
+FeatureStatistics ComputeFeatureStatistics(const std::vector< std::shared_ptr< Tensor<T> > >& tensors, size_t num_threads = 1)
+{
+	std::vector<const T*> samples(tensors.size());
+	for (size_t i=0; i<tensors.size(); i++)
+		samples[i] = tensors[i]->GetStartPtr();
+	return ComputeFeatureStatistics(samples.data(), samples.size(), tensors.empty() ? 0 : tensors[0]->Numel(), num_threads);
+}
+
+// x = (x-shifts)*scales for each feature of each sample, in parallel over the samples
+template <class T>
+void ShiftAndScaleFeatures(T* const* samples, size_t num_samples, size_t num_features, const T* shifts, const T* scales, size_t num_threads = 1)
+{
+	ParallelForSamples(num_samples, num_threads, [&](size_t part_ind, size_t first_sample, size_t end_sample)
+	{
+		for (size_t sample_ind=first_sample; sample_ind<end_sample; sample_ind++)
+		{
+			T* sample = samples[sample_ind];
+			for (size_t i=0; i<num_features; i++)
+				sample[i] = (sample[i] - shifts[i]) * scales[i];
+		}
+	});
+}
+
+// x = (x-means)/stds for each sample
+template <class T>
+void NormalizeFeatures(T* const* samples, size_t num_samples, const Tensor<T>& means, const Tensor<T>& stds, size_t num_threads = 1)
+{
+	std::vector<T> inverse_stds(stds.Numel());
+	for (size_t i=0; i<inverse_stds.size(); i++)
+		inverse_stds[i] = 1 / stds[i];
+	ShiftAndScaleFeatures(samples, num_samples, means.Numel(), means.GetStartPtr(), inverse_stds.data(), num_threads);
+}
+
+// the samples are the rows of a row-major matrix that are sample_stride apart
+template <class T>
+void NormalizeFeatures(T* samples, size_t num_samples, size_t sample_stride, const Tensor<T>& means, const Tensor<T>& stds, size_t num_threads = 1)
+{
+	std::vector<T*> samples_ptrs(num_samples);
+	for (size_t i=0; i<num_samples; i++)
+		samples_ptrs[i] = samples + i*sample_stride;
+	NormalizeFeatures(samples_ptrs.data(), num_samples, means, stds, num_threads);
+}
+
+template <class T>
+void NormalizeFeatures(std::vector< std::shared_ptr< Tensor<T> > >& tensors, const Tensor<T>& means, const Tensor<T>& stds, size_t num_threads = 1)
+{
+	std::vector<T*> samples(tensors.size());
+	for (size_t i=0; i<tensors.size(); i++)
+		samples[i] = tensors[i]->GetStartPtr();
+	NormalizeFeatures(samples.data(), samples.size(), means, stds, num_threads);
+}
+
 template <class T>
 void SubtractMean(std::vector< std::shared_ptr< Tensor<T> > >& tensors, double mean)
 {
 	for (size_t i=0; i<tensors.size(); i++)
 	{
-		auto& tensor = *tensors[i];
-		for (size_t j=0; j<tensor.Numel(); j++)
-			(*tensors[i])[j] -= mean;
+		T* tensor_data = tensors[i]->GetStartPtr();
+		size_t numel = tensors[i]->Numel();
+		for (size_t j=0; j<numel; j++)
+			tensor_data[j] -= static_cast<T>(mean);
 	}
 }
 
@@ -66,11 +256,13 @@ double GetSameMean(std::vector< std::shared_ptr< Tensor<T> > >& tensors)
 template <class T>
 void DivideByStd(std::vector< std::shared_ptr< Tensor<T> > >& tensors, double stdev)
 {
+	T inverse_stdev = static_cast<T>(1 / stdev);
 	for (size_t i=0; i<tensors.size(); i++)
 	{
-		auto& tensor = *tensors[i];
-		for (size_t j=0; j<tensor.Numel(); j++)
-			tensor[j] /= stdev;
+		T* tensor_data = tensors[i]->GetStartPtr();
+		size_t numel = tensors[i]->Numel();
+		for (size_t j=0; j<numel; j++)
+			tensor_data[j] *= inverse_stdev;
 	}
 }
 
@@ -98,74 +290,40 @@ double GetSameStd(std::vector< std::shared_ptr< Tensor<T> > >& tensors)
 }
 
 template <class T>
-void FullMeanSubtract(std::vector< std::shared_ptr< Tensor<T> > >& tensors, Tensor<T>& means)
+void FullMeanSubtract(std::vector< std::shared_ptr< Tensor<T> > >& tensors, Tensor<T>& means, size_t num_threads = 1)
 {
-	size_t num_samples = tensors.size();
-	size_t num_features = tensors[0]->Numel();
-	for (size_t sample_ind=0; sample_ind<num_samples; sample_ind++)
-	{
-		auto& tensor = (*tensors[sample_ind]);
-		for (size_t i=0; i<num_features; i++)
-			tensor[i] -= means[i];
-	}
+	std::vector<T*> samples(tensors.size());
+	for (size_t i=0; i<tensors.size(); i++)
+		samples[i] = tensors[i]->GetStartPtr();
+	std::vector<T> ones(means.Numel(), 1);
+	ShiftAndScaleFeatures(samples.data(), samples.size(), means.Numel(), means.GetStartPtr(), ones.data(), num_threads);
 }
 
 // the last dim is sample index, it is always averaged
 //returns the tensor of means
 template <class T>
-Tensor<T> GetFullMeans(std::vector< std::shared_ptr< Tensor<T> > >& tensors)
+Tensor<T> GetFullMeans(std::vector< std::shared_ptr< Tensor<T> > >& tensors, size_t num_threads = 1)
 {
-	Tensor<double> accumulated_means(tensors[0]->GetDimensions());
-	size_t num_samples = tensors.size();
-	size_t num_features = tensors[0]->Numel();
-	for (size_t sample_ind=0; sample_ind<num_samples; sample_ind++)
-	{
-		auto& tensor = (*tensors[sample_ind]);
-		for (size_t i=0; i<num_features; i++)
-			accumulated_means[i] += tensor[i];
-	}
-
-	for (size_t i=0; i<accumulated_means.Numel(); i++)
-		accumulated_means[i] /= num_samples;
-	
-	Tensor<T> means(tensors[0]->GetDimensions());
-	for (size_t i=0; i< means.Numel(); i++)
-		means[i] = static_cast<T>(accumulated_means[i]);
-
-	return means;
+	return ComputeFeatureStatistics(tensors, num_threads).template GetMeans<T>(tensors[0]->GetDimensions());
 }
 
 template <class T>
-void FullStdDivide(std::vector< std::shared_ptr< Tensor<T> > >& tensors, Tensor<T>& stds)
+void FullStdDivide(std::vector< std::shared_ptr< Tensor<T> > >& tensors, Tensor<T>& stds, size_t num_threads = 1)
 {
-	size_t num_samples = tensors.size();
-	size_t num_features = tensors[0]->Numel();
-	for (size_t sample_ind=0; sample_ind<num_samples; sample_ind++)
-	{
-		auto& tensor = (*tensors[sample_ind]);
-		for (size_t i=0; i<num_features; i++)
-			tensor[i] /= stds[i];
-	}
+	Tensor<T> zeros(stds.GetDimensions());
+	NormalizeFeatures(tensors, zeros, stds, num_threads);
 }
 
+// the root mean square of each feature, i.e. the std of the data with subtracted means
 template <class T>
-Tensor<T> GetFullStd(std::vector< std::shared_ptr< Tensor<T> > >& tensors)
+Tensor<T> GetFullStd(std::vector< std::shared_ptr< Tensor<T> > >& tensors, size_t num_threads = 1)
 {
-	Tensor<double> accummulated_variances(tensors[0]->GetDimensions());
-	size_t num_samples = tensors.size();
-	size_t num_features = tensors[0]->Numel();
-	for (size_t sample_ind=0; sample_ind<num_samples; sample_ind++)
-	{
-		auto& tensor = (*tensors[sample_ind]);
-		for (size_t i=0; i<num_features; i++)
-			accummulated_variances[i] += tensor[i]*tensor[i];
-	}
-	
+	FeatureStatistics statistics = ComputeFeatureStatistics(tensors, num_threads);
 	Tensor<T> stds(tensors[0]->GetDimensions());
-	for (size_t i=0; i< accummulated_variances.Numel(); i++)
-		stds[i] = static_cast<T>( std::sqrt(accummulated_variances[i] / num_samples ) + 0.0000000001 );
+	for (size_t i=0; i< stds.Numel(); i++)
+		stds[i] = static_cast<T>( std::sqrt( statistics.GetVariance(i) + statistics.GetMean(i)*statistics.GetMean(i) ) + 0.0000000001 );
 
 	return stds;
 }
 
-#endif
\ No newline at end of file
+#endif
@@ -2,6 +2,7 @@
 #define PURE_SOFTMAX_MODULE_H
 
 #include "Module.h"
+#include "SoftmaxKernels.h"
 #include "my_math.h"
 
 // Softmax takes exp() of its inputs before turning them to probabilities
@@ -25,6 +26,16 @@ public:
 	{
 		return module.GetType() == GetType() && module.GetName() == GetName();
 	}
+
+	virtual bool OverwritesOutputBuffer() const
+	{
+		return true;
+	}
+
+	virtual bool OverwritesInputGradientsBuffer() const
+	{
+		return true;
+	}
 	
 	static std::shared_ptr< Module< ParamsType> > Create(IOTreeNode& data);
 
@@ -52,18 +63,20 @@ std::shared_ptr< Module< ParamsType> > PureSoftmaxModule<ParamsType>::Create(IOT
 template <class ParamsType>
 void PureSoftmaxModule<ParamsType>::sub_train_fprop(const std::shared_ptr< Tensor<ParamsType> >& input, std::shared_ptr< Tensor<ParamsType> >& output)
 {	
-	Tensor<ParamsType>& input_tensor = *input;
-	Tensor<ParamsType>& output_tensor = *output;
-	size_t minibatch_size = input_tensor.GetDimensionSize(input_tensor.NumDimensions()-1);
-	size_t num_features = input_tensor.Numel() / minibatch_size;
+	size_t minibatch_size = input->GetDimensionSize(input->NumDimensions()-1);
+	size_t num_features = input->Numel() / minibatch_size;
+	const ParamsType* input_ptr = input->GetStartPtr();
+	ParamsType* output_ptr = output->GetStartPtr();
 	for (size_t sample_ind = 0; sample_ind<minibatch_size; sample_ind++)
 	{
-		size_t sample_offset = num_features*sample_ind;
+		const ParamsType* sample_input = input_ptr + num_features*sample_ind;
+		ParamsType* sample_output = output_ptr + num_features*sample_ind;
 		ParamsType partition_val = EPS;
 		for (size_t i=0; i<num_features; i++)
-			partition_val += input_tensor[sample_offset+i];
+			partition_val += sample_input[i];
+		ParamsType normalizer = 1 / partition_val;
 		for (size_t i = 0; i<num_features; i++)
-			output_tensor[sample_offset+i] = input_tensor[sample_offset+i]/partition_val;
+			sample_output[i] = sample_input[i]*normalizer;
 	}
 }
 
@@ -72,26 +85,24 @@ void PureSoftmaxModule<ParamsType>::sub_bprop(const std::shared_ptr< Tensor<Para
 	std::shared_ptr< Tensor<ParamsType> >& input_gradients, const std::shared_ptr< Tensor<ParamsType> >& output_gradients, 
 	const std::vector<ParamsType>& samples_importances)
 {	
-	Tensor<ParamsType>& input_tensor = *input;
-	Tensor<ParamsType>& output_tensor = *output;
-	Tensor<ParamsType>& input_gradients_tensor = *input_gradients;
-	Tensor<ParamsType>& output_gradients_tensor = *output_gradients;
-	size_t minibatch_size = output_tensor.GetDimensionSize(output_tensor.NumDimensions()-1);
-	size_t num_features = output_tensor.Numel() / minibatch_size;
+	size_t minibatch_size = output->GetDimensionSize(output->NumDimensions()-1);
+	size_t num_features = output->Numel() / minibatch_size;
+	const ParamsType* input_ptr = input->GetStartPtr();
+	const ParamsType* output_ptr = output->GetStartPtr();
+	const ParamsType* output_gradients_ptr = output_gradients->GetStartPtr();
+	ParamsType* input_gradients_ptr = input_gradients->GetStartPtr();
 
 	for (size_t sample_ind = 0; sample_ind<minibatch_size; sample_ind++)
 	{
 		size_t sample_offset = num_features*sample_ind;
 		ParamsType partition_val = EPS;
 		for (size_t i=0; i<num_features; i++)
-			partition_val += input_tensor[sample_offset+i];
-
-		ParamsType weighted_gradient = 0;
-		for (size_t i=0; i<num_features; i++)
-			weighted_gradient += output_tensor[sample_offset+i] / partition_val * output_gradients_tensor[sample_offset+i];
+			partition_val += input_ptr[sample_offset+i];
+		ParamsType normalizer = 1 / partition_val;
 
+		ParamsType weighted_gradient = SumOfProducts(output_ptr+sample_offset, output_gradients_ptr+sample_offset, num_features) * normalizer;
 		for (size_t i = 0; i<num_features; i++)
-			input_gradients_tensor[sample_offset+i] = output_gradients_tensor[sample_offset+i]/partition_val - weighted_gradient;
+			input_gradients_ptr[sample_offset+i] = output_gradients_ptr[sample_offset+i]*normalizer - weighted_gradient;
 	}
 }
 
@@ -4,24 +4,43 @@
 // I could not make Visual Studio link to the original cpp file. 
 // It is the only cpp that has to be imported, therefore I copied it here
 
-#include <random>
-std::mt19937 gen = std::mt19937();
+#include <mutex>
+// stream 0 is the global generator, the created streams are numbered from 1
+uint64_t gen_seed = 0;
+uint64_t num_created_streams = 0;
+RandomStream gen = RandomStream();
+// the generator is shared by all threads
+std::mutex gen_mutex;
 
 // max inclusive
 int RandomGenerator::GetUniformInt(int min_val, int max_val)
 {
-	std::uniform_int_distribution<int> dist(min_val, max_val);
-	return dist(gen);
+	std::lock_guard<std::mutex> lock(gen_mutex);
+	return gen.GetUniformInt(min_val, max_val);
 }
 
 double RandomGenerator::GetUniformDouble(double min_val, double max_val)
 {
-	std::uniform_real_distribution<double> dist(min_val, max_val);
-	return dist(gen);
+	std::lock_guard<std::mutex> lock(gen_mutex);
+	return gen.GetUniformDouble(min_val, max_val);
 }
 
 double RandomGenerator::GetNormalDouble(double mean, double std)
 {
-	std::normal_distribution<double> dist(mean, std);
-	return dist(gen);
+	std::lock_guard<std::mutex> lock(gen_mutex);
+	return gen.GetNormalDouble(mean, std);
+}
+
+void RandomGenerator::SetSeed(uint64_t new_seed)
+{
+	std::lock_guard<std::mutex> lock(gen_mutex);
+	gen_seed = new_seed;
+	num_created_streams = 0;
+	gen = RandomStream(gen_seed);
+}
+
+RandomStream RandomGenerator::CreateStream()
+{
+	std::lock_guard<std::mutex> lock(gen_mutex);
+	return RandomStream(gen_seed, ++num_created_streams);
 }
\ No newline at end of file
@@ -1,6 +1,10 @@
 #ifndef RANDOMGENERATOR_H
 #define RANDOMGENERATOR_H
 
+#include "RandomStream.h"
+
+// Global generator shared by all threads (the calls are serialized), and the source of independent streams
+// (see RandomStream) for the code that generates many numbers or runs in parallel
 class RandomGenerator
 {
 public:
@@ -9,6 +13,13 @@ public:
 	static double GetUniformDouble(double min_val, double max_val);
 
 	static double GetNormalDouble(double mean, double std);
+
+	// restarts the global generator and the numbering of the streams, the seed is 0 at the start of the program
+	static void SetSeed(uint64_t seed);
+
+	// the streams are numbered in the order of the calls, so a program that creates them in the same order after SetSeed
+	// gets the same numbers
+	static RandomStream CreateStream();
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,338 @@
+#ifndef RANDOM_STREAM_H
+#define RANDOM_STREAM_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cmath>
+#include <algorithm>
+#include <climits>
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+// Counter-based generator Philox4x32-10 (Salmon et al., "Parallel random numbers: as easy as 1, 2, 3").
+// Block i of the stream is the encryption of the counter (i, stream id) with the seed as the key, so the numbers depend
+// only on the seed, the stream id and the position in the stream. Split() derives independent streams for threads, modules
+// and minibatches, so parallel code gets the same numbers regardless of the scheduling.
+// A stream is not thread safe, each thread uses its own. The bulk fills return the same numbers as the consecutive calls
+// of NextUInt32, and generate 8 blocks at once if AVX2 is enabled for the compiler
+class RandomStream
+{
+	enum
+	{
+		block_size = 4,
+		// number of the values converted at once by the fills
+		chunk_size = 256
+	};
+
+	uint32_t key_[2];
+	uint64_t stream_id_;
+	// the next block to generate
+	uint64_t block_counter_;
+	// the values of the last block that were not returned yet, from buffer_pos_ to block_size
+	uint32_t buffer_[block_size];
+	size_t buffer_pos_;
+
+	static void Philox(const uint32_t counter[block_size], const uint32_t key[2], uint32_t result[block_size])
+	{
+		uint32_t x0 = counter[0], x1 = counter[1], x2 = counter[2], x3 = counter[3];
+		uint32_t k0 = key[0], k1 = key[1];
+		for (size_t round = 0; round<10; round++)
+		{
+			uint64_t product0 = static_cast<uint64_t>(0xD2511F53) * x0;
+			uint64_t product1 = static_cast<uint64_t>(0xCD9E8D57) * x2;
+			x0 = static_cast<uint32_t>(product1 >> 32) ^ x1 ^ k0;
+			x1 = static_cast<uint32_t>(product1);
+			x2 = static_cast<uint32_t>(product0 >> 32) ^ x3 ^ k1;
+			x3 = static_cast<uint32_t>(product0);
+			k0 += 0x9E3779B9;
+			k1 += 0xBB67AE85;
+		}
+		result[0] = x0; result[1] = x1; result[2] = x2; result[3] = x3;
+	}
+
+	void GetCounter(uint64_t block_index, uint32_t counter[block_size]) const
+	{
+		counter[0] = static_cast<uint32_t>(block_index);
+		counter[1] = static_cast<uint32_t>(block_index >> 32);
+		counter[2] = static_cast<uint32_t>(stream_id_);
+		counter[3] = static_cast<uint32_t>(stream_id_ >> 32);
+	}
+
+#if defined(__AVX2__)
+	// 32x32 bit products of the 8 lanes
+	static void MulHiLo(__m256i x, __m256i multiplier, __m256i& hi, __m256i& lo)
+	{
+		__m256i even_products = _mm256_mul_epu32(x, multiplier);
+		__m256i odd_products = _mm256_mul_epu32(_mm256_srli_epi64(x, 32), multiplier);
+		lo = _mm256_blend_epi32(even_products, _mm256_slli_epi64(odd_products, 32), 0xAA);
+		hi = _mm256_blend_epi32(_mm256_srli_epi64(even_products, 32), odd_products, 0xAA);
+	}
+
+	// 8 consecutive blocks, a lane per block
+	void GenerateBlocks8(uint32_t* data)
+	{
+		uint32_t counter[block_size];
+		GetCounter(block_counter_, counter);
+		__m256i x0 = _mm256_add_epi32(_mm256_set1_epi32(static_cast<int>(counter[0])), _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7));
+		// the high part of the block index is incremented in the lanes where the low part wraps around
+		__m256i carry = _mm256_cmpgt_epi32(_mm256_xor_si256(_mm256_set1_epi32(static_cast<int>(counter[0])), _mm256_set1_epi32(INT_MIN)),
+			_mm256_xor_si256(x0, _mm256_set1_epi32(INT_MIN)));
+		__m256i x1 = _mm256_sub_epi32(_mm256_set1_epi32(static_cast<int>(counter[1])), carry);
+		__m256i x2 = _mm256_set1_epi32(static_cast<int>(counter[2]));
+		__m256i x3 = _mm256_set1_epi32(static_cast<int>(counter[3]));
+		const __m256i multiplier0 = _mm256_set1_epi32(static_cast<int>(0xD2511F53));
+		const __m256i multiplier1 = _mm256_set1_epi32(static_cast<int>(0xCD9E8D57));
+		uint32_t k0 = key_[0], k1 = key_[1];
+		for (size_t round = 0; round<10; round++)
+		{
+			__m256i hi0, lo0, hi1, lo1;
+			MulHiLo(x0, multiplier0, hi0, lo0);
+			MulHiLo(x2, multiplier1, hi1, lo1);
+			x0 = _mm256_xor_si256( _mm256_xor_si256(hi1, x1), _mm256_set1_epi32(static_cast<int>(k0)) );
+			x1 = lo1;
+			x2 = _mm256_xor_si256( _mm256_xor_si256(hi0, x3), _mm256_set1_epi32(static_cast<int>(k1)) );
+			x3 = lo0;
+			k0 += 0x9E3779B9;
+			k1 += 0xBB67AE85;
+		}
+		// transpose, so that the values of each block are consecutive
+		__m256i t0 = _mm256_unpacklo_epi32(x0, x1), t1 = _mm256_unpackhi_epi32(x0, x1);
+		__m256i t2 = _mm256_unpacklo_epi32(x2, x3), t3 = _mm256_unpackhi_epi32(x2, x3);
+		__m256i blocks04 = _mm256_unpacklo_epi64(t0, t2), blocks15 = _mm256_unpackhi_epi64(t0, t2);
+		__m256i blocks26 = _mm256_unpacklo_epi64(t1, t3), blocks37 = _mm256_unpackhi_epi64(t1, t3);
+		__m256i* output = reinterpret_cast<__m256i*>(data);
+		_mm256_storeu_si256(output, _mm256_permute2x128_si256(blocks04, blocks15, 0x20));
+		_mm256_storeu_si256(output+1, _mm256_permute2x128_si256(blocks26, blocks37, 0x20));
+		_mm256_storeu_si256(output+2, _mm256_permute2x128_si256(blocks04, blocks15, 0x31));
+		_mm256_storeu_si256(output+3, _mm256_permute2x128_si256(blocks26, blocks37, 0x31));
+		block_counter_ += 8;
+	}
+#endif
+
+	// consecutive blocks from block_counter_
+	void GenerateBlocks(uint32_t* data, size_t num_blocks)
+	{
+		size_t block_ind = 0;
+#if defined(__AVX2__)
+		for (; block_ind+8<=num_blocks; block_ind+=8)
+			GenerateBlocks8(data+block_size*block_ind);
+#endif
+		for (; block_ind<num_blocks; block_ind++)
+		{
+			uint32_t counter[block_size];
+			GetCounter(block_counter_++, counter);
+			Philox(counter, key_, data+block_size*block_ind);
+		}
+	}
+
+	// (0, 1), so that log() of the values is finite
+	static float ToUniformFloat(uint32_t value)
+	{
+		return (static_cast<float>(value >> 8) + 0.5f) * (1.0f / 16777216.0f);
+	}
+
+	static double ToUniformDouble(uint32_t value)
+	{
+		return (static_cast<double>(value) + 0.5) * (1.0 / 4294967296.0);
+	}
+
+	template <class T>
+	static T ToUniform(uint32_t value);
+
+public:
+
+	explicit RandomStream(uint64_t seed = 0, uint64_t stream_id = 0) : stream_id_(stream_id), block_counter_(0), buffer_pos_(block_size)
+	{
+		key_[0] = static_cast<uint32_t>(seed);
+		key_[1] = static_cast<uint32_t>(seed >> 32);
+	}
+
+	// independent stream with the same seed, the result depends only on this stream's seed and id and on substream_id
+	RandomStream Split(uint64_t substream_id) const
+	{
+		uint32_t counter[block_size] = { static_cast<uint32_t>(substream_id), static_cast<uint32_t>(substream_id >> 32),
+			static_cast<uint32_t>(stream_id_), static_cast<uint32_t>(stream_id_ >> 32) };
+		// the key is changed, so that the ids of the substreams are not blocks of this stream
+		uint32_t key[2] = { key_[0] ^ 0x5851F42D, key_[1] ^ 0x4C957F2D };
+		uint32_t id[block_size];
+		Philox(counter, key, id);
+		return RandomStream(GetSeed(), id[0] | (static_cast<uint64_t>(id[1]) << 32));
+	}
+
+	uint64_t GetSeed() const
+	{
+		return key_[0] | (static_cast<uint64_t>(key_[1]) << 32);
+	}
+
+	uint64_t GetStreamId() const
+	{
+		return stream_id_;
+	}
+
+	// skips the rest of the current block and moves to the block, e.g. to the first block of a minibatch
+	void SetPosition(uint64_t block_index)
+	{
+		block_counter_ = block_index;
+		buffer_pos_ = block_size;
+	}
+
+	uint32_t NextUInt32()
+	{
+		if (buffer_pos_ == block_size)
+		{
+			GenerateBlocks(buffer_, 1);
+			buffer_pos_ = 0;
+		}
+		return buffer_[buffer_pos_++];
+	}
+
+	void FillUInt32(uint32_t* data, size_t num_elements)
+	{
+		size_t i = 0;
+		for (; i<num_elements && buffer_pos_ < block_size; i++)
+			data[i] = buffer_[buffer_pos_++];
+		size_t num_blocks = (num_elements-i) / block_size;
+		GenerateBlocks(data+i, num_blocks);
+		i += block_size*num_blocks;
+		for (; i<num_elements; i++)
+			data[i] = NextUInt32();
+	}
+
+	// max inclusive
+	int GetUniformInt(int min_val, int max_val)
+	{
+		uint64_t range = static_cast<uint64_t>(static_cast<long long>(max_val) - min_val + 1);
+		return static_cast<int>(min_val + static_cast<long long>((NextUInt32() * range) >> 32));
+	}
+
+	// 53 random bits
+	double GetUniformDouble(double min_val, double max_val)
+	{
+		uint32_t high = NextUInt32() >> 5;
+		uint32_t low = NextUInt32() >> 6;
+		double uniform = (high * 67108864.0 + low) * (1.0 / 9007199254740992.0);
+		return min_val + (max_val-min_val)*uniform;
+	}
+
+	// Box-Muller transform
+	double GetNormalDouble(double mean, double std)
+	{
+		double radius = std::sqrt( -2*std::log(ToUniformDouble(NextUInt32())) );
+		double angle = 6.283185307179586 * ToUniformDouble(NextUInt32());
+		return mean + std*radius*std::cos(angle);
+	}
+
+	// values in (min_val, max_val)
+	template <class T>
+	void FillUniform(T* data, size_t num_elements, T min_val, T max_val)
+	{
+		uint32_t values[chunk_size];
+		T range = max_val-min_val;
+		for (size_t offset = 0; offset<num_elements; offset += chunk_size)
+		{
+			size_t chunk_numel = std::min<size_t>(chunk_size, num_elements-offset);
+			FillUInt32(values, chunk_numel);
+			for (size_t i=0; i<chunk_numel; i++)
+				data[offset+i] = min_val + range*ToUniform<T>(values[i]);
+		}
+	}
+
+	// Box-Muller transform of pairs of values
+	template <class T>
+	void FillNormal(T* data, size_t num_elements, T mean, T std)
+	{
+		uint32_t values[chunk_size];
+		for (size_t offset = 0; offset<num_elements; offset += chunk_size/2)
+		{
+			size_t chunk_numel = std::min<size_t>(chunk_size/2, num_elements-offset);
+			size_t num_pairs = (chunk_numel+1)/2;
+			FillUInt32(values, 2*num_pairs);
+			for (size_t pair_ind = 0; pair_ind<num_pairs; pair_ind++)
+			{
+				double radius = std * std::sqrt( -2*std::log(ToUniformDouble(values[2*pair_ind])) );
+				double angle = 6.283185307179586 * ToUniformDouble(values[2*pair_ind+1]);
+				data[offset+2*pair_ind] = static_cast<T>(mean + radius*std::cos(angle));
+				if (2*pair_ind+1 < chunk_numel)
+					data[offset+2*pair_ind+1] = static_cast<T>(mean + radius*std::sin(angle));
+			}
+		}
+	}
+
+	// 1 with the probability, 0 otherwise
+	template <class T>
+	void FillBernoulli(T* data, size_t num_elements, double probability)
+	{
+		if (probability >= 1)
+		{
+			std::fill(data, data+num_elements, static_cast<T>(1));
+			return;
+		}
+		uint32_t values[chunk_size];
+		// 32 bit comparisons are vectorized
+		uint32_t threshold = static_cast<uint32_t>( std::max(0.0, probability) * 4294967296.0 );
+		for (size_t offset = 0; offset<num_elements; offset += chunk_size)
+		{
+			size_t chunk_numel = std::min<size_t>(chunk_size, num_elements-offset);
+			FillUInt32(values, chunk_numel);
+			for (size_t i=0; i<chunk_numel; i++)
+				data[offset+i] = static_cast<T>(values[i] < threshold);
+		}
+	}
+
+	// bit i%32 of bits[i/32] is 1 with the probability, the unused bits of the last word are 0. Uses the same numbers as FillBernoulli
+	void FillBernoulliBits(uint32_t* bits, size_t num_elements, double probability)
+	{
+		size_t num_words = (num_elements+31) / 32;
+		if (probability >= 1)
+		{
+			std::fill(bits, bits+num_words, 0xFFFFFFFFu);
+			if (num_elements % 32 != 0)
+				bits[num_words-1] = (1u << (num_elements % 32)) - 1;
+			return;
+		}
+		uint32_t values[chunk_size];
+		uint32_t threshold = static_cast<uint32_t>( std::max(0.0, probability) * 4294967296.0 );
+#if defined(__AVX2__)
+		// unsigned comparison as the signed one of the values with the flipped sign bits
+		const __m256i sign_bit = _mm256_set1_epi32(INT_MIN);
+		const __m256i signed_threshold = _mm256_xor_si256(_mm256_set1_epi32(static_cast<int>(threshold)), sign_bit);
+#endif
+		for (size_t offset = 0; offset<num_elements; offset += chunk_size)
+		{
+			size_t chunk_numel = std::min<size_t>(chunk_size, num_elements-offset);
+			FillUInt32(values, chunk_numel);
+			for (size_t word_start = 0; word_start<chunk_numel; word_start += 32)
+			{
+				size_t word_numel = std::min<size_t>(32, chunk_numel-word_start);
+				const uint32_t* word_values = values+word_start;
+				uint32_t word = 0;
+				size_t i = 0;
+#if defined(__AVX2__)
+				for (; i+8<=word_numel; i+=8)
+				{
+					__m256i x = _mm256_xor_si256(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(word_values+i)), sign_bit);
+					word |= static_cast<uint32_t>(_mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpgt_epi32(signed_threshold, x)))) << i;
+				}
+#endif
+				for (; i<word_numel; i++)
+					word |= static_cast<uint32_t>(word_values[i] < threshold) << i;
+				bits[(offset+word_start)/32] = word;
+			}
+		}
+	}
+};
+
+template <>
+inline float RandomStream::ToUniform<float>(uint32_t value)
+{
+	return ToUniformFloat(value);
+}
+
+template <>
+inline double RandomStream::ToUniform<double>(uint32_t value)
+{
+	return ToUniformDouble(value);
+}
+
+#endif
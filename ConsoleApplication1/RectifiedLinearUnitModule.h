@@ -2,6 +2,7 @@
 #define RECTIFIED_LINEAR_UNIT_MODULE_H
 
 #include "Module.h"
+#include "ActivationKernels.h"
 
 template <class ParamsType>
 class RectifiedLinearUnitModule : public Module<ParamsType>
@@ -21,6 +22,27 @@ public:
 	{
 		return module.GetType() == GetType() && module.GetName() == GetName();
 	}
+
+	virtual bool OverwritesOutputBuffer() const
+	{
+		return true;
+	}
+
+	virtual bool OverwritesInputGradientsBuffer() const
+	{
+		return true;
+	}
+
+	virtual ActivationType GetActivationType() const
+	{
+		return rlu_activation;
+	}
+
+	// the gradient is computed from the output
+	virtual bool BpropUsesInput() const
+	{
+		return false;
+	}
 	
 	static std::shared_ptr< Module< ParamsType> > Create(IOTreeNode& data);
 
@@ -48,12 +70,7 @@ std::shared_ptr< Module< ParamsType> > RectifiedLinearUnitModule<ParamsType>::Cr
 template <class ParamsType>
 void RectifiedLinearUnitModule<ParamsType>::sub_train_fprop(const std::shared_ptr< Tensor<ParamsType> >& input, std::shared_ptr< Tensor<ParamsType> >& output)
 {
-	size_t numel = input->Numel();
-	for (size_t i = 0; i<numel; i++)
-	{
-		ParamsType in = (*input)[i];
-		(*output)[i] = (ParamsType)(in>0?in:0);
-	}
+	ElementwiseActivation<RluActivation, ParamsType>::fprop(input->GetStartPtr(), output->GetStartPtr(), input->Numel());
 }
 
 template <class ParamsType>
@@ -61,12 +78,8 @@ void RectifiedLinearUnitModule<ParamsType>::sub_bprop(const std::shared_ptr< Ten
 	std::shared_ptr< Tensor<ParamsType> >& input_gradients, const std::shared_ptr< Tensor<ParamsType> >& output_gradients, 
 	const std::vector<ParamsType>& samples_importances)
 {
-	size_t numel = input->Numel();
-	for (size_t i = 0; i<numel; i++)
-	{
-		ParamsType in = (*input)[i];
-		(*input_gradients)[i] = ( (ParamsType)(in>0?1:0) )*(*output_gradients)[i];
-	}
+	ElementwiseActivation<RluActivation, ParamsType>::bprop(input->GetStartPtr(), output->GetStartPtr(), output_gradients->GetStartPtr(), 
+		input_gradients->GetStartPtr(), input->Numel());
 }
 
 #endif
\ No newline at end of file
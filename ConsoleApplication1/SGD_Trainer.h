@@ -121,6 +121,7 @@ double SGD_Trainer<ParamsType>::Train(NN<ParamsType>& net,
 		ProcessTrainResultFunc train_result_processor = DefaultProcessTrainFunc<ParamsType>, 
 		ProcessValidationResultFunc validation_result_processor = DefaultProcessValidationFunc<ParamsType>)
 {
+	FusedCostScope<ParamsType> fused_cost_scope(net, train_cost_module);
 	size_t num_params = net.GetNumParams();
 	std::vector<ParamsType> move_speed(num_params);
 
@@ -129,8 +130,9 @@ double SGD_Trainer<ParamsType>::Train(NN<ParamsType>& net,
 
 	double best_train_cost = net.GetCost(train_set, train_cost_module, train_set.SelectIndices(5000), true, false);
 	double best_validation_cost = net.GetCost(validation_set, validation_cost_module, validation_set.SelectIndices(5000), false, false);
-	std::vector<ParamsType> best_parameters = net.GetParameters();
-	std::vector<ParamsType> parameters = best_parameters;
+	// the parameters of the net are moved in place
+	std::vector<ParamsType>& parameters = net.GetParameters();
+	std::vector<ParamsType> best_parameters = parameters;
 
 	double train_cost = best_train_cost;
 	double validation_cost = best_validation_cost;
@@ -143,8 +145,6 @@ double SGD_Trainer<ParamsType>::Train(NN<ParamsType>& net,
 
 		UpdateSpeed(move_speed, cost_and_gradient.gradients.data(), GetMomentum(batch_ind));
 		Move(parameters.data(), move_speed.data(), num_params);
-		
-		net.SetParameters(parameters);
 
 		if (IsValidationResultBatch(batch_ind))
 		{
@@ -23,6 +23,7 @@
 #include "AbsModule.h"
 #include "BiasModule.h"
 #include "LinearMixModule.h"
+#include "ActivationFusion.h"
 #include "SoftSignModule.h"
 #include "SigmoidModule.h"
 #include "SoftmaxModule.h"
@@ -33,11 +34,14 @@
 #include "EmptyRegularizer.h"
 #include "Utilities.h"
 #include "TrainDataset.h"
+#include "PrefetchingTrainDataset.h"
 #include  "ITensorDataLoader.h"
 #include "Preprocessing.h"
 #include "Converter.h"
+#include "CsvReader.h"
 #include "IOTreeNode.h"
 #include "IOXML.h"
+#include "IOBinary.h"
 #include "DropoutModule.h"
 #include "MeanStdNormalizingModule.h"
 #include "GaussianNoiseModule.h"
@@ -326,6 +330,7 @@ std::shared_ptr< NN<T> > ConstructRluRluSoftmaxNN(const std::vector<size_t>& inp
 	std::vector<size_t> layer9_input_dims = AddBiasModule(modules, "bias3", layer8_input_dims);
 	std::vector<size_t> layer10_input_dims = AddSoftmaxModule(modules, "softmax1", layer9_input_dims);
 
+	modules = FuseActivations(modules);
 	std::shared_ptr< CompositeModule<T> > composite_module( new CompositeModule<T>("composite1", modules) );
 	std::shared_ptr< NN<T> > nn( new NN<T>(composite_module, 1000) );
 	nn->InitializeParameters();
@@ -347,6 +352,7 @@ std::shared_ptr< NN<T> > ConstructRluSoftmaxNN(const std::vector<size_t>& input_
 	layer_input_dims = AddBiasModule(modules, "bias2", layer_input_dims);
 	layer_input_dims = AddSoftmaxModule(modules, "softmax1", layer_input_dims);
 
+	modules = FuseActivations(modules);
 	std::shared_ptr< CompositeModule<T> > composite_module( new CompositeModule<T>("composite1", modules) );
 	std::shared_ptr< NN<T> > nn( new NN<T>(composite_module, 1000) );
 	nn->InitializeParameters();
@@ -641,6 +647,11 @@ struct SemisupervisedDataset
 	Tensor<FeaturesType> data_means;
 	Tensor<FeaturesType> data_stds;
 
+	// row-major matrices of the samples read from the files, the tensors of the samples point to their rows
+	std::shared_ptr< std::vector<FeaturesType> > labeled_data;
+	std::shared_ptr< std::vector<FeaturesType> > labels_data;
+	std::shared_ptr< std::vector<FeaturesType> > unlabeled_data;
+
 	std::vector< std::shared_ptr< Tensor<FeaturesType> > > labeled_input;
 	std::vector< std::shared_ptr< Tensor<FeaturesType> > > labels;
 	std::vector<ParamsType> labeled_importance;
@@ -649,36 +660,38 @@ struct SemisupervisedDataset
 	std::vector<ParamsType> unlabeled_importance;
 };
 
+// The labeled file has the label (from 1) in the first column and the features in the others, the unlabeled file has only the features.
+// Both files have headers. The rows are parsed in parallel by CsvReader into matrices that back the sample tensors,
+// the statistics of the features of the labeled rows are computed and applied in parallel over the rows
 template <class ParamsType, class FeaturesType>
 SemisupervisedDataset<ParamsType, FeaturesType> LoadTrainDataFromFile(std::string labeled_path, 
 																	  bool normalize, bool load_unlabeled = false, std::string unlabeled_path = "")
 {
 	const size_t num_output_clases = 9;
-	std::ifstream labeled_stream(labeled_path);
 	SemisupervisedDataset<ParamsType, FeaturesType> res;
-
 	std::vector<size_t> labels_dims(1,num_output_clases);
-	
-	std::string entry_str;
-	labeled_stream>>entry_str; // skip header
-	std::vector<FeaturesType> features = Converter::StringToVector<FeaturesType>(entry_str, ',');
-	std::vector<size_t> input_dims;
-	while (labeled_stream>>entry_str)
+
+	CsvReader<FeaturesType> labeled_reader(labeled_path);
+	res.labeled_data = std::shared_ptr< std::vector<FeaturesType> >( new std::vector<FeaturesType>() );
+	size_t num_labeled = labeled_reader.ReadAll(*res.labeled_data);
+	size_t row_size = labeled_reader.GetNumColumns();
+	if (num_labeled == 0 || row_size < 2)
+		throw std::runtime_error("LoadTrainDataFromFile: no samples in " + labeled_path);
+	size_t num_features = row_size-1;
+	std::vector<size_t> input_dims(1, num_features);
+
+	res.labels_data = std::shared_ptr< std::vector<FeaturesType> >( new std::vector<FeaturesType>(num_labeled*num_output_clases, 0) );
+	FeaturesType* labeled_rows = res.labeled_data->data();
+	for (size_t sample_ind = 0; sample_ind < num_labeled; sample_ind++)
 	{
-		std::vector<FeaturesType> features = Converter::StringToVector<FeaturesType>(entry_str, ',');
-		if (input_dims.size() == 0)
-			input_dims = std::vector<size_t>( 1, features.size()-1);
-		if (features.size() != input_dims[0]+1)
-			throw 1;
-		std::shared_ptr< Tensor<FeaturesType> > features_tensor_ptr( new Tensor<FeaturesType>(input_dims) );
-		for (size_t i = 1; i < features.size(); i++)
-			(*features_tensor_ptr)[i-1] = features[i];
-		res.labeled_input.push_back(features_tensor_ptr);
-
-		std::shared_ptr< Tensor<FeaturesType> > labels_tensor_ptr( new Tensor<FeaturesType>(labels_dims) );
-		labels_tensor_ptr->SetZeros();
-		(*labels_tensor_ptr)[ static_cast<size_t>(features[0]) - 1 ] = 1;
-		res.labels.push_back(labels_tensor_ptr);
+		FeaturesType* row = labeled_rows + sample_ind*row_size;
+		FeaturesType* features = row+1;
+		if (!(row[0] >= 1 && row[0] <= num_output_clases))
+			throw std::runtime_error("LoadTrainDataFromFile: wrong label of sample " + std::to_string(sample_ind+1) + " in " + labeled_path);
+		FeaturesType* sample_labels = res.labels_data->data() + sample_ind*num_output_clases;
+		sample_labels[ static_cast<size_t>(row[0]) - 1 ] = 1;
+		res.labeled_input.push_back( std::shared_ptr< Tensor<FeaturesType> >( new Tensor<FeaturesType>(features, input_dims) ) );
+		res.labels.push_back( std::shared_ptr< Tensor<FeaturesType> >( new Tensor<FeaturesType>(sample_labels, labels_dims) ) );
 	}
 
 	RandomShuffleVectors( res.labeled_input, res.labels );
@@ -687,42 +700,38 @@ SemisupervisedDataset<ParamsType, FeaturesType> LoadTrainDataFromFile(std::strin
 
 	if ( load_unlabeled )
 	{
-		std::ifstream unlabeled_stream(unlabeled_path);
-		unlabeled_stream>>entry_str; // skip header
-		while (unlabeled_stream>>entry_str)
-		{
-			std::vector<FeaturesType> features = Converter::StringToVector<FeaturesType>(entry_str, ',');
-			if (features.size() != input_dims[0])
-				throw 1;
-			std::shared_ptr< Tensor<FeaturesType> > features_tensor_ptr( new Tensor<FeaturesType>(input_dims) );
-			for (size_t i = 0; i < features.size(); i++)
-				(*features_tensor_ptr)[i] = features[i];
-			res.unlabeled_input.push_back(features_tensor_ptr);
-		}
+		CsvReader<FeaturesType> unlabeled_reader(unlabeled_path);
+		res.unlabeled_data = std::shared_ptr< std::vector<FeaturesType> >( new std::vector<FeaturesType>() );
+		size_t num_unlabeled = unlabeled_reader.ReadAll(*res.unlabeled_data);
+		if (num_unlabeled > 0 && unlabeled_reader.GetNumColumns() != num_features)
+			throw std::runtime_error("LoadTrainDataFromFile: the number of the features in " + unlabeled_path + " differs from " + labeled_path);
+		for (size_t sample_ind = 0; sample_ind < num_unlabeled; sample_ind++)
+			res.unlabeled_input.push_back( std::shared_ptr< Tensor<FeaturesType> >( 
+				new Tensor<FeaturesType>(res.unlabeled_data->data() + sample_ind*num_features, input_dims) ) );
 
 		//RandomShuffleVector( res.unlabeled_input );
 		
 		res.unlabeled_importance = std::vector<ParamsType>(res.unlabeled_input.size(), 1);
 	}
 
-	res.data_means = Tensor<FeaturesType>( res.labeled_input[0]->GetDimensions() );
+	res.data_means = Tensor<FeaturesType>(input_dims);
 	res.data_means.SetZeros();
-	res.data_stds = Tensor<FeaturesType>( res.labeled_input[0]->GetDimensions() );
+	res.data_stds = Tensor<FeaturesType>(input_dims);
 	for (size_t i = 0; i< res.data_stds.Numel(); i++)
 		res.data_stds[i] = 1;
 
 	if (normalize)
 	{
-		res.data_means = GetFullMeans(res.labeled_input);
-		FullMeanSubtract(res.labeled_input, res.data_means);
-		res.data_stds = GetFullStd(res.labeled_input);
-		FullStdDivide(res.labeled_input, res.data_stds);
-
+		size_t num_threads = std::max<size_t>(1, std::thread::hardware_concurrency());
+		std::vector<const FeaturesType*> labeled_features(num_labeled);
+		for (size_t sample_ind = 0; sample_ind < num_labeled; sample_ind++)
+			labeled_features[sample_ind] = labeled_rows + sample_ind*row_size + 1;
+		FeatureStatistics statistics = ComputeFeatureStatistics(labeled_features.data(), num_labeled, num_features, num_threads);
+		res.data_means = statistics.GetMeans<FeaturesType>(input_dims);
+		res.data_stds = statistics.GetStds<FeaturesType>(input_dims);
+		NormalizeFeatures(labeled_rows + 1, num_labeled, row_size, res.data_means, res.data_stds, num_threads);
 		if (load_unlabeled)
-		{
-			FullMeanSubtract(res.unlabeled_input, res.data_means);
-			FullStdDivide(res.unlabeled_input, res.data_stds);
-		}
+			NormalizeFeatures(res.unlabeled_data->data(), res.unlabeled_input.size(), num_features, res.data_means, res.data_stds, num_threads);
 	}
 
 	return res;
@@ -732,23 +741,21 @@ template <class FeaturesType>
 std::vector< std::shared_ptr< Tensor<FeaturesType> > > LoadTestDataFromFile(std::string& filepath, 
 																			std::vector<FeaturesType>& means, std::vector<FeaturesType>& stds)
 {
-	std::ifstream stream(filepath);
+	CsvReader<FeaturesType> reader(filepath);
+	std::vector<FeaturesType> rows;
+	size_t num_samples = reader.ReadAll(rows);
+	size_t num_features = reader.GetNumColumns();
+	std::vector<size_t> input_dims( 1, num_features);
 	std::vector< std::shared_ptr< Tensor<FeaturesType> > > res;
-
-	stream>>entry_str; // skip header
-	while (stream>>entry_str)
+	for (size_t sample_ind = 0; sample_ind < num_samples; sample_ind++)
 	{
-		std::vector<FeaturesType> features = Converter::StringToVector<FeaturesType>(entry_str, ',');
-		std::vector<size_t> input_dims( 1, features.size());
 		std::shared_ptr< Tensor<FeaturesType> > features_tensor_ptr( new Tensor<FeaturesType>(input_dims) );
-		for (size_t i = 0; i < features.size(); i++)
-			(*features_tensor_ptr)[i] = features[i];
+		const FeaturesType* row = rows.data() + sample_ind*num_features;
+		for (size_t i = 0; i < num_features; i++)
+			(*features_tensor_ptr)[i] = (row[i] - means[i]) / stds[i];
 		res.push_back(features_tensor_ptr);
 	}
 
-	FullMeanSubtract(res, means);
-	FullStdDivide(res, stds);
-
 	return res;
 }
 
@@ -903,6 +910,14 @@ std::pair< SemisupervisedDataset<ParamsType, FeaturesType>, SemisupervisedDatase
 	validation_dataset.data_means = dataset.data_means;
 	validation_dataset.data_stds = dataset.data_stds;
 
+	// the tensors of the samples point into the storage of the source dataset, which may be destroyed before the results
+	train_dataset.labeled_data = dataset.labeled_data;
+	train_dataset.labels_data = dataset.labels_data;
+	train_dataset.unlabeled_data = dataset.unlabeled_data;
+	validation_dataset.labeled_data = dataset.labeled_data;
+	validation_dataset.labels_data = dataset.labels_data;
+	validation_dataset.unlabeled_data = dataset.unlabeled_data;
+
 	return res;
 }
 
@@ -917,9 +932,9 @@ public:
 		if (result.is_best)
 		{
 			std::cout<<result.batch_num<<" Train cost = "<<result.train_cost<<" validation cost = "<<result.validation_cost<<" BEST"<<std::endl;
-			std::ofstream stream( save_net_path_ );
+			std::ofstream stream( save_net_path_, std::ios::binary );
 			std::shared_ptr< IOTreeNode > state = result.net.GetState();
-			IOXML::save(*state, stream);
+			IOBinary::save(*state, stream);
 		}
 		else
 			std::cout<<result.batch_num<<" Train cost = "<<result.train_cost<<" validation cost = "<<result.validation_cost<<std::endl;
@@ -1151,8 +1166,9 @@ struct TrainingParams
 template <class T>
 std::shared_ptr< NN<T> > load_net(std::string filename)
 {
-	std::ifstream stream(filename);
-	std::shared_ptr<IOTreeNode> node = IOXML::load(stream);
+	std::ifstream stream(filename, std::ios::binary);
+	// nets exported to XML are still supported
+	std::shared_ptr<IOTreeNode> node = IOBinary::IsBinary(stream) ? IOBinary::load(stream) : IOXML::load(stream);
 	return NN<T>::Create( *node );
 }
 
@@ -1236,8 +1252,9 @@ void semisupervised_learning_train2()
 	std::shared_ptr< ITensorDataLoader<ParamsType> > validation_labeled_output_loader( new FullTensorDataLoader<ParamsType, FeaturesType>( validation_data.labels ) );
 
 	std::cout<<"Training"<<std::endl;
-	std::shared_ptr< ITrainDataset<ParamsType> > train_labeled_dataset( new TrainDataset<ParamsType>(train_labeled_input_loader, 
-		train_labeled_output_loader, train_data.labeled_importance) );
+	std::shared_ptr< ITrainDataset<ParamsType> > train_labeled_dataset( new PrefetchingTrainDataset<ParamsType>( 
+		std::shared_ptr< ITrainDataset<ParamsType> >( new TrainDataset<ParamsType>(train_labeled_input_loader, 
+		train_labeled_output_loader, train_data.labeled_importance) ), params.train_batch_size ) );
 	std::shared_ptr< ITrainDataset<ParamsType> > validation_labeled_dataset( new TrainDataset<ParamsType>(validation_labeled_input_loader, 
 		validation_labeled_output_loader, validation_data.labeled_importance) );
 
@@ -1312,8 +1329,9 @@ void semisupervised_learning_main()
 		new ClassificationPairsOutputTensorDataLoader<ParamsType, FeaturesType>( validation_data.labels ) );
 
 	std::cout<<"Training"<<std::endl;
-	std::shared_ptr< ITrainDataset<ParamsType> > train_labeled_dataset( new TrainDatasetPairsWithBatchIndProblem<ParamsType>(train_labeled_input_loader, 
-		train_labeled_output_loader, train_data.labeled_importance) );
+	std::shared_ptr< ITrainDataset<ParamsType> > train_labeled_dataset( new PrefetchingTrainDataset<ParamsType>( 
+		std::shared_ptr< ITrainDataset<ParamsType> >( new TrainDatasetPairsWithBatchIndProblem<ParamsType>(train_labeled_input_loader, 
+		train_labeled_output_loader, train_data.labeled_importance) ), params.train_batch_size ) );
 	std::shared_ptr< ITrainDataset<ParamsType> > validation_labeled_dataset( new TrainDatasetPairsWithBatchIndProblem<ParamsType>(validation_labeled_input_loader, 
 		validation_labeled_output_loader, validation_data.labeled_importance) );
 
@@ -2,6 +2,7 @@
 #define SIGMOID_MODULE_H
 
 #include "Module.h"
+#include "ActivationKernels.h"
 
 template <class ParamsType>
 class SigmoidModule : public Module<ParamsType>
@@ -21,6 +22,27 @@ public:
 	{
 		return module.GetType() == GetType() && module.GetName() == GetName();
 	}
+
+	virtual bool OverwritesOutputBuffer() const
+	{
+		return true;
+	}
+
+	virtual bool OverwritesInputGradientsBuffer() const
+	{
+		return true;
+	}
+
+	virtual ActivationType GetActivationType() const
+	{
+		return sigmoid_activation;
+	}
+
+	// the gradient is computed from the output
+	virtual bool BpropUsesInput() const
+	{
+		return false;
+	}
 	
 	static std::shared_ptr< Module< ParamsType> > Create(IOTreeNode& data);
 
@@ -48,8 +70,7 @@ std::shared_ptr< Module< ParamsType> > SigmoidModule<ParamsType>::Create(IOTreeN
 template <class ParamsType>
 void SigmoidModule<ParamsType>::sub_train_fprop(const std::shared_ptr< Tensor<ParamsType> >& input, std::shared_ptr< Tensor<ParamsType> >& output)
 {
-	for (size_t i = 0; i<input->Numel(); i++)
-		(*output)[i] = (ParamsType)(1.0 / (1.0 + std::exp(-(*input)[i])));
+	ElementwiseActivation<SigmoidActivation, ParamsType>::fprop(input->GetStartPtr(), output->GetStartPtr(), input->Numel());
 }
 
 template <class ParamsType>
@@ -57,11 +78,8 @@ void SigmoidModule<ParamsType>::sub_bprop(const std::shared_ptr< Tensor<ParamsTy
 	std::shared_ptr< Tensor<ParamsType> >& input_gradients, const std::shared_ptr< Tensor<ParamsType> >& output_gradients, 
 	const std::vector<ParamsType>& samples_importances)
 {
-	for (size_t i = 0; i<input->Numel(); i++)
-	{
-		ParamsType out = (*output)[i];
-		(*input_gradients)[i] = out*(1-out)*(*output_gradients)[i];
-	}
+	ElementwiseActivation<SigmoidActivation, ParamsType>::bprop(input->GetStartPtr(), output->GetStartPtr(), output_gradients->GetStartPtr(), 
+		input_gradients->GetStartPtr(), input->Numel());
 }
 
 #endif
\ No newline at end of file
@@ -0,0 +1,131 @@
+#ifndef SIMD_OPERATIONS_H
+#define SIMD_OPERATIONS_H
+
+#include <cstddef>
+
+// Vector of floats of the widest instruction set enabled for the compiler (/arch:AVX2, -mavx2 -mfma, -mavx512f).
+// NNLIB_SIMD_FLOAT is defined if such a vector is available, otherwise the callers use scalar code
+#if defined(__AVX512F__)
+#define NNLIB_SIMD_FLOAT
+#include <immintrin.h>
+
+typedef __m512 SimdFloat;
+const size_t simd_float_width = 16;
+
+inline SimdFloat SimdLoad(const float* ptr) { return _mm512_loadu_ps(ptr); }
+inline void SimdStore(float* ptr, SimdFloat x) { _mm512_storeu_ps(ptr, x); }
+inline SimdFloat SimdSet(float value) { return _mm512_set1_ps(value); }
+inline SimdFloat SimdAdd(SimdFloat x, SimdFloat y) { return _mm512_add_ps(x, y); }
+inline SimdFloat SimdSub(SimdFloat x, SimdFloat y) { return _mm512_sub_ps(x, y); }
+inline SimdFloat SimdMul(SimdFloat x, SimdFloat y) { return _mm512_mul_ps(x, y); }
+inline SimdFloat SimdDiv(SimdFloat x, SimdFloat y) { return _mm512_div_ps(x, y); }
+inline SimdFloat SimdMax(SimdFloat x, SimdFloat y) { return _mm512_max_ps(x, y); }
+inline SimdFloat SimdMin(SimdFloat x, SimdFloat y) { return _mm512_min_ps(x, y); }
+// x*y+z
+inline SimdFloat SimdFmadd(SimdFloat x, SimdFloat y, SimdFloat z) { return _mm512_fmadd_ps(x, y, z); }
+inline SimdFloat SimdAbs(SimdFloat x) { return _mm512_castsi512_ps( _mm512_and_si512(_mm512_castps_si512(x), _mm512_set1_epi32(0x7FFFFFFF)) ); }
+// condition>0 ? if_positive : otherwise
+inline SimdFloat SimdSelectPositive(SimdFloat condition, SimdFloat if_positive, SimdFloat otherwise)
+{
+	return _mm512_mask_blend_ps(_mm512_cmp_ps_mask(condition, _mm512_setzero_ps(), _CMP_GT_OQ), otherwise, if_positive);
+}
+inline SimdFloat SimdRound(SimdFloat x) { return _mm512_roundscale_ps(x, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC); }
+// x*2^n for integer n
+inline SimdFloat SimdScale(SimdFloat x, SimdFloat n) { return _mm512_scalef_ps(x, n); }
+// x in the lanes whose bits are set in the lowest simd_float_width bits of lane_bits, 0 in other lanes
+inline SimdFloat SimdMaskLanes(SimdFloat x, unsigned int lane_bits) { return _mm512_maskz_mov_ps(static_cast<__mmask16>(lane_bits), x); }
+
+#elif defined(__AVX2__) && (defined(__FMA__) || defined(_MSC_VER))
+#define NNLIB_SIMD_FLOAT
+#include <immintrin.h>
+
+typedef __m256 SimdFloat;
+const size_t simd_float_width = 8;
+
+inline SimdFloat SimdLoad(const float* ptr) { return _mm256_loadu_ps(ptr); }
+inline void SimdStore(float* ptr, SimdFloat x) { _mm256_storeu_ps(ptr, x); }
+inline SimdFloat SimdSet(float value) { return _mm256_set1_ps(value); }
+inline SimdFloat SimdAdd(SimdFloat x, SimdFloat y) { return _mm256_add_ps(x, y); }
+inline SimdFloat SimdSub(SimdFloat x, SimdFloat y) { return _mm256_sub_ps(x, y); }
+inline SimdFloat SimdMul(SimdFloat x, SimdFloat y) { return _mm256_mul_ps(x, y); }
+inline SimdFloat SimdDiv(SimdFloat x, SimdFloat y) { return _mm256_div_ps(x, y); }
+inline SimdFloat SimdMax(SimdFloat x, SimdFloat y) { return _mm256_max_ps(x, y); }
+inline SimdFloat SimdMin(SimdFloat x, SimdFloat y) { return _mm256_min_ps(x, y); }
+// x*y+z
+inline SimdFloat SimdFmadd(SimdFloat x, SimdFloat y, SimdFloat z) { return _mm256_fmadd_ps(x, y, z); }
+inline SimdFloat SimdAbs(SimdFloat x) { return _mm256_andnot_ps(_mm256_set1_ps(-0.0f), x); }
+// condition>0 ? if_positive : otherwise
+inline SimdFloat SimdSelectPositive(SimdFloat condition, SimdFloat if_positive, SimdFloat otherwise)
+{
+	return _mm256_blendv_ps(otherwise, if_positive, _mm256_cmp_ps(condition, _mm256_setzero_ps(), _CMP_GT_OQ));
+}
+inline SimdFloat SimdRound(SimdFloat x) { return _mm256_round_ps(x, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC); }
+// x*2^n for integer n
+inline SimdFloat SimdScale(SimdFloat x, SimdFloat n)
+{
+	__m256i exponent = _mm256_slli_epi32( _mm256_add_epi32(_mm256_cvtps_epi32(n), _mm256_set1_epi32(127)), 23 );
+	return _mm256_mul_ps(x, _mm256_castsi256_ps(exponent));
+}
+// x in the lanes whose bits are set in the lowest simd_float_width bits of lane_bits, 0 in other lanes
+inline SimdFloat SimdMaskLanes(SimdFloat x, unsigned int lane_bits)
+{
+	const __m256i lane_masks = _mm256_setr_epi32(1, 2, 4, 8, 16, 32, 64, 128);
+	__m256i selected = _mm256_cmpeq_epi32( _mm256_and_si256(_mm256_set1_epi32(static_cast<int>(lane_bits)), lane_masks), lane_masks );
+	return _mm256_and_ps(x, _mm256_castsi256_ps(selected));
+}
+#endif
+
+#ifdef NNLIB_SIMD_FLOAT
+// exp with the relative error of a few float ulps (Cephes expf), the argument is clamped to the range where the result is finite
+inline SimdFloat SimdExp(SimdFloat x)
+{
+	x = SimdMin( SimdMax(x, SimdSet(-87.3365f)), SimdSet(88.0f) );
+	SimdFloat n = SimdRound( SimdMul(x, SimdSet(1.44269504088896341f)) );
+	x = SimdFmadd(n, SimdSet(-0.693359375f), x);
+	x = SimdFmadd(n, SimdSet(2.12194440e-4f), x);
+	SimdFloat y = SimdSet(1.9875691500e-4f);
+	y = SimdFmadd(y, x, SimdSet(1.3981999507e-3f));
+	y = SimdFmadd(y, x, SimdSet(8.3334519073e-3f));
+	y = SimdFmadd(y, x, SimdSet(4.1665795894e-2f));
+	y = SimdFmadd(y, x, SimdSet(1.6666665459e-1f));
+	y = SimdFmadd(y, x, SimdSet(5.0000001201e-1f));
+	y = SimdFmadd(y, SimdMul(x, x), SimdAdd(x, SimdSet(1.0f)));
+	return SimdScale(y, n);
+}
+
+// exp with the relative error below 1e-4 (degree 4 polynomial after the range reduction), for the callers that trade accuracy for speed
+inline SimdFloat SimdExpFast(SimdFloat x)
+{
+	x = SimdMin( SimdMax(x, SimdSet(-87.3365f)), SimdSet(88.0f) );
+	SimdFloat n = SimdRound( SimdMul(x, SimdSet(1.44269504088896341f)) );
+	x = SimdFmadd(n, SimdSet(-0.693147180559945f), x);
+	SimdFloat y = SimdSet(4.1666666667e-2f);
+	y = SimdFmadd(y, x, SimdSet(1.6666666667e-1f));
+	y = SimdFmadd(y, x, SimdSet(0.5f));
+	y = SimdFmadd(y, x, SimdSet(1.0f));
+	y = SimdFmadd(y, x, SimdSet(1.0f));
+	return SimdScale(y, n);
+}
+
+inline float SimdReduceAdd(SimdFloat x)
+{
+	float values[simd_float_width];
+	SimdStore(values, x);
+	float sum = 0;
+	for (size_t i=0; i<simd_float_width; i++)
+		sum += values[i];
+	return sum;
+}
+
+inline float SimdReduceMax(SimdFloat x)
+{
+	float values[simd_float_width];
+	SimdStore(values, x);
+	float max_value = values[0];
+	for (size_t i=1; i<simd_float_width; i++)
+		max_value = values[i] > max_value ? values[i] : max_value;
+	return max_value;
+}
+#endif
+
+#endif
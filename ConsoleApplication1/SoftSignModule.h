@@ -2,6 +2,7 @@
 #define SOFTSIGN_MODULE_H
 
 #include "Module.h"
+#include "ActivationKernels.h"
 
 template <class ParamsType>
 class SoftSignModule : public Module<ParamsType>
@@ -21,6 +22,27 @@ public:
 	{
 		return module.GetType() == GetType() && module.GetName() == GetName();
 	}
+
+	virtual bool OverwritesOutputBuffer() const
+	{
+		return true;
+	}
+
+	virtual bool OverwritesInputGradientsBuffer() const
+	{
+		return true;
+	}
+
+	virtual ActivationType GetActivationType() const
+	{
+		return softsign_activation;
+	}
+
+	// the gradient is computed from the output
+	virtual bool BpropUsesInput() const
+	{
+		return false;
+	}
 	
 	static std::shared_ptr< Module< ParamsType> > Create(IOTreeNode& data);
 
@@ -48,13 +70,7 @@ std::shared_ptr< Module< ParamsType> > SoftSignModule<ParamsType>::Create(IOTree
 template <class ParamsType>
 void SoftSignModule<ParamsType>::sub_train_fprop(const std::shared_ptr< Tensor<ParamsType> >& input, std::shared_ptr< Tensor<ParamsType> >& output)
 {
-	Tensor<ParamsType>& input_tensor = *input;
-	Tensor<ParamsType>& output_tensor = *output;
-	for (size_t i = 0; i<input->Numel(); i++)
-	{
-		ParamsType in = input_tensor[i];
-		output_tensor[i] = static_cast<ParamsType>(in / (1.0 + std::abs(in)));
-	}
+	ElementwiseActivation<SoftSignActivation, ParamsType>::fprop(input->GetStartPtr(), output->GetStartPtr(), input->Numel());
 }
 
 template <class ParamsType>
@@ -62,17 +78,8 @@ void SoftSignModule<ParamsType>::sub_bprop(const std::shared_ptr< Tensor<ParamsT
 	std::shared_ptr< Tensor<ParamsType> >& input_gradients, const std::shared_ptr< Tensor<ParamsType> >& output_gradients, 
 	const std::vector<ParamsType>& samples_importances)
 {
-	Tensor<ParamsType>& input_tensor = *input;
-	Tensor<ParamsType>& input_gradients_tensor = *input_gradients;
-	Tensor<ParamsType>& output_gradients_tensor = *output_gradients;
-	Tensor<ParamsType>& output_tensor = *output;
-	for (size_t i = 0; i<input_tensor.Numel(); i++)
-	{
-		ParamsType in = input_tensor[i];
-		ParamsType out = output_tensor[i];
-		input_tensor[i] = out/in*(1-std::abs(out));
-		input_gradients_tensor[i] = out/in*(1-std::abs(out))*output_gradients_tensor[i];
-	}
+	ElementwiseActivation<SoftSignActivation, ParamsType>::bprop(input->GetStartPtr(), output->GetStartPtr(), output_gradients->GetStartPtr(), 
+		input_gradients->GetStartPtr(), input->Numel());
 }
 
 #endif
\ No newline at end of file
@@ -0,0 +1,165 @@
+#ifndef SOFTMAX_KERNELS_H
+#define SOFTMAX_KERNELS_H
+
+#include <cmath>
+#include <string>
+#include <stdexcept>
+#include "SimdOperations.h"
+
+// Kernels of SoftmaxModule and BatchSoftmaxModule. The maximum is subtracted from the inputs before exp(), so exp() does not
+// overflow, and exp() is computed once per element. Floats are vectorized if NNLIB_SIMD_FLOAT is defined
+
+// exp() used for floats in vectorized code, scalar code (doubles, builds without NNLIB_SIMD_FLOAT) always uses std::exp
+enum ExpPrecision
+{
+	precise_exp,	// std::exp
+	vectorized_exp,	// SimdExp, a few float ulps
+	fast_exp		// SimdExpFast, the relative error below 1e-4
+};
+
+inline std::string GetExpPrecisionName(ExpPrecision precision)
+{
+	switch (precision)
+	{
+	case precise_exp: return "precise";
+	case vectorized_exp: return "vectorized";
+	case fast_exp: return "fast";
+	}
+	throw std::runtime_error("Unknown exp precision");
+}
+
+inline ExpPrecision GetExpPrecisionByName(const std::string& name)
+{
+	const ExpPrecision precisions[] = {precise_exp, vectorized_exp, fast_exp};
+	for (size_t i=0; i<sizeof(precisions)/sizeof(precisions[0]); i++)
+		if (GetExpPrecisionName(precisions[i]) == name)
+			return precisions[i];
+	throw std::runtime_error("Unknown exp precision " + name);
+}
+
+template <class T>
+T MaxElement(const T* data, size_t num_elements)
+{
+	T max_value = data[0];
+	for (size_t i=1; i<num_elements; i++)
+		max_value = data[i] > max_value ? data[i] : max_value;
+	return max_value;
+}
+
+// output[i] = exp(input[i]-shift), returns the sum of the outputs
+template <class T>
+T ShiftedExp(const T* input, T shift, T* output, size_t num_elements, ExpPrecision precision)
+{
+	T sum = 0;
+	for (size_t i=0; i<num_elements; i++)
+	{
+		output[i] = std::exp(input[i]-shift);
+		sum += output[i];
+	}
+	return sum;
+}
+
+// output[i] = exp(input[i]-shifts[i])
+template <class T>
+void ShiftedExp(const T* input, const T* shifts, T* output, size_t num_elements, ExpPrecision precision)
+{
+	for (size_t i=0; i<num_elements; i++)
+		output[i] = std::exp(input[i]-shifts[i]);
+}
+
+template <class T>
+T SumOfProducts(const T* x1, const T* x2, size_t num_elements)
+{
+	T sum = 0;
+	for (size_t i=0; i<num_elements; i++)
+		sum += x1[i]*x2[i];
+	return sum;
+}
+
+#ifdef NNLIB_SIMD_FLOAT
+inline float MaxElement(const float* data, size_t num_elements)
+{
+	if (num_elements < simd_float_width)
+		return MaxElement<float>(data, num_elements);
+	SimdFloat simd_max = SimdLoad(data);
+	size_t i = simd_float_width;
+	for (; i+simd_float_width<=num_elements; i+=simd_float_width)
+		simd_max = SimdMax(simd_max, SimdLoad(data+i));
+	float max_value = SimdReduceMax(simd_max);
+	for (; i<num_elements; i++)
+		max_value = data[i] > max_value ? data[i] : max_value;
+	return max_value;
+}
+
+inline SimdFloat SimdExp(SimdFloat x, ExpPrecision precision)
+{
+	return precision == fast_exp ? SimdExpFast(x) : SimdExp(x);
+}
+
+inline float ShiftedExp(const float* input, float shift, float* output, size_t num_elements, ExpPrecision precision)
+{
+	size_t i = 0;
+	float sum = 0;
+	if (precision != precise_exp)
+	{
+		SimdFloat simd_shift = SimdSet(shift);
+		SimdFloat simd_sum = SimdSet(0.0f);
+		for (; i+simd_float_width<=num_elements; i+=simd_float_width)
+		{
+			SimdFloat exp_values = SimdExp(SimdSub(SimdLoad(input+i), simd_shift), precision);
+			SimdStore(output+i, exp_values);
+			simd_sum = SimdAdd(simd_sum, exp_values);
+		}
+		sum = SimdReduceAdd(simd_sum);
+	}
+	for (; i<num_elements; i++)
+	{
+		output[i] = std::exp(input[i]-shift);
+		sum += output[i];
+	}
+	return sum;
+}
+
+inline void ShiftedExp(const float* input, const float* shifts, float* output, size_t num_elements, ExpPrecision precision)
+{
+	size_t i = 0;
+	if (precision != precise_exp)
+		for (; i+simd_float_width<=num_elements; i+=simd_float_width)
+			SimdStore( output+i, SimdExp(SimdSub(SimdLoad(input+i), SimdLoad(shifts+i)), precision) );
+	for (; i<num_elements; i++)
+		output[i] = std::exp(input[i]-shifts[i]);
+}
+
+inline float SumOfProducts(const float* x1, const float* x2, size_t num_elements)
+{
+	size_t i = 0;
+	SimdFloat simd_sum = SimdSet(0.0f);
+	for (; i+simd_float_width<=num_elements; i+=simd_float_width)
+		simd_sum = SimdFmadd(SimdLoad(x1+i), SimdLoad(x2+i), simd_sum);
+	float sum = SimdReduceAdd(simd_sum);
+	for (; i<num_elements; i++)
+		sum += x1[i]*x2[i];
+	return sum;
+}
+#endif
+
+// softmax of one sample, the output can be the same array as the input
+template <class T>
+void SoftmaxFprop(const T* input, T* output, size_t num_features, ExpPrecision precision)
+{
+	T max_value = MaxElement(input, num_features);
+	T normalizer = 1 / ShiftedExp(input, max_value, output, num_features, precision);
+	for (size_t i=0; i<num_features; i++)
+		output[i] *= normalizer;
+}
+
+// gradients of softmax of one sample: output*(output_gradients - <output, output_gradients>)
+template <class T>
+void SoftmaxBprop(const T* output, const T* output_gradients, T* input_gradients, size_t num_features)
+{
+	T weighted_gradient = SumOfProducts(output, output_gradients, num_features);
+	for (size_t i=0; i<num_features; i++)
+		input_gradients[i] = output[i] * (output_gradients[i] - weighted_gradient);
+}
+
+#endif
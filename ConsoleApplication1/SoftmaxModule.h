@@ -2,13 +2,19 @@
 #define SOFTMAX_MODULE_H
 
 #include "Module.h"
+#include "SoftmaxKernels.h"
 
 template <class ParamsType>
 class SoftmaxModule : public Module<ParamsType>
 {
+	ExpPrecision exp_precision_;
+	// the output gradients are the gradients with respect to the input (see CrossEntropyCostModule::FuseSoftmax).
+	// A pairing with the cost module at run time, it is not saved with the state of the module
+	bool fused_cross_entropy_;
+
 public:
 
-	SoftmaxModule( std::string name) : Module<ParamsType>(name)
+	SoftmaxModule( std::string name) : Module<ParamsType>(name), exp_precision_(vectorized_exp), fused_cross_entropy_(false)
 	{
 	}
 
@@ -16,82 +22,134 @@ public:
 	{
 		return "SoftmaxModule";
 	}
-	
+
 	virtual bool Equals(const Module<ParamsType>& module) const
 	{
-		return module.GetType() == GetType() && module.GetName() == GetName();
+		if (module.GetType() != GetType() || module.GetName() != GetName())
+			return false;
+		const SoftmaxModule<ParamsType>& softmax_module = static_cast<const SoftmaxModule<ParamsType>&>(module);
+		return softmax_module.exp_precision_ == exp_precision_;
+	}
+
+	virtual bool AlocateInputGradientsBuffer() const
+	{
+		return !fused_cross_entropy_;
+	}
+
+	virtual bool OverwritesOutputBuffer() const
+	{
+		return true;
+	}
+
+	virtual bool OverwritesInputGradientsBuffer() const
+	{
+		return true;
 	}
-	
+
+	// the gradients are computed from the output
+	virtual bool BpropUsesInput() const
+	{
+		return false;
+	}
+
+	// exp() of the floats in vectorized builds, vectorized_exp by default
+	void SetExpPrecision(ExpPrecision exp_precision)
+	{
+		exp_precision_ = exp_precision;
+	}
+
+	ExpPrecision GetExpPrecision() const
+	{
+		return exp_precision_;
+	}
+
+	// bprop passes the output gradients through as the input gradients. Set by CrossEntropyCostModule::FuseSoftmax,
+	// whose bprop then returns the gradients with respect to the input of softmax
+	void SetFusedCrossEntropy(bool fused_cross_entropy)
+	{
+		fused_cross_entropy_ = fused_cross_entropy;
+	}
+
+	bool GetFusedCrossEntropy() const
+	{
+		return fused_cross_entropy_;
+	}
+
+	virtual bool IsFusedWithCost() const
+	{
+		return fused_cross_entropy_;
+	}
+
+	// the replicas of the network (see NN::SetNumThreads, HogwildTrainer) are trained with the cost module of the network
+	virtual void CopyTrainState(const Module<ParamsType>& module)
+	{
+		fused_cross_entropy_ = static_cast< const SoftmaxModule<ParamsType>& >(module).fused_cross_entropy_;
+	}
+
 	static std::shared_ptr< Module< ParamsType> > Create(IOTreeNode& data);
 
 protected:
 	virtual void sub_train_fprop(const std::shared_ptr< Tensor<ParamsType> >& input, std::shared_ptr< Tensor<ParamsType> >& output);
-	
-	virtual void sub_bprop(const std::shared_ptr< Tensor<ParamsType> >& input, const std::shared_ptr< Tensor<ParamsType> >& output, 
-		std::shared_ptr< Tensor<ParamsType> >& input_gradients, const std::shared_ptr< Tensor<ParamsType> >& output_gradients, 
+
+	virtual void sub_bprop(const std::shared_ptr< Tensor<ParamsType> >& input, const std::shared_ptr< Tensor<ParamsType> >& output,
+		std::shared_ptr< Tensor<ParamsType> >& input_gradients, const std::shared_ptr< Tensor<ParamsType> >& output_gradients,
 		const std::vector<ParamsType>& samples_importances);
 
 	virtual void sub_GetState(IOTreeNode& node) const;
 };
 
+// the attributes are written only if they differ from the defaults, so the states of other modules do not change
 template <class ParamsType>
 void SoftmaxModule<ParamsType>::sub_GetState(IOTreeNode& node) const
 {
+	if (exp_precision_ != vectorized_exp)
+		node.attributes().AppendEntry( "exp_precision", GetExpPrecisionName(exp_precision_) );
 }
 
 template <class ParamsType>
 std::shared_ptr< Module< ParamsType> > SoftmaxModule<ParamsType>::Create(IOTreeNode& data)
 {
-	return std::shared_ptr< Module< ParamsType> >( new SoftmaxModule<ParamsType>(data.attributes().GetEntry( "Name" ) ));
+	std::shared_ptr< SoftmaxModule<ParamsType> > module( new SoftmaxModule<ParamsType>(data.attributes().GetEntry( "Name" )) );
+	if (data.attributes().HasEntry( "exp_precision" ))
+		module->SetExpPrecision( GetExpPrecisionByName(data.attributes().GetEntry( "exp_precision" )) );
+	return module;
 }
 
 template <class ParamsType>
 void SoftmaxModule<ParamsType>::sub_train_fprop(const std::shared_ptr< Tensor<ParamsType> >& input, std::shared_ptr< Tensor<ParamsType> >& output)
-{	
-	Tensor<ParamsType>& input_tensor = *input;
-	Tensor<ParamsType>& output_tensor = *output;
-	size_t minibatch_size = input_tensor.GetDimensionSize(input_tensor.NumDimensions()-1);
-	size_t num_features = input_tensor.Numel() / minibatch_size;
+{
+	size_t minibatch_size = input->GetDimensionSize(input->NumDimensions()-1);
+	size_t num_features = input->Numel() / minibatch_size;
+	const ParamsType* input_ptr = input->GetStartPtr();
+	ParamsType* output_ptr = output->GetStartPtr();
 	for (size_t sample_ind = 0; sample_ind<minibatch_size; sample_ind++)
 	{
 		size_t offset = num_features*sample_ind;
-		double min_feature_val = *std::min_element(input_tensor.GetStartPtr()+offset, input_tensor.GetStartPtr()+offset+num_features);
-		double partition_val = 0;
-		for (size_t i=0; i<num_features; i++)
-			partition_val += std::exp(input_tensor[offset+i]-min_feature_val);
-
-		for (size_t feature_ind = 0; feature_ind<num_features; feature_ind++)
-		{
-			size_t feature_offset = offset+feature_ind;
-			output_tensor[feature_offset] = static_cast<ParamsType>(std::exp(input_tensor[feature_offset]-min_feature_val)/partition_val);
-		}
+		SoftmaxFprop(input_ptr+offset, output_ptr+offset, num_features, exp_precision_);
 	}
 }
 
 template <class ParamsType>
-void SoftmaxModule<ParamsType>::sub_bprop(const std::shared_ptr< Tensor<ParamsType> >& input, const std::shared_ptr< Tensor<ParamsType> >& output, 
-	std::shared_ptr< Tensor<ParamsType> >& input_gradients, const std::shared_ptr< Tensor<ParamsType> >& output_gradients, 
+void SoftmaxModule<ParamsType>::sub_bprop(const std::shared_ptr< Tensor<ParamsType> >& input, const std::shared_ptr< Tensor<ParamsType> >& output,
+	std::shared_ptr< Tensor<ParamsType> >& input_gradients, const std::shared_ptr< Tensor<ParamsType> >& output_gradients,
 	const std::vector<ParamsType>& samples_importances)
 {
-	Tensor<ParamsType>& input_tensor = *input;
-	Tensor<ParamsType>& output_tensor = *output;
-	Tensor<ParamsType>& input_gradients_tensor = *input_gradients;
-	Tensor<ParamsType>& output_gradients_tensor = *output_gradients;
-	size_t minibatch_size = output_tensor.GetDimensionSize(output_tensor.NumDimensions()-1);
-	size_t num_features = output_tensor.Numel() / minibatch_size;
+	if (fused_cross_entropy_)
+	{
+		input_gradients = output_gradients;
+		return;
+	}
 
+	size_t minibatch_size = output->GetDimensionSize(output->NumDimensions()-1);
+	size_t num_features = output->Numel() / minibatch_size;
+	const ParamsType* output_ptr = output->GetStartPtr();
+	const ParamsType* output_gradients_ptr = output_gradients->GetStartPtr();
+	ParamsType* input_gradients_ptr = input_gradients->GetStartPtr();
 	for (size_t sample_ind = 0; sample_ind<minibatch_size; sample_ind++)
 	{
-		size_t sample_offset = num_features*sample_ind;
-
-		double weighted_gradient = 0;
-		for (size_t i=0; i<num_features; i++)
-			weighted_gradient += static_cast<ParamsType>(output_tensor[sample_offset+i] * output_gradients_tensor[sample_offset+i]);
-
-		for (size_t i = 0; i<num_features; i++)
-			input_gradients_tensor[sample_offset+i] = static_cast<ParamsType>(  output_tensor[sample_offset+i] * 
-				( output_gradients_tensor[sample_offset+i] - weighted_gradient ) );
+		size_t offset = num_features*sample_ind;
+		SoftmaxBprop(output_ptr+offset, output_gradients_ptr+offset, input_gradients_ptr+offset, num_features);
 	}
 }
 
-#endif
\ No newline at end of file
+#endif
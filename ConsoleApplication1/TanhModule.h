@@ -2,6 +2,7 @@
 #define TANH_MODULE_H
 
 #include "Module.h"
+#include "ActivationKernels.h"
 
 template <class ParamsType>
 class TanhModule : public Module<ParamsType>
@@ -21,27 +22,42 @@ public:
 	{
 		return module.GetType() == GetType() && module.GetName() == GetName();
 	}
+
+	virtual bool OverwritesOutputBuffer() const
+	{
+		return true;
+	}
+
+	virtual bool OverwritesInputGradientsBuffer() const
+	{
+		return true;
+	}
+
+	virtual ActivationType GetActivationType() const
+	{
+		return tanh_activation;
+	}
+
+	// the gradient is computed from the output
+	virtual bool BpropUsesInput() const
+	{
+		return false;
+	}
 	
 	static std::shared_ptr< Module< ParamsType> > Create(IOTreeNode& data);
 
 protected:
 	virtual void sub_train_fprop(const std::shared_ptr< Tensor<ParamsType> >& input, std::shared_ptr< Tensor<ParamsType> >& output)
 	{
-		size_t numel = input->Numel();
-		for (size_t i = 0; i<numel; i++)
-			(*output)[i] = (ParamsType)(2.0 / (1.0 + std::exp(-2*(*input)[i]))-1);
+		ElementwiseActivation<TanhActivation, ParamsType>::fprop(input->GetStartPtr(), output->GetStartPtr(), input->Numel());
 	}
 
 	virtual void sub_bprop(const std::shared_ptr< Tensor<ParamsType> >& input, const std::shared_ptr< Tensor<ParamsType> >& output, 
 		std::shared_ptr< Tensor<ParamsType> >& input_gradients, const std::shared_ptr< Tensor<ParamsType> >& output_gradients, 
 		const std::vector<ParamsType>& samples_importances)
 	{
-		size_t numel = input->Numel();
-		for (size_t i = 0; i<numel; i++)
-		{
-			ParamsType out = (*output)[i];
-			(*input_gradients)[i] = (1-out*out)*(*output_gradients)[i];
-		}
+		ElementwiseActivation<TanhActivation, ParamsType>::bprop(input->GetStartPtr(), output->GetStartPtr(), output_gradients->GetStartPtr(), 
+			input_gradients->GetStartPtr(), input->Numel());
 	}
 
 	virtual void sub_GetState(IOTreeNode& node) const;
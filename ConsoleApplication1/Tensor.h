@@ -4,6 +4,8 @@
 #include <vector>
 #include <memory>
 #include <cassert>
+#include "TensorShape.h"
+#include "MemoryPool.h"
 
 template <class DataType> class Tensor;
 
@@ -18,14 +20,24 @@ class Tensor
 {
 private:
 	DataType* data_ptr;
-	std::vector<size_t> dimensions;
-	std::vector<size_t> dim_strides;
+	TensorShape shape;
 	bool owns_data;
 	
 	static void Tensor<DataType>::AppendValidTensorOffsets(std::vector<size_t>& valid_tensor_offsets, std::vector<size_t>& tensor_dims, 
 													std::vector<size_t>& tensor_strides, size_t current_offset, 
 													size_t dim_ind, std::vector<size_t> margins_left, std::vector<size_t> margins_right, std::vector<size_t>& strides);
 	void Copy(const Tensor& tensor);
+
+	// the owned data comes from the pool, it is aligned and its memory is reused by the next tensors
+	static DataType* AllocateData(size_t numel)
+	{
+		return static_cast<DataType*>( MemoryPool::GetInstance().Allocate(numel*sizeof(DataType)) );
+	}
+
+	static void ReleaseData(DataType* data_ptr)
+	{
+		MemoryPool::GetInstance().Deallocate(data_ptr);
+	}
 	
 public:
 
@@ -33,6 +45,8 @@ public:
 	// constructors
 	Tensor(DataType* data_ptr, const std::vector<size_t>& dimensions);
 	Tensor(const std::vector<size_t>& dimensions);
+	Tensor(DataType* data_ptr, const TensorShape& shape);
+	explicit Tensor(const TensorShape& shape);
 	Tensor(const Tensor<DataType>& tensor);
 	Tensor();
 	~Tensor();
@@ -51,6 +65,7 @@ public:
 	DataType* GetStartPtr();
 	const DataType* GetStartPtr() const;
 	void SetDataPtr(DataType* data_ptr);
+	void Allocate(); // gives owned zeros to the tensor, e.g. to a tensor created without memory by Tensor(0, dimensions)
 
 	// kernel Info
 	bool OwnsData() const; // whether it is responsible for deallocation of data
@@ -63,6 +78,17 @@ public:
 	bool DimensionsEqual(const Tensor<DataType>& tensor) const;
 	size_t GetDimensionSize(size_t ind) const;
 	std::vector<size_t> GetDimensions() const;
+	const TensorShape& GetShape() const; // allocation free alternative to GetDimensions
+	bool IsContiguous() const; // operator[] and the loops over GetStartPtr() assume contiguous tensors
+
+	// views, they do not own the data and keep the strides of the tensor, so no elements are copied
+	// ... elements from start to start+count of the dimension
+	Tensor<DataType> Slice(size_t dim_ind, size_t start, size_t count);
+	// ... element index of the dimension, the dimension is removed (e.g. a sample of a minibatch)
+	Tensor<DataType> Select(size_t dim_ind, size_t index);
+	Tensor<DataType> Transpose(size_t dim_ind1, size_t dim_ind2);
+	// ... box of the given dimensions that starts at the given position
+	Tensor<DataType> Crop(const std::vector<size_t>& start, const std::vector<size_t>& dims);
 	
 	// general operations
 	// ... number of elements in a tensor with given dimensions
@@ -79,18 +105,54 @@ public:
 												   std::vector<size_t> margins_left, std::vector<size_t> margins_right, std::vector<size_t> strides);
 };
 
+// copies the elements of a tensor (possibly a strided view) to contiguous memory in the column-major order, converting them to To
+template <class From, class To>
+void CopyTensorElements(const Tensor<From>& from, To* to)
+{
+	const TensorShape& shape = from.GetShape();
+	const From* from_ptr = from.GetStartPtr();
+	if (shape.IsContiguous() || shape.Numel() == 0)
+	{
+		for (size_t i=0; i<shape.Numel(); i++)
+			to[i] = static_cast<To>(from_ptr[i]);
+		return;
+	}
+
+	// rows along the first dimension, the position of a row in the other dimensions is advanced like an odometer
+	size_t row_length = shape[0];
+	size_t row_stride = shape.GetStride(0);
+	size_t num_rows = shape.Numel() / row_length;
+	size_t row_pos[TensorShape::max_rank] = {0};
+	for (size_t row_ind = 0; row_ind<num_rows; row_ind++, to += row_length)
+	{
+		for (size_t i=0; i<row_length; i++)
+			to[i] = static_cast<To>(from_ptr[i*row_stride]);
+		for (size_t dim_ind = 1; dim_ind<shape.size(); dim_ind++)
+		{
+			from_ptr += shape.GetStride(dim_ind);
+			if (++row_pos[dim_ind] < shape[dim_ind])
+				break;
+			from_ptr -= shape.GetStride(dim_ind)*shape[dim_ind];
+			row_pos[dim_ind] = 0;
+		}
+	}
+}
+
+// compares the dimensions and the values but not the ownership of the data, e.g. for the parameters
+// of modules that may be views of the parameters of NN
 template <class DataType>
-bool operator==(const Tensor<DataType>& tensor1, const Tensor<DataType>& tensor2)
+bool EqualValues(const Tensor<DataType>& tensor1, const Tensor<DataType>& tensor2)
 {
-	if (tensor1.GetDimensions() != tensor2.GetDimensions())
-		return false;
-	if ( tensor1.GetStrides() != tensor2.GetStrides() )
-		return false;
-	if (tensor1.OwnsData() != tensor2.OwnsData())
+	if (tensor1.GetShape() != tensor2.GetShape())
 		return false;
+	if (!tensor1.IsContiguous() || !tensor2.IsContiguous())
+	{
+		Tensor<DataType> contiguous1(tensor1.GetShape()), contiguous2(tensor2.GetShape());
+		CopyTensorElements(tensor1, contiguous1.GetStartPtr());
+		CopyTensorElements(tensor2, contiguous2.GetStartPtr());
+		return EqualValues(contiguous1, contiguous2);
+	}
 
-	// When tensors don't own the data and point to other memory locations it is not considered a problem
-	// This is required to test save / load tensor functionality
 	size_t numel = tensor1.Numel();
 	for (size_t i=0; i<numel; i++)
 		if ( abs(tensor1[i] - tensor2[i])>0.000001 )
@@ -98,6 +160,17 @@ bool operator==(const Tensor<DataType>& tensor1, const Tensor<DataType>& tensor2
 	return true;
 }
 
+template <class DataType>
+bool operator==(const Tensor<DataType>& tensor1, const Tensor<DataType>& tensor2)
+{
+	if (tensor1.OwnsData() != tensor2.OwnsData())
+		return false;
+
+	// When tensors don't own the data and point to other memory locations it is not considered a problem
+	// This is required to test save / load tensor functionality
+	return EqualValues(tensor1, tensor2);
+}
+
 template <class DataType>
 bool operator!=(const Tensor<DataType>& tensor1, const Tensor<DataType>& tensor2)
 {
@@ -107,7 +180,7 @@ bool operator!=(const Tensor<DataType>& tensor1, const Tensor<DataType>& tensor2
 template <class DataType>
 std::vector<size_t> Tensor<DataType>::GetStrides() const
 {
-	return Tensor<DataType>::GetStrides(GetDimensions());
+	return shape.GetStrides();
 }
 
 template <class DataType>
@@ -121,7 +194,7 @@ void Tensor<DataType>::SetDataPtr(DataType* data_ptr)
 {
 	if (owns_data)
 	{
-		delete[] data_ptr;
+		ReleaseData(this->data_ptr);
 		owns_data = false;
 	}
 	this->data_ptr = data_ptr;
@@ -225,13 +298,13 @@ void Tensor<DataType>::GetValidOffsetsInds(std::vector<size_t>& out_offsets, std
 template <class DataType>
 bool Tensor<DataType>::DimensionsEqual(const std::vector<size_t>& other_dims) const
 {
-	return dimensions == other_dims;
+	return shape == other_dims;
 }
 
 template <class DataType>
 bool Tensor<DataType>::DimensionsEqual(const Tensor<DataType>& tensor) const
 {
-	return dimensions == tensor.dimensions;
+	return shape == tensor.shape;
 }
 
 template <class DataType>
@@ -245,19 +318,28 @@ std::vector<size_t> Tensor<DataType>::GetStrides(const std::vector<size_t>& dime
 }
 
 template <class DataType>
-Tensor<DataType>::Tensor(DataType* data_ptr, const std::vector<size_t>& dimensions) : owns_data(false)
+Tensor<DataType>::Tensor(DataType* data_ptr, const std::vector<size_t>& dimensions) : shape(dimensions), owns_data(false)
 {
 	this->data_ptr = data_ptr;
-	this->dimensions = dimensions;
-	dim_strides = Tensor<DataType>::GetStrides(dimensions);
 }
 
 template <class DataType>
-Tensor<DataType>::Tensor(const std::vector<size_t>& dimensions) : owns_data(true)
+Tensor<DataType>::Tensor(const std::vector<size_t>& dimensions) : shape(dimensions), owns_data(true)
 {
-	this->dimensions = dimensions;
-	dim_strides = Tensor<DataType>::GetStrides(dimensions);
-	data_ptr = new DataType[this->Numel()];
+	data_ptr = AllocateData(this->Numel());
+	this->SetZeros();
+}
+
+template <class DataType>
+Tensor<DataType>::Tensor(DataType* data_ptr, const TensorShape& shape) : shape(shape), owns_data(false)
+{
+	this->data_ptr = data_ptr;
+}
+
+template <class DataType>
+Tensor<DataType>::Tensor(const TensorShape& shape) : shape(shape.GetContiguous()), owns_data(true)
+{
+	data_ptr = AllocateData(this->Numel());
 	this->SetZeros();
 }
 
@@ -270,15 +352,14 @@ Tensor<DataType>::Tensor() : owns_data(false)
 template <class DataType>
 void Tensor<DataType>::Copy(const Tensor& tensor)
 {
-	this->dimensions = tensor.dimensions;
-	this->dim_strides = tensor.dim_strides;
+	this->shape = tensor.shape;
 	if (this->owns_data)
-		delete[] this->data_ptr;
+		ReleaseData(this->data_ptr);
 	this->owns_data = tensor.owns_data;
 
 	if (this->owns_data)
 	{
-		this->data_ptr = new DataType[this->Numel()];
+		this->data_ptr = AllocateData(this->Numel());
 		for (size_t i=0; i<tensor.Numel(); i++)
 			this->data_ptr[i] = tensor.data_ptr[i];
 	}
@@ -304,17 +385,14 @@ Tensor<DataType>& Tensor<DataType>::operator=(const Tensor& tensor)
 template <class DataType>
 size_t Tensor<DataType>::Numel() const
 {
-	size_t numel = 1;
-	for (size_t dim_ind = 0; dim_ind<dimensions.size(); dim_ind++)
-		numel*=dimensions[dim_ind];
-	return numel;
+	return shape.Numel();
 }
 
 template <class DataType>
 size_t Tensor<DataType>::GetDimStride(size_t dim_num) const
 {
 	if (dim_num<NumDimensions())
-		return dim_strides[dim_num];
+		return shape.GetStride(dim_num);
 	else
 		return Numel();
 }
@@ -323,8 +401,8 @@ template <class DataType>
 DataType* Tensor<DataType>::GetPtr(const size_t* dims)
 {
 	size_t offset = 0;
-	for (size_t dim_ind = 0; dim_ind<dimensions.size(); dim_ind++)
-		offset+=GetDimStride(dim_ind)*dims[dim_ind];
+	for (size_t dim_ind = 0; dim_ind<shape.size(); dim_ind++)
+		offset+=shape.GetStride(dim_ind)*dims[dim_ind];
 	return data_ptr+offset;
 }
 
@@ -332,8 +410,8 @@ template <class DataType>
 const DataType* Tensor<DataType>::GetPtr(const size_t* dims) const
 {
 	size_t offset = 0;
-	for (size_t dim_ind = 0; dim_ind<dimensions.size(); dim_ind++)
-		offset+=GetDimStride(dim_ind)*dims[dim_ind];
+	for (size_t dim_ind = 0; dim_ind<shape.size(); dim_ind++)
+		offset+=shape.GetStride(dim_ind)*dims[dim_ind];
 	return data_ptr+offset;
 }
 
@@ -349,14 +427,14 @@ size_t Tensor<DataType>::Numel(const std::vector<size_t>& dimensions)
 template <class DataType>
 size_t Tensor<DataType>::NumDimensions() const
 {
-	return dimensions.size();
+	return shape.size();
 }
 
 template <class DataType>
 size_t Tensor<DataType>::GetDimensionSize(size_t ind) const
 {
-	if (ind<dimensions.size())
-		return dimensions[ind];
+	if (ind<shape.size())
+		return shape[ind];
 	else
 		return 1;
 }
@@ -380,10 +458,72 @@ void Tensor<DataType>::SetZeros()
 	std::fill(data_ptr, data_ptr+Numel(), static_cast<DataType>(0));
 }
 
+template <class DataType>
+void Tensor<DataType>::Allocate()
+{
+	if (owns_data)
+		ReleaseData(data_ptr);
+	shape = shape.GetContiguous();
+	data_ptr = AllocateData(Numel());
+	owns_data = true;
+	SetZeros();
+}
+
 template <class DataType>
 std::vector<size_t> Tensor<DataType>::GetDimensions() const
 {
-	return dimensions;
+	return shape.GetDimensions();
+}
+
+template <class DataType>
+const TensorShape& Tensor<DataType>::GetShape() const
+{
+	return shape;
+}
+
+template <class DataType>
+bool Tensor<DataType>::IsContiguous() const
+{
+	return shape.IsContiguous();
+}
+
+template <class DataType>
+Tensor<DataType> Tensor<DataType>::Slice(size_t dim_ind, size_t start, size_t count)
+{
+	assert( dim_ind < NumDimensions() && start + count <= shape[dim_ind] );
+	TensorShape slice_shape = shape;
+	slice_shape.SetDimension(dim_ind, count);
+	return Tensor<DataType>(data_ptr + start*shape.GetStride(dim_ind), slice_shape);
+}
+
+template <class DataType>
+Tensor<DataType> Tensor<DataType>::Select(size_t dim_ind, size_t index)
+{
+	assert( dim_ind < NumDimensions() && index < shape[dim_ind] );
+	TensorShape select_shape = shape;
+	select_shape.RemoveDimension(dim_ind);
+	return Tensor<DataType>(data_ptr + index*shape.GetStride(dim_ind), select_shape);
+}
+
+template <class DataType>
+Tensor<DataType> Tensor<DataType>::Transpose(size_t dim_ind1, size_t dim_ind2)
+{
+	TensorShape transposed_shape = shape;
+	transposed_shape.SwapDimensions(dim_ind1, dim_ind2);
+	return Tensor<DataType>(data_ptr, transposed_shape);
+}
+
+template <class DataType>
+Tensor<DataType> Tensor<DataType>::Crop(const std::vector<size_t>& start, const std::vector<size_t>& dims)
+{
+	assert( start.size() == NumDimensions() && dims.size() == NumDimensions() );
+	TensorShape crop_shape = shape;
+	for (size_t dim_ind = 0; dim_ind<dims.size(); dim_ind++)
+	{
+		assert( start[dim_ind] + dims[dim_ind] <= shape[dim_ind] );
+		crop_shape.SetDimension(dim_ind, dims[dim_ind]);
+	}
+	return Tensor<DataType>(GetPtr(start.data()), crop_shape);
 }
 
 template <class DataType>
@@ -416,7 +556,7 @@ template <class DataType>
 Tensor<DataType>::~Tensor()
 {
 	if (owns_data)
-		delete[] data_ptr;
+		ReleaseData(data_ptr);
 }
 
 #endif
\ No newline at end of file
@@ -3,6 +3,7 @@
 
 #include <iostream>
 #include <fstream>
+#include <assert.h>
 #include "IOTreeNode.h"
 #include "Tensor.h"
 #include "Converter.h"
@@ -12,16 +13,29 @@ std::shared_ptr<IOTreeNode> GetTensorState(const Tensor<T>& tensor)
 {
 	std::shared_ptr< IOTreeNode> parameters_node = std::shared_ptr< IOTreeNode>( new IOTreeNode() );
 	parameters_node->attributes().AppendEntry( "dims", Converter::ConvertVectorToString( tensor.GetDimensions() ) );
-	parameters_node->attributes().AppendEntry( "parameters", Converter::ConvertArrayToString(tensor.GetStartPtr(), tensor.Numel()) );
+	parameters_node->blobs().AppendEntry( "parameters", IOBlob::Create(tensor.GetStartPtr(), tensor.Numel()) );
 	return parameters_node;
 }
 
+inline std::vector<size_t> GetTensorStateDimensions(IOTreeNode& node)
+{
+	return Converter::StringToVector<size_t>( node.attributes().GetEntry("dims") );
+}
+
 template< class T>
 std::shared_ptr< Tensor<T> > CreateTensor(IOTreeNode& node)
 {
-	std::vector<size_t> dims = Converter::StringToVector<size_t>( node.attributes().GetEntry("dims") );
-	std::vector<T> parameters = Converter::StringToVector<T>( node.attributes().GetEntry("parameters") );
+	std::vector<size_t> dims = GetTensorStateDimensions(node);
 	std::shared_ptr< Tensor<T> > res( new Tensor<T>(dims) );
+	if (node.blobs().HasEntry("parameters"))
+	{
+		std::shared_ptr<IOBlob> parameters = node.blobs().GetEntry("parameters");
+		assert( parameters->GetNumElements() == res->Numel() );
+		parameters->CopyTo(res->GetStartPtr());
+		return res;
+	}
+	// the parameters were loaded from text (e.g. XML)
+	std::vector<T> parameters = Converter::StringToVector<T>( node.attributes().GetEntry("parameters") );
 	for (size_t i=0; i<parameters.size(); i++)
 		(*res)[i] = parameters[i];
 	return res;
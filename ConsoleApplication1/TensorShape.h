@@ -0,0 +1,233 @@
+#ifndef TENSOR_SHAPE_H
+#define TENSOR_SHAPE_H
+
+#include <vector>
+#include <stdexcept>
+#include <string>
+#include <cassert>
+#include <algorithm>
+
+// Dimensions of a tensor with the strides and the number of elements. The values are stored inline
+// (up to max_rank dimensions), so copying a shape or making a tensor view does not allocate memory.
+// The shapes made from dimensions have the dense column-major strides, the views of tensors (slices, transpositions, crops)
+// keep the strides of the viewed tensor
+class TensorShape
+{
+public:
+	enum { max_rank = 8 };
+
+private:
+	size_t rank_;
+	size_t numel_;
+	size_t dims_[max_rank];
+	size_t strides_[max_rank];
+
+	void CheckRank(size_t rank) const
+	{
+		if (rank > max_rank)
+			throw std::runtime_error("TensorShape: " + std::to_string(rank) + " dimensions, at most " +
+				std::to_string(static_cast<size_t>(max_rank)) + " are supported");
+	}
+
+	void UpdateNumel()
+	{
+		numel_ = 1;
+		for (size_t dim_ind = 0; dim_ind<rank_; dim_ind++)
+			numel_ *= dims_[dim_ind];
+	}
+
+	void SetDims(const size_t* dims, size_t rank)
+	{
+		CheckRank(rank);
+		rank_ = rank;
+		numel_ = 1;
+		for (size_t dim_ind = 0; dim_ind<rank; dim_ind++)
+		{
+			dims_[dim_ind] = dims[dim_ind];
+			strides_[dim_ind] = numel_;
+			numel_ *= dims[dim_ind];
+		}
+	}
+
+public:
+
+	TensorShape() : rank_(0), numel_(1)
+	{
+	}
+
+	explicit TensorShape(const std::vector<size_t>& dims)
+	{
+		SetDims(dims.empty() ? 0 : &dims[0], dims.size());
+	}
+
+	TensorShape(const size_t* dims, size_t rank)
+	{
+		SetDims(dims, rank);
+	}
+
+	TensorShape(const size_t* dims, const size_t* strides, size_t rank)
+	{
+		SetDims(dims, rank);
+		for (size_t dim_ind = 0; dim_ind<rank; dim_ind++)
+			strides_[dim_ind] = strides[dim_ind];
+	}
+
+	size_t size() const
+	{
+		return rank_;
+	}
+
+	bool empty() const
+	{
+		return rank_ == 0;
+	}
+
+	size_t operator[](size_t dim_ind) const
+	{
+		assert(dim_ind < rank_);
+		return dims_[dim_ind];
+	}
+
+	size_t GetStride(size_t dim_ind) const
+	{
+		assert(dim_ind < rank_);
+		return strides_[dim_ind];
+	}
+
+	size_t Numel() const
+	{
+		return numel_;
+	}
+
+	const size_t* GetDims() const
+	{
+		return dims_;
+	}
+
+	const size_t* GetStridesPtr() const
+	{
+		return strides_;
+	}
+
+	// whether the elements occupy a contiguous block in the column-major order, the strides of dimensions of size 1 are not used
+	bool IsContiguous() const
+	{
+		size_t dense_stride = 1;
+		for (size_t dim_ind = 0; dim_ind<rank_; dim_ind++)
+		{
+			if (dims_[dim_ind] != 1 && strides_[dim_ind] != dense_stride)
+				return numel_ == 0;
+			dense_stride *= dims_[dim_ind];
+		}
+		return true;
+	}
+
+	// the same dimensions with the dense strides
+	TensorShape GetContiguous() const
+	{
+		return TensorShape(dims_, rank_);
+	}
+
+	// whether the dimensions and the strides are equal, the == operator compares only the dimensions
+	bool SameLayout(const TensorShape& shape) const
+	{
+		if (*this != shape)
+			return false;
+		for (size_t dim_ind = 0; dim_ind<rank_; dim_ind++)
+			if (strides_[dim_ind] != shape.strides_[dim_ind])
+				return false;
+		return true;
+	}
+
+	// changes the size of the dimension keeping the strides, e.g. for a slice
+	void SetDimension(size_t dim_ind, size_t dim)
+	{
+		assert(dim_ind < rank_);
+		dims_[dim_ind] = dim;
+		UpdateNumel();
+	}
+
+	void RemoveDimension(size_t dim_ind)
+	{
+		assert(dim_ind < rank_);
+		for (size_t i = dim_ind+1; i<rank_; i++)
+		{
+			dims_[i-1] = dims_[i];
+			strides_[i-1] = strides_[i];
+		}
+		rank_--;
+		UpdateNumel();
+	}
+
+	void SwapDimensions(size_t dim_ind1, size_t dim_ind2)
+	{
+		assert(dim_ind1 < rank_ && dim_ind2 < rank_);
+		std::swap(dims_[dim_ind1], dims_[dim_ind2]);
+		std::swap(strides_[dim_ind1], strides_[dim_ind2]);
+	}
+
+	size_t back() const
+	{
+		assert(rank_ > 0);
+		return dims_[rank_-1];
+	}
+
+	// the added dimension follows the last one, as in a dense tensor
+	void push_back(size_t dim)
+	{
+		CheckRank(rank_+1);
+		dims_[rank_] = dim;
+		strides_[rank_] = numel_;
+		numel_ *= dim;
+		rank_++;
+	}
+
+	void pop_back()
+	{
+		assert(rank_ > 0);
+		rank_--;
+		UpdateNumel();
+	}
+
+	std::vector<size_t> GetDimensions() const
+	{
+		return std::vector<size_t>(dims_, dims_ + rank_);
+	}
+
+	std::vector<size_t> GetStrides() const
+	{
+		return std::vector<size_t>(strides_, strides_ + rank_);
+	}
+
+	bool operator==(const TensorShape& shape) const
+	{
+		if (rank_ != shape.rank_)
+			return false;
+		for (size_t dim_ind = 0; dim_ind<rank_; dim_ind++)
+			if (dims_[dim_ind] != shape.dims_[dim_ind])
+				return false;
+		return true;
+	}
+
+	bool operator!=(const TensorShape& shape) const
+	{
+		return !(*this == shape);
+	}
+
+	bool operator==(const std::vector<size_t>& dims) const
+	{
+		if (rank_ != dims.size())
+			return false;
+		for (size_t dim_ind = 0; dim_ind<rank_; dim_ind++)
+			if (dims_[dim_ind] != dims[dim_ind])
+				return false;
+		return true;
+	}
+
+	bool operator!=(const std::vector<size_t>& dims) const
+	{
+		return !(*this == dims);
+	}
+};
+
+#endif
@@ -0,0 +1,110 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <exception>
+
+// Fixed set of worker threads that run the same task concurrently.
+// The calling thread takes part in the work as worker 0, so a pool of N workers owns only N-1 threads
+class ThreadPool
+{
+	std::vector<std::thread> threads_;
+	std::mutex mutex_;
+	std::condition_variable task_started_;
+	std::condition_variable task_finished_;
+	std::function<void (size_t)> task_;
+	// incremented for each new task, so that every thread runs the task exactly once
+	size_t task_id_;
+	size_t num_running_;
+	bool stopped_;
+	std::exception_ptr exception_;
+
+	void RunTask(size_t worker_ind)
+	{
+		try
+		{
+			task_(worker_ind);
+		}
+		catch (...)
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			if (!exception_)
+				exception_ = std::current_exception();
+		}
+	}
+
+	void WorkerLoop(size_t worker_ind)
+	{
+		size_t last_task_id = 0;
+		while (true)
+		{
+			{
+				std::unique_lock<std::mutex> lock(mutex_);
+				while (!stopped_ && task_id_ == last_task_id)
+					task_started_.wait(lock);
+				if (stopped_)
+					return;
+				last_task_id = task_id_;
+			}
+			RunTask(worker_ind);
+			{
+				std::lock_guard<std::mutex> lock(mutex_);
+				num_running_--;
+			}
+			task_finished_.notify_all();
+		}
+	}
+
+	ThreadPool(const ThreadPool&);
+	ThreadPool& operator=(const ThreadPool&);
+public:
+	ThreadPool(size_t num_workers) : task_id_(0), num_running_(0), stopped_(false)
+	{
+		for (size_t worker_ind = 1; worker_ind < num_workers; worker_ind++)
+			threads_.push_back( std::thread(&ThreadPool::WorkerLoop, this, worker_ind) );
+	}
+
+	~ThreadPool()
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			stopped_ = true;
+		}
+		task_started_.notify_all();
+		for (size_t i = 0; i < threads_.size(); i++)
+			threads_[i].join();
+	}
+
+	size_t GetNumWorkers() const
+	{
+		return threads_.size()+1;
+	}
+
+	// calls task(worker_ind) for each worker_ind in [0, GetNumWorkers()) and returns when all the calls have finished.
+	// The first exception thrown by a task is rethrown here
+	void Run(const std::function<void (size_t)>& task)
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			task_ = task;
+			exception_ = std::exception_ptr();
+			num_running_ = threads_.size();
+			task_id_++;
+		}
+		task_started_.notify_all();
+		RunTask(0);
+		{
+			std::unique_lock<std::mutex> lock(mutex_);
+			while (num_running_ > 0)
+				task_finished_.wait(lock);
+		}
+		if (exception_)
+			std::rethrow_exception(exception_);
+	}
+};
+
+#endif
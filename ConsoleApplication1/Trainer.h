@@ -52,6 +52,36 @@ void DefaultProcessTrainFunc(TrainCallbackParams<ParamsType>& result)
 	std::cout<<result.batch_num<<" Train cost = "<<result.train_cost<<std::endl;
 }
 
+// fuses the train cost module with the output module of the network for a training call, so the cost and the gradients
+// with respect to the input of the output module are computed in one pass (see CrossEntropyCostModule::FuseSoftmax).
+// The fusion ends with the call, so the cost module and the network can be used with others after it. A cost module that
+// is already fused is left as it is
+template <class ParamsType>
+class FusedCostScope
+{
+	CostModule<ParamsType>& cost_module_;
+	bool fused_;
+
+	FusedCostScope(const FusedCostScope&);
+	FusedCostScope& operator=(const FusedCostScope&);
+public:
+	FusedCostScope(NN<ParamsType>& net, CostModule<ParamsType>& cost_module) : cost_module_(cost_module), fused_(false)
+	{
+		std::shared_ptr< CompositeModule<ParamsType> > nn_module = net.GetCompositeModule();
+		if (cost_module.GetFusedModule() || nn_module->NumModules() == 0)
+			return;
+		std::shared_ptr< Module<ParamsType> > output_module = nn_module->GetModule(nn_module->NumModules()-1);
+		if (!output_module->IsFusedWithCost())
+			fused_ = cost_module.Fuse(*output_module);
+	}
+
+	~FusedCostScope()
+	{
+		if (fused_)
+			cost_module_.Unfuse();
+	}
+};
+
 template <class ParamsType>
 class Trainer
 {
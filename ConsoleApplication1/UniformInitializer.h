@@ -24,8 +24,8 @@ public:
 
 	virtual void InitializeParameters(Tensor<T>& params_tensor) 
 	{
-		for (size_t i = 0; i<params_tensor.Numel(); i++)
-			params_tensor[i] = static_cast<T>(RandomGenerator::GetUniformDouble(min_value_, max_value_));
+		RandomStream random_stream = RandomGenerator::CreateStream();
+		random_stream.FillUniform(params_tensor.GetStartPtr(), params_tensor.Numel(), static_cast<T>(min_value_), static_cast<T>(max_value_));
 	}
 
 	static std::shared_ptr< ParametersInitializer< T> > Create(IOTreeNode& data)
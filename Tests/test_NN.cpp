@@ -10,6 +10,9 @@
 #include "FullTensorDataLoader.h"
 #include "MseCostModule.h"
 #include "test_utilities.h"
+#include "IOBinary.h"
+#include <fstream>
+#include <cstdio>
 
 BOOST_AUTO_TEST_CASE(TestNN)
 {
@@ -119,4 +122,216 @@ BOOST_AUTO_TEST_CASE(TestNN)
 	linear_mix_input[1] = 1;
 	
 	BOOST_CHECK( test_save_load_nn_state(*net) );
-}
\ No newline at end of file
+}
+
+BOOST_AUTO_TEST_CASE(TestNNLoadMapped)
+{
+	std::vector< std::shared_ptr< Module<float> > > modules;
+	modules.push_back( std::shared_ptr< Module<float> >(new LinearMixModule<float>("linear_mix", 7, 5)) );
+	modules.push_back( std::shared_ptr< Module<float> >(new BiasModule<float>("bias", std::vector<size_t>(1,5))) );
+	modules.push_back( std::shared_ptr< Module<float> >(new AbsModule<float>("abs")) );
+	std::shared_ptr< CompositeModule<float> > composite_module( new CompositeModule<float>("composite", modules) );
+	NN<float> net(composite_module);
+	std::vector<float> parameters;
+	for (size_t i=0; i<net.GetNumParams(); i++)
+		parameters.push_back( static_cast<float>(RandomGenerator::GetUniformDouble(-1, 1)) );
+	net.SetParameters(parameters);
+
+	std::string path = "TestNNLoadMapped.bin";
+	{
+		std::ofstream stream(path, std::ios::binary);
+		IOBinary::save(*net.GetState(), stream);
+	}
+
+	std::shared_ptr<IOTreeNode> state = IOBinary::load_mapped(path);
+	std::shared_ptr< NN<float> > mapped_net = NN<float>::Create(*state);
+	// the modules keep the mapped file alive
+	state.reset();
+	BOOST_CHECK( mapped_net->GetParameters() == parameters );
+	std::vector< std::shared_ptr< Tensor<float> > > input(3);
+	for (size_t i=0; i<input.size(); i++)
+		input[i] = GetRandomTensorPtr<float>(std::vector<size_t>(1, 7));
+	FullTensorDataLoader<float, float> loader(input);
+	std::vector< std::shared_ptr< Tensor<float> > > output = net.Predict(loader);
+	std::vector< std::shared_ptr< Tensor<float> > > mapped_output = mapped_net->Predict(loader);
+	for (size_t i=0; i<input.size(); i++)
+		BOOST_CHECK( *output[i] == *mapped_output[i] );
+
+	// changes of the mapped parameters are not written to the file
+	mapped_net->SetParameters( std::vector<float>(net.GetNumParams(), 0) );
+	BOOST_CHECK( mapped_net->GetParameters() == std::vector<float>(net.GetNumParams(), 0) );
+	{
+		std::ifstream stream(path, std::ios::binary);
+		std::shared_ptr< NN<float> > loaded_net = NN<float>::Create(*IOBinary::load(stream));
+		BOOST_CHECK( loaded_net->GetParameters() == parameters );
+	}
+	mapped_net.reset();
+	std::remove(path.c_str());
+}
+
+BOOST_AUTO_TEST_CASE(TestNNLoadMappedAllocations)
+{
+	std::vector< std::shared_ptr< Module<float> > > modules;
+	modules.push_back( std::shared_ptr< Module<float> >(new LinearMixModule<float>("linear_mix", 300, 200)) );
+	modules.push_back( std::shared_ptr< Module<float> >(new BiasModule<float>("bias", std::vector<size_t>(1,200))) );
+	std::shared_ptr< CompositeModule<float> > composite_module( new CompositeModule<float>("composite", modules) );
+	NN<float> net(composite_module);
+	std::vector<float> parameters;
+	for (size_t i=0; i<net.GetNumParams(); i++)
+		parameters.push_back( static_cast<float>(RandomGenerator::GetUniformDouble(-1, 1)) );
+	net.SetParameters(parameters);
+
+	std::string path = "TestNNLoadMappedAllocations.bin";
+	{
+		std::ofstream stream(path, std::ios::binary);
+		IOBinary::save(*net.GetState(), stream);
+	}
+
+	// neither the parameters nor the gradients of the mapped network are allocated
+	std::shared_ptr<IOTreeNode> state = IOBinary::load_mapped(path);
+	size_t bytes_in_use = MemoryPool::GetInstance().GetStatistics().bytes_in_use;
+	std::shared_ptr< NN<float> > mapped_net = NN<float>::Create(*state);
+	BOOST_CHECK( MemoryPool::GetInstance().GetStatistics().bytes_in_use < bytes_in_use + net.GetNumParams()*sizeof(float) );
+
+	std::vector< std::shared_ptr< Tensor<float> > > input(3);
+	for (size_t i=0; i<input.size(); i++)
+		input[i] = GetRandomTensorPtr<float>(std::vector<size_t>(1, 300));
+	FullTensorDataLoader<float, float> loader(input);
+	std::vector< std::shared_ptr< Tensor<float> > > output = net.Predict(loader);
+	std::vector< std::shared_ptr< Tensor<float> > > mapped_output = mapped_net->Predict(loader);
+	for (size_t i=0; i<input.size(); i++)
+		BOOST_CHECK( *output[i] == *mapped_output[i] );
+	mapped_net.reset();
+
+	// a module loaded without a network allocates its gradients on the first bprop
+	std::shared_ptr< Module<float> > mapped_linear_mix = LinearMixModule<float>::Create(*state->nodes().GetEntry("nn_module")->nodes().GetEntry("module0"));
+	std::vector<float> gradients;
+	mapped_linear_mix->GetGradients(gradients);
+	BOOST_CHECK( gradients == std::vector<float>(300*200, 0) );
+	LinearMixModule<float> linear_mix("linear_mix", 300, 200);
+	linear_mix.SetParameters(parameters.data());
+	std::vector<size_t> minibatch_dims(1, 300);
+	minibatch_dims.push_back(2);
+	std::shared_ptr< Tensor<float> > minibatch = GetRandomTensorPtr<float>(minibatch_dims);
+	std::vector<float> importances(2, 1);
+	std::vector<size_t> output_gradients_dims(1, 200);
+	output_gradients_dims.push_back(2);
+	std::shared_ptr< Tensor<float> > output_gradients = GetRandomTensorPtr<float>(output_gradients_dims);
+	linear_mix.train_fprop(minibatch);
+	linear_mix.bprop(output_gradients, importances);
+	mapped_linear_mix->train_fprop(minibatch);
+	mapped_linear_mix->bprop(output_gradients, importances);
+	std::vector<float> expected_gradients;
+	linear_mix.GetGradients(expected_gradients);
+	gradients.clear();
+	mapped_linear_mix->GetGradients(gradients);
+	BOOST_CHECK( gradients == expected_gradients );
+
+	mapped_linear_mix.reset();
+	state.reset();
+	std::remove(path.c_str());
+}
+
+BOOST_AUTO_TEST_CASE(TestNNPredictBatched)
+{
+	std::vector< std::shared_ptr< Module<float> > > modules;
+	modules.push_back( std::shared_ptr< Module<float> >(new LinearMixModule<float>("linear_mix", 7, 5)) );
+	modules.push_back( std::shared_ptr< Module<float> >(new BiasModule<float>("bias", std::vector<size_t>(1,5))) );
+	modules.push_back( std::shared_ptr< Module<float> >(new AbsModule<float>("abs")) );
+	std::shared_ptr< CompositeModule<float> > composite_module( new CompositeModule<float>("composite", modules) );
+	// the last batch is partial
+	NN<float> net(composite_module, 3);
+	std::vector<float> parameters;
+	for (size_t i=0; i<net.GetNumParams(); i++)
+		parameters.push_back( static_cast<float>(RandomGenerator::GetUniformDouble(-1, 1)) );
+	net.SetParameters(parameters);
+
+	std::vector< std::shared_ptr< Tensor<float> > > input(8);
+	for (size_t i=0; i<input.size(); i++)
+		input[i] = GetRandomTensorPtr<float>(std::vector<size_t>(1, 7));
+	FullTensorDataLoader<float, float> loader(input);
+	std::vector< std::shared_ptr< Tensor<float> > > output = net.Predict(loader);
+	std::vector<size_t> all_indices;
+	std::vector< std::shared_ptr< Tensor<float> > > bias_output = net.Predict(loader, all_indices, "bias");
+
+	std::vector<float> output_matrix;
+	net.Predict(loader, std::vector<size_t>(), output_matrix);
+	BOOST_CHECK_EQUAL(output_matrix.size(), 8*5);
+	for (size_t i=0; i<input.size(); i++)
+		BOOST_CHECK( test_equal_arrays(output[i]->GetStartPtr(), output_matrix.data() + i*5, 5, 0.0f) );
+
+	// the outputs of two modules in one pass, for the selected samples
+	std::vector<size_t> indices;
+	indices.push_back(6); indices.push_back(1); indices.push_back(3); indices.push_back(7);
+	std::vector<std::string> module_names;
+	module_names.push_back("bias"); module_names.push_back("");
+	std::vector<size_t> first_samples;
+	bool equal = true;
+	net.Predict(loader, indices, module_names, [&](size_t first_sample, const std::vector< std::shared_ptr< Tensor<float> > >& batch_outputs)
+	{
+		first_samples.push_back(first_sample);
+		BOOST_CHECK_EQUAL(batch_outputs.size(), 2);
+		size_t batch_size = batch_outputs[0]->GetDimensionSize(1);
+		for (size_t i=0; i<batch_size; i++)
+		{
+			size_t sample_ind = indices[first_sample+i];
+			equal = equal && test_equal_arrays(bias_output[sample_ind]->GetStartPtr(), batch_outputs[0]->GetStartPtr() + i*5, 5, 0.0f);
+			equal = equal && test_equal_arrays(output[sample_ind]->GetStartPtr(), batch_outputs[1]->GetStartPtr() + i*5, 5, 0.0f);
+		}
+	});
+	BOOST_CHECK(equal);
+	BOOST_CHECK_EQUAL(first_samples.size(), 2);
+	BOOST_CHECK_EQUAL(first_samples[1], 3);
+
+	// no samples, no outputs
+	FullTensorDataLoader<float, float> empty_loader( (std::vector< std::shared_ptr< Tensor<float> > >()) );
+	net.Predict(empty_loader, std::vector<size_t>(), output_matrix);
+	BOOST_CHECK(output_matrix.empty());
+}
+
+BOOST_AUTO_TEST_CASE(TestNNParameterArena)
+{
+	std::vector< std::shared_ptr< Module<double> > > modules;
+	modules.push_back( std::shared_ptr< Module<double> >(new LinearMixModule<double>("linear_mix", 4, 3)) );
+	modules.push_back( std::shared_ptr< Module<double> >(new BiasModule<double>("bias", std::vector<size_t>(1,3))) );
+	std::shared_ptr< CompositeModule<double> > composite_module( new CompositeModule<double>("composite", modules) );
+	// several batches
+	NN<double> net(composite_module, 3);
+	std::vector<double> random_parameters;
+	for (size_t i=0; i<net.GetNumParams(); i++)
+		random_parameters.push_back( RandomGenerator::GetUniformDouble(-1, 1) );
+	net.SetParameters(random_parameters);
+
+	// the modules use the parameters of the net
+	std::vector<double>& parameters = net.GetParameters();
+	BOOST_CHECK( parameters == random_parameters );
+	parameters[0] += 1;
+	parameters[14] -= 1;
+	std::vector<double> module_parameters;
+	composite_module->GetParameters(module_parameters);
+	BOOST_CHECK( module_parameters == parameters );
+	BOOST_CHECK( &net.GetParameters() == &parameters );
+
+	std::vector< std::shared_ptr< Tensor<double> > > input(8), output(8);
+	for (size_t i=0; i<input.size(); i++)
+	{
+		input[i] = GetRandomTensorPtr<double>(std::vector<size_t>(1, 4));
+		output[i] = GetRandomTensorPtr<double>(std::vector<size_t>(1, 3));
+	}
+	std::shared_ptr< ITensorDataLoader<double> > input_loader( new FullTensorDataLoader<double, double>(input) );
+	std::shared_ptr< ITensorDataLoader<double> > output_loader( new FullTensorDataLoader<double, double>(output) );
+	std::vector<double> importance(8, 1);
+	TrainDataset<double> dataset(input_loader, output_loader, importance);
+	MseCostModule<double> cost_module;
+
+	// the gradients of the batches are summed in the gradients of the net, the modules are left with the gradients of all the samples
+	std::vector<size_t> indices;
+	std::vector<double> gradients = net.GetGradientsAndCost(dataset, cost_module, indices).gradients;
+	std::vector<double> module_gradients;
+	composite_module->GetGradients(module_gradients);
+	BOOST_CHECK( test_equal_arrays(gradients.data(), module_gradients.data(), static_cast<int>(gradients.size()), 0.0) );
+	net.SetMinibatchSize(8);
+	std::vector<double> one_batch_gradients = net.GetGradientsAndCost(dataset, cost_module, indices).gradients;
+	BOOST_CHECK( test_equal_arrays(gradients.data(), one_batch_gradients.data(), static_cast<int>(gradients.size()), 1e-12) );
+	BOOST_CHECK( CheckNNGradientsSameForDifferentBufferSizes(net, cost_module, dataset) );
+}
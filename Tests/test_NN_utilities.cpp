@@ -2,6 +2,7 @@
 #include <assert.h>
 #include <vector>
 #include <memory>
+#include <cmath>
 #include "Tensor.h"
 #include "Preprocessing.h"
 
@@ -62,4 +63,77 @@ BOOST_AUTO_TEST_CASE(testFullMeanAndStd)
 	BOOST_CHECK( abs(data[3]*data[3]+data[9]*data[9]-2) <0.000000001);
 	BOOST_CHECK( abs(data[4]*data[4]+data[10]*data[10]-2) <0.000000001);
 	BOOST_CHECK( abs(data[5]*data[5]+data[11]*data[11]-2) <0.000000001);
-}
\ No newline at end of file
+}
+
+BOOST_AUTO_TEST_CASE(testFeatureStatistics)
+{
+	// large means and small deviations, the naive sums of the squares lose the variance
+	size_t num_samples = 1001;
+	size_t num_features = 5;
+	std::vector<size_t> dims(1, num_features);
+	std::vector< std::shared_ptr< Tensor<double> > > tensors;
+	for (size_t sample_ind=0; sample_ind<num_samples; sample_ind++)
+	{
+		tensors.push_back( std::shared_ptr< Tensor<double> >( new Tensor<double>(dims) ) );
+		for (size_t i=0; i<num_features; i++)
+			(*tensors.back())[i] = 1e8*(i+1) + std::sin(static_cast<double>(sample_ind*(i+1)));
+	}
+
+	std::vector<double> means(num_features, 0), variances(num_features, 0);
+	for (size_t i=0; i<num_features; i++)
+	{
+		for (size_t sample_ind=0; sample_ind<num_samples; sample_ind++)
+			means[i] += (*tensors[sample_ind])[i] - 1e8*(i+1);
+		means[i] /= num_samples;
+		for (size_t sample_ind=0; sample_ind<num_samples; sample_ind++)
+		{
+			double deviation = (*tensors[sample_ind])[i] - 1e8*(i+1) - means[i];
+			variances[i] += deviation*deviation;
+		}
+		variances[i] /= num_samples;
+		means[i] += 1e8*(i+1);
+	}
+
+	// the threads and the streamed chunks give the same statistics
+	FeatureStatistics chunks_statistics(num_features);
+	for (size_t first_sample=0; first_sample<num_samples; first_sample+=300)
+	{
+		FeatureStatistics chunk_statistics(num_features);
+		for (size_t sample_ind=first_sample; sample_ind<std::min(first_sample+300, num_samples); sample_ind++)
+			chunk_statistics.AddSample(tensors[sample_ind]->GetStartPtr());
+		chunks_statistics.Merge(chunk_statistics);
+	}
+	const size_t num_threads[] = {1, 3};
+	for (size_t k=0; k<3; k++)
+	{
+		FeatureStatistics statistics = k < 2 ? ComputeFeatureStatistics(tensors, num_threads[k]) : chunks_statistics;
+		BOOST_CHECK_EQUAL(statistics.GetNumSamples(), num_samples);
+		for (size_t i=0; i<num_features; i++)
+		{
+			BOOST_CHECK( std::abs(statistics.GetMean(i) - means[i]) < 1e-6 );
+			BOOST_CHECK( std::abs(statistics.GetVariance(i) - variances[i]) < 1e-6 * variances[i] );
+		}
+	}
+
+	// a row-major matrix with a label column
+	std::vector<float> rows(num_samples*(num_features+1));
+	for (size_t sample_ind=0; sample_ind<num_samples; sample_ind++)
+		for (size_t i=0; i<num_features; i++)
+			rows[sample_ind*(num_features+1) + i+1] = static_cast<float>( (*tensors[sample_ind])[i] - 1e8*(i+1) );
+	FeatureStatistics rows_statistics(num_features);
+	rows_statistics.AddSamples(rows.data()+1, num_samples, num_features+1);
+	Tensor<float> rows_means = rows_statistics.GetMeans<float>(dims);
+	Tensor<float> rows_stds = rows_statistics.GetStds<float>(dims);
+	NormalizeFeatures(rows.data()+1, num_samples, num_features+1, rows_means, rows_stds, 3);
+	FeatureStatistics normalized_statistics(num_features);
+	normalized_statistics.AddSamples(rows.data()+1, num_samples, num_features+1);
+	for (size_t i=0; i<num_features; i++)
+	{
+		BOOST_CHECK( std::abs(normalized_statistics.GetMean(i)) < 1e-5 );
+		BOOST_CHECK( std::abs(normalized_statistics.GetVariance(i) - 1) < 1e-5 );
+	}
+	BOOST_CHECK_EQUAL(rows[0], 0);
+
+	FeatureStatistics other_statistics(num_features+1);
+	BOOST_CHECK_THROW(chunks_statistics.Merge(other_statistics), std::runtime_error);
+}
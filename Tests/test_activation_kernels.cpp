@@ -0,0 +1,166 @@
+#include <boost/test/unit_test.hpp>
+#include <vector>
+#include <memory>
+#include "Tensor.h"
+#include "ActivationKernels.h"
+#include "ActivationFusion.h"
+#include "MseCostModule.h"
+#include "GaussianInitializer.h"
+#include "WeightDecayRegularizer.h"
+#include "LinearMixModule.h"
+#include "BiasModule.h"
+#include "TanhModule.h"
+#include "SigmoidModule.h"
+#include "RectifiedLinearUnitModule.h"
+#include "SoftSignModule.h"
+#include "AbsModule.h"
+#include "CompositeModule.h"
+#include "FullTensorDataLoader.h"
+#include "TrainDataset.h"
+#include "test_utilities.h"
+
+namespace
+{
+	// vectorized float kernels (if enabled) against the scalar double ones, the size is not a multiple of the vector width
+	template <class Activation>
+	bool TestFloatKernel(double min_val, double max_val)
+	{
+		const size_t num_elements = 37;
+		std::vector<size_t> dims(1, num_elements);
+		std::shared_ptr< Tensor<double> > input = GetRandomTensorPtr<double>(dims, min_val, max_val);
+		std::shared_ptr< Tensor<double> > output_gradients = GetRandomTensorPtr<double>(dims);
+		std::vector<double> expected_output(num_elements), expected_input_gradients(num_elements);
+		ElementwiseActivation<Activation, double>::fprop(input->GetStartPtr(), expected_output.data(), num_elements);
+		ElementwiseActivation<Activation, double>::bprop(input->GetStartPtr(), expected_output.data(), output_gradients->GetStartPtr(),
+			expected_input_gradients.data(), num_elements);
+
+		std::vector<float> float_input(input->GetStartPtr(), input->GetStartPtr()+num_elements);
+		std::vector<float> float_output_gradients(output_gradients->GetStartPtr(), output_gradients->GetStartPtr()+num_elements);
+		std::vector<float> output(num_elements), input_gradients(num_elements);
+		ElementwiseActivation<Activation, float>::fprop(float_input.data(), output.data(), num_elements);
+		ElementwiseActivation<Activation, float>::bprop(float_input.data(), output.data(), float_output_gradients.data(),
+			input_gradients.data(), num_elements);
+
+		for (size_t i=0; i<num_elements; i++)
+			if (std::abs(output[i]-expected_output[i]) > 1e-5 || std::abs(input_gradients[i]-expected_input_gradients[i]) > 1e-5)
+				return false;
+
+		// in place
+		ElementwiseActivation<Activation, float>::fprop(float_input.data(), float_input.data(), num_elements);
+		return float_input == output;
+	}
+
+	std::vector< std::shared_ptr< Module<float> > > CreateLayer(std::shared_ptr< Module<float> > activation_module)
+	{
+		std::shared_ptr<ParametersInitializer<float>> initializer(new GaussianInitializer<float>());
+		std::shared_ptr<Regularizer<float>> regularizer(new WeightDecayRegularizer<float>(0.5));
+		std::vector< std::shared_ptr< Module<float> > > modules;
+		modules.push_back(std::shared_ptr< Module<float> >( new LinearMixModule<float>("linear_mix", 23, 300, initializer, regularizer) ));
+		modules.push_back(activation_module);
+		std::vector<size_t> bias_dims(1, 300);
+		modules.push_back(std::shared_ptr< Module<float> >( new BiasModule<float>("bias", bias_dims, initializer, regularizer) ));
+		modules.push_back(std::shared_ptr< Module<float> >( new SigmoidModule<float>("sigmoid") ));
+		return modules;
+	}
+}
+
+BOOST_AUTO_TEST_CASE(TestActivationKernels)
+{
+	BOOST_CHECK(TestFloatKernel<TanhActivation>(-10, 10));
+	BOOST_CHECK(TestFloatKernel<SigmoidActivation>(-20, 20));
+	BOOST_CHECK(TestFloatKernel<RluActivation>(-1, 1));
+	BOOST_CHECK(TestFloatKernel<SoftSignActivation>(-5, 5));
+	BOOST_CHECK(TestFloatKernel<AbsActivation>(-1, 1));
+
+	// saturated arguments of the vectorized exp
+	float input[] = {-200, -100, -90, -50, 0, 50, 90, 100, 200};
+	float output[9];
+	ElementwiseActivation<SigmoidActivation, float>::fprop(input, output, 9);
+	float expected_output[] = {0, 0, 0, 0, 0.5f, 1, 1, 1, 1};
+	BOOST_CHECK(test_equal_arrays(expected_output, output, 9, 1e-6f));
+	ElementwiseActivation<TanhActivation, float>::fprop(input, output, 9);
+	float expected_tanh_output[] = {-1, -1, -1, -1, 0, 1, 1, 1, 1};
+	BOOST_CHECK(test_equal_arrays(expected_tanh_output, output, 9, 1e-6f));
+
+	BOOST_CHECK(GetActivationByName(GetActivationName(softsign_activation)) == softsign_activation);
+	BOOST_CHECK(!IsFusableActivation(abs_activation));
+}
+
+BOOST_AUTO_TEST_CASE(TestFusedActivationsSameAsModules)
+{
+	std::vector< std::shared_ptr< Module<float> > > modules = CreateLayer(std::shared_ptr< Module<float> >( new RectifiedLinearUnitModule<float>("rlu") ));
+	std::vector< std::shared_ptr< Module<float> > > fused_modules = FuseActivations(modules);
+	BOOST_CHECK_EQUAL(fused_modules.size(), 2);
+	BOOST_CHECK(static_cast<LinearMixModule<float>&>(*fused_modules[0]).GetFusedActivation() == rlu_activation);
+	BOOST_CHECK(static_cast<BiasModule<float>&>(*fused_modules[1]).GetFusedActivation() == sigmoid_activation);
+
+	// the modules of the fused network are new, with the same parameters
+	std::vector< std::shared_ptr< Module<float> > > unfused_modules = CreateLayer(std::shared_ptr< Module<float> >( new RectifiedLinearUnitModule<float>("rlu") ));
+	CompositeModule<float> unfused("composite", unfused_modules);
+	CompositeModule<float> fused("composite", fused_modules);
+	fused.InitializeParameters();
+	std::vector<float> parameters;
+	fused.GetParameters(parameters);
+	unfused.SetParameters(parameters);
+
+	std::vector<size_t> input_dims; input_dims.push_back(23); input_dims.push_back(130);
+	std::vector<size_t> output_dims; output_dims.push_back(300); output_dims.push_back(130);
+	std::shared_ptr< Tensor<float> > input = GetRandomTensorPtr<float>(input_dims);
+	std::shared_ptr< Tensor<float> > output_gradients = GetRandomTensorPtr<float>(output_dims);
+	std::vector<float> importances(130, 1);
+
+	std::shared_ptr< Tensor<float> > unfused_output = unfused.train_fprop(input);
+	std::shared_ptr< Tensor<float> > fused_output = fused.train_fprop(input);
+	BOOST_CHECK(test_equal_arrays(unfused_output->GetStartPtr(), fused_output->GetStartPtr(), static_cast<int>(fused_output->Numel()), 1e-5f));
+
+	std::shared_ptr< Tensor<float> > unfused_input_gradients = unfused.bprop(output_gradients, importances);
+	std::shared_ptr< Tensor<float> > fused_input_gradients = fused.bprop(output_gradients, importances);
+	BOOST_CHECK(test_equal_arrays(unfused_input_gradients->GetStartPtr(), fused_input_gradients->GetStartPtr(),
+		static_cast<int>(fused_input_gradients->Numel()), 1e-4f));
+	std::vector<float> unfused_gradients, fused_gradients;
+	unfused.GetGradients(unfused_gradients);
+	fused.GetGradients(fused_gradients);
+	BOOST_CHECK(test_equal_arrays(unfused_gradients.data(), fused_gradients.data(), static_cast<int>(fused_gradients.size()), 1e-3f));
+
+	// abs needs its input for the gradient and stays a separate module
+	BOOST_CHECK_EQUAL(FuseActivations(CreateLayer(std::shared_ptr< Module<float> >( new AbsModule<float>("abs") ))).size(), 3);
+}
+
+BOOST_AUTO_TEST_CASE(TestFusedActivationGradient)
+{
+	std::vector< std::shared_ptr< Tensor<double> > > train_input(15);
+	std::vector< std::shared_ptr< Tensor<double> > > train_output(15);
+	std::vector<double> train_importance(15);
+
+	std::vector<size_t> case_input_dims;case_input_dims.push_back(9);
+	std::vector<size_t> case_output_dims;case_output_dims.push_back(5);
+	for (size_t i=0; i<train_input.size(); i++)
+	{
+		train_input[i] = GetRandomTensorPtr<double>(case_input_dims);
+		train_output[i] = GetRandomTensorPtr<double>(case_output_dims);
+		train_importance[i]  = i+1.0;
+	}
+
+	std::shared_ptr< ITensorDataLoader<double> > input_data_loader(new FullTensorDataLoader<double,double>(train_input));
+	std::shared_ptr< ITensorDataLoader<double> > output_data_loader(new FullTensorDataLoader<double,double>(train_output));
+	TrainDataset<double> train_dataset(input_data_loader, output_data_loader, train_importance);
+
+	std::shared_ptr<ParametersInitializer<double>> initializer(new GaussianInitializer<double>());
+	std::shared_ptr<Regularizer<double>> regularizer(new WeightDecayRegularizer<double>(0.5));
+	std::vector<size_t> bias_dims(1, 8);
+	std::vector< std::shared_ptr< Module<double> > > modules;
+	modules.push_back(std::shared_ptr< Module<double> >( new LinearMixModule<double>("module1", 9, 8, initializer, regularizer) ));
+	modules.push_back(std::shared_ptr< Module<double> >( new BiasModule<double>("module2", bias_dims, initializer, regularizer) ));
+	modules.push_back(std::shared_ptr< Module<double> >( new TanhModule<double>("module3") ));
+	modules.push_back(std::shared_ptr< Module<double> >( new LinearMixModule<double>("module4", 8, 5, initializer, regularizer) ));
+	modules.push_back(std::shared_ptr< Module<double> >( new SoftSignModule<double>("module5") ));
+	modules = FuseActivations(modules);
+	BOOST_CHECK_EQUAL(modules.size(), 3);
+	std::shared_ptr< CompositeModule<double> > main_module(new CompositeModule<double>("module6", modules));
+
+	NN<double> net(main_module);
+	net.InitializeParameters();
+	BOOST_CHECK(NumericalCheckNNGradients(net, MseCostModule<double>(), train_dataset));
+
+	BOOST_CHECK( test_save_load_nn_state(net) );
+}
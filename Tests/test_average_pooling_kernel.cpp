@@ -0,0 +1,189 @@
+#include <boost/test/unit_test.hpp>
+#include <vector>
+#include "Tensor.h"
+#include "AveragePoolingKernel.h"
+#include "L2PoolingKernel.h"
+
+#include <memory>
+#include "KernelModule.h"
+#include "LinearModule.h"
+#include "MseCostModule.h"
+#include "GaussianInitializer.h"
+#include "WeightDecayRegularizer.h"
+#include "LinearMixModule.h"
+#include "CompositeModule.h"
+#include "FullTensorDataLoader.h"
+#include "TrainDataset.h"
+#include "test_utilities.h"
+
+BOOST_AUTO_TEST_CASE(TestAveragePoolingKernel)
+{
+	std::vector<size_t> input_dims; input_dims.push_back(5); input_dims.push_back(4); input_dims.push_back(2);
+	float input_data[] = { 1, 2, 3, 4, 2,
+		5, 6, 7, 8, 3,
+		2, 4, 1, 3, 1,
+		1, 9, 2, 1, 9,
+
+		2, 3, 4, 1, 4,
+		1, 5, 7, 2, 8,
+		2, 4, 1, 3, 0,
+		1, 8, 2, 1, 2};
+	std::vector<size_t> kernel_dims; kernel_dims.push_back(3); kernel_dims.push_back(2); kernel_dims.push_back(1);
+	std::vector<size_t> strides; strides.push_back(2); strides.push_back(2); strides.push_back(1);
+	std::vector<size_t> output_dims; output_dims.push_back(2); output_dims.push_back(2); output_dims.push_back(2);
+	Tensor<float> input_tensor(input_data, input_dims);
+
+	AveragePoolingKernel<float> kernel(Tensor<float>(0, kernel_dims), strides);
+	BOOST_CHECK(kernel.GetOutputTensorDimensions(input_dims) == output_dims);
+	Tensor<float> output_tensor(output_dims);
+	kernel.fprop(input_tensor, output_tensor);
+	BOOST_CHECK_CLOSE(output_tensor[0], 24.0f/6, 0.0001);
+	BOOST_CHECK_CLOSE(output_tensor[1], 27.0f/6, 0.0001);
+	BOOST_CHECK_CLOSE(output_tensor[2], 19.0f/6, 0.0001);
+	BOOST_CHECK_CLOSE(output_tensor[3], 17.0f/6, 0.0001);
+	BOOST_CHECK(test_filter_response<float>(input_tensor, output_tensor, kernel, kernel_dims, strides));
+
+	L2PoolingKernel<float> l2_kernel(Tensor<float>(0, kernel_dims), strides);
+	l2_kernel.fprop(input_tensor, output_tensor);
+	BOOST_CHECK_CLOSE(output_tensor[0], std::sqrt(124.0f/6), 0.0001);
+	BOOST_CHECK(test_filter_response<float>(input_tensor, output_tensor, l2_kernel, kernel_dims, strides));
+}
+
+BOOST_AUTO_TEST_CASE(TestAveragePoolingKernel_windows)
+{
+	// the running sums give the means of the windows for the overlapping, adjacent and separated windows,
+	// bprop is the adjoint of fprop: <fprop(x), g> = <x, bprop(g)>
+	std::vector<size_t> input_dims; input_dims.push_back(23); input_dims.push_back(9); input_dims.push_back(3);
+	Tensor<double> input_tensor = GetRandomTensor<double>(input_dims);
+	size_t windows[][4] = { {1, 1, 2, 1}, {7, 1, 1, 1}, {7, 1, 3, 1}, {4, 3, 4, 3}, {3, 2, 5, 2}, {23, 9, 1, 1} };
+	for (size_t window_ind = 0; window_ind<6; window_ind++)
+	{
+		std::vector<size_t> kernel_dims; kernel_dims.push_back(windows[window_ind][0]); kernel_dims.push_back(windows[window_ind][1]); kernel_dims.push_back(1);
+		std::vector<size_t> strides; strides.push_back(windows[window_ind][2]); strides.push_back(windows[window_ind][3]); strides.push_back(1);
+		AveragePoolingKernel<double> kernel(Tensor<double>(0, kernel_dims), strides);
+		Tensor<double> output_tensor(kernel.GetOutputTensorDimensions(input_dims));
+		kernel.fprop(input_tensor, output_tensor);
+		BOOST_CHECK(test_filter_response<double>(input_tensor, output_tensor, kernel, kernel_dims, strides));
+
+		Tensor<double> output_gradients = GetRandomTensor<double>(output_tensor.GetDimensions());
+		Tensor<double> input_gradients(input_dims);
+		kernel.bprop(input_tensor, output_tensor, input_gradients, output_gradients);
+		double output_product = 0, input_product = 0;
+		for (size_t i=0; i<output_tensor.Numel(); i++)
+			output_product += output_tensor[i]*output_gradients[i];
+		for (size_t i=0; i<input_tensor.Numel(); i++)
+			input_product += input_tensor[i]*input_gradients[i];
+		BOOST_CHECK( std::abs(output_product - input_product) < 0.000001 );
+
+		// a view of the input gives the same output
+		Tensor<double> transposed_input(std::vector<size_t>(input_dims.rbegin(), input_dims.rend()));
+		for (size_t i=0; i<input_tensor.Numel(); i++)
+			*transposed_input.Transpose(0, 2).GetPtr(Tensor<double>::IndToPos(input_dims, i).data()) = input_tensor[i];
+		Tensor<double> view_output_tensor(output_tensor.GetDimensions());
+		kernel.fprop(transposed_input.Transpose(0, 2), view_output_tensor);
+		BOOST_CHECK( view_output_tensor == output_tensor );
+	}
+}
+
+BOOST_AUTO_TEST_CASE(TestL2PoolingKernel_zero_windows)
+{
+	// the running sums of the squares of doubles cancel inexactly on the windows of zeros that follow large elements,
+	// these windows give 0 or almost 0 and not NaN
+	std::vector<size_t> input_dims; input_dims.push_back(40); input_dims.push_back(3); input_dims.push_back(1);
+	Tensor<double> input_tensor(input_dims);
+	double nonzero_data[] = {0.00997, 9.33, 0.00128, 9.99};
+	for (size_t line=0; line<3; line++)
+		for (size_t i=0; i<input_dims[0]; i++)
+			input_tensor[line*input_dims[0] + i] = (i%20) < 4 ? nonzero_data[i%20]*(line+1) : 0;
+
+	std::vector<size_t> kernel_dims; kernel_dims.push_back(4); kernel_dims.push_back(1); kernel_dims.push_back(1);
+	std::vector<size_t> strides; strides.push_back(1); strides.push_back(1); strides.push_back(1);
+	L2PoolingKernel<double> kernel(Tensor<double>(0, kernel_dims), strides);
+	Tensor<double> output_tensor(kernel.GetOutputTensorDimensions(input_dims));
+	kernel.fprop(input_tensor, output_tensor);
+	bool has_nan = false;
+	for (size_t i=0; i<output_tensor.Numel(); i++)
+		has_nan = has_nan || output_tensor[i] != output_tensor[i];
+	BOOST_CHECK( !has_nan );
+	BOOST_CHECK( output_tensor[10] < 0.000001 );
+	BOOST_CHECK(test_filter_response<double>(input_tensor, output_tensor, kernel, kernel_dims, strides));
+
+	// the gradients of the zero windows are 0
+	Tensor<double> output_gradients(output_tensor.GetDimensions());
+	output_gradients.SetZeros();
+	output_gradients[10] = 1;
+	Tensor<double> input_gradients(input_dims);
+	input_gradients.SetZeros();
+	kernel.bprop(input_tensor, output_tensor, input_gradients, output_gradients);
+	bool gradients_are_zero = true;
+	for (size_t i=0; i<input_gradients.Numel(); i++)
+		gradients_are_zero = gradients_are_zero && input_gradients[i] == 0;
+	BOOST_CHECK( gradients_are_zero );
+
+	// the differences of floats are exact in double, so the windows of zeros after a long line of large values are 0
+	std::vector<size_t> line_dims; line_dims.push_back(4000); line_dims.push_back(1); line_dims.push_back(1);
+	Tensor<float> line_tensor(line_dims);
+	for (size_t i=0; i<line_dims[0]; i++)
+		line_tensor[i] = i < line_dims[0]/2 ? static_cast<float>(RandomGenerator::GetNormalDouble(0, 3)) : 0;
+	std::vector<size_t> line_kernel_dims; line_kernel_dims.push_back(40); line_kernel_dims.push_back(1); line_kernel_dims.push_back(1);
+	std::vector<size_t> line_strides; line_strides.push_back(20); line_strides.push_back(1); line_strides.push_back(1);
+	L2PoolingKernel<float> line_kernel(Tensor<float>(0, line_kernel_dims), line_strides);
+	Tensor<float> line_output(line_kernel.GetOutputTensorDimensions(line_dims));
+	line_kernel.fprop(line_tensor, line_output);
+	BOOST_CHECK(test_filter_response<float>(line_tensor, line_output, line_kernel, line_kernel_dims, line_strides));
+	Tensor<float> line_means(line_output.GetDimensions());
+	AveragePoolingKernel<float>(Tensor<float>(0, line_kernel_dims), line_strides).fprop(line_tensor, line_means);
+	float max_zero_window_output = 0;
+	for (size_t i=line_dims[0]/2/line_strides[0]; i<line_output.Numel(); i++)
+		max_zero_window_output = (std::max)(max_zero_window_output, (std::max)(line_output[i], std::abs(line_means[i])));
+	BOOST_CHECK_EQUAL( max_zero_window_output, 0 );
+}
+
+namespace
+{
+	void CheckPoolingKernelGradient(const KernelFactory<double>& kernel_factory)
+	{
+		std::vector< std::shared_ptr< Tensor<double> > > train_input(5);
+		std::vector< std::shared_ptr< Tensor<double> > > train_output(5);
+		std::vector<double> train_importance(5);
+
+		std::vector<size_t> case_input_dims;case_input_dims.push_back(15); case_input_dims.push_back(14); case_input_dims.push_back(4);
+		std::vector<size_t> case_output_dims;case_output_dims.push_back(8);
+		for (size_t i=0; i<train_input.size(); i++)
+		{
+			train_input[i] = GetRandomTensorPtr<double>(case_input_dims);
+			train_output[i] = GetRandomTensorPtr<double>(case_output_dims);
+			train_importance[i]  = i+1.0;
+		}
+
+		std::shared_ptr< ITensorDataLoader<double> > input_data_loader(new FullTensorDataLoader<double,double>(train_input));
+		std::shared_ptr< ITensorDataLoader<double> > output_data_loader(new FullTensorDataLoader<double,double>(train_output));
+		TrainDataset<double> train_dataset(input_data_loader, output_data_loader, train_importance);
+
+		std::shared_ptr<ParametersInitializer<double>> initializer(new GaussianInitializer<double>());
+		std::shared_ptr<Regularizer<double>> regularizer(new WeightDecayRegularizer<double>(0.5));
+
+		std::vector<size_t> kernel_dims; kernel_dims.push_back(4); kernel_dims.push_back(5); kernel_dims.push_back(1);
+		std::vector<size_t> strides;strides.push_back(2);strides.push_back(3);strides.push_back(1);
+		std::shared_ptr< Module<double> > kernel_module(new KernelModule<double>("module1", 1,kernel_dims,strides,
+			kernel_factory, initializer, regularizer));
+
+		size_t num_kernel_outputs = Tensor<double>::Numel(kernel_module->GetPerCaseOutputDims(case_input_dims));
+		std::shared_ptr< Module<double> > m1(new LinearModule<double>("module2", case_input_dims,initializer, regularizer));
+		std::shared_ptr< Module<double> > m3(new LinearMixModule<double>("module3", num_kernel_outputs,8,initializer, regularizer));
+		std::vector< std::shared_ptr< Module<double> > > modules; modules.push_back(m1); modules.push_back(kernel_module); modules.push_back(m3);
+		std::shared_ptr< CompositeModule<double> > main_module(new CompositeModule<double>("module4", modules));
+
+		NN<double> net(main_module);
+		net.InitializeParameters();
+		BOOST_CHECK(NumericalCheckNNGradients(net, MseCostModule<double>(), train_dataset));
+
+		BOOST_CHECK( test_save_load_nn_state(net) );
+	}
+}
+
+BOOST_AUTO_TEST_CASE(test_averagepoolingkernel_gradient)
+{
+	CheckPoolingKernelGradient(AveragePoolingKernelFactory<double>());
+	CheckPoolingKernelGradient(L2PoolingKernelFactory<double>());
+}
@@ -82,4 +82,22 @@ BOOST_AUTO_TEST_CASE(TestBatchSoftmaxModuleGradient)
 	BOOST_CHECK(NumericalCheckNNGradients(net, LogisticCostModule<double>(), train_dataset, false));
 
 	BOOST_CHECK( test_save_load_nn_state(net) );
-}
\ No newline at end of file
+}
+
+BOOST_AUTO_TEST_CASE(TestBatchSoftmaxModuleStability)
+{
+	// exp() of the inputs overflows floats, the outputs depend only on the differences of the inputs over the batch
+	float input[] = {1000, -1000, 1001, -999, 1002, -998, 1003, -1001};
+	float expected_output[] = {0.0321f, 0.0871f, 0.0871f, 0.2369f, 0.2369f, 0.6439f, 0.6439f, 0.0321f};
+	std::vector<size_t> input_dims; input_dims.push_back(2); input_dims.push_back(4);
+	std::shared_ptr< Tensor<float> > input_tensor( new Tensor<float>(input_dims) );
+	std::copy(input, input+8, input_tensor->GetStartPtr());
+
+	const ExpPrecision precisions[] = {precise_exp, vectorized_exp, fast_exp};
+	for (size_t i=0; i<3; i++)
+	{
+		BatchSoftmaxModule<float> a("module1");
+		a.SetExpPrecision(precisions[i]);
+		BOOST_CHECK(test_equal_arrays(expected_output, a.train_fprop(input_tensor)->GetStartPtr(), 8));
+	}
+}
@@ -7,6 +7,9 @@
 #include "ConstantInitializer.h"
 #include "WeightDecayRegularizer.h"
 #include "LinearMixModule.h"
+#include "TanhModule.h"
+#include "RectifiedLinearUnitModule.h"
+#include "GaussianInitializer.h"
 #include "CompositeModule.h"
 #include "FullTensorDataLoader.h"
 #include "TrainDataset.h"
@@ -103,4 +106,83 @@ BOOST_AUTO_TEST_CASE(TestCompositeModule)
 		BOOST_CHECK(parameters_tensor[i] == 0);
 	
 	BOOST_CHECK( TestGetSetParameters<float>(module, num_params) );
-}
\ No newline at end of file
+}
+
+namespace
+{
+	std::vector< std::shared_ptr< Module<float> > > CreateMlpModules()
+	{
+		std::shared_ptr<ParametersInitializer<float>> initializer(new GaussianInitializer<float>());
+		std::shared_ptr<Regularizer<float>> regularizer(new WeightDecayRegularizer<float>(0.5));
+		std::vector<size_t> bias1_dims(1, 50), bias2_dims(1, 20);
+		std::vector< std::shared_ptr< Module<float> > > modules;
+		modules.push_back(std::shared_ptr< Module<float> >( new LinearMixModule<float>("linear_mix1", 9, 50, initializer, regularizer) ));
+		modules.push_back(std::shared_ptr< Module<float> >( new BiasModule<float>("bias1", bias1_dims, initializer, regularizer) ));
+		modules.push_back(std::shared_ptr< Module<float> >( new TanhModule<float>("tanh1") ));
+		modules.push_back(std::shared_ptr< Module<float> >( new LinearMixModule<float>("linear_mix2", 50, 20, initializer, regularizer) ));
+		modules.push_back(std::shared_ptr< Module<float> >( new BiasModule<float>("bias2", bias2_dims, initializer, regularizer) ));
+		modules.push_back(std::shared_ptr< Module<float> >( new RectifiedLinearUnitModule<float>("rlu2") ));
+		modules.push_back(std::shared_ptr< Module<float> >( new LinearMixModule<float>("linear_mix3", 20, 5, initializer, regularizer) ));
+		modules.push_back(std::shared_ptr< Module<float> >( new AbsModule<float>("abs3") ));
+		return modules;
+	}
+}
+
+BOOST_AUTO_TEST_CASE(TestAssignBufferArenas)
+{
+	size_t starts[] = {0, 1, 2, 3, 2, 6};
+	size_t ends[] = {1, 2, 9, 5, 2, 7};
+	std::vector<size_t> arena_inds = AssignBufferArenas(std::vector<size_t>(starts, starts+6), std::vector<size_t>(ends, ends+6));
+	size_t expected_arena_inds[] = {0, 1, 0, 1, 2, 1};
+	BOOST_CHECK(arena_inds == std::vector<size_t>(expected_arena_inds, expected_arena_inds+6));
+}
+
+BOOST_AUTO_TEST_CASE(TestCompositeModuleSharedBuffers)
+{
+	std::vector< std::shared_ptr< Module<float> > > modules = CreateMlpModules();
+	std::vector< std::shared_ptr< Module<float> > > own_buffers_modules = CreateMlpModules();
+	CompositeModule<float> module("composite", modules);
+	CompositeModule<float> own_buffers_module("composite", own_buffers_modules);
+	own_buffers_module.SetBufferSharing(false);
+	module.InitializeParameters();
+	std::vector<float> parameters;
+	module.GetParameters(parameters);
+	own_buffers_module.SetParameters(parameters);
+
+	std::vector<size_t> input_dims; input_dims.push_back(9); input_dims.push_back(10);
+	std::vector<size_t> output_dims; output_dims.push_back(5); output_dims.push_back(10);
+	std::vector<float> importances(10, 1);
+	for (size_t iter = 0; iter < 2; iter++)
+	{
+		std::shared_ptr< Tensor<float> > input = GetRandomTensorPtr<float>(input_dims);
+		std::shared_ptr< Tensor<float> > output_gradients = GetRandomTensorPtr<float>(output_dims);
+
+		// only the input and the output of the current module are alive
+		std::shared_ptr< Tensor<float> > output = module.predict_fprop(input);
+		std::shared_ptr< Tensor<float> > expected_output = own_buffers_module.predict_fprop(input);
+		BOOST_CHECK(test_equal_arrays(expected_output->GetStartPtr(), output->GetStartPtr(), 50, 1e-6f));
+		BOOST_CHECK_EQUAL(module.GetSharedBuffersNumel(false), 2*500);
+
+		output = module.train_fprop(input);
+		expected_output = own_buffers_module.train_fprop(input);
+		BOOST_CHECK(test_equal_arrays(expected_output->GetStartPtr(), output->GetStartPtr(), 50, 1e-6f));
+		std::shared_ptr< Tensor<float> > input_gradients = module.bprop(output_gradients, importances);
+		std::shared_ptr< Tensor<float> > expected_input_gradients = own_buffers_module.bprop(output_gradients, importances);
+		BOOST_CHECK(test_equal_arrays(expected_input_gradients->GetStartPtr(), input_gradients->GetStartPtr(), 90, 1e-5f));
+		std::vector<float> gradients, expected_gradients;
+		module.GetGradients(gradients);
+		own_buffers_module.GetGradients(expected_gradients);
+		BOOST_CHECK(test_equal_arrays(expected_gradients.data(), gradients.data(), static_cast<int>(gradients.size()), 1e-5f));
+		// separate buffers take 2200 elements for the outputs and 1540 for the input gradients
+		BOOST_CHECK_EQUAL(module.GetSharedBuffersNumel(true), 2250);
+	}
+
+	// the output of an inner module is valid after fprop if it is retained
+	module.RetainOutputBuffer("tanh1");
+	module.predict_fprop(GetRandomTensorPtr<float>(input_dims));
+	std::shared_ptr< Tensor<float> > input = GetRandomTensorPtr<float>(input_dims);
+	module.predict_fprop(input);
+	own_buffers_module.predict_fprop(input);
+	BOOST_CHECK(test_equal_arrays(own_buffers_module.GetModule("tanh1")->GetOutputBuffer()->GetStartPtr(), 
+		module.GetModule("tanh1")->GetOutputBuffer()->GetStartPtr(), 500, 1e-6f));
+}
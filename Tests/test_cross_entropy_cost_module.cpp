@@ -2,6 +2,7 @@
 #include <vector>
 #include "Tensor.h"
 #include "CrossEntropyCostModule.h"
+#include "SoftmaxModule.h"
 #include "test_utilities.h"
 
 BOOST_AUTO_TEST_CASE(TestCrossEntropyCostModule)
@@ -19,4 +20,37 @@ BOOST_AUTO_TEST_CASE(TestCrossEntropyCostModule)
 	BOOST_CHECK( abs(cost-5.2150)<0.001);
 	cost = cost_module.GetCost(output_tensor, expected_output_tensor, importance, true);
 	BOOST_CHECK( abs(cost-5.2150/3)<0.001);
-}
\ No newline at end of file
+}
+
+BOOST_AUTO_TEST_CASE(TestCrossEntropyCostModuleCostAndGradients)
+{
+	std::vector<size_t> output_dims;output_dims.push_back(4); output_dims.push_back(2);
+	float output[] = {0.4147f, 0.2645f, 0.1604f, 0.1604f, 0.1708f, 0.2548f, 0.4118f, 0.1625f};
+	float expected_output[] = {1, 0, 0, 0, 0, 0.5f, 0.5f, 0};
+	std::vector<float> importance;importance.push_back(1); importance.push_back(2);
+	Tensor<float> expected_output_tensor(expected_output, output_dims);
+	Tensor<float> output_tensor(output, output_dims);
+
+	CrossEntropyCostModule<float> cost_module;
+	double cost = cost_module.GetCost(output_tensor, expected_output_tensor, importance, true, 0.5);
+	// bprop and GetCostAndGradients return the same buffer
+	std::shared_ptr< Tensor<float> > gradients_tensor = cost_module.bprop(output_tensor, expected_output_tensor, importance, true, 0.5);
+	std::vector<float> gradients(gradients_tensor->GetStartPtr(), gradients_tensor->GetStartPtr()+8);
+	std::pair< double, std::shared_ptr< Tensor<float> > > cost_and_gradients = 
+		cost_module.GetCostAndGradients(output_tensor, expected_output_tensor, importance, true, 0.5);
+	BOOST_CHECK_CLOSE(cost_and_gradients.first, cost, 1e-4);
+	BOOST_CHECK(test_equal_arrays(gradients.data(), cost_and_gradients.second->GetStartPtr(), 8, 1e-6f));
+
+	// with fused softmax the gradients are with respect to the input of softmax: lambda*w/sum(w)*(p*sum(y)-y)/ln(2)
+	SoftmaxModule<float> softmax_module("softmax");
+	cost_module.FuseSoftmax(softmax_module);
+	cost_and_gradients = cost_module.GetCostAndGradients(output_tensor, expected_output_tensor, importance, true, 0.5);
+	BOOST_CHECK_CLOSE(cost_and_gradients.first, cost, 1e-4);
+	for (size_t sample_ind = 0; sample_ind<2; sample_ind++)
+		for (size_t i=0; i<4; i++)
+		{
+			size_t offset = 4*sample_ind+i;
+			double expected_gradient = 0.5*importance[sample_ind]/3*(output[offset]-expected_output[offset])/std::log(2.0);
+			BOOST_CHECK( std::abs((*cost_and_gradients.second)[offset]-expected_gradient) < 1e-6 );
+		}
+}
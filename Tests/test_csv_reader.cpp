@@ -0,0 +1,135 @@
+#include <boost/test/unit_test.hpp>
+#include <vector>
+#include <string>
+#include <fstream>
+#include <sstream>
+#include <cstdio>
+#include <cmath>
+#include "CsvReader.h"
+#include "test_utilities.h"
+
+namespace
+{
+	void WriteFile(const std::string& path, const std::string& contents)
+	{
+		std::ofstream stream(path, std::ios::binary);
+		stream << contents;
+	}
+}
+
+BOOST_AUTO_TEST_CASE(TestParseCsvNumber)
+{
+	const char* fields[] = {"0", "-12", "3.25", " 1e-3 ", "-2.5E+2", ".5", "12345678901234567890123", "1.00000000000000000000001", "0.1", "nan"};
+	double expected[] = {0, -12, 3.25, 1e-3, -250, 0.5, 12345678901234567890123.0, 1, 0.1, 0};
+	for (size_t i=0; i<sizeof(fields)/sizeof(fields[0]); i++)
+	{
+		std::string field = std::string(fields[i]) + ",7";
+		const char* ptr = field.data();
+		double value;
+		BOOST_CHECK(ParseCsvNumber(ptr, field.data()+field.size(), ',', value));
+		BOOST_CHECK(*ptr == ',');
+		if (i == 9)
+			BOOST_CHECK(value != value);
+		else
+			BOOST_CHECK_EQUAL(value, expected[i]);
+	}
+
+	const char* wrong_fields[] = {"", "abc", "1.5x", "--1", "1e"};
+	for (size_t i=0; i<sizeof(wrong_fields)/sizeof(wrong_fields[0]); i++)
+	{
+		std::string field(wrong_fields[i]);
+		const char* ptr = field.data();
+		float value;
+		BOOST_CHECK(!ParseCsvNumber(ptr, field.data()+field.size(), ',', value));
+	}
+}
+
+BOOST_AUTO_TEST_CASE(TestCsvReader)
+{
+	std::string path = "test_csv_reader.csv";
+	size_t num_rows = 1000;
+	size_t num_columns = 7;
+	std::vector<double> expected;
+	std::ostringstream contents;
+	contents << "\"label\",f1,f2,f3,f4,f5,f6\r\n";
+	for (size_t row=0; row<num_rows; row++)
+	{
+		for (size_t column=0; column<num_columns; column++)
+		{
+			double value = (column == 0) ? static_cast<double>(row % 9 + 1) : (static_cast<double>(row)-500)*column/8;
+			expected.push_back(value);
+			contents << (column == 0 ? "" : ",") << value;
+		}
+		// empty lines and both line endings
+		contents << (row % 2 == 0 ? "\r\n" : "\n");
+		if (row % 100 == 0)
+			contents << "\n";
+	}
+	WriteFile(path, contents.str());
+
+	// small chunks split the file between the lines, the rows are split between the threads
+	const size_t num_threads[] = {1, 3};
+	const size_t chunk_bytes[] = {1 << 24, 100};
+	for (size_t i=0; i<2; i++)
+		for (size_t j=0; j<2; j++)
+		{
+			CsvReader<float> reader(path, true, ',', num_threads[i], chunk_bytes[j]);
+			BOOST_CHECK_EQUAL(reader.GetNumColumns(), num_columns);
+			BOOST_CHECK_EQUAL(reader.GetHeader()[0], "label");
+			BOOST_CHECK_EQUAL(reader.GetHeader()[6], "f6");
+			std::vector<float> matrix;
+			if (j == 0)
+				BOOST_CHECK_EQUAL(reader.ReadChunk(matrix), num_rows);
+			else
+				BOOST_CHECK_EQUAL(reader.ReadAll(matrix), num_rows);
+			BOOST_CHECK(reader.AtEnd());
+			BOOST_CHECK_EQUAL(matrix.size(), expected.size());
+			bool equal = true;
+			for (size_t k=0; k<expected.size(); k++)
+				equal = equal && matrix[k] == static_cast<float>(expected[k]);
+			BOOST_CHECK(equal);
+		}
+
+	// without the header the number of the columns is taken from the first row
+	WriteFile(path, "\n1;2.5;3\n4;5;6");
+	{
+		CsvReader<double> reader(path, false, ';', 2);
+		BOOST_CHECK(reader.GetHeader().empty());
+		BOOST_CHECK_EQUAL(reader.GetNumColumns(), 3);
+		std::vector<double> matrix;
+		BOOST_CHECK_EQUAL(reader.ReadAll(matrix), 2);
+		double expected_matrix[] = {1, 2.5, 3, 4, 5, 6};
+		BOOST_CHECK(test_equal_arrays(expected_matrix, matrix.data(), 6));
+	}
+	std::remove(path.c_str());
+}
+
+BOOST_AUTO_TEST_CASE(TestCsvReaderErrors)
+{
+	std::string path = "test_csv_reader_errors.csv";
+	const char* contents[] = {"a,b\n1,2\n3\n", "a,b\n1,2\n3,4,5\n", "a,b\n1,2\n\n3,x\n"};
+	for (size_t i=0; i<sizeof(contents)/sizeof(contents[0]); i++)
+	{
+		WriteFile(path, contents[i]);
+		CsvReader<float> reader(path, true, ',', 2);
+		std::vector<float> matrix;
+		BOOST_CHECK_THROW(reader.ReadAll(matrix), std::runtime_error);
+	}
+
+	// the message has the line number
+	WriteFile(path, contents[2]);
+	{
+		CsvReader<float> reader(path);
+		std::vector<float> matrix;
+		try
+		{
+			reader.ReadAll(matrix);
+			BOOST_CHECK(false);
+		}
+		catch (const std::runtime_error& error)
+		{
+			BOOST_CHECK(std::string(error.what()).find("line 4") != std::string::npos);
+		}
+	}
+	std::remove(path.c_str());
+}
@@ -49,6 +49,42 @@ BOOST_AUTO_TEST_CASE(TestDropoutModule_stochastic)
 	}
 }
 
+BOOST_AUTO_TEST_CASE(TestDropoutModule_inverted)
+{
+	size_t num_inputs = 10000;
+	double dropout_probability = 0.75;
+	std::vector<size_t> input_dims;input_dims.push_back(num_inputs);input_dims.push_back(2);
+	std::shared_ptr< Tensor<double> > input = GetRandomTensorPtr<double>(input_dims);
+	DropoutModule<double> m1("module1", dropout_probability, true);
+	BOOST_CHECK(!m1.AlocateOutputBuffer());
+	BOOST_CHECK(m1.IsInverted());
+
+	// the kept elements are scaled, so that the expected output equals the input
+	std::shared_ptr< Tensor<double> > output = m1.train_fprop(input);
+	BOOST_CHECK(output->GetStartPtr() != input->GetStartPtr());
+	size_t num_dropouts = 0;
+	bool scaled = true;
+	for (size_t i = 0; i<input->Numel(); i++)
+	{
+		num_dropouts += static_cast<size_t>((*output)[i]==0);
+		scaled = scaled && ((*output)[i]==0 || std::abs((*output)[i] - (*input)[i]/(1-dropout_probability)) < 1e-10);
+	}
+	BOOST_CHECK(scaled);
+	BOOST_CHECK( abs( static_cast<double>(num_dropouts) / input->Numel() - dropout_probability ) < 0.05 );
+
+	// the gradients use the same mask and scale
+	std::shared_ptr< Tensor<double> > output_gradients = GetRandomTensorPtr<double>(input_dims);
+	std::shared_ptr< Tensor<double> > input_gradients = m1.bprop(output_gradients, std::vector<double>(2, 1));
+	bool same_mask = true;
+	for (size_t i = 0; i<input->Numel(); i++)
+		same_mask = same_mask && std::abs((*input_gradients)[i]*(*input)[i] - (*output)[i]*(*output_gradients)[i]) < 1e-10;
+	BOOST_CHECK(same_mask);
+
+	// predict passes the input through
+	BOOST_CHECK(m1.predict_fprop(input)->GetStartPtr() == input->GetStartPtr());
+	BOOST_CHECK(m1.train_fprop(input)->GetStartPtr() == output->GetStartPtr());
+}
+
 BOOST_AUTO_TEST_CASE(TestDropoutGradient)
 {
 	// it is random, not clear how to test it
@@ -85,7 +121,8 @@ BOOST_AUTO_TEST_CASE(TestDropoutSaveLoadState)
 
 	std::shared_ptr< Module<double> > m1(new LinearModule<double>("module1", case_input_dims,initializer, regularizer));
 	std::shared_ptr< Module<double> > m2(new DropoutModule<double>("module2", 0.5));
-	std::vector< std::shared_ptr< Module<double> > > modules; modules.push_back(m1); modules.push_back(m2);
+	std::shared_ptr< Module<double> > m3(new DropoutModule<double>("module4", 0.5, true));
+	std::vector< std::shared_ptr< Module<double> > > modules; modules.push_back(m1); modules.push_back(m2); modules.push_back(m3);
 	std::shared_ptr< CompositeModule<double> > main_module(new CompositeModule<double>("module3", modules));
 
 	NN<double> net(main_module);
@@ -67,4 +67,33 @@ BOOST_AUTO_TEST_CASE(test_full_tensor_data_loader_save_load)
 		std::static_pointer_cast<  FullTensorDataLoader<double,float> >(DataLoaderFactory::GetDataLoader<double, float>(stream));
 
 	BOOST_CHECK(data_loader.Equals(*data_loader2));
-}
\ No newline at end of file
+}
+
+BOOST_AUTO_TEST_CASE(test_full_tensor_data_loader_sample_arena)
+{
+	std::vector< std::shared_ptr< Tensor<float> > > input(20);
+	std::vector<size_t> case_dims;case_dims.push_back(93);
+	for (size_t i=0; i<input.size(); i++)
+		input[i] = GetRandomTensorPtr<float>(case_dims);
+
+	// samples of the same dimensions are copied, the loader does not keep the tensors
+	FullTensorDataLoader<double,float> data_loader(input);
+	for (size_t i=0; i<input.size(); i++)
+		BOOST_CHECK( input[i].use_count() == 1 );
+	BOOST_CHECK( data_loader.GetNumSamples() == input.size() );
+
+	std::vector<size_t> inds;inds.push_back(7);inds.push_back(19);inds.push_back(7);inds.push_back(0);
+	std::shared_ptr< Tensor<double> > samples = data_loader.GetData(inds);
+	for (size_t i=0; i<inds.size(); i++)
+		for (size_t j=0; j<93; j++)
+			BOOST_CHECK( (*samples)[i*93+j] == (*input[inds[i]])[j] );
+
+	// samples of different dimensions are stored separately
+	std::vector<size_t> other_case_dims;other_case_dims.push_back(94);
+	input.push_back(GetRandomTensorPtr<float>(other_case_dims));
+	FullTensorDataLoader<float,float> separate_data_loader(input);
+	BOOST_CHECK( input[0].use_count() == 2 );
+	inds.clear();inds.push_back(3);
+	std::shared_ptr< Tensor<float> > other_samples = separate_data_loader.GetData(inds);
+	BOOST_CHECK( test_equal_arrays(other_samples->GetStartPtr(), input[3]->GetStartPtr(), 93) );
+}
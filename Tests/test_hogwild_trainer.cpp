@@ -0,0 +1,89 @@
+#include <boost/test/unit_test.hpp>
+#include <vector>
+#include <memory>
+#include "Tensor.h"
+#include "LinearMixInitializer.h"
+#include "GaussianInitializer.h"
+#include "BiasModule.h"
+#include "SigmoidModule.h"
+#include "CompositeModule.h"
+#include "LinearMixModule.h"
+#include "LogisticCostModule.h"
+#include "HogwildTrainer.h"
+#include "FullTensorDataLoader.h"
+#include "NN.h"
+
+BOOST_AUTO_TEST_CASE(testHogwildTrainer)
+{
+	// the linearly separable problem of testSgdTrainer, solved by several workers with and without the bounded staleness
+	double train_cases[] = {1,0,   -1, 1,   1,-1,    0.5,0,    -0.5,0,   -0.67,-0.09,    0.58,-0.83,    -0.47,0.07};
+	double train_labels[] = {1, 0, 1, 1, 0, 0, 1, 0};
+
+	size_t num_inputs = 2;
+	size_t num_outputs = 1;
+	size_t num_train_cases = 8;
+
+	std::vector<size_t> input_dims; input_dims.push_back(num_inputs);
+	std::vector<size_t> output_dims; output_dims.push_back(num_outputs);
+
+	std::vector< std::shared_ptr< Tensor<double> > > train_input(num_train_cases);
+	std::vector< std::shared_ptr< Tensor<double> > > train_output(num_train_cases);
+	std::vector<double> train_importance(num_train_cases, 1.0);
+	for (size_t i=0; i<num_train_cases; i++)
+	{
+		train_input[i] = std::shared_ptr< Tensor<double> >( new Tensor<double>(train_cases+num_inputs*i, input_dims));
+		train_output[i] = std::shared_ptr< Tensor<double> >( new Tensor<double>(train_labels+num_outputs*i, output_dims));
+	}
+
+	std::shared_ptr< ITensorDataLoader<double> > input_data_loader(new FullTensorDataLoader<double,double>(train_input));
+	std::shared_ptr< ITensorDataLoader<double> > output_data_loader(new FullTensorDataLoader<double,double>(train_output));
+	std::shared_ptr< ITrainDataset<double> > train_dataset( new TrainDataset<double>(input_data_loader, output_data_loader, train_importance) );
+
+	std::shared_ptr<ParametersInitializer<double>> lmm_initializer(new LinearMixInitializer<double>());
+	std::shared_ptr<Regularizer<double>> regularizer(new EmptyRegularizer<double>());
+	std::shared_ptr<ParametersInitializer<double>> bias_initializer(new GaussianInitializer<double>(0.001));
+
+	const size_t max_stalenesses[] = {0, 1};
+	for (size_t i=0; i<2; i++)
+	{
+		std::shared_ptr< Module<double> > m1(new LinearMixModule<double>("module1", num_inputs,num_outputs,lmm_initializer, regularizer));
+		std::shared_ptr< Module<double> > m2(new BiasModule<double>("module2", output_dims,bias_initializer, regularizer));
+		std::shared_ptr< Module<double> > m3(new SigmoidModule<double>("module3"));
+		std::vector< std::shared_ptr< Module<double> > > modules; modules.push_back(m1); modules.push_back(m2); modules.push_back(m3);
+		std::shared_ptr< CompositeModule<double> > main_module(new CompositeModule<double>("module4", modules));
+
+		NN<double> net(main_module);
+		net.InitializeParameters();
+
+		// the results are processed in the order of the batches, the train results get the current parameters
+		// also before the first validation
+		size_t num_validation_results = 0;
+		size_t last_batch_num = 0;
+		bool ordered = true;
+		bool trained_parameters = true;
+		std::vector<double> initial_parameters = net.GetParameters();
+		HogwildTrainer<double> trainer(2000, 0.1, 0.9, 1, 100, 0.99, 0, 30, 100, 3, max_stalenesses[i]);
+		LogisticCostModule<double> cost_module;
+		double validation_cost = trainer.Train(net, cost_module, cost_module, *train_dataset, *train_dataset,
+			[&](TrainCallbackParams<double>& result)
+			{
+				ordered = ordered && result.batch_num > last_batch_num;
+				last_batch_num = result.batch_num;
+				trained_parameters = trained_parameters && result.net.GetParameters() != initial_parameters;
+			},
+			[&](ValidationCallbackParams<double>& result)
+			{
+				ordered = ordered && result.batch_num > last_batch_num;
+				last_batch_num = result.batch_num;
+				num_validation_results++;
+			});
+		BOOST_CHECK(ordered);
+		BOOST_CHECK(trained_parameters);
+		BOOST_CHECK(num_validation_results > 0 && num_validation_results <= 20);
+		BOOST_CHECK(validation_cost < 0.5);
+
+		auto predicted_labels = net.Predict( *input_data_loader );
+		for (size_t j=0; j<num_train_cases; j++)
+			BOOST_CHECK_EQUAL( (*predicted_labels[j])[0] > 0.5, train_labels[j] == 1 );
+	}
+}
@@ -0,0 +1,96 @@
+#include <boost/test/unit_test.hpp>
+#include <vector>
+#include <memory>
+#include "Tensor.h"
+#include "LinearMixModule.h"
+#include "BiasModule.h"
+#include "TanhModule.h"
+#include "AbsModule.h"
+#include "RectifiedLinearUnitModule.h"
+#include "MeanStdNormalizingModule.h"
+#include "DropoutModule.h"
+#include "SoftmaxModule.h"
+#include "PureSoftmaxModule.h"
+#include "CompositeModule.h"
+#include "ActivationFusion.h"
+#include "InferenceNN.h"
+#include "test_utilities.h"
+
+namespace
+{
+	std::shared_ptr< Module<double> > CreateLinearMix(std::string name, size_t num_inputs, size_t num_outputs)
+	{
+		std::shared_ptr< LinearMixModule<double> > module( new LinearMixModule<double>(name, num_inputs, num_outputs) );
+		module->SetParameters(GetRandomTensorPtr<double>(std::vector<size_t>(1, num_inputs*num_outputs))->GetStartPtr());
+		return module;
+	}
+
+	std::shared_ptr< Module<double> > CreateBias(std::string name, size_t num_inputs)
+	{
+		std::shared_ptr< BiasModule<double> > module( new BiasModule<double>(name, std::vector<size_t>(1, num_inputs)) );
+		module->SetParameters(GetRandomTensorPtr<double>(std::vector<size_t>(1, num_inputs))->GetStartPtr());
+		return module;
+	}
+
+	// the outputs of the network and of the inference network for the batch sizes 1, 3 and 7
+	void CheckInferenceNN(CompositeModule<double>& network, size_t num_inputs, size_t num_outputs, size_t expected_num_steps)
+	{
+		size_t num_samples = 7;
+		std::vector<size_t> input_dims; input_dims.push_back(num_inputs); input_dims.push_back(num_samples);
+		std::shared_ptr< Tensor<double> > input = GetRandomTensorPtr<double>(input_dims, -2, 2);
+		std::shared_ptr< Tensor<double> > expected_output = network.predict_fprop(input);
+
+		const size_t max_batch_sizes[] = {1, 3, 7};
+		for (size_t i=0; i<3; i++)
+		{
+			InferenceNN<double> inference_nn(network, std::vector<size_t>(1, num_inputs), max_batch_sizes[i]);
+			BOOST_CHECK_EQUAL(inference_nn.GetNumSteps(), expected_num_steps);
+			BOOST_CHECK_EQUAL(inference_nn.GetNumOutputs(), num_outputs);
+			Tensor<double> output(expected_output->GetDimensions());
+			inference_nn.Predict(*input, output);
+			BOOST_CHECK(test_equal_arrays(expected_output->GetStartPtr(), output.GetStartPtr(), static_cast<int>(output.Numel()), 1e-10));
+		}
+	}
+}
+
+BOOST_AUTO_TEST_CASE(TestInferenceNN)
+{
+	// normalization, dropout and biases are folded into the linear mixes
+	std::vector< std::shared_ptr< Module<double> > > modules;
+	std::shared_ptr< MeanStdNormalizingModule<double> > normalizing_module( new MeanStdNormalizingModule<double>("normalizer", 4) );
+	for (size_t i=0; i<4; i++)
+	{
+		normalizing_module->GetMeans()[i] = i - 1.5;
+		normalizing_module->GetStds()[i] = 0.5 + i;
+	}
+	modules.push_back(normalizing_module);
+	modules.push_back(CreateLinearMix("linear_mix1", 4, 5));
+	modules.push_back(CreateBias("bias1", 5));
+	modules.push_back(std::shared_ptr< Module<double> >( new TanhModule<double>("tanh") ));
+	modules.push_back(std::shared_ptr< Module<double> >( new DropoutModule<double>("dropout", 0.7) ));
+	modules.push_back(std::shared_ptr< Module<double> >( new DropoutModule<double>("inverted_dropout", 0.3, true) ));
+	modules.push_back(CreateLinearMix("linear_mix2", 5, 3));
+	modules.push_back(CreateBias("bias2", 3));
+	modules.push_back(std::shared_ptr< Module<double> >( new SoftmaxModule<double>("softmax") ));
+	CompositeModule<double> network("network", modules);
+	CheckInferenceNN(network, 4, 3, 3);
+
+	// fused activations, a nested composite module and an activation that can not be fused
+	std::vector< std::shared_ptr< Module<double> > > inner_modules;
+	inner_modules.push_back(CreateLinearMix("linear_mix3", 4, 6));
+	inner_modules.push_back(CreateBias("bias3", 6));
+	inner_modules.push_back(std::shared_ptr< Module<double> >( new RectifiedLinearUnitModule<double>("rlu") ));
+	inner_modules = FuseActivations(inner_modules);
+	std::vector< std::shared_ptr< Module<double> > > outer_modules;
+	outer_modules.push_back(std::shared_ptr< Module<double> >( new CompositeModule<double>("inner", inner_modules) ));
+	outer_modules.push_back(std::shared_ptr< Module<double> >( new AbsModule<double>("abs") ));
+	outer_modules.push_back(CreateBias("bias4", 6));
+	CompositeModule<double> fused_network("fused_network", outer_modules);
+	CheckInferenceNN(fused_network, 4, 6, 3);
+
+	// the modules without inference steps are rejected
+	std::vector< std::shared_ptr< Module<double> > > unsupported_modules;
+	unsupported_modules.push_back(std::shared_ptr< Module<double> >( new PureSoftmaxModule<double>("pure_softmax") ));
+	CompositeModule<double> unsupported_network("unsupported_network", unsupported_modules);
+	BOOST_CHECK_THROW(InferenceNN<double>(unsupported_network, std::vector<size_t>(1, 4)), std::runtime_error);
+}
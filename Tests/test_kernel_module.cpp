@@ -113,4 +113,120 @@ BOOST_AUTO_TEST_CASE(TestKernelModule_convolutional)
 	BOOST_CHECK_EQUAL(kernel_module.GetNumParams() , num_output_kernels*num_input_kernels*kernel_dims[0]*kernel_dims[1]);
 	
 	TestGetSetParameters<double>(kernel_module, kernel_module.GetNumParams());
-}
\ No newline at end of file
+}
+
+BOOST_AUTO_TEST_CASE(TestKernelModule_convolutional_bprop)
+{
+	size_t num_input_kernels = 3;
+	size_t num_output_kernels = 4;
+	size_t num_samples = 5;
+	std::vector<size_t> input_dims; input_dims.push_back(11); input_dims.push_back(9); input_dims.push_back(num_input_kernels);input_dims.push_back(num_samples);
+	std::shared_ptr<Tensor<double> > input_tensor = GetRandomTensorPtr<double>(input_dims);
+	std::vector<size_t> kernel_dims; kernel_dims.push_back(3); kernel_dims.push_back(2); kernel_dims.push_back(num_input_kernels);
+	std::vector<size_t> strides;strides.push_back(2);strides.push_back(1);strides.push_back(1);
+	
+	KernelModule<double> kernel_module("module1", num_output_kernels,kernel_dims,strides, ConvolutionalKernelFactory<double>());
+	std::vector<size_t> all_kernels_dims = kernel_dims;
+	all_kernels_dims.push_back(num_output_kernels);
+	Tensor<double> all_kernels_tensor = GetRandomTensor<double>(all_kernels_dims);
+	double* params = all_kernels_tensor.GetStartPtr();
+	kernel_module.SetParameters(params);
+	std::shared_ptr<Tensor<double> > output_tensor = kernel_module.train_fprop(input_tensor);
+	std::shared_ptr<Tensor<double> > output_gradients = GetRandomTensorPtr<double>(output_tensor->GetDimensions());
+	std::shared_ptr<Tensor<double> > input_gradients = kernel_module.bprop(output_gradients, std::vector<double>(num_samples, 1));
+	std::vector<double> gradients;
+	kernel_module.GetGradients(gradients);
+
+	// compare with applying each kernel to each sample separately
+	std::vector<size_t> sample_input_dims = input_dims;
+	sample_input_dims.pop_back();
+	std::vector<size_t> sample_output_dims = kernel_module.GetKernel(0)->GetOutputTensorDimensions(sample_input_dims);
+	size_t num_params_per_kernel = Tensor<double>::Numel(kernel_dims);
+	size_t sample_output_numel = Tensor<double>::Numel(sample_output_dims);
+	size_t sample_input_numel = Tensor<double>::Numel(sample_input_dims);
+	Tensor<double> expected_input_gradients(input_dims);
+	Tensor<double> expected_gradients(all_kernels_dims);
+	Tensor<double> expected_output(sample_output_dims);
+	for (size_t kernel_ind = 0; kernel_ind<num_output_kernels; kernel_ind++)
+	{
+		ConvolutionalKernel<double> kernel(Tensor<double>(params + num_params_per_kernel*kernel_ind, kernel_dims), strides);
+		Tensor<double> kernel_gradients(expected_gradients.GetStartPtr()+num_params_per_kernel*kernel_ind, kernel_dims);
+		for (size_t sample_ind = 0; sample_ind<num_samples; sample_ind++)
+		{
+			size_t output_offset = (num_output_kernels*sample_ind + kernel_ind)*sample_output_numel;
+			Tensor<double> sample_input(input_tensor->GetStartPtr()+sample_ind*sample_input_numel, sample_input_dims);
+			Tensor<double> sample_input_gradients(expected_input_gradients.GetStartPtr()+sample_ind*sample_input_numel, sample_input_dims);
+			Tensor<double> sample_output(output_tensor->GetStartPtr()+output_offset, sample_output_dims);
+			Tensor<double> sample_output_gradients(output_gradients->GetStartPtr()+output_offset, sample_output_dims);
+			kernel.fprop(sample_input, expected_output);
+			BOOST_CHECK(test_equal_arrays(expected_output.GetStartPtr(), sample_output.GetStartPtr(), sample_output_numel, 0.000001));
+			kernel.GetGradient(sample_input, sample_output, sample_output_gradients, kernel_gradients);
+			kernel.bprop(sample_input, sample_output, sample_input_gradients, sample_output_gradients);
+		}
+	}
+
+	BOOST_CHECK(gradients.size() == expected_gradients.Numel());
+	BOOST_CHECK(test_equal_arrays(expected_gradients.GetStartPtr(), gradients.data(), gradients.size(), 0.000001));
+	BOOST_CHECK(test_equal_arrays(expected_input_gradients.GetStartPtr(), input_gradients->GetStartPtr(), input_gradients->Numel(), 0.000001));
+}
+
+BOOST_AUTO_TEST_CASE(TestKernelModule_strided_input)
+{
+	// a crop of a minibatch is processed without copying it, the results are the ones of the dense copy of the crop
+	size_t num_input_kernels = 2;
+	size_t num_output_kernels = 3;
+	size_t num_samples = 4;
+	std::vector<size_t> full_dims; full_dims.push_back(13); full_dims.push_back(10); full_dims.push_back(num_input_kernels); full_dims.push_back(num_samples+2);
+	Tensor<double> full_tensor = GetRandomTensor<double>(full_dims);
+	std::vector<size_t> start; start.push_back(2); start.push_back(1); start.push_back(0); start.push_back(1);
+	std::vector<size_t> input_dims; input_dims.push_back(9); input_dims.push_back(7); input_dims.push_back(num_input_kernels); input_dims.push_back(num_samples);
+	std::shared_ptr<Tensor<double> > crop( new Tensor<double>(full_tensor.Crop(start, input_dims)) );
+	BOOST_CHECK( !crop->IsContiguous() );
+	std::shared_ptr<Tensor<double> > dense_input( new Tensor<double>(input_dims) );
+	CopyTensorElements(*crop, dense_input->GetStartPtr());
+
+	std::vector<size_t> kernel_dims; kernel_dims.push_back(3); kernel_dims.push_back(2); kernel_dims.push_back(num_input_kernels);
+	std::vector<size_t> strides; strides.push_back(2); strides.push_back(1); strides.push_back(1);
+	KernelModule<double> strided_module("module1", num_output_kernels, kernel_dims, strides, ConvolutionalKernelFactory<double>());
+	KernelModule<double> dense_module("module2", num_output_kernels, kernel_dims, strides, ConvolutionalKernelFactory<double>());
+	BOOST_CHECK( strided_module.AcceptsStridedInput() );
+	std::vector<size_t> all_kernels_dims = kernel_dims;
+	all_kernels_dims.push_back(num_output_kernels);
+	Tensor<double> all_kernels_tensor = GetRandomTensor<double>(all_kernels_dims);
+	strided_module.SetParameters(all_kernels_tensor.GetStartPtr());
+	dense_module.SetParameters(all_kernels_tensor.GetStartPtr());
+
+	std::shared_ptr<Tensor<double> > output = strided_module.train_fprop(crop);
+	std::shared_ptr<Tensor<double> > expected_output = dense_module.train_fprop(dense_input);
+	BOOST_CHECK( *output == *expected_output );
+	std::shared_ptr<Tensor<double> > output_gradients = GetRandomTensorPtr<double>(output->GetDimensions());
+	std::shared_ptr<Tensor<double> > input_gradients = strided_module.bprop(output_gradients, std::vector<double>(num_samples, 1));
+	std::shared_ptr<Tensor<double> > expected_input_gradients = dense_module.bprop(output_gradients, std::vector<double>(num_samples, 1));
+	BOOST_CHECK( input_gradients->IsContiguous() );
+	BOOST_CHECK( *input_gradients == *expected_input_gradients );
+	std::vector<double> gradients, expected_gradients;
+	strided_module.GetGradients(gradients);
+	dense_module.GetGradients(expected_gradients);
+	BOOST_CHECK(test_equal_arrays(expected_gradients.data(), gradients.data(), gradients.size(), 0.000001));
+
+	// the kernel keeps the offsets of the strided input and of the dense gradients, alternating between them does not recompute them
+	ConvolutionalKernel<double> kernel(Tensor<double>(kernel_dims), strides);
+	const std::vector<int>* strided_offsets = &kernel.GetKernelOffsets(crop->GetShape());
+	std::vector<int> expected_strided_offsets = *strided_offsets;
+	const std::vector<int>* dense_offsets = &kernel.GetKernelOffsets(dense_input->GetShape());
+	BOOST_CHECK( *dense_offsets != expected_strided_offsets );
+	BOOST_CHECK( &kernel.GetKernelOffsets(crop->GetShape()) == strided_offsets );
+	BOOST_CHECK( *strided_offsets == expected_strided_offsets );
+	BOOST_CHECK( &kernel.GetKernelOffsets(dense_input->GetShape()) == dense_offsets );
+
+	// the max pooling gets a dense copy of the crop
+	std::vector<size_t> pooling_dims; pooling_dims.push_back(2); pooling_dims.push_back(2); pooling_dims.push_back(1);
+	KernelModule<double> pooling_module("module3", 1, pooling_dims, pooling_dims, MaxPoolingKernelFactory<double>());
+	KernelModule<double> dense_pooling_module("module4", 1, pooling_dims, pooling_dims, MaxPoolingKernelFactory<double>());
+	BOOST_CHECK( !pooling_module.AcceptsStridedInput() );
+	output = pooling_module.train_fprop(crop);
+	BOOST_CHECK( *output == *dense_pooling_module.train_fprop(dense_input) );
+	output_gradients = GetRandomTensorPtr<double>(output->GetDimensions());
+	input_gradients = pooling_module.bprop(output_gradients, std::vector<double>(num_samples, 1));
+	BOOST_CHECK( *input_gradients == *dense_pooling_module.bprop(output_gradients, std::vector<double>(num_samples, 1)) );
+}
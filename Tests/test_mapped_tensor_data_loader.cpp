@@ -0,0 +1,84 @@
+#include <boost/test/unit_test.hpp>
+#include <vector>
+#include <memory>
+#include <fstream>
+#include <sstream>
+#include <cstdio>
+#include "Tensor.h"
+#include "MappedTensorDataLoader.h"
+#include "FullTensorDataLoader.h"
+#include "DataLoaderFactory.h"
+#include "test_utilities.h"
+
+BOOST_AUTO_TEST_CASE(test_mapped_tensor_data_loader)
+{
+	std::vector< std::shared_ptr< Tensor<double> > > input(15);
+	std::vector<size_t> case_dims;case_dims.push_back(9);case_dims.push_back(5);case_dims.push_back(4);
+	for (size_t i=0; i<input.size(); i++)
+		input[i] = GetRandomTensorPtr<double>(case_dims);
+
+	std::string path = "test_mapped_tensor_data_loader.bin";
+	{
+		std::ofstream stream(path, std::ios::binary);
+		SaveBinaryDataset(input, stream);
+	}
+
+	{
+		MappedTensorDataLoader<float, double> mapped_loader(path);
+		FullTensorDataLoader<float, double> full_loader(input);
+		BOOST_CHECK( mapped_loader.GetNumSamples() == input.size() );
+		BOOST_CHECK( mapped_loader.GetSampleDims() == case_dims );
+
+		std::vector<size_t> inds;inds.push_back(3);inds.push_back(0);inds.push_back(14);inds.push_back(3);
+		std::shared_ptr< Tensor<float> > mapped_samples = mapped_loader.GetData(inds);
+		std::shared_ptr< Tensor<float> > full_samples = full_loader.GetData(inds);
+		BOOST_CHECK( mapped_samples->GetDimensions() == full_samples->GetDimensions() );
+		BOOST_CHECK( test_equal_arrays(mapped_samples->GetStartPtr(), full_samples->GetStartPtr(), full_samples->Numel()) );
+
+		// only the path is saved
+		std::stringstream stream;
+		mapped_loader.Save(stream);
+		std::shared_ptr< BaseTensorDataLoader<float, double> > loaded_loader = DataLoaderFactory::GetDataLoader<float, double>(stream);
+		BOOST_CHECK( loaded_loader->Equals(mapped_loader) );
+
+		// elements type of the file should match
+		BOOST_CHECK_THROW( (MappedTensorDataLoader<float, float>(path)), std::runtime_error );
+	}
+	std::remove(path.c_str());
+}
+
+BOOST_AUTO_TEST_CASE(test_mapped_tensor_data_loader_variable_sample_dims)
+{
+	std::vector< std::shared_ptr< Tensor<float> > > input;
+	std::vector<size_t> case_dims1;case_dims1.push_back(3);case_dims1.push_back(2);
+	std::vector<size_t> case_dims2;case_dims2.push_back(5);case_dims2.push_back(1);
+	for (size_t i=0; i<6; i++)
+		input.push_back( GetRandomTensorPtr<float>(i%3 == 0 ? case_dims2 : case_dims1) );
+
+	std::string path = "test_mapped_tensor_data_loader_variable_sample_dims.bin";
+	{
+		std::ofstream stream(path, std::ios::binary);
+		SaveBinaryDataset(input, stream);
+	}
+
+	{
+		MappedTensorDataLoader<float, float> mapped_loader(path);
+		BOOST_CHECK( mapped_loader.GetNumSamples() == input.size() );
+		BOOST_CHECK( mapped_loader.GetSampleDims(3) == case_dims2 );
+		BOOST_CHECK( mapped_loader.GetSampleDims(4) == case_dims1 );
+
+		std::vector<size_t> inds;inds.push_back(4);inds.push_back(1);
+		std::shared_ptr< Tensor<float> > samples = mapped_loader.GetData(inds);
+		BOOST_CHECK( test_equal_arrays(samples->GetStartPtr(), input[4]->GetStartPtr(), 6) );
+		BOOST_CHECK( test_equal_arrays(samples->GetStartPtr()+6, input[1]->GetStartPtr(), 6) );
+
+		inds.clear();inds.push_back(3);inds.push_back(0);
+		samples = mapped_loader.GetData(inds);
+		BOOST_CHECK( test_equal_arrays(samples->GetStartPtr(), input[3]->GetStartPtr(), 5) );
+		BOOST_CHECK( test_equal_arrays(samples->GetStartPtr()+5, input[0]->GetStartPtr(), 5) );
+
+		inds.push_back(1);
+		BOOST_CHECK_THROW( mapped_loader.GetData(inds), std::runtime_error );
+	}
+	std::remove(path.c_str());
+}
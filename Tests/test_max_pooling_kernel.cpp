@@ -124,4 +124,44 @@ BOOST_AUTO_TEST_CASE(test_maxpoolingkernel_gradient)
 	BOOST_CHECK(NumericalCheckNNGradients(net, MseCostModule<double>(), train_dataset));
 	
 	BOOST_CHECK( test_save_load_nn_state(net) );
-}
\ No newline at end of file
+}
+
+BOOST_AUTO_TEST_CASE(TestMaxPoolingKernel_specialized_windows)
+{
+	// the unrolled windows and the argmax cache give the results of the generic search
+	std::vector<size_t> input_dims; input_dims.push_back(13); input_dims.push_back(11); input_dims.push_back(3);
+	Tensor<double> input_tensor = GetRandomTensor<double>(input_dims);
+	size_t windows[][2] = { {2, 1}, {3, 1}, {2, 2}, {3, 3}, {3, 2} };
+	for (size_t window_ind = 0; window_ind<5; window_ind++)
+		for (size_t stride = 1; stride<=3; stride++)
+		{
+			std::vector<size_t> kernel_dims; kernel_dims.push_back(windows[window_ind][0]); kernel_dims.push_back(windows[window_ind][1]); kernel_dims.push_back(1);
+			std::vector<size_t> strides; strides.push_back(stride); strides.push_back(stride); strides.push_back(1);
+			if (stride == 3)
+			{
+				// stride = window
+				strides[0] = kernel_dims[0];
+				strides[1] = kernel_dims[1];
+			}
+			MaxPoolingKernel<double> kernel(Tensor<double>(0, kernel_dims), strides);
+			Tensor<double> output_tensor(kernel.GetOutputTensorDimensions(input_dims));
+			kernel.fprop(input_tensor, output_tensor);
+			BOOST_CHECK(test_filter_response<double>(input_tensor, output_tensor, kernel, kernel_dims, strides));
+
+			Tensor<double> output_gradients = GetRandomTensor<double>(output_tensor.GetDimensions());
+			Tensor<double> input_gradients(input_dims);
+			kernel.bprop(input_tensor, output_tensor, input_gradients, output_gradients);
+
+			// a kernel without fprop searches for the maximums in bprop
+			MaxPoolingKernel<double> reference_kernel(Tensor<double>(0, kernel_dims), strides);
+			Tensor<double> expected_input_gradients(input_dims);
+			reference_kernel.bprop(input_tensor, output_tensor, expected_input_gradients, output_gradients);
+			BOOST_CHECK( input_gradients == expected_input_gradients );
+			double gradients_sum = 0, expected_gradients_sum = 0;
+			for (size_t i=0; i<output_gradients.Numel(); i++)
+				expected_gradients_sum += output_gradients[i];
+			for (size_t i=0; i<input_gradients.Numel(); i++)
+				gradients_sum += input_gradients[i];
+			BOOST_CHECK( std::abs(gradients_sum - expected_gradients_sum) < 0.000001 );
+		}
+}
@@ -0,0 +1,131 @@
+#include <boost/test/unit_test.hpp>
+#include <vector>
+#include <cstring>
+#include "MemoryPool.h"
+#include "Tensor.h"
+#include "CashedTensor.h"
+
+BOOST_AUTO_TEST_CASE(TestMemoryPool)
+{
+	MemoryPool pool;
+
+	// blocks are aligned, the released blocks are reused by the allocations of the same size class
+	std::vector<void*> blocks;
+	for (size_t num_bytes = 1; num_bytes < 100000; num_bytes = num_bytes*3 + 1)
+	{
+		void* block = pool.Allocate(num_bytes);
+		BOOST_CHECK_EQUAL( reinterpret_cast<size_t>(block) % MemoryPool::alignment, 0 );
+		memset(block, 1, num_bytes);
+		blocks.push_back(block);
+	}
+	MemoryPoolStatistics statistics = pool.GetStatistics();
+	BOOST_CHECK_EQUAL( statistics.num_allocations, blocks.size() );
+	BOOST_CHECK_EQUAL( statistics.num_system_allocations, blocks.size() );
+	BOOST_CHECK_EQUAL( statistics.bytes_cached, 0 );
+	BOOST_CHECK( statistics.bytes_in_use > 100000 );
+
+	for (size_t i=0; i<blocks.size(); i++)
+		pool.Deallocate(blocks[i]);
+	statistics = pool.GetStatistics();
+	BOOST_CHECK_EQUAL( statistics.bytes_in_use, 0 );
+	BOOST_CHECK_EQUAL( statistics.bytes_cached, statistics.peak_bytes_in_use );
+
+	// the blocks of 1 to 40 bytes are in the class of 64 bytes, the last released one is reused first
+	void* block1 = pool.Allocate(60);
+	void* block2 = pool.Allocate(100);
+	BOOST_CHECK( block1 == blocks[3] );
+	BOOST_CHECK( block2 == blocks[4] );
+	statistics = pool.GetStatistics();
+	BOOST_CHECK_EQUAL( statistics.num_pool_hits, 2 );
+	BOOST_CHECK_EQUAL( statistics.num_system_allocations, blocks.size() );
+	pool.Deallocate(block1);
+	pool.Deallocate(block2);
+
+	pool.ReleaseCachedBlocks();
+	statistics = pool.GetStatistics();
+	BOOST_CHECK_EQUAL( statistics.bytes_cached, 0 );
+	void* block3 = pool.Allocate(60);
+	BOOST_CHECK_EQUAL( pool.GetStatistics().num_system_allocations, blocks.size()+1 );
+	pool.Deallocate(block3);
+
+	// the large page blocks are usable whether or not the system provides the large pages
+	pool.SetUseLargePages(true);
+	double* large_block = static_cast<double*>( pool.Allocate(MemoryPool::large_page_size) );
+	BOOST_CHECK_EQUAL( reinterpret_cast<size_t>(large_block) % MemoryPool::alignment, 0 );
+	large_block[MemoryPool::large_page_size/sizeof(double)-1] = 1;
+	pool.Deallocate(large_block);
+
+	// the blocks above the pooled size are allocated with their sizes rounded up to the alignment and are not cached
+	MemoryPool small_pool(1024);
+	void* unpooled_block = small_pool.Allocate(3000);
+	BOOST_CHECK_EQUAL( small_pool.GetStatistics().bytes_in_use, 3008 );
+	small_pool.Deallocate(unpooled_block);
+	BOOST_CHECK_EQUAL( small_pool.GetStatistics().bytes_cached, 0 );
+	small_pool.Deallocate(small_pool.Allocate(1000));
+	BOOST_CHECK_EQUAL( small_pool.GetStatistics().bytes_cached, 1024 );
+}
+
+BOOST_AUTO_TEST_CASE(TestMemoryPoolLargeBlocks)
+{
+	// the blocks above 64 KB are rounded up to eighths of a power of 2, not to the next power of 2
+	MemoryPool pool;
+	for (size_t num_bytes = 65537; num_bytes < 40*1024*1024; num_bytes = num_bytes*3 + 1)
+	{
+		void* block = pool.Allocate(num_bytes);
+		size_t block_size = pool.GetStatistics().bytes_in_use;
+		BOOST_CHECK( block_size >= num_bytes );
+		BOOST_CHECK( block_size <= num_bytes + num_bytes/8 + MemoryPool::alignment );
+		pool.Deallocate(block);
+		pool.ReleaseCachedBlocks();
+	}
+
+	// the blocks of the same class are reused, the blocks of the next class are not
+	void* block1 = pool.Allocate(100000);
+	pool.Deallocate(block1);
+	void* block2 = pool.Allocate(99000);
+	BOOST_CHECK( block2 == block1 );
+	void* block3 = pool.Allocate(70000);
+	BOOST_CHECK_EQUAL( pool.GetStatistics().num_pool_hits, 1 );
+	pool.Deallocate(block2);
+	pool.Deallocate(block3);
+
+	// the blocks above the default pooled size, e.g. the arena of a dataset, are not cached
+	void* dataset_block = pool.Allocate(33*1024*1024 + 1);
+	BOOST_CHECK_EQUAL( pool.GetStatistics().bytes_in_use, 33*1024*1024 + MemoryPool::alignment );
+	size_t bytes_cached = pool.GetStatistics().bytes_cached;
+	pool.Deallocate(dataset_block);
+	BOOST_CHECK_EQUAL( pool.GetStatistics().bytes_cached, bytes_cached );
+}
+
+namespace
+{
+	void CheckPoolAllocatedBuffers(std::vector<size_t> dims)
+	{
+		Tensor<float> tensor(dims);
+		BOOST_CHECK_EQUAL( reinterpret_cast<size_t>(tensor.GetStartPtr()) % MemoryPool::alignment, 0 );
+		Tensor<float> tensor_copy(tensor);
+		BOOST_CHECK( tensor_copy == tensor );
+		CashedTensor<double> buffer;
+		buffer.Update(dims);
+		BOOST_CHECK_EQUAL( reinterpret_cast<size_t>(buffer()->GetStartPtr()) % MemoryPool::alignment, 0 );
+
+		PoolVector<double>::type vector(Tensor<double>::Numel(dims), 1.0);
+		BOOST_CHECK_EQUAL( reinterpret_cast<size_t>(vector.data()) % MemoryPool::alignment, 0 );
+	}
+}
+
+BOOST_AUTO_TEST_CASE(TestPoolAllocatedBuffers)
+{
+	// tensors and buffers that change size between minibatches reuse the memory of the pool after the first minibatch
+	std::vector<size_t> dims; dims.push_back(7); dims.push_back(33);
+	CheckPoolAllocatedBuffers(dims);
+	MemoryPoolStatistics statistics_before = MemoryPool::GetInstance().GetStatistics();
+	for (size_t batch_size = 32; batch_size > 29; batch_size--)
+	{
+		dims[1] = batch_size;
+		CheckPoolAllocatedBuffers(dims);
+	}
+	MemoryPoolStatistics statistics_after = MemoryPool::GetInstance().GetStatistics();
+	BOOST_CHECK_EQUAL( statistics_after.num_system_allocations, statistics_before.num_system_allocations );
+	BOOST_CHECK( statistics_after.num_pool_hits > statistics_before.num_pool_hits );
+}
@@ -0,0 +1,110 @@
+#include <boost/test/unit_test.hpp>
+#include <vector>
+#include <memory>
+#include <sstream>
+#include "Tensor.h"
+#include "GaussianInitializer.h"
+#include "LinearMixModule.h"
+#include "TanhModule.h"
+#include "CompositeModule.h"
+#include "MseCostModule.h"
+#include "FullTensorDataLoader.h"
+#include "TrainDataset.h"
+#include "ModuleProfiler.h"
+#include "NN.h"
+#include "test_utilities.h"
+
+BOOST_AUTO_TEST_CASE(TestModuleProfiler)
+{
+	size_t num_samples = 20;
+	std::vector< std::shared_ptr< Tensor<float> > > train_input(num_samples);
+	std::vector< std::shared_ptr< Tensor<float> > > train_output(num_samples);
+	std::vector<float> train_importance(num_samples, 1);
+	std::vector<size_t> case_input_dims(1, 9);
+	std::vector<size_t> case_output_dims(1, 5);
+	for (size_t i=0; i<num_samples; i++)
+	{
+		train_input[i] = GetRandomTensorPtr<float>(case_input_dims);
+		train_output[i] = GetRandomTensorPtr<float>(case_output_dims);
+	}
+	std::shared_ptr< ITensorDataLoader<float> > input_data_loader(new FullTensorDataLoader<float,float>(train_input));
+	std::shared_ptr< ITensorDataLoader<float> > output_data_loader(new FullTensorDataLoader<float,float>(train_output));
+	TrainDataset<float> train_dataset(input_data_loader, output_data_loader, train_importance);
+
+	std::shared_ptr<ParametersInitializer<float>> initializer(new GaussianInitializer<float>());
+	std::vector< std::shared_ptr< Module<float> > > modules;
+	modules.push_back(std::shared_ptr< Module<float> >( new LinearMixModule<float>("linear_mix", 9, 8, initializer) ));
+	modules.push_back(std::shared_ptr< Module<float> >( new TanhModule<float>("tanh") ));
+	modules.push_back(std::shared_ptr< Module<float> >( new LinearMixModule<float>("output", 8, 5, initializer) ));
+	std::shared_ptr< CompositeModule<float> > main_module(new CompositeModule<float>("network", modules));
+	NN<float> net(main_module, 5);
+	net.InitializeParameters();
+	MseCostModule<float> cost_module;
+
+	// not recorded before the profiling is enabled
+	net.GetGradientsAndCost(train_dataset, cost_module);
+	BOOST_CHECK(!net.GetProfiling());
+	BOOST_CHECK(net.GetProfile().empty());
+
+	net.SetProfiling(true);
+	net.GetGradientsAndCost(train_dataset, cost_module);
+	std::map<std::string, ModuleProfile> profile = net.GetProfile();
+	BOOST_CHECK_EQUAL(profile.size(), 5);
+	const char* module_names[] = {"network", "linear_mix", "tanh", "output"};
+	for (size_t i=0; i<4; i++)
+	{
+		const ModuleProfile& module_profile = profile[module_names[i]];
+		BOOST_CHECK_EQUAL(module_profile.train_fprop_calls, 4);
+		BOOST_CHECK_EQUAL(module_profile.bprop_calls, 4);
+		BOOST_CHECK_EQUAL(module_profile.predict_fprop_calls, 0);
+		BOOST_CHECK(module_profile.train_fprop_time >= 0 && module_profile.bprop_time >= 0);
+		// the buffers were allocated before the profiling
+		BOOST_CHECK_EQUAL(module_profile.buffer_allocations, 0);
+	}
+	BOOST_CHECK_EQUAL(profile["linear_mix"].type, "LinearMixModule");
+	// input and output in fprop, output gradients and input gradients in bprop
+	BOOST_CHECK_EQUAL(profile["linear_mix"].buffer_bytes, 4 * 2 * (9*5 + 8*5) * sizeof(float));
+	BOOST_CHECK_EQUAL(profile["cost_module"].cost_calls, 4);
+	BOOST_CHECK_EQUAL(profile["cost_module"].bprop_calls, 4);
+	BOOST_CHECK(profile["network"].GetTotalTime() >= profile["tanh"].GetTotalTime());
+	// the cost module is profiled only during the calls of the network
+	BOOST_CHECK(!cost_module.GetProfiler());
+
+	net.ResetProfile();
+	net.GetCost(train_dataset, cost_module, std::vector<size_t>(), false);
+	profile = net.GetProfile();
+	BOOST_CHECK_EQUAL(profile["output"].predict_fprop_calls, 4);
+	BOOST_CHECK_EQUAL(profile["output"].train_fprop_calls, 0);
+	BOOST_CHECK_EQUAL(profile["cost_module"].cost_calls, 4);
+
+	// the replicas of the network record to the same profiler, their buffers are allocated by the first call
+	net.ResetProfile();
+	net.SetNumThreads(2);
+	net.GetGradientsAndCost(train_dataset, cost_module);
+	profile = net.GetProfile();
+	BOOST_CHECK_EQUAL(profile["tanh"].train_fprop_calls, 4);
+	BOOST_CHECK_EQUAL(profile["tanh"].bprop_calls, 4);
+	BOOST_CHECK(profile["tanh"].buffer_allocations > 0);
+	size_t allocations = profile["tanh"].buffer_allocations;
+	net.GetGradientsAndCost(train_dataset, cost_module);
+	BOOST_CHECK_EQUAL(net.GetProfile()["tanh"].buffer_allocations, allocations);
+
+	std::ostringstream report;
+	net.WriteProfileReport(report);
+	BOOST_CHECK(report.str().find("linear_mix") != std::string::npos);
+
+	// the profiler of the caller is given back to the cost module after the call
+	std::shared_ptr<ModuleProfiler> cost_profiler(new ModuleProfiler());
+	cost_module.SetProfiler(cost_profiler);
+	net.GetGradientsAndCost(train_dataset, cost_module);
+	BOOST_CHECK(cost_module.GetProfiler() == cost_profiler);
+	BOOST_CHECK(cost_profiler->GetProfiles().empty());
+
+	// the cost module of an unprofiled network keeps recording to the profiler of the caller
+	net.SetProfiling(false);
+	net.GetGradientsAndCost(train_dataset, cost_module);
+	BOOST_CHECK(net.GetProfile().empty());
+	BOOST_CHECK(!main_module->GetModule("tanh")->GetProfiler());
+	BOOST_CHECK(cost_module.GetProfiler() == cost_profiler);
+	BOOST_CHECK_EQUAL(cost_profiler->GetProfiles()["cost_module"].cost_calls, 4);
+}
@@ -0,0 +1,83 @@
+#include <boost/test/unit_test.hpp>
+#include <vector>
+#include <memory>
+#include "Tensor.h"
+#include "FullTensorDataLoader.h"
+#include "PrefetchingTrainDataset.h"
+#include "test_utilities.h"
+
+namespace
+{
+	// all the elements of the sample equal value
+	bool SampleEquals(const float* sample, size_t numel, float value)
+	{
+		for (size_t i=0; i<numel; i++)
+			if (sample[i] != value)
+				return false;
+		return true;
+	}
+}
+
+BOOST_AUTO_TEST_CASE(test_prefetching_train_dataset)
+{
+	size_t num_samples = 50;
+	std::vector<size_t> input_dims;input_dims.push_back(3);input_dims.push_back(2);
+	std::vector<size_t> output_dims;output_dims.push_back(4);
+	std::vector< std::shared_ptr< Tensor<float> > > input_cases;
+	std::vector< std::shared_ptr< Tensor<float> > > output_cases;
+	std::vector<float> importance;
+	for (size_t i=0; i<num_samples; i++)
+	{
+		input_cases.push_back(std::shared_ptr< Tensor<float> >(new Tensor<float>(input_dims)));
+		std::fill(input_cases[i]->GetStartPtr(), input_cases[i]->GetStartPtr()+6, static_cast<float>(i));
+		output_cases.push_back(std::shared_ptr< Tensor<float> >(new Tensor<float>(output_dims)));
+		std::fill(output_cases[i]->GetStartPtr(), output_cases[i]->GetStartPtr()+4, static_cast<float>(2*i));
+		importance.push_back(static_cast<float>(i+1));
+	}
+
+	std::shared_ptr< ITensorDataLoader<float> > input_data_loader( new FullTensorDataLoader<float,float>(input_cases) );
+	std::shared_ptr< ITensorDataLoader<float> > output_data_loader( new FullTensorDataLoader<float,float>(output_cases) );
+	std::shared_ptr< ITrainDataset<float> > dataset( new TrainDataset<float>(input_data_loader, output_data_loader, importance) );
+	PrefetchingTrainDataset<float> prefetching_dataset(dataset, 5, 3);
+	BOOST_CHECK( prefetching_dataset.GetNumSamples() == num_samples );
+
+	bool data_ok = true;
+	for (size_t batch_ind=0; batch_ind<40; batch_ind++)
+	{
+		std::vector<size_t> inds = prefetching_dataset.SelectIndices(5);
+		BOOST_REQUIRE( inds.size() == 5 );
+
+		// whole minibatch
+		std::shared_ptr< Tensor<float> > input = prefetching_dataset.GetInput(inds);
+		std::shared_ptr< Tensor<float> > output = prefetching_dataset.GetOutput(inds);
+		std::vector<float> batch_importance = prefetching_dataset.GetImportance(inds);
+		data_ok = data_ok && input->GetDimensionSize(2) == 5 && output->GetDimensionSize(1) == 5 && batch_importance.size() == 5;
+		for (size_t i=0; i<inds.size(); i++)
+		{
+			data_ok = data_ok && SampleEquals(input->GetStartPtr()+6*i, 6, static_cast<float>(inds[i]));
+			data_ok = data_ok && SampleEquals(output->GetStartPtr()+4*i, 4, static_cast<float>(2*inds[i]));
+			data_ok = data_ok && batch_importance[i] == inds[i]+1;
+		}
+
+		// a part of the minibatch, as requested by NN with a smaller buffer
+		std::vector<size_t> part_inds(inds.begin()+2, inds.begin()+4);
+		std::shared_ptr< Tensor<float> > part_input = prefetching_dataset.GetInput(part_inds);
+		std::vector<float> part_importance = prefetching_dataset.GetImportance(part_inds);
+		data_ok = data_ok && part_input->GetDimensionSize(2) == 2 && part_importance.size() == 2;
+		for (size_t i=0; i<part_inds.size(); i++)
+		{
+			data_ok = data_ok && SampleEquals(part_input->GetStartPtr()+6*i, 6, static_cast<float>(part_inds[i]));
+			data_ok = data_ok && part_importance[i] == part_inds[i]+1;
+		}
+	}
+	BOOST_CHECK( data_ok );
+
+	// requests that were not prepared are passed to the dataset
+	std::vector<size_t> inds = prefetching_dataset.SelectIndices(100);
+	BOOST_CHECK( inds.size() == num_samples );
+	inds.resize(7);
+	std::shared_ptr< Tensor<float> > input = prefetching_dataset.GetInput(inds);
+	BOOST_CHECK( input->GetDimensionSize(2) == 7 );
+	for (size_t i=0; i<inds.size(); i++)
+		BOOST_CHECK( SampleEquals(input->GetStartPtr()+6*i, 6, static_cast<float>(inds[i])) );
+}
@@ -0,0 +1,151 @@
+#include <boost/test/unit_test.hpp>
+#include <vector>
+#include <cmath>
+#include <cstdint>
+#include "RandomStream.h"
+#include "RandomGenerator.h"
+#include "test_utilities.h"
+
+// known answers of Philox4x32-10 from Random123
+BOOST_AUTO_TEST_CASE(TestRandomStreamKnownAnswers)
+{
+	RandomStream zero_stream(0, 0);
+	uint32_t zero_expected[] = {0x6627e8d5, 0xe169c58d, 0xbc57ac4c, 0x9b00dbd8};
+	for (size_t i=0; i<4; i++)
+		BOOST_CHECK_EQUAL(zero_stream.NextUInt32(), zero_expected[i]);
+
+	RandomStream ones_stream(0xffffffffffffffffULL, 0xffffffffffffffffULL);
+	ones_stream.SetPosition(0xffffffffffffffffULL);
+	uint32_t ones_expected[] = {0x408f276d, 0x41c83b0e, 0xa20bc7c6, 0x6d5451fd};
+	for (size_t i=0; i<4; i++)
+		BOOST_CHECK_EQUAL(ones_stream.NextUInt32(), ones_expected[i]);
+
+	RandomStream pi_stream(0x299f31d0a4093822ULL, 0x0370734413198a2eULL);
+	pi_stream.SetPosition(0x85a308d3243f6a88ULL);
+	uint32_t pi_expected[] = {0xd16cfe09, 0x94fdcceb, 0x5001e420, 0x24126ea1};
+	for (size_t i=0; i<4; i++)
+		BOOST_CHECK_EQUAL(pi_stream.NextUInt32(), pi_expected[i]);
+}
+
+BOOST_AUTO_TEST_CASE(TestRandomStreamFill)
+{
+	RandomStream stream(17, 3);
+	RandomStream bulk_stream(17, 3);
+	// unaligned to the blocks and larger than the vectorized part
+	std::vector<uint32_t> values(1003);
+	bulk_stream.NextUInt32();
+	bulk_stream.FillUInt32(&values[0], values.size());
+	stream.NextUInt32();
+	for (size_t i=0; i<values.size(); i++)
+		BOOST_CHECK_EQUAL(values[i], stream.NextUInt32());
+	BOOST_CHECK_EQUAL(bulk_stream.NextUInt32(), stream.NextUInt32());
+
+	// the same position gives the same numbers
+	stream.SetPosition(10);
+	uint32_t value = stream.NextUInt32();
+	bulk_stream.SetPosition(10);
+	BOOST_CHECK_EQUAL(value, bulk_stream.NextUInt32());
+}
+
+BOOST_AUTO_TEST_CASE(TestRandomStreamSplit)
+{
+	RandomStream stream(5, 1);
+	RandomStream substream1 = stream.Split(0);
+	RandomStream substream2 = stream.Split(1);
+	BOOST_CHECK_EQUAL(substream1.GetSeed(), 5);
+	BOOST_CHECK(substream1.GetStreamId() != substream2.GetStreamId());
+	BOOST_CHECK(substream1.GetStreamId() != stream.GetStreamId());
+	// does not depend on the position of the stream
+	stream.NextUInt32();
+	BOOST_CHECK_EQUAL(stream.Split(1).GetStreamId(), substream2.GetStreamId());
+	BOOST_CHECK(RandomStream(6, 1).Split(1).GetStreamId() != substream2.GetStreamId());
+
+	size_t num_equal = 0;
+	for (size_t i=0; i<1000; i++)
+		num_equal += static_cast<size_t>(substream1.NextUInt32() == substream2.NextUInt32());
+	BOOST_CHECK(num_equal < 3);
+}
+
+BOOST_AUTO_TEST_CASE(TestRandomStreamDistributions)
+{
+	RandomStream stream(42);
+	size_t num_values = 100000;
+	std::vector<float> uniform(num_values);
+	stream.FillUniform(&uniform[0], num_values, -1.0f, 3.0f);
+	double mean = 0;
+	for (size_t i=0; i<num_values; i++)
+	{
+		BOOST_CHECK(uniform[i] > -1 && uniform[i] < 3);
+		mean += uniform[i];
+	}
+	BOOST_CHECK(std::abs(mean / num_values - 1) < 0.02);
+
+	// odd number of values, the last pair is used partially
+	std::vector<double> normal(num_values+1);
+	stream.FillNormal(&normal[0], normal.size(), 2.0, 0.5);
+	mean = 0;
+	double sum_of_squares = 0;
+	for (size_t i=0; i<normal.size(); i++)
+	{
+		mean += normal[i];
+		sum_of_squares += normal[i]*normal[i];
+	}
+	mean /= normal.size();
+	BOOST_CHECK(std::abs(mean - 2) < 0.01);
+	BOOST_CHECK(std::abs(std::sqrt(sum_of_squares / normal.size() - mean*mean) - 0.5) < 0.01);
+
+	std::vector<double> bernoulli(num_values);
+	stream.FillBernoulli(&bernoulli[0], num_values, 0.3);
+	double num_ones = 0;
+	for (size_t i=0; i<num_values; i++)
+	{
+		BOOST_CHECK(bernoulli[i] == 0 || bernoulli[i] == 1);
+		num_ones += bernoulli[i];
+	}
+	BOOST_CHECK(std::abs(num_ones / num_values - 0.3) < 0.01);
+
+	for (size_t i=0; i<1000; i++)
+	{
+		int value = stream.GetUniformInt(-2, 2);
+		BOOST_CHECK(value >= -2 && value <= 2);
+		double double_value = stream.GetUniformDouble(0, 1);
+		BOOST_CHECK(double_value >= 0 && double_value < 1);
+	}
+}
+
+BOOST_AUTO_TEST_CASE(TestRandomStreamBernoulliBits)
+{
+	// the same numbers as FillBernoulli, the last word is partial
+	size_t num_values = 1000;
+	std::vector<float> bernoulli(num_values);
+	RandomStream(7).FillBernoulli(&bernoulli[0], num_values, 0.4);
+	std::vector<uint32_t> bits((num_values+31)/32);
+	RandomStream(7).FillBernoulliBits(&bits[0], num_values, 0.4);
+	for (size_t i=0; i<num_values; i++)
+		BOOST_CHECK_EQUAL((bits[i/32] >> (i%32)) & 1, static_cast<uint32_t>(bernoulli[i]));
+	BOOST_CHECK_EQUAL(bits.back() >> (num_values%32), 0);
+
+	RandomStream(7).FillBernoulliBits(&bits[0], num_values, 1);
+	BOOST_CHECK_EQUAL(bits[0], 0xFFFFFFFFu);
+	BOOST_CHECK_EQUAL(bits.back(), (1u << (num_values%32)) - 1);
+	RandomStream(7).FillBernoulliBits(&bits[0], num_values, 0);
+	BOOST_CHECK_EQUAL(bits[0], 0);
+}
+
+BOOST_AUTO_TEST_CASE(TestRandomGeneratorCreateStream)
+{
+	RandomGenerator::SetSeed(123);
+	RandomStream stream1 = RandomGenerator::CreateStream();
+	RandomStream stream2 = RandomGenerator::CreateStream();
+	double value = RandomGenerator::GetUniformDouble(0, 1);
+	BOOST_CHECK(stream1.GetStreamId() != stream2.GetStreamId());
+
+	RandomGenerator::SetSeed(123);
+	RandomStream stream1_again = RandomGenerator::CreateStream();
+	RandomGenerator::CreateStream();
+	BOOST_CHECK_EQUAL(stream1.GetSeed(), stream1_again.GetSeed());
+	BOOST_CHECK_EQUAL(stream1.GetStreamId(), stream1_again.GetStreamId());
+	BOOST_CHECK_EQUAL(stream1.NextUInt32(), stream1_again.NextUInt32());
+	BOOST_CHECK_EQUAL(value, RandomGenerator::GetUniformDouble(0, 1));
+	RandomGenerator::SetSeed(0);
+}
@@ -11,6 +11,8 @@
 #include "CompositeModule.h"
 #include "FullTensorDataLoader.h"
 #include "TrainDataset.h"
+#include "NN.h"
+#include "SGD_Trainer.h"
 #include "test_utilities.h"
 
 BOOST_AUTO_TEST_CASE(TestSoftmaxModule)
@@ -81,4 +83,134 @@ BOOST_AUTO_TEST_CASE(TestSoftmaxGradient)
 	BOOST_CHECK(NumericalCheckNNGradients(net, CrossEntropyCostModule<double>(), train_dataset));
 	
 	BOOST_CHECK( test_save_load_nn_state(net) );
-}
\ No newline at end of file
+}
+
+BOOST_AUTO_TEST_CASE(TestSoftmaxModuleStability)
+{
+	// exp() of the inputs overflows floats, the outputs depend only on the differences of the inputs
+	float input[] = {1000, 1001, 999, 1002, -1000, -999, -1001, -998};
+	float expected_output[] = {0.0871f, 0.2369f, 0.0321f, 0.6439f, 0.0871f, 0.2369f, 0.0321f, 0.6439f};
+	std::vector<size_t> input_dims; input_dims.push_back(4); input_dims.push_back(2);
+	std::shared_ptr< Tensor<float> > input_tensor( new Tensor<float>(input_dims) );
+	std::copy(input, input+8, input_tensor->GetStartPtr());
+
+	const ExpPrecision precisions[] = {precise_exp, vectorized_exp, fast_exp};
+	for (size_t i=0; i<3; i++)
+	{
+		SoftmaxModule<float> a("module1");
+		a.SetExpPrecision(precisions[i]);
+		BOOST_CHECK(test_equal_arrays(expected_output, a.train_fprop(input_tensor)->GetStartPtr(), 8));
+	}
+
+	// enough features for the vectorized code
+	std::vector<size_t> dims; dims.push_back(37); dims.push_back(3);
+	std::shared_ptr< Tensor<float> > random_input = GetRandomTensorPtr<float>(dims, -20, 20);
+	SoftmaxModule<float> precise_softmax("precise"), fast_softmax("fast");
+	precise_softmax.SetExpPrecision(precise_exp);
+	fast_softmax.SetExpPrecision(fast_exp);
+	std::shared_ptr< Tensor<float> > precise_output = precise_softmax.train_fprop(random_input);
+	std::shared_ptr< Tensor<float> > fast_output = fast_softmax.train_fprop(random_input);
+	for (size_t i=0; i<precise_output->Numel(); i++)
+		BOOST_CHECK( std::abs((*fast_output)[i]-(*precise_output)[i]) <= 2e-4*(*precise_output)[i] + 1e-7 );
+}
+
+BOOST_AUTO_TEST_CASE(TestSoftmaxFusedCrossEntropyGradient)
+{
+	size_t num_samples = 15;
+	std::vector< std::shared_ptr< Tensor<double> > > train_input(num_samples);
+	std::vector< std::shared_ptr< Tensor<double> > > train_output(num_samples);
+	std::vector<double> train_importance(num_samples);
+	std::vector<size_t> case_input_dims;case_input_dims.push_back(9);
+	std::vector<size_t> case_output_dims;case_output_dims.push_back(5);
+	for (size_t i=0; i<num_samples; i++)
+	{
+		train_input[i] = GetRandomTensorPtr<double>(case_input_dims);
+		// the expected outputs do not have to sum to one
+		train_output[i] = GetRandomTensorPtr<double>(case_output_dims, 0.005, 0.995);
+		train_importance[i]  = i+1.0;
+	}
+	std::shared_ptr< ITensorDataLoader<double> > input_data_loader(new FullTensorDataLoader<double,double>(train_input));
+	std::shared_ptr< ITensorDataLoader<double> > output_data_loader(new FullTensorDataLoader<double,double>(train_output));
+	TrainDataset<double> train_dataset(input_data_loader, output_data_loader, train_importance);
+
+	std::shared_ptr<ParametersInitializer<double>> initializer(new GaussianInitializer<double>());
+	std::shared_ptr< Module<double> > m1(new LinearMixModule<double>("module1", 9,5,initializer));
+	std::shared_ptr< SoftmaxModule<double> > m2(new SoftmaxModule<double>("module2"));
+	std::vector< std::shared_ptr< Module<double> > > modules; modules.push_back(m1); modules.push_back(m2);
+	std::shared_ptr< CompositeModule<double> > main_module(new CompositeModule<double>("module3", modules));
+	NN<double> net(main_module, 4);
+	net.InitializeParameters();
+
+	CrossEntropyCostModule<double> cost_module;
+	CostAndGradients<double> unfused = net.GetGradientsAndCost(train_dataset, cost_module);
+	double unfused_cost = unfused.cost;
+	std::vector<double> unfused_gradients = unfused.gradients;
+
+	cost_module.FuseSoftmax(*m2);
+	BOOST_CHECK(cost_module.IsSoftmaxFused() && m2->GetFusedCrossEntropy());
+	BOOST_CHECK(!m2->AlocateInputGradientsBuffer());
+	CostAndGradients<double> fused = net.GetGradientsAndCost(train_dataset, cost_module);
+	BOOST_CHECK_CLOSE(fused.cost, unfused_cost, 1e-8);
+	BOOST_CHECK(test_equal_arrays(unfused_gradients.data(), fused.gradients.data(), static_cast<int>(unfused_gradients.size()), 1e-6));
+	BOOST_CHECK(NumericalCheckNNGradients(net, cost_module, train_dataset));
+
+	// the replicas of the threads copy the fusion with the train state of the network
+	net.SetNumThreads(2);
+	std::vector<double>& parallel_gradients = net.GetGradientsAndCost(train_dataset, cost_module).gradients;
+	BOOST_CHECK(test_equal_arrays(unfused_gradients.data(), parallel_gradients.data(), static_cast<int>(unfused_gradients.size()), 1e-6));
+	BOOST_CHECK( test_save_load_nn_state(net) );
+
+	// the fusion is not saved, a loaded network is trained correctly with a cost module that is not fused
+	std::shared_ptr< NN<double> > loaded_net = NN<double>::Create(*net.GetState());
+	CrossEntropyCostModule<double> new_cost_module;
+	std::vector<double>& loaded_gradients = loaded_net->GetGradientsAndCost(train_dataset, new_cost_module).gradients;
+	BOOST_CHECK(test_equal_arrays(unfused_gradients.data(), loaded_gradients.data(), static_cast<int>(unfused_gradients.size()), 1e-6));
+
+	// the fused network is not trained with another cost module and the fused cost module is not used with another network
+	BOOST_CHECK_THROW(net.GetGradientsAndCost(train_dataset, new_cost_module), std::runtime_error);
+	BOOST_CHECK_THROW(loaded_net->GetGradientsAndCost(train_dataset, cost_module), std::runtime_error);
+
+	cost_module.Unfuse();
+	BOOST_CHECK(!cost_module.IsSoftmaxFused() && !m2->GetFusedCrossEntropy());
+	CostAndGradients<double> unfused_again = net.GetGradientsAndCost(train_dataset, new_cost_module);
+	BOOST_CHECK(test_equal_arrays(unfused_gradients.data(), unfused_again.gradients.data(), static_cast<int>(unfused_gradients.size()), 1e-6));
+}
+
+BOOST_AUTO_TEST_CASE(TestSoftmaxFusedCrossEntropyTraining)
+{
+	size_t num_samples = 40;
+	std::vector< std::shared_ptr< Tensor<double> > > train_input(num_samples);
+	std::vector< std::shared_ptr< Tensor<double> > > train_output(num_samples);
+	std::vector<double> train_importance(num_samples, 1);
+	std::vector<size_t> case_input_dims(1, 9);
+	std::vector<size_t> case_output_dims(1, 5);
+	for (size_t i=0; i<num_samples; i++)
+	{
+		train_input[i] = GetRandomTensorPtr<double>(case_input_dims);
+		train_output[i] = GetRandomTensorPtr<double>(case_output_dims, 0.005, 0.995);
+	}
+	std::shared_ptr< ITensorDataLoader<double> > input_data_loader(new FullTensorDataLoader<double,double>(train_input));
+	std::shared_ptr< ITensorDataLoader<double> > output_data_loader(new FullTensorDataLoader<double,double>(train_output));
+	TrainDataset<double> train_dataset(input_data_loader, output_data_loader, train_importance);
+
+	std::shared_ptr<ParametersInitializer<double>> initializer(new GaussianInitializer<double>());
+	std::shared_ptr< Module<double> > m1(new LinearMixModule<double>("module1", 9,5,initializer));
+	std::shared_ptr< SoftmaxModule<double> > m2(new SoftmaxModule<double>("module2"));
+	std::vector< std::shared_ptr< Module<double> > > modules; modules.push_back(m1); modules.push_back(m2);
+	std::shared_ptr< CompositeModule<double> > main_module(new CompositeModule<double>("module3", modules));
+	NN<double> net(main_module, 8);
+	net.InitializeParameters();
+
+	// the trainer fuses the cost module with the softmax for the training call only
+	CrossEntropyCostModule<double> cost_module;
+	std::vector<size_t> all_indices;
+	double initial_cost = net.GetCost(train_dataset, cost_module, all_indices, false);
+	size_t num_fused_results = 0;
+	SGD_Trainer<double> trainer(200, 0.1, 0.9, 8, 40, 0.9, 0, 50, 10, 0, 0.5);
+	trainer.Train(net, cost_module, cost_module, train_dataset, train_dataset, 
+		[&](TrainCallbackParams<double>&) { num_fused_results += cost_module.GetFusedModule() == m2.get() && m2->GetFusedCrossEntropy(); },
+		[&](ValidationCallbackParams<double>&) { num_fused_results += cost_module.GetFusedModule() == m2.get() && m2->GetFusedCrossEntropy(); });
+	BOOST_CHECK_EQUAL(num_fused_results, 20);
+	BOOST_CHECK(!cost_module.IsSoftmaxFused() && !m2->GetFusedCrossEntropy());
+	BOOST_CHECK(net.GetCost(train_dataset, cost_module, all_indices, false) < initial_cost);
+}
@@ -68,4 +68,102 @@ BOOST_AUTO_TEST_CASE(TestTensorComparison)
 	BOOST_CHECK( tensor1 == tensor2 );
 	tensor2 = Tensor<float>(data2, dims1);
 	BOOST_CHECK( tensor1 == tensor2 );
-}
\ No newline at end of file
+}
+
+BOOST_AUTO_TEST_CASE(TestTensorShape)
+{
+	std::vector<size_t> dims; dims.push_back(3); dims.push_back(4); dims.push_back(5);
+	TensorShape shape(dims);
+	BOOST_CHECK_EQUAL( shape.size(), 3 );
+	BOOST_CHECK_EQUAL( shape.Numel(), 60 );
+	BOOST_CHECK_EQUAL( shape.GetStride(0), 1 );
+	BOOST_CHECK_EQUAL( shape.GetStride(1), 3 );
+	BOOST_CHECK_EQUAL( shape.GetStride(2), 12 );
+	BOOST_CHECK( shape.GetDimensions() == dims );
+	BOOST_CHECK( shape.GetStrides() == Tensor<float>::GetStrides(dims) );
+	BOOST_CHECK( shape == dims );
+
+	// removing and adding the last dimension keeps the strides and the number of elements consistent
+	shape.pop_back();
+	BOOST_CHECK_EQUAL( shape.Numel(), 12 );
+	BOOST_CHECK( shape != dims );
+	shape.push_back(0);
+	BOOST_CHECK_EQUAL( shape.Numel(), 0 );
+	shape.pop_back();
+	BOOST_CHECK_EQUAL( shape.Numel(), 12 );
+	shape.push_back(5);
+	BOOST_CHECK( shape == TensorShape(dims) );
+
+	BOOST_CHECK_THROW( TensorShape(std::vector<size_t>(TensorShape::max_rank+1, 1)), std::runtime_error );
+
+	// tensors created from shapes and from dimensions are the same
+	float data[60] = {0};
+	Tensor<float> tensor(data, shape);
+	BOOST_CHECK( tensor == Tensor<float>(data, dims) );
+	BOOST_CHECK( tensor.GetShape() == shape );
+	BOOST_CHECK_EQUAL( tensor.Numel(), 60 );
+	size_t pos[] = {1, 2, 3};
+	BOOST_CHECK_EQUAL( tensor.GetPtr(pos) - data, 1 + 2*3 + 3*12 );
+	BOOST_CHECK( Tensor<float>(shape) == Tensor<float>(dims) );
+}
+
+BOOST_AUTO_TEST_CASE(TestTensorViews)
+{
+	float data[60];
+	for (int i=0; i<60; i++)
+		data[i] = (float)i;
+	std::vector<size_t> dims; dims.push_back(3); dims.push_back(4); dims.push_back(5);
+	Tensor<float> tensor(data, dims);
+	BOOST_CHECK( tensor.IsContiguous() );
+
+	// a slice of the last dimension (e.g. a part of a minibatch) is contiguous
+	Tensor<float> slice = tensor.Slice(2, 1, 3);
+	BOOST_CHECK( slice.IsContiguous() );
+	BOOST_CHECK( !slice.OwnsData() );
+	BOOST_CHECK_EQUAL( slice.GetStartPtr() - data, 12 );
+	BOOST_CHECK_EQUAL( slice.Numel(), 36 );
+
+	// a slice of the first dimension keeps the strides of the tensor
+	Tensor<float> rows = tensor.Slice(0, 1, 2);
+	BOOST_CHECK( !rows.IsContiguous() );
+	size_t pos[] = {1, 2, 3};
+	BOOST_CHECK_EQUAL( *rows.GetPtr(pos), tensor.GetPtr(pos)[1] );
+
+	// a selected element of a dimension removes the dimension
+	Tensor<float> sample = tensor.Select(2, 4);
+	BOOST_CHECK_EQUAL( sample.NumDimensions(), 2 );
+	BOOST_CHECK( sample.IsContiguous() );
+	BOOST_CHECK_EQUAL( sample[0], 48 );
+	Tensor<float> column = tensor.Select(0, 2);
+	BOOST_CHECK( !column.IsContiguous() );
+	BOOST_CHECK_EQUAL( column.GetDimensionSize(0), 4 );
+	BOOST_CHECK_EQUAL( column.GetDimStride(0), 3 );
+
+	// the views are copied in the column-major order of their dimensions
+	Tensor<float> transposed = tensor.Transpose(0, 1);
+	BOOST_CHECK_EQUAL( transposed.GetDimensionSize(0), 4 );
+	BOOST_CHECK_EQUAL( transposed.GetDimensionSize(1), 3 );
+	std::vector<double> copied(60);
+	CopyTensorElements(transposed, copied.data());
+	for (size_t k=0; k<5; k++)
+		for (size_t j=0; j<3; j++)
+			for (size_t i=0; i<4; i++)
+				BOOST_CHECK_EQUAL( copied[i + 4*j + 12*k], data[j + 3*i + 12*k] );
+
+	std::vector<size_t> start; start.push_back(1); start.push_back(1); start.push_back(2);
+	std::vector<size_t> crop_dims; crop_dims.push_back(2); crop_dims.push_back(2); crop_dims.push_back(3);
+	Tensor<float> crop = tensor.Crop(start, crop_dims);
+	BOOST_CHECK( crop.DimensionsEqual(crop_dims) );
+	Tensor<float> crop_copy(crop.GetShape());
+	BOOST_CHECK( crop_copy.IsContiguous() );
+	CopyTensorElements(crop, crop_copy.GetStartPtr());
+	for (size_t k=0; k<3; k++)
+		for (size_t j=0; j<2; j++)
+			for (size_t i=0; i<2; i++)
+				BOOST_CHECK_EQUAL( crop_copy[i + 2*j + 4*k], data[(i+1) + 3*(j+1) + 12*(k+2)] );
+
+	// the views are compared by values
+	BOOST_CHECK( EqualValues(crop, crop_copy) );
+	crop_copy[3] += 1;
+	BOOST_CHECK( !EqualValues(crop, crop_copy) );
+}
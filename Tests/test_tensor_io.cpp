@@ -2,6 +2,7 @@
 #include <sstream>
 #include "test_utilities.h"
 #include "TensorIO.h"
+#include "IOBinary.h"
 
 BOOST_AUTO_TEST_CASE(TestSaveLoadTensor)
 {
@@ -14,6 +15,47 @@ BOOST_AUTO_TEST_CASE(TestSaveLoadTensor)
 	BOOST_CHECK( *input == *input2 );
 }
 
+BOOST_AUTO_TEST_CASE(TestSaveLoadTensorBinary)
+{
+	std::vector<size_t> case_dims;case_dims.push_back(9); case_dims.push_back(8);
+	std::shared_ptr< Tensor<double> > input = GetRandomTensorPtr<double>(case_dims);
+	std::shared_ptr< Tensor<double> > input2 = GetRandomTensorPtr<double>(case_dims);
+
+	std::shared_ptr<IOTreeNode> state( new IOTreeNode() );
+	state->attributes().AppendEntry( "name", "tensors" );
+	state->nodes().AppendEntry( "tensor1", GetTensorState(*input) );
+	state->nodes().AppendEntry( "tensor2", GetTensorState(*input2) );
+
+	std::stringstream stream;
+	IOBinary::save(*state, stream);
+	BOOST_CHECK( IOBinary::IsBinary(stream) );
+	std::shared_ptr<IOTreeNode> loaded_state = IOBinary::load(stream);
+
+	BOOST_CHECK( loaded_state->attributes().GetEntry("name") == "tensors" );
+	BOOST_CHECK( *input == *CreateTensor<double>(*loaded_state->nodes().GetEntry("tensor1")) );
+	BOOST_CHECK( *input2 == *CreateTensor<double>(*loaded_state->nodes().GetEntry("tensor2")) );
+
+	// blobs are aligned in the file
+	std::string data = stream.str();
+	const double* first_element = input->GetStartPtr();
+	size_t first_blob_offset = data.find( std::string(reinterpret_cast<const char*>(first_element), sizeof(double)) );
+	BOOST_CHECK( first_blob_offset % IOBinary::alignment == 0 );
+
+	// parameters saved as double can be loaded as float
+	std::shared_ptr< Tensor<float> > float_tensor = CreateTensor<float>(*loaded_state->nodes().GetEntry("tensor1"));
+	BOOST_CHECK( (*float_tensor)[5] == static_cast<float>((*input)[5]) );
+
+	std::stringstream xml_stream;
+	IOXML::save(*state, xml_stream);
+	BOOST_CHECK( !IOBinary::IsBinary(xml_stream) );
+	BOOST_CHECK_THROW( IOBinary::load(xml_stream), std::runtime_error );
+
+	// unknown versions are rejected
+	data[8] = 2;
+	std::stringstream wrong_version_stream(data);
+	BOOST_CHECK_THROW( IOBinary::load(wrong_version_stream), std::runtime_error );
+}
+
 BOOST_AUTO_TEST_CASE(TestSaveLoadTensorDataset)
 {
 	std::vector<size_t> case_dims; case_dims.push_back(9); case_dims.push_back(8);
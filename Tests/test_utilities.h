@@ -10,6 +10,7 @@
 #include "RandomGenerator.h"
 #include "IOTreeNode.h"
 #include "IOXML.h"
+#include "IOBinary.h"
 
 template <class DataType>
 Tensor<DataType> GetRandomTensor(std::vector<size_t> tensor_dims, double min_val=-1, double max_val=1)
@@ -63,6 +64,21 @@ bool CheckNNGradientsSameForDifferentBufferSizes(NN<double>& nn, CostModule<doub
 	for (size_t i=0; i<num_params; i++)
 		if( abs(gradients1[i] - gradients2[i]) >0.000000001)
 			return false;
+
+	// batches processed by several threads should give the same result
+	size_t initial_num_threads = nn.GetNumThreads();
+	nn.SetNumThreads(3);
+	CostAndGradients<double> res3 = nn.GetGradientsAndCost(dataset, cost_module, std::vector<size_t>(), true);
+	std::vector<double> gradients3 = res3.gradients;
+	double cost3 = res3.cost;
+	nn.SetNumThreads(initial_num_threads);
+
+	if ( abs(cost1 - cost3) > 0.000000001)
+		return false;
+
+	for (size_t i=0; i<num_params; i++)
+		if( abs(gradients1[i] - gradients3[i]) >0.000000001)
+			return false;
 	nn.SetMinibatchSize(initial_buffer_size);
 	return true;
 }
@@ -148,7 +164,16 @@ bool test_save_load_nn_state(NN<T>& net)
 	IOXML::save(*net_state, stream);
 	net_state = IOXML::load(stream);
 	std::shared_ptr< NN<T> > net2 = NN<T>::Create(*net_state);
-	return net.Equals( *net2 );
+	if (!net.Equals( *net2 ))
+		return false;
+
+	// binary format should restore exactly the same parameters
+	net_state = net.GetState();
+	std::stringstream binary_stream;
+	IOBinary::save(*net_state, binary_stream);
+	net_state = IOBinary::load(binary_stream);
+	std::shared_ptr< NN<T> > net3 = NN<T>::Create(*net_state);
+	return net.Equals( *net3 ) && (net.GetParameters() == net3->GetParameters());
 }
 
 template <class DataType>